@@ -39,6 +39,10 @@
 #include "mmcli.h"
 #include "mmcli-common.h"
 
+/* The Test interface is only exported by daemons running in test mode, so
+ * there is no client-side API for it; call the method directly instead */
+#define MM_DBUS_INTERFACE_TEST "org.freedesktop.ModemManager1.Test"
+
 /* Context */
 typedef struct {
     MMManager *manager;
@@ -55,6 +59,7 @@ static gboolean monitor_modems_flag;
 static gboolean scan_modems_flag;
 static gchar *set_logging_str;
 static gchar *report_kernel_event_str;
+static gboolean port_statistics_flag;
 
 #if defined WITH_UDEV
 static gboolean report_kernel_event_auto_scan;
@@ -81,6 +86,10 @@ static GOptionEntry entries[] = {
       "Report kernel event",
       "[\"key=value,...\"]"
     },
+    { "port-statistics", 0, 0, G_OPTION_ARG_NONE, &port_statistics_flag,
+      "Show command latency statistics of the modem ports (requires the Test interface)",
+      NULL
+    },
 #if defined WITH_UDEV
     { "report-kernel-event-auto-scan", 0, 0, G_OPTION_ARG_NONE, &report_kernel_event_auto_scan,
       "Automatically report kernel events based on udev notifications",
@@ -119,7 +128,8 @@ mmcli_manager_options_enabled (void)
                  monitor_modems_flag +
                  scan_modems_flag +
                  !!set_logging_str +
-                 !!report_kernel_event_str);
+                 !!report_kernel_event_str +
+                 port_statistics_flag);
 
 #if defined WITH_UDEV
     n_actions += report_kernel_event_auto_scan;
@@ -265,6 +275,125 @@ scan_devices_ready (MMManager    *manager,
     mmcli_async_operation_done ();
 }
 
+static void
+get_port_statistics_process_reply (GVariant     *statistics,
+                                   const GError *error)
+{
+    GVariantIter iter;
+    GVariant *dict;
+    const gchar *last_port = NULL;
+
+    if (!statistics) {
+        g_printerr ("error: couldn't get port statistics: '%s'\n",
+                    error ? error->message : "unknown error");
+        exit (EXIT_FAILURE);
+    }
+
+    g_print ("\n");
+    if (!g_variant_n_children (statistics)) {
+        g_print ("No port statistics available\n\n");
+        return;
+    }
+
+    g_variant_iter_init (&iter, statistics);
+    while ((dict = g_variant_iter_next_value (&iter))) {
+        const gchar *modem = NULL;
+        const gchar *port = NULL;
+        const gchar *command = NULL;
+        guint32 count = 0, timeouts = 0, errors = 0, max_queue_depth = 0;
+        guint32 queue_time_avg = 0, queue_time_max = 0, wire_time_avg = 0;
+        guint32 total_time_avg = 0, total_time_max = 0;
+        GVariant *histogram;
+        GVariant *bounds;
+        GString *histogram_str;
+        gsize i;
+
+        g_variant_lookup (dict, "modem",           "&s", &modem);
+        g_variant_lookup (dict, "port",            "&s", &port);
+        g_variant_lookup (dict, "command",         "&s", &command);
+        g_variant_lookup (dict, "count",           "u",  &count);
+        g_variant_lookup (dict, "timeouts",        "u",  &timeouts);
+        g_variant_lookup (dict, "errors",          "u",  &errors);
+        g_variant_lookup (dict, "max-queue-depth", "u",  &max_queue_depth);
+        g_variant_lookup (dict, "queue-time-avg",  "u",  &queue_time_avg);
+        g_variant_lookup (dict, "queue-time-max",  "u",  &queue_time_max);
+        g_variant_lookup (dict, "wire-time-avg",   "u",  &wire_time_avg);
+        g_variant_lookup (dict, "total-time-avg",  "u",  &total_time_avg);
+        g_variant_lookup (dict, "total-time-max",  "u",  &total_time_max);
+
+        histogram_str = g_string_new ("");
+        histogram = g_variant_lookup_value (dict, "histogram", G_VARIANT_TYPE ("au"));
+        bounds = g_variant_lookup_value (dict, "histogram-bounds", G_VARIANT_TYPE ("au"));
+        if (histogram && bounds && g_variant_n_children (histogram) == g_variant_n_children (bounds) + 1) {
+            for (i = 0; i < g_variant_n_children (histogram); i++) {
+                guint32 n = 0;
+
+                g_variant_get_child (histogram, i, "u", &n);
+                if (i < g_variant_n_children (bounds)) {
+                    guint32 bound = 0;
+
+                    g_variant_get_child (bounds, i, "u", &bound);
+                    g_string_append_printf (histogram_str, "%s<%u: %u", i ? ", " : "", bound, n);
+                } else
+                    g_string_append_printf (histogram_str, ", more: %u", n);
+            }
+        }
+        if (histogram)
+            g_variant_unref (histogram);
+        if (bounds)
+            g_variant_unref (bounds);
+
+        if (g_strcmp0 (port, last_port) != 0) {
+            g_print ("%s (%s)\n",
+                     port ? port : "unknown",
+                     modem ? modem : "unknown modem");
+            last_port = port;
+        }
+
+        g_print ("\t%s\n"
+                 "\t\tcount: %u, timeouts: %u, errors: %u, max queue depth: %u\n"
+                 "\t\tqueue time: avg %u ms, max %u ms; wire time: avg %u ms\n"
+                 "\t\ttotal time: avg %u ms, max %u ms\n"
+                 "\t\thistogram (ms): %s\n",
+                 command ? command : "unknown",
+                 count, timeouts, errors, max_queue_depth,
+                 queue_time_avg, queue_time_max, wire_time_avg,
+                 total_time_avg, total_time_max,
+                 histogram_str->str);
+
+        g_string_free (histogram_str, TRUE);
+        g_variant_unref (dict);
+    }
+    g_print ("\n");
+}
+
+static GVariant *
+get_port_statistics_unpack (GVariant *reply)
+{
+    GVariant *statistics = NULL;
+
+    if (reply) {
+        g_variant_get (reply, "(@aa{sv})", &statistics);
+        g_variant_unref (reply);
+    }
+    return statistics;
+}
+
+static void
+get_port_statistics_ready (GDBusConnection *connection,
+                           GAsyncResult    *result)
+{
+    GVariant *statistics;
+    GError *error = NULL;
+
+    statistics = get_port_statistics_unpack (g_dbus_connection_call_finish (connection, result, &error));
+    get_port_statistics_process_reply (statistics, error);
+    if (statistics)
+        g_variant_unref (statistics);
+
+    mmcli_async_operation_done ();
+}
+
 static void
 print_modem_short_info (MMObject *modem)
 {
@@ -388,6 +517,23 @@ get_manager_ready (GObject      *source,
         return;
     }
 
+    /* Request to get port statistics? */
+    if (port_statistics_flag) {
+        g_dbus_connection_call (g_dbus_object_manager_client_get_connection (G_DBUS_OBJECT_MANAGER_CLIENT (ctx->manager)),
+                                MM_DBUS_SERVICE,
+                                MM_DBUS_PATH,
+                                MM_DBUS_INTERFACE_TEST,
+                                "GetPortStatistics",
+                                NULL,
+                                G_VARIANT_TYPE ("(aa{sv})"),
+                                G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                -1,
+                                ctx->cancellable,
+                                (GAsyncReadyCallback)get_port_statistics_ready,
+                                NULL);
+        return;
+    }
+
 #if defined WITH_UDEV
     if (report_kernel_event_auto_scan) {
         const gchar *subsys[] = { "tty", "usbmisc", "net", NULL };
@@ -531,6 +677,27 @@ mmcli_manager_run_synchronous (GDBusConnection *connection)
         return;
     }
 
+    /* Request to get port statistics? */
+    if (port_statistics_flag) {
+        GVariant *statistics;
+
+        statistics = get_port_statistics_unpack (g_dbus_connection_call_sync (connection,
+                                                                              MM_DBUS_SERVICE,
+                                                                              MM_DBUS_PATH,
+                                                                              MM_DBUS_INTERFACE_TEST,
+                                                                              "GetPortStatistics",
+                                                                              NULL,
+                                                                              G_VARIANT_TYPE ("(aa{sv})"),
+                                                                              G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                                              -1,
+                                                                              NULL,
+                                                                              &error));
+        get_port_statistics_process_reply (statistics, error);
+        if (statistics)
+            g_variant_unref (statistics);
+        return;
+    }
+
     /* Request to list modems? */
     if (list_modems_flag) {
         list_current_modems (ctx->manager);
@@ -1667,15 +1667,19 @@ mm_utils_ishexstr (const gchar *hex)
 gchar *
 mm_utils_bin2hexstr (const guint8 *bin, gsize len)
 {
-    GString *ret;
+    static const gchar digits[] = "0123456789ABCDEF";
+    gchar *ret;
     gsize i;
 
     g_return_val_if_fail (bin != NULL, NULL);
 
-    ret = g_string_sized_new (len * 2 + 1);
-    for (i = 0; i < len; i++)
-        g_string_append_printf (ret, "%.2X", bin[i]);
-    return g_string_free (ret, FALSE);
+    ret = g_malloc (len * 2 + 1);
+    for (i = 0; i < len; i++) {
+        ret[i * 2]     = digits[bin[i] >> 4];
+        ret[i * 2 + 1] = digits[bin[i] & 0x0F];
+    }
+    ret[len * 2] = '\0';
+    return ret;
 }
 
 gboolean
@@ -21,6 +21,7 @@
 #define _LIBMM_INSIDE_MM
 #include <libmm-glib.h>
 
+#include "mm-modem-helpers.h"
 #include "mm-modem-helpers-altair-lte.h"
 
 #define MM_ALTAIR_IMS_PDN_CID           1
@@ -71,6 +72,8 @@ gchar *
 mm_altair_parse_ceer_response (const gchar *response,
                                GError **error)
 {
+    static MMStaticRegex ceer_regex =
+        MM_STATIC_REGEX_INIT ("\\+CEER:\\s*(\\w*)?", G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info = NULL;
     gchar *ceer_response = NULL;
@@ -86,10 +89,7 @@ mm_altair_parse_ceer_response (const gchar *response,
     /* The response we are interested in looks so:
      * +CEER: EPS_AND_NON_EPS_SERVICES_NOT_ALLOWED
      */
-    r = g_regex_new ("\\+CEER:\\s*(\\w*)?",
-                     G_REGEX_RAW,
-                     0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&ceer_regex);
 
     if (!g_regex_match (r, response, 0, &match_info)) {
         g_set_error (error, MM_CORE_ERROR, MM_CORE_ERROR_FAILED, "Could not parse +CEER response");
@@ -115,12 +115,13 @@ mm_altair_parse_ceer_response (const gchar *response,
 guint
 mm_altair_parse_cid (const gchar *response, GError **error)
 {
+    static MMStaticRegex cginfo_regex =
+        MM_STATIC_REGEX_INIT ("\\%CGINFO:\\s*(\\d+)", G_REGEX_RAW);
     GRegex *regex;
     GMatchInfo *match_info;
     guint cid = -1;
 
-    regex = g_regex_new ("\\%CGINFO:\\s*(\\d+)", G_REGEX_RAW, 0, NULL);
-    g_assert (regex);
+    regex = mm_static_regex_get (&cginfo_regex);
     if (!g_regex_match_full (regex, response, strlen (response), 0, 0, &match_info, error)) {
         g_match_info_free (match_info);
         g_regex_unref (regex);
@@ -151,6 +152,8 @@ typedef enum {
 static guint
 altair_extract_vzw_pco_value (const gchar *pco_payload, GError **error)
 {
+    static MMStaticRegex vzw_pco_value_regex =
+        MM_STATIC_REGEX_INIT ("130184(\\d+)", G_REGEX_RAW);
     GRegex *regex;
     GMatchInfo *match_info;
     guint pco_value = -1;
@@ -158,8 +161,7 @@ altair_extract_vzw_pco_value (const gchar *pco_payload, GError **error)
     /* Extract PCO value from PCO payload.
      * The PCO value in the VZW network is after the VZW PLMN (MCC+MNC 311-480).
      */
-    regex = g_regex_new ("130184(\\d+)", G_REGEX_RAW, 0, NULL);
-    g_assert (regex);
+    regex = mm_static_regex_get (&vzw_pco_value_regex);
     if (!g_regex_match_full (regex,
                              pco_payload,
                              strlen (pco_payload),
@@ -189,6 +191,8 @@ altair_extract_vzw_pco_value (const gchar *pco_payload, GError **error)
 guint
 mm_altair_parse_vendor_pco_info (const gchar *pco_info, GError **error)
 {
+    static MMStaticRegex pcoinfo_regex =
+        MM_STATIC_REGEX_INIT ("\\%PCOINFO:(?:\\s*\\d+\\s*,)?(\\d+)\\s*(,([^,\\)]*),([0-9A-Fa-f]*))?", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex *regex;
     GMatchInfo *match_info;
     guint pco_value = -1;
@@ -203,10 +207,7 @@ mm_altair_parse_vendor_pco_info (const gchar *pco_info, GError **error)
      *     Solicited response: %PCOINFO:<mode>,<cid>[,<pcoid>[,<payload>]]
      *     Unsolicited response: %PCOINFO:<cid>,<pcoid>[,<payload>]
      */
-    regex = g_regex_new ("\\%PCOINFO:(?:\\s*\\d+\\s*,)?(\\d+)\\s*(,([^,\\)]*),([0-9A-Fa-f]*))?",
-                         G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                         0, NULL);
-    g_assert (regex);
+    regex = mm_static_regex_get (&pcoinfo_regex);
     if (!g_regex_match_full (regex, pco_info, strlen (pco_info), 0, 0, &match_info, error)) {
         g_match_info_free (match_info);
         g_regex_unref (regex);
@@ -85,6 +85,8 @@ mm_cinterion_parse_scfg_test (const gchar *response,
                               GArray **supported_bands,
                               GError **error)
 {
+    static MMStaticRegex scfg_test_regex =
+        MM_STATIC_REGEX_INIT ("\\^SCFG:\\s*\"Radio/Band\",\\((?:\")?([0-9]*)(?:\")?-(?:\")?([0-9]*)(?:\")?.*\\)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -95,10 +97,7 @@ mm_cinterion_parse_scfg_test (const gchar *response,
         return FALSE;
     }
 
-    r = g_regex_new ("\\^SCFG:\\s*\"Radio/Band\",\\((?:\")?([0-9]*)(?:\")?-(?:\")?([0-9]*)(?:\")?.*\\)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&scfg_test_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -175,6 +174,8 @@ mm_cinterion_parse_scfg_response (const gchar *response,
                                   GArray **current_bands,
                                   GError **error)
 {
+    static MMStaticRegex scfg_read_regex =
+        MM_STATIC_REGEX_INIT ("\\^SCFG:\\s*\"Radio/Band\",\\s*\"?([0-9a-fA-F]*)\"?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -185,8 +186,7 @@ mm_cinterion_parse_scfg_response (const gchar *response,
         return FALSE;
     }
 
-    r = g_regex_new ("\\^SCFG:\\s*\"Radio/Band\",\\s*\"?([0-9a-fA-F]*)\"?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&scfg_read_regex);
 
     if (g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, NULL)) {
         gchar *currentstr;
@@ -257,6 +257,8 @@ mm_cinterion_parse_cnmi_test (const gchar *response,
                               GArray **supported_bfr,
                               GError **error)
 {
+    static MMStaticRegex cnmi_test_regex =
+        MM_STATIC_REGEX_INIT ("\\+CNMI:\\s*\\((.*)\\),\\((.*)\\),\\((.*)\\),\\((.*)\\),\\((.*)\\)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -271,10 +273,7 @@ mm_cinterion_parse_cnmi_test (const gchar *response,
         return FALSE;
     }
 
-    r = g_regex_new ("\\+CNMI:\\s*\\((.*)\\),\\((.*)\\),\\((.*)\\),\\((.*)\\),\\((.*)\\)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&cnmi_test_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -418,6 +417,8 @@ mm_cinterion_parse_sind_response (const gchar *response,
                                   guint *value,
                                   GError **error)
 {
+    static MMStaticRegex sind_regex =
+        MM_STATIC_REGEX_INIT ("\\^SIND:\\s*(.*),(\\d+),(\\d+)(\\r\\n)?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     guint errors = 0;
@@ -427,8 +428,7 @@ mm_cinterion_parse_sind_response (const gchar *response,
         return FALSE;
     }
 
-    r = g_regex_new ("\\^SIND:\\s*(.*),(\\d+),(\\d+)(\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&sind_regex);
 
     if (g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, NULL)) {
         if (description) {
@@ -491,6 +491,8 @@ mm_cinterion_parse_swwan_response (const gchar  *response,
                                    guint         cid,
                                    GError      **error)
 {
+    static MMStaticRegex swwan_read_regex =
+        MM_STATIC_REGEX_INIT ("\\^SWWAN:\\s*(\\d+),\\s*(\\d+)(?:,\\s*(\\d+))?(?:\\r\\n)?", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex                   *r;
     GMatchInfo               *match_info;
     GError                   *inner_error = NULL;
@@ -509,9 +511,7 @@ mm_cinterion_parse_swwan_response (const gchar  *response,
         return MM_BEARER_CONNECTION_STATUS_UNKNOWN;
     }
 
-    r = g_regex_new ("\\^SWWAN:\\s*(\\d+),\\s*(\\d+)(?:,\\s*(\\d+))?(?:\\r\\n)?",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&swwan_read_regex);
 
     status = MM_BEARER_CONNECTION_STATUS_UNKNOWN;
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -582,6 +582,10 @@ mm_cinterion_parse_smong_response (const gchar              *response,
                                    MMModemAccessTechnology  *access_tech,
                                    GError                  **error)
 {
+    static MMStaticRegex smong_regex =
+        MM_STATIC_REGEX_INIT (".*GPRS Monitor(?:\r\n)*"
+                              "BCCH\\s*G.*\\r\\n"
+                              "\\s*(\\d+)\\s*(\\d+)\\s*", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GError     *inner_error = NULL;
     GMatchInfo *match_info = NULL;
     GRegex     *regex;
@@ -596,12 +600,7 @@ mm_cinterion_parse_smong_response (const gchar              *response,
      * 0776  1  -      -   214   03  2    00      01
      * OK
      */
-    regex = g_regex_new (".*GPRS Monitor(?:\r\n)*"
-                         "BCCH\\s*G.*\\r\\n"
-                         "\\s*(\\d+)\\s*(\\d+)\\s*",
-                         G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                         0, NULL);
-    g_assert (regex);
+    regex = mm_static_regex_get (&smong_regex);
 
     if (g_regex_match_full (regex, response, strlen (response), 0, 0, &match_info, &inner_error)) {
         guint value = 0;
@@ -79,12 +79,440 @@ test_enable_disable (TestFixture *fixture)
 
 /*****************************************************************************/
 
+/* Messaging support in the SIM storage */
+static void
+set_messaging_commands (TestPortContext *port,
+                        gboolean pdu_mode)
+{
+    test_port_context_set_command (port, "AT+CNMI=?", "\\r\\n+CNMI: (0-2),(0-3),(0,2),(0-2),(0,1)\\r\\n\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CNMI=2,1,2,1,0", "\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CPMS=?", "\\r\\n+CPMS: (\"SM\"),(\"SM\"),(\"SM\")\\r\\n\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CPMS?", "\\r\\n+CPMS: \"SM\",0,30,\"SM\",0,30,\"SM\",0,30\\r\\n\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CPMS=\"SM\",\"SM\",\"SM\"", "\\r\\n+CPMS: 0,30,0,30,0,30\\r\\n\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CPMS=\"SM\",\"SM\"", "\\r\\n+CPMS: 0,30,0,30,0,30\\r\\n\\r\\nOK\\r\\n");
+    test_port_context_set_command (port, "AT+CPMS=\"SM\"", "\\r\\n+CPMS: 0,30,0,30,0,30\\r\\n\\r\\nOK\\r\\n");
+    if (pdu_mode)
+        test_port_context_set_command (port, "AT+CMGL=4", "\\r\\nOK\\r\\n");
+    else {
+        test_port_context_set_command (port, "AT+CMGF=?", "\\r\\n+CMGF: (1)\\r\\n\\r\\nOK\\r\\n");
+        test_port_context_set_command (port, "AT+CMGF=1", "\\r\\nOK\\r\\n");
+        test_port_context_set_command (port, "AT+CMGL=\"ALL\"", "\\r\\nOK\\r\\n");
+    }
+}
+
+static void
+set_cmgr_command (TestPortContext *port,
+                  guint idx,
+                  guint length,
+                  const gchar *pdu)
+{
+    gchar *command;
+    gchar *response;
+
+    command = g_strdup_printf ("AT+CMGR=%u", idx);
+    response = g_strdup_printf ("\\r\\n+CMGR: 0,,%u\\r\\n%s\\r\\n\\r\\nOK\\r\\n", length, pdu);
+    test_port_context_set_command (port, command, response);
+    g_free (response);
+    g_free (command);
+}
+
+static guint
+get_cmgr_count (TestPortContext *port,
+                guint idx)
+{
+    gchar *command;
+    guint count;
+
+    command = g_strdup_printf ("AT+CMGR=%u", idx);
+    count = test_port_context_get_received_count (port, command);
+    g_free (command);
+    return count;
+}
+
+/* Sends a +CMTI indication for each of the given indices, all at once */
+static void
+send_cmti (TestPortContext *port,
+           const guint *indices,
+           guint n_indices)
+{
+    GString *str;
+    guint i;
+
+    str = g_string_new ("");
+    for (i = 0; i < n_indices; i++)
+        g_string_append_printf (str, "\r\n+CMTI: \"SM\",%u\r\n", indices[i]);
+    test_port_context_send (port, str->str);
+    g_string_free (str, TRUE);
+}
+
+static void
+wait_for_cmgr (TestPortContext *port,
+               const guint *indices,
+               guint n_indices)
+{
+    GTimer *timer;
+    guint i = 0;
+
+    timer = g_timer_new ();
+    while (i < n_indices) {
+        if (get_cmgr_count (port, indices[i])) {
+            i++;
+            continue;
+        }
+        g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 10.0);
+        g_main_context_iteration (NULL, FALSE);
+        g_usleep (G_USEC_PER_SEC / 100);
+    }
+    g_timer_destroy (timer);
+}
+
+static gboolean
+sms_list_is_complete (GList *list,
+                      guint n_sms)
+{
+    GList *l;
+
+    if (g_list_length (list) != n_sms)
+        return FALSE;
+    for (l = list; l; l = g_list_next (l)) {
+        if (mm_sms_get_state (MM_SMS (l->data)) != MM_SMS_STATE_RECEIVED)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Waits until the given number of messages are listed, all fully received */
+static GList *
+wait_for_sms_list (MMModemMessaging *messaging,
+                   guint n_sms)
+{
+    GError *error = NULL;
+    GTimer *timer;
+    GList *list;
+
+    timer = g_timer_new ();
+    while (TRUE) {
+        list = mm_modem_messaging_list_sync (messaging, NULL, &error);
+        g_assert_no_error (error);
+        if (sms_list_is_complete (list, n_sms))
+            break;
+        g_list_free_full (list, g_object_unref);
+        g_assert_cmpfloat (g_timer_elapsed (timer, NULL), <, 10.0);
+        g_usleep (G_USEC_PER_SEC / 20);
+    }
+    g_timer_destroy (timer);
+    return list;
+}
+
+static MMSms *
+find_sms_by_number (GList *list,
+                    const gchar *number)
+{
+    GList *l;
+
+    for (l = list; l; l = g_list_next (l)) {
+        if (g_str_equal (mm_sms_get_number (MM_SMS (l->data)), number))
+            return MM_SMS (l->data);
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+#define CMTI_BURST_N_PARTS 8
+
+#define TELIT_PDU                                                       \
+    "07916163838428F9040B916121021021F7000051905141642"                 \
+    "20A23C4B0BCFD5E8740C4B0BCFD5E83C26E3248196687C9A0301D440DBBC3677918"
+
+static void
+test_cmti_burst (TestFixture *fixture)
+{
+    GError *error = NULL;
+    MMObject *obj;
+    MMModem *modem;
+    TestPortContext *port0;
+    gchar *ports [] = { NULL, NULL };
+    guint indices[CMTI_BURST_N_PARTS];
+    guint i;
+
+    ports[0] = g_strdup_printf ("abstract:port0:%ld", (glong) getpid ());
+    g_debug ("test service generic: using abstract port at '%s'", ports[0]);
+
+    /* Setup new port context, with messaging support */
+    port0 = test_port_context_new (ports[0]);
+    test_port_context_load_commands (port0, COMMON_GSM_PORT_CONF);
+    set_messaging_commands (port0, TRUE);
+    for (i = 0; i < CMTI_BURST_N_PARTS; i++) {
+        indices[i] = i + 1;
+        set_cmgr_command (port0, indices[i], 50, TELIT_PDU);
+    }
+    test_port_context_start (port0);
+
+    /* Ensure no modem is modem exported */
+    test_fixture_no_modem (fixture);
+
+    /* Set the test profile */
+    test_fixture_set_profile (fixture,
+                              "test-cmti-burst",
+                              "Generic",
+                              (const gchar *const *)ports);
+
+    /* Wait and get the modem object, and enable it */
+    obj = test_fixture_get_modem (fixture);
+    modem = mm_object_get_modem (obj);
+    g_assert (modem != NULL);
+    mm_modem_enable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+
+    /* Only look at what the burst itself triggers */
+    test_port_context_reset_received (port0);
+    send_cmti (port0, indices, CMTI_BURST_N_PARTS);
+    wait_for_cmgr (port0, indices, CMTI_BURST_N_PARTS);
+
+    /* All parts read in a single batch, with the storage set once */
+    g_assert_cmpuint (test_port_context_get_received_count (port0, "AT+CPMS=\"SM\""), ==, 1);
+    for (i = 0; i < CMTI_BURST_N_PARTS; i++)
+        g_assert_cmpuint (get_cmgr_count (port0, indices[i]), ==, 1);
+
+    mm_modem_disable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+
+    g_object_unref (modem);
+    g_object_unref (obj);
+
+    /* Stop port context */
+    test_port_context_stop (port0);
+    test_port_context_free (port0);
+
+    g_free (ports[0]);
+}
+
+/*****************************************************************************/
+
+/* Two parts of a multipart message, reference 0x4C, from +16175046925 */
+#define MULTIPART_PDU_1A                                                                \
+    "07912160130320F5440B916171056429F5000021405291650569A00500034C0201A9E8F41C949E"    \
+    "83C2207B599E07B1DFEE33885E9ED341E4F23C7D7697C920FA1B54C697E5E3F4BC0C6AD7D9F434"    \
+    "081E96D341E3303C2C4EB3D3F4BC0B94A483E6E8779D4D06CDD1EF3BA80E0785E7A0B7BB0C6A97"    \
+    "E7F3F0B9CC02B9DF7450780EA2DFDF2C50780EA2A3CBA0BA9B5C96B3F369F71954768FDFE4B4FB"    \
+    "0C9297E1F2F2BCECA6CF41"
+#define MULTIPART_PDU_2A                                                                \
+    "07912160130320F6440B916171056429F5000021405291651569320500034C0202E9E8301D4447"    \
+    "9741F0B09C3E0785E56590BCCC0ED3CB6410FD0D7ABBCBA0B0FB4D4797E52E10"
+
+/* The same ones, from +16175046926 */
+#define MULTIPART_PDU_1B                                                                \
+    "07912160130320F5440B916171056429F6000021405291650569A00500034C0201A9E8F41C949E"    \
+    "83C2207B599E07B1DFEE33885E9ED341E4F23C7D7697C920FA1B54C697E5E3F4BC0C6AD7D9F434"    \
+    "081E96D341E3303C2C4EB3D3F4BC0B94A483E6E8779D4D06CDD1EF3BA80E0785E7A0B7BB0C6A97"    \
+    "E7F3F0B9CC02B9DF7450780EA2DFDF2C50780EA2A3CBA0BA9B5C96B3F369F71954768FDFE4B4FB"    \
+    "0C9297E1F2F2BCECA6CF41"
+#define MULTIPART_PDU_2B                                                                \
+    "07912160130320F6440B916171056429F6000021405291651569320500034C0202E9E8301D4447"    \
+    "9741F0B09C3E0785E56590BCCC0ED3CB6410FD0D7ABBCBA0B0FB4D4797E52E10"
+
+#define MULTIPART_NUMBER_A "+16175046925"
+#define MULTIPART_NUMBER_B "+16175046926"
+#define MULTIPART_TEXT                                                                  \
+    "This is a very long test designed to exercise multi part capability. It should "   \
+    "show up as one message, not as two, as the underlying encoding represents "        \
+    "that the parts are related to one another. "
+
+static void
+test_sms_list (TestFixture *fixture)
+{
+    static const guint all_indices[] = { 1, 2, 3, 4 };
+    static const guint sender_a_indices[] = { 1, 3 };
+    static const guint resent_indices[] = { 1, 2, 3 };
+    GError *error = NULL;
+    MMObject *obj;
+    MMModem *modem;
+    MMModemMessaging *messaging;
+    TestPortContext *port0;
+    gchar *ports [] = { NULL, NULL };
+    GList *list;
+    MMSms *sms;
+    gchar *path;
+
+    ports[0] = g_strdup_printf ("abstract:port0:%ld", (glong) getpid ());
+    g_debug ("test service generic: using abstract port at '%s'", ports[0]);
+
+    /* Setup new port context, with messaging support and the parts of two
+     * multipart messages from different senders using the same reference,
+     * interleaved in the storage */
+    port0 = test_port_context_new (ports[0]);
+    test_port_context_load_commands (port0, COMMON_GSM_PORT_CONF);
+    set_messaging_commands (port0, TRUE);
+    set_cmgr_command (port0, 1, 159, MULTIPART_PDU_1A);
+    set_cmgr_command (port0, 2, 159, MULTIPART_PDU_1B);
+    set_cmgr_command (port0, 3, 63,  MULTIPART_PDU_2A);
+    set_cmgr_command (port0, 4, 63,  MULTIPART_PDU_2B);
+    test_port_context_set_command (port0, "AT+CMGD=1", "\\r\\nOK\\r\\n");
+    test_port_context_set_command (port0, "AT+CMGD=3", "\\r\\nOK\\r\\n");
+    test_port_context_start (port0);
+
+    /* Ensure no modem is modem exported */
+    test_fixture_no_modem (fixture);
+
+    /* Set the test profile */
+    test_fixture_set_profile (fixture,
+                              "test-sms-list",
+                              "Generic",
+                              (const gchar *const *)ports);
+
+    /* Wait and get the modem object, and enable it */
+    obj = test_fixture_get_modem (fixture);
+    modem = mm_object_get_modem (obj);
+    g_assert (modem != NULL);
+    mm_modem_enable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+    messaging = mm_object_get_modem_messaging (obj);
+    g_assert (messaging != NULL);
+
+    /* Each sender gets its own message, with its own parts */
+    send_cmti (port0, all_indices, G_N_ELEMENTS (all_indices));
+    list = wait_for_sms_list (messaging, 2);
+    sms = find_sms_by_number (list, MULTIPART_NUMBER_A);
+    g_assert (sms != NULL);
+    g_assert_cmpstr (mm_sms_get_text (sms), ==, MULTIPART_TEXT);
+    path = g_strdup (mm_sms_get_path (sms));
+    sms = find_sms_by_number (list, MULTIPART_NUMBER_B);
+    g_assert (sms != NULL);
+    g_assert_cmpstr (mm_sms_get_text (sms), ==, MULTIPART_TEXT);
+    g_list_free_full (list, g_object_unref);
+
+    /* Delete the message from the first sender by path; only its parts are
+     * removed from the storage */
+    test_port_context_reset_received (port0);
+    mm_modem_messaging_delete_sync (messaging, path, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (test_port_context_get_received_count (port0, "AT+CMGD=1"), ==, 1);
+    g_assert_cmpuint (test_port_context_get_received_count (port0, "AT+CMGD=3"), ==, 1);
+    list = wait_for_sms_list (messaging, 1);
+    g_assert (find_sms_by_number (list, MULTIPART_NUMBER_B) != NULL);
+    g_list_free_full (list, g_object_unref);
+
+    /* Deleting it again fails, the path is gone */
+    g_assert (!mm_modem_messaging_delete_sync (messaging, path, NULL, &error));
+    g_assert (error != NULL);
+    g_clear_error (&error);
+    g_free (path);
+
+    /* The parts of the deleted message are no longer known, so they're read
+     * again when reported; the ones still in use are not */
+    test_port_context_reset_received (port0);
+    send_cmti (port0, resent_indices, G_N_ELEMENTS (resent_indices));
+    wait_for_cmgr (port0, sender_a_indices, G_N_ELEMENTS (sender_a_indices));
+    list = wait_for_sms_list (messaging, 2);
+    g_assert_cmpuint (get_cmgr_count (port0, 2), ==, 0);
+    g_assert (find_sms_by_number (list, MULTIPART_NUMBER_A) != NULL);
+    g_assert (find_sms_by_number (list, MULTIPART_NUMBER_B) != NULL);
+    g_list_free_full (list, g_object_unref);
+
+    mm_modem_disable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+
+    g_object_unref (messaging);
+    g_object_unref (modem);
+    g_object_unref (obj);
+
+    /* Stop port context */
+    test_port_context_stop (port0);
+    test_port_context_free (port0);
+
+    g_free (ports[0]);
+}
+
+static void
+test_sms_list_stored (TestFixture *fixture)
+{
+    static const guint stored_indices[] = { 5, 6 };
+    static const guint new_indices[] = { 6 };
+    GError *error = NULL;
+    MMObject *obj;
+    MMModem *modem;
+    MMModemMessaging *messaging;
+    MMSmsProperties *properties;
+    TestPortContext *port0;
+    gchar *ports [] = { NULL, NULL };
+    MMSms *sms;
+
+    ports[0] = g_strdup_printf ("abstract:port0:%ld", (glong) getpid ());
+    g_debug ("test service generic: using abstract port at '%s'", ports[0]);
+
+    /* Setup new port context, with messaging support in text mode, so that
+     * the data of the stored message is known in advance */
+    port0 = test_port_context_new (ports[0]);
+    test_port_context_load_commands (port0, COMMON_GSM_PORT_CONF);
+    set_messaging_commands (port0, FALSE);
+    test_port_context_set_command (port0, "AT+CMGW=\"+34600000001\"", "\\r\\n> ");
+    test_port_context_set_command (port0, "hello", "\\r\\n+CMGW: 5\\r\\n\\r\\nOK\\r\\n");
+    set_cmgr_command (port0, 6, 50, TELIT_PDU);
+    test_port_context_start (port0);
+
+    /* Ensure no modem is modem exported */
+    test_fixture_no_modem (fixture);
+
+    /* Set the test profile */
+    test_fixture_set_profile (fixture,
+                              "test-sms-list-stored",
+                              "Generic",
+                              (const gchar *const *)ports);
+
+    /* Wait and get the modem object, and enable it */
+    obj = test_fixture_get_modem (fixture);
+    modem = mm_object_get_modem (obj);
+    g_assert (modem != NULL);
+    mm_modem_enable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+    messaging = mm_object_get_modem_messaging (obj);
+    g_assert (messaging != NULL);
+
+    /* Create a message and store it, it gets index 5 */
+    properties = mm_sms_properties_new ();
+    mm_sms_properties_set_number (properties, "+34600000001");
+    mm_sms_properties_set_text (properties, "hello");
+    sms = mm_modem_messaging_create_sync (messaging, properties, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (sms != NULL);
+    mm_sms_store_sync (sms, MM_SMS_STORAGE_UNKNOWN, NULL, &error);
+    g_assert_no_error (error);
+    g_object_unref (properties);
+    g_object_unref (sms);
+
+    /* The stored message is already known, so its part isn't read when
+     * reported; a new one in the same batch is */
+    test_port_context_reset_received (port0);
+    send_cmti (port0, stored_indices, G_N_ELEMENTS (stored_indices));
+    wait_for_cmgr (port0, new_indices, G_N_ELEMENTS (new_indices));
+    g_assert_cmpuint (get_cmgr_count (port0, 5), ==, 0);
+
+    mm_modem_disable_sync (modem, NULL, &error);
+    g_assert_no_error (error);
+
+    g_object_unref (messaging);
+    g_object_unref (modem);
+    g_object_unref (obj);
+
+    /* Stop port context */
+    test_port_context_stop (port0);
+    test_port_context_free (port0);
+
+    g_free (ports[0]);
+}
+
+/*****************************************************************************/
+
 int main (int   argc,
           char *argv[])
 {
     g_test_init (&argc, &argv, NULL);
 
-    TEST_ADD ("/MM/Service/Generic/enable-disable", test_enable_disable);
+    TEST_ADD ("/MM/Service/Generic/enable-disable",   test_enable_disable);
+    TEST_ADD ("/MM/Service/Generic/cmti-burst",       test_cmti_burst);
+    TEST_ADD ("/MM/Service/Generic/sms-list",         test_sms_list);
+    TEST_ADD ("/MM/Service/Generic/sms-list-stored",  test_sms_list_stored);
 
     return g_test_run ();
 }
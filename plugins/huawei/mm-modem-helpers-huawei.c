@@ -37,6 +37,11 @@ mm_huawei_parse_ndisstatqry_response (const gchar *response,
                                       gboolean *ipv6_connected,
                                       GError **error)
 {
+    static MMStaticRegex ndisstatqry_regex =
+        MM_STATIC_REGEX_INIT ("\\^NDISSTAT(?:QRY)?(?:Qry)?:\\s*(\\d),([^,]*),([^,]*),([^,\\r\\n]*)(?:\\r\\n)?"
+                              "(?:\\^NDISSTAT:|\\^NDISSTATQRY:)?\\s*,?(\\d)?,?([^,]*)?,?([^,]*)?,?([^,\\r\\n]*)?(?:\\r\\n)?", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
+    static MMStaticRegex ndisstatqry_simple_regex =
+        MM_STATIC_REGEX_INIT ("\\^NDISSTAT(?:QRY)?(?:Qry)?:\\s*(\\d)(?:\\r\\n)?", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -69,11 +74,7 @@ mm_huawei_parse_ndisstatqry_response (const gchar *response,
 
     /* If multiple fields available, try first parsing method */
     if (strchr (response, ',')) {
-        r = g_regex_new ("\\^NDISSTAT(?:QRY)?(?:Qry)?:\\s*(\\d),([^,]*),([^,]*),([^,\\r\\n]*)(?:\\r\\n)?"
-                         "(?:\\^NDISSTAT:|\\^NDISSTATQRY:)?\\s*,?(\\d)?,?([^,]*)?,?([^,]*)?,?([^,\\r\\n]*)?(?:\\r\\n)?",
-                         G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                         0, NULL);
-        g_assert (r != NULL);
+        r = mm_static_regex_get (&ndisstatqry_regex);
 
         g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
         if (!inner_error && g_match_info_matches (match_info)) {
@@ -112,10 +113,7 @@ mm_huawei_parse_ndisstatqry_response (const gchar *response,
     }
     /* No separate IPv4/IPv6 info given just connected/not connected */
     else {
-        r = g_regex_new ("\\^NDISSTAT(?:QRY)?(?:Qry)?:\\s*(\\d)(?:\\r\\n)?",
-                         G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                         0, NULL);
-        g_assert (r != NULL);
+        r = mm_static_regex_get (&ndisstatqry_simple_regex);
 
         g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
         if (!inner_error && g_match_info_matches (match_info)) {
@@ -208,6 +206,8 @@ mm_huawei_parse_dhcp_response (const char *reply,
                                guint *out_dns2,
                                GError **error)
 {
+    static MMStaticRegex dhcp_regex =
+        MM_STATIC_REGEX_INIT ("\\^DHCP:\\s*([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),.*$", 0);
     gboolean matched;
     GRegex *r;
     GMatchInfo *match_info = NULL;
@@ -230,8 +230,7 @@ mm_huawei_parse_dhcp_response (const char *reply,
      * actually 10.10.1.1.
      */
 
-    r = g_regex_new ("\\^DHCP:\\s*([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),([0-9a-fA-F]+),.*$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&dhcp_regex);
 
     matched = g_regex_match_full (r, reply, -1, 0, 0, &match_info, &match_error);
     if (!matched) {
@@ -277,6 +276,8 @@ mm_huawei_parse_sysinfo_response (const char *reply,
                                   guint *out_sys_submode,
                                   GError **error)
 {
+    static MMStaticRegex sysinfo_regex =
+        MM_STATIC_REGEX_INIT ("\\^SYSINFO:\\s*(\\d+),(\\d+),(\\d+),(\\d+),(\\d+),?(\\d+)?,?(\\d+)?$", 0);
     gboolean matched;
     GRegex *r;
     GMatchInfo *match_info = NULL;
@@ -296,8 +297,7 @@ mm_huawei_parse_sysinfo_response (const char *reply,
      */
 
     /* Can't just use \d here since sometimes you get "^SYSINFO:2,1,0,3,1,,3" */
-    r = g_regex_new ("\\^SYSINFO:\\s*(\\d+),(\\d+),(\\d+),(\\d+),(\\d+),?(\\d+)?,?(\\d+)?$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&sysinfo_regex);
 
     matched = g_regex_match_full (r, reply, -1, 0, 0, &match_info, &match_error);
     if (!matched) {
@@ -343,6 +343,8 @@ mm_huawei_parse_sysinfoex_response (const char *reply,
                                     guint *out_sys_submode,
                                     GError **error)
 {
+    static MMStaticRegex sysinfoex_regex =
+        MM_STATIC_REGEX_INIT ("\\^SYSINFOEX:\\s*(\\d+),(\\d+),(\\d+),(\\d+),?(\\d*),(\\d+),\"?([^\"]*)\"?,(\\d+),\"?([^\"]*)\"?$", 0);
     gboolean matched;
     GRegex *r;
     GMatchInfo *match_info = NULL;
@@ -364,8 +366,7 @@ mm_huawei_parse_sysinfoex_response (const char *reply,
 
     /* ^SYSINFOEX:2,3,0,1,,3,"WCDMA",41,"HSPA+" */
 
-    r = g_regex_new ("\\^SYSINFOEX:\\s*(\\d+),(\\d+),(\\d+),(\\d+),?(\\d*),(\\d+),\"?([^\"]*)\"?,(\\d+),\"?([^\"]*)\"?$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&sysinfoex_regex);
 
     matched = g_regex_match_full (r, reply, -1, 0, 0, &match_info, &match_error);
     if (!matched) {
@@ -1194,6 +1195,8 @@ gboolean mm_huawei_parse_nwtime_response (const gchar *response,
                                           MMNetworkTimezone **tzp,
                                           GError **error)
 {
+    static MMStaticRegex nwtime_regex =
+        MM_STATIC_REGEX_INIT ("\\^NWTIME:\\s*(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d*)([\\-\\+\\d]+),(\\d+)$", 0);
     GRegex *r;
     GMatchInfo *match_info = NULL;
     GError *match_error = NULL;
@@ -1203,8 +1206,7 @@ gboolean mm_huawei_parse_nwtime_response (const gchar *response,
 
     g_assert (iso8601p || tzp); /* at least one */
 
-    r = g_regex_new ("\\^NWTIME:\\s*(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d*)([\\-\\+\\d]+),(\\d+)$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&nwtime_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
@@ -1272,6 +1274,8 @@ gboolean mm_huawei_parse_time_response (const gchar *response,
                                         MMNetworkTimezone **tzp,
                                         GError **error)
 {
+    static MMStaticRegex time_regex =
+        MM_STATIC_REGEX_INIT ("\\^TIME:\\s*(\\d+)/(\\d+)/(\\d+)\\s*(\\d+):(\\d+):(\\d*)$", 0);
     GRegex *r;
     GMatchInfo *match_info = NULL;
     GError *match_error = NULL;
@@ -1290,8 +1294,7 @@ gboolean mm_huawei_parse_time_response (const gchar *response,
     }
 
     /* Already in ISO-8601 format, but verify just to be sure */
-    r = g_regex_new ("\\^TIME:\\s*(\\d+)/(\\d+)/(\\d+)\\s*(\\d+):(\\d+):(\\d*)$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&time_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
@@ -1349,14 +1352,15 @@ mm_huawei_parse_hcsq_response (const gchar *response,
                                guint *out_value5,
                                GError **error)
 {
+    static MMStaticRegex hcsq_regex =
+        MM_STATIC_REGEX_INIT ("\\^HCSQ:\\s*\"([a-zA-Z]*)\",(\\d+),?(\\d+)?,?(\\d+)?,?(\\d+)?,?(\\d+)?$", 0);
     GRegex *r;
     GMatchInfo *match_info = NULL;
     GError *match_error = NULL;
     gboolean ret = FALSE;
     char *s;
 
-    r = g_regex_new ("\\^HCSQ:\\s*\"([a-zA-Z]*)\",(\\d+),?(\\d+)?,?(\\d+)?,?(\\d+)?,?(\\d+)?$", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&hcsq_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
@@ -55,6 +55,8 @@ mm_mbm_parse_e2ipcfg_response (const gchar *response,
                                MMBearerIpConfig **out_ip6_config,
                                GError **error)
 {
+    static MMStaticRegex e2ipcfg_regex =
+        MM_STATIC_REGEX_INIT ("\\((\\d),\"([0-9a-fA-F.:]+)\"\\)", 0);
     MMBearerIpConfig **ip_config = NULL;
     gboolean got_address = FALSE, got_gw = FALSE, got_dns = FALSE;
     GRegex *r;
@@ -95,8 +97,7 @@ mm_mbm_parse_e2ipcfg_response (const gchar *response,
      * *E2IPCFG: (1,"fe80:0000:0000:0000:0000:0000:e537:1801")(3,"2001:4600:0004:0fff:0000:0000:0000:0054")(3,"2001:4600:0004:1fff:0000:0000:0000:0054")
      * *E2IPCFG: (1,"fe80:0000:0000:0000:0000:0027:b7fe:9401")(3,"fd00:976a:0000:0000:0000:0000:0000:0009")
      */
-    r = g_regex_new ("\\((\\d),\"([0-9a-fA-F.:]+)\"\\)", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&e2ipcfg_regex);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
         if (match_error) {
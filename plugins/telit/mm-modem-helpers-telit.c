@@ -121,6 +121,8 @@ gint
 mm_telit_parse_csim_response (const gchar *response,
                               GError **error)
 {
+    static MMStaticRegex csim_regex =
+        MM_STATIC_REGEX_INIT ("\\+CSIM:\\s*[0-9]+,\\s*\".*([0-9a-fA-F]{4})\"", G_REGEX_RAW);
     GMatchInfo *match_info = NULL;
     GRegex *r = NULL;
     gchar *str_code = NULL;
@@ -128,7 +130,7 @@ mm_telit_parse_csim_response (const gchar *response,
     guint hex_code;
     GError *inner_error = NULL;
 
-    r = g_regex_new ("\\+CSIM:\\s*[0-9]+,\\s*\".*([0-9a-fA-F]{4})\"", G_REGEX_RAW, 0, NULL);
+    r = mm_static_regex_get (&csim_regex);
     g_regex_match (r, response, 0, &match_info);
 
     if (!g_match_info_matches (match_info)) {
@@ -260,6 +262,10 @@ mm_telit_parse_bnd_response (const gchar *response,
                              GArray **supported_bands,
                              GError **error)
 {
+    static MMStaticRegex supp_band_regex =
+        MM_STATIC_REGEX_INIT (SUPP_BAND_RESPONSE_REGEX, G_REGEX_RAW);
+    static MMStaticRegex curr_band_regex =
+        MM_STATIC_REGEX_INIT (CURR_BAND_RESPONSE_REGEX, G_REGEX_RAW);
     GArray *bands = NULL;
     GMatchInfo *match_info = NULL;
     GRegex *r = NULL;
@@ -268,11 +274,11 @@ mm_telit_parse_bnd_response (const gchar *response,
     switch (band_type) {
         case LOAD_SUPPORTED_BANDS:
             /* Parse #BND=? response */
-            r = g_regex_new (SUPP_BAND_RESPONSE_REGEX, G_REGEX_RAW, 0, NULL);
+            r = mm_static_regex_get (&supp_band_regex);
             break;
         case LOAD_CURRENT_BANDS:
             /* Parse #BND? response */
-            r = g_regex_new (CURR_BAND_RESPONSE_REGEX, G_REGEX_RAW, 0, NULL);
+            r = mm_static_regex_get (&curr_band_regex);
         default:
             break;
     }
@@ -33,6 +33,8 @@ struct _TestPortContext {
     GSocketService *socket_service;
     GList *clients;
     GHashTable *commands;
+    GMutex received_mutex;
+    GHashTable *received;
 };
 
 /*****************************************************************************/
@@ -92,6 +94,43 @@ test_port_context_load_commands (TestPortContext *self,
     g_free (contents);
 }
 
+guint
+test_port_context_get_received_count (TestPortContext *self,
+                                      const gchar *command)
+{
+    guint count = 0;
+
+    g_mutex_lock (&self->received_mutex);
+    if (self->received)
+        count = GPOINTER_TO_UINT (g_hash_table_lookup (self->received, command));
+    g_mutex_unlock (&self->received_mutex);
+
+    return count;
+}
+
+void
+test_port_context_reset_received (TestPortContext *self)
+{
+    g_mutex_lock (&self->received_mutex);
+    if (self->received)
+        g_hash_table_remove_all (self->received);
+    g_mutex_unlock (&self->received_mutex);
+}
+
+static void
+record_received_command (TestPortContext *self,
+                         const gchar *command)
+{
+    guint count;
+
+    g_mutex_lock (&self->received_mutex);
+    if (G_UNLIKELY (!self->received))
+        self->received = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    count = GPOINTER_TO_UINT (g_hash_table_lookup (self->received, command));
+    g_hash_table_replace (self->received, g_strdup (command), GUINT_TO_POINTER (count + 1));
+    g_mutex_unlock (&self->received_mutex);
+}
+
 static const gchar *
 process_next_command (TestPortContext *ctx,
                       GByteArray *buffer)
@@ -101,18 +140,20 @@ process_next_command (TestPortContext *ctx,
     const gchar *response;
     static const gchar *error_response = "\r\nERROR\r\n";
 
-    /* Find command end */
-    while (i < buffer->len && buffer->data[i] != '\r' && buffer->data[i] != '\n')
+    /* Find command end; message data given after a '>' prompt (e.g. in
+     * +CMGW) ends with <CTRL-Z> instead */
+    while (i < buffer->len && buffer->data[i] != '\r' && buffer->data[i] != '\n' && buffer->data[i] != 0x1A)
         i++;
     if (i ==  buffer->len)
         /* no command */
         return NULL;
 
-    while (i < buffer->len && (buffer->data[i] == '\r' || buffer->data[i] == '\n'))
+    while (i < buffer->len && (buffer->data[i] == '\r' || buffer->data[i] == '\n' || buffer->data[i] == 0x1A))
         buffer->data[i++] = '\0';
 
     /* Setup command and lookup response */
     command = g_strndup ((gchar *)buffer->data, i);
+    record_received_command (ctx, command);
     response = g_hash_table_lookup (ctx->commands, command);
     g_free (command);
 
@@ -150,6 +191,23 @@ connection_close (Client *client)
     client_free (client);
 }
 
+static void
+client_send (Client *client,
+             const gchar *data)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+                                    data,
+                                    strlen (data),
+                                    NULL, /* bytes_written */
+                                    NULL, /* cancellable */
+                                    &error)) {
+        g_warning ("Cannot send data to client: %s", error->message);
+        g_error_free (error);
+    }
+}
+
 static void
 client_parse_request (Client *client)
 {
@@ -157,20 +215,8 @@ client_parse_request (Client *client)
 
     do {
         response = process_next_command (client->ctx, client->buffer);
-        if (response) {
-            GError *error = NULL;
-
-            if (!g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
-                                            response,
-                                            strlen (response),
-                                            NULL, /* bytes_written */
-                                            NULL, /* cancellable */
-                                            &error)) {
-                g_warning ("Cannot send response to client: %s", error->message);
-                g_error_free (error);
-            }
-        }
-
+        if (response)
+            client_send (client, response);
     } while (response);
 }
 
@@ -242,6 +288,47 @@ client_new (TestPortContext *self,
     return client;
 }
 
+typedef struct {
+    TestPortContext *self;
+    gchar *data;
+} SendContext;
+
+static void
+send_context_free (SendContext *ctx)
+{
+    g_free (ctx->data);
+    g_slice_free (SendContext, ctx);
+}
+
+static gboolean
+send_cb (SendContext *ctx)
+{
+    GList *l;
+
+    for (l = ctx->self->clients; l; l = g_list_next (l))
+        client_send ((Client *)l->data, ctx->data);
+    return FALSE;
+}
+
+void
+test_port_context_send (TestPortContext *self,
+                        const gchar *data)
+{
+    SendContext *ctx;
+
+    g_assert (self->context != NULL);
+
+    /* Clients are only handled in the port context thread */
+    ctx = g_slice_new (SendContext);
+    ctx->self = self;
+    ctx->data = g_strdup (data);
+    g_main_context_invoke_full (self->context,
+                                G_PRIORITY_DEFAULT,
+                                (GSourceFunc) send_cb,
+                                ctx,
+                                (GDestroyNotify) send_context_free);
+}
+
 /* /\*****************************************************************************\/ */
 
 static void
@@ -387,9 +474,12 @@ test_port_context_free (TestPortContext *self)
 
     g_cond_clear (&self->ready_cond);
     g_mutex_clear (&self->ready_mutex);
+    g_mutex_clear (&self->received_mutex);
 
     if (self->commands)
         g_hash_table_unref (self->commands);
+    if (self->received)
+        g_hash_table_unref (self->received);
     g_list_free_full (self->clients, (GDestroyNotify)client_free);
     if (self->socket) {
         GError *error = NULL;
@@ -418,5 +508,6 @@ test_port_context_new (const gchar *name)
     self->name = g_strdup (name);
     g_cond_init (&self->ready_cond);
     g_mutex_init (&self->ready_mutex);
+    g_mutex_init (&self->received_mutex);
     return self;
 }
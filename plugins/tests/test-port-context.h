@@ -32,4 +32,13 @@ void             test_port_context_set_command   (TestPortContext *self,
 void             test_port_context_load_commands (TestPortContext *self,
                                                   const gchar *commands_file);
 
+/* Sends data to all connected clients, e.g. unsolicited messages */
+void             test_port_context_send          (TestPortContext *self,
+                                                  const gchar *data);
+
+/* Number of times a command was received since the last reset */
+guint            test_port_context_get_received_count (TestPortContext *self,
+                                                       const gchar *command);
+void             test_port_context_reset_received     (TestPortContext *self);
+
 #endif /* TEST_PORT_CONTEXT_H */
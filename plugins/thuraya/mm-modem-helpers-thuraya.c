@@ -52,6 +52,8 @@ mm_thuraya_3gpp_parse_cpms_test_response (const gchar *reply,
                                           GArray **mem2,
                                           GArray **mem3)
 {
+    static MMStaticRegex cpms_storage_regex =
+        MM_STATIC_REGEX_INIT ("\\s*\"([^,\\)]+)\"\\s*", 0);
 #define N_EXPECTED_GROUPS 3
 
     GRegex *r;
@@ -88,8 +90,7 @@ mm_thuraya_3gpp_parse_cpms_test_response (const gchar *reply,
         return FALSE;
     }
 
-    r = g_regex_new ("\\s*\"([^,\\)]+)\"\\s*", 0, 0, NULL);
-    g_assert (r);
+    r = mm_static_regex_get (&cpms_storage_regex);
 
     for (i = 0; i < N_EXPECTED_GROUPS; i++) {
         GMatchInfo *match_info = NULL;
@@ -31,6 +31,8 @@ mm_ublox_parse_upincnt_response (const gchar  *response,
                                  guint        *out_puk2_attempts,
                                  GError      **error)
 {
+    static MMStaticRegex upincnt_regex =
+        MM_STATIC_REGEX_INIT ("\\+UPINCNT: (\\d+),(\\d+),(\\d+),(\\d+)(?:\\r\\n)?", 0);
     GRegex     *r;
     GMatchInfo *match_info;
     GError     *inner_error = NULL;
@@ -48,8 +50,7 @@ mm_ublox_parse_upincnt_response (const gchar  *response,
     /* Response may be e.g.:
      * +UPINCNT: 3,3,10,10
      */
-    r = g_regex_new ("\\+UPINCNT: (\\d+),(\\d+),(\\d+),(\\d+)(?:\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&upincnt_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -108,6 +109,8 @@ mm_ublox_parse_uusbconf_response (const gchar        *response,
                                   MMUbloxUsbProfile  *out_profile,
                                   GError            **error)
 {
+    static MMStaticRegex uusbconf_regex =
+        MM_STATIC_REGEX_INIT ("\\+UUSBCONF: (\\d+),([^,]*),([^,]*),([^,]*)(?:\\r\\n)?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -123,8 +126,7 @@ mm_ublox_parse_uusbconf_response (const gchar        *response,
      * Note: we don't rely on the PID; assuming future new modules will
      * have a different PID but they may keep the profile names.
      */
-    r = g_regex_new ("\\+UUSBCONF: (\\d+),([^,]*),([^,]*),([^,]*)(?:\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&uusbconf_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -171,6 +173,8 @@ mm_ublox_parse_ubmconf_response (const gchar            *response,
                                  MMUbloxNetworkingMode  *out_mode,
                                  GError                **error)
 {
+    static MMStaticRegex ubmconf_regex =
+        MM_STATIC_REGEX_INIT ("\\+UBMCONF: (\\d+)(?:\\r\\n)?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -182,8 +186,7 @@ mm_ublox_parse_ubmconf_response (const gchar            *response,
      * +UBMCONF: 1
      * +UBMCONF: 2
      */
-    r = g_regex_new ("\\+UBMCONF: (\\d+)(?:\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&ubmconf_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -237,6 +240,8 @@ mm_ublox_parse_uipaddr_response (const gchar  *response,
                                  gchar       **out_ipv6_link_local_address,
                                  GError      **error)
 {
+    static MMStaticRegex uipaddr_regex =
+        MM_STATIC_REGEX_INIT ("\\+UIPADDR: (\\d+),([^,]*),([^,]*),([^,]*),([^,]*),([^,]*)(?:\\r\\n)?", 0);
     GRegex     *r;
     GMatchInfo *match_info;
     GError     *inner_error = NULL;
@@ -254,8 +259,7 @@ mm_ublox_parse_uipaddr_response (const gchar  *response,
      *
      * We assume only ONE line is returned; because we request +UIPADDR with a specific N CID.
      */
-    r = g_regex_new ("\\+UIPADDR: (\\d+),([^,]*),([^,]*),([^,]*),([^,]*),([^,]*)(?:\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&uipaddr_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (inner_error)
@@ -826,6 +830,8 @@ mm_ublox_parse_urat_read_response (const gchar  *response,
                                    MMModemMode  *out_preferred,
                                    GError      **error)
 {
+    static MMStaticRegex urat_regex =
+        MM_STATIC_REGEX_INIT ("\\+URAT: (\\d+)(?:,(\\d+))?(?:\\r\\n)?", 0);
     GRegex      *r;
     GMatchInfo  *match_info;
     GError      *inner_error = NULL;
@@ -840,8 +846,7 @@ mm_ublox_parse_urat_read_response (const gchar  *response,
      * +URAT: 1,2
      * +URAT: 1
      */
-    r = g_regex_new ("\\+URAT: (\\d+)(?:,(\\d+))?(?:\\r\\n)?", 0, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&urat_regex);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
     if (!inner_error && g_match_info_matches (match_info)) {
@@ -969,6 +974,8 @@ mm_ublox_parse_ugcntrd_response_for_cid (const gchar  *response,
                                          guint        *out_total_rx_bytes,
                                          GError      **error)
 {
+    static MMStaticRegex ugcntrd_regex =
+        MM_STATIC_REGEX_INIT ("\\+UGCNTRD:\\s*(\\d+),\\s*(\\d+),\\s*(\\d+),\\s*(\\d+),\\s*(\\d+)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex     *r;
     GMatchInfo *match_info = NULL;
     GError     *inner_error = NULL;
@@ -982,9 +989,7 @@ mm_ublox_parse_ugcntrd_response_for_cid (const gchar  *response,
      *  +UGCNTRD: 31,2704,1819,2724,1839
      * We assume only ONE line is returned.
      */
-    r = g_regex_new ("\\+UGCNTRD:\\s*(\\d+),\\s*(\\d+),\\s*(\\d+),\\s*(\\d+),\\s*(\\d+)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW, 0, NULL);
-    g_assert (r != NULL);
+    r = mm_static_regex_get (&ugcntrd_regex);
 
     /* Report invalid CID given */
     if (!in_cid) {
@@ -1340,17 +1340,21 @@ setup_ports (MMBroadbandModem *self)
         return;
 
     /* AT+CPIN? replies will never have an OK appended */
-    parser = mm_serial_parser_v1_new ();
+    parser = mm_serial_parser_v2_new ();
     regex = g_regex_new ("\\r\\n\\+CPIN: .*\\r\\n",
                          G_REGEX_RAW | G_REGEX_OPTIMIZE,
                          0, NULL);
-    mm_serial_parser_v1_set_custom_regex (parser, regex, NULL);
+    mm_serial_parser_v2_set_custom_regex (parser, regex, NULL);
     g_regex_unref (regex);
 
     mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (primary),
-                                           mm_serial_parser_v1_parse,
+                                           mm_serial_parser_v2_parse,
                                            parser,
-                                           mm_serial_parser_v1_destroy);
+                                           mm_serial_parser_v2_destroy);
+    mm_port_serial_at_set_response_check (MM_PORT_SERIAL_AT (primary),
+                                          mm_serial_parser_v2_check);
+    mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (primary),
+                                          mm_serial_parser_v2_reset);
 }
 
 /*****************************************************************************/
@@ -32,6 +32,9 @@ udev_rule_match_clear (MMUdevRuleMatch *rule_match)
 {
     g_free (rule_match->parameter);
     g_free (rule_match->value);
+    g_free (rule_match->property);
+    g_free (rule_match->pattern.str);
+    g_free (rule_match->subpath_pattern.str);
 }
 
 static void
@@ -53,6 +56,8 @@ udev_rule_clear (MMUdevRule *rule)
 
     if (rule->conditions)
         g_array_unref (rule->conditions);
+    if (rule->dispatch)
+        g_hash_table_unref (rule->dispatch);
 }
 
 static gboolean
@@ -114,6 +119,28 @@ out:
     return TRUE;
 }
 
+static MMUdevRuleParameter
+compile_attribute (const gchar *attribute)
+{
+    if (g_str_equal (attribute, "idVendor"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_ID_VENDOR;
+    if (g_str_equal (attribute, "idProduct"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_ID_PRODUCT;
+    if (g_str_equal (attribute, "manufacturer"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_MANUFACTURER;
+    if (g_str_equal (attribute, "product"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_PRODUCT;
+    if (g_str_equal (attribute, "bInterfaceClass"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_CLASS;
+    if (g_str_equal (attribute, "bInterfaceSubClass"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_SUBCLASS;
+    if (g_str_equal (attribute, "bInterfaceProtocol"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_PROTOCOL;
+    if (g_str_equal (attribute, "bInterfaceNumber"))
+        return MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_NUMBER;
+    return MM_UDEV_RULE_PARAMETER_UNKNOWN;
+}
+
 static gboolean
 load_rule_result (MMUdevRuleResult  *rule_result,
                   const gchar       *item,
@@ -154,6 +181,30 @@ load_rule_result (MMUdevRuleResult  *rule_result,
         rule_result->content.property.name = g_strndup (left + 4, left_len - 5);
         rule_result->content.property.value = right;
         right = NULL;
+
+        /* Values read from interface attributes */
+        if (g_str_has_prefix (rule_result->content.property.value, "$attr{")) {
+            gchar               *attribute;
+            MMUdevRuleParameter  value_attribute;
+
+            attribute = g_strndup (rule_result->content.property.value + 6,
+                                   strlen (rule_result->content.property.value) - 7);
+            value_attribute = compile_attribute (attribute);
+            g_free (attribute);
+
+            switch (value_attribute) {
+            case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_CLASS:
+            case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_SUBCLASS:
+            case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_PROTOCOL:
+            case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_NUMBER:
+                rule_result->content.property.value_attribute = value_attribute;
+                break;
+            default:
+                /* Only interface attributes are supported, others are
+                 * taken literally */
+                break;
+            }
+        }
         goto out;
     }
 
@@ -173,6 +224,101 @@ out:
     return TRUE;
 }
 
+static void
+compile_pattern (MMUdevRulePattern *pattern,
+                 const gchar       *str)
+{
+    gsize len;
+
+    pattern->type = MM_UDEV_RULE_PATTERN_TYPE_EXACT;
+
+    if (str[0] == '*') {
+        pattern->type = MM_UDEV_RULE_PATTERN_TYPE_SUFFIX;
+        str++;
+    }
+
+    len = strlen (str);
+    if (len > 0 && str[len - 1] == '*') {
+        pattern->type = (pattern->type == MM_UDEV_RULE_PATTERN_TYPE_SUFFIX ?
+                         MM_UDEV_RULE_PATTERN_TYPE_CONTAINS :
+                         MM_UDEV_RULE_PATTERN_TYPE_PREFIX);
+        len--;
+    }
+
+    pattern->str = g_strndup (str, len);
+}
+
+static void
+compile_rule_match (MMUdevRuleMatch *rule_match)
+{
+    const gchar *parameter;
+    gboolean     condition_equal;
+
+    parameter = rule_match->parameter;
+    condition_equal = (rule_match->type == MM_UDEV_RULE_MATCH_TYPE_EQUAL);
+
+    if (g_str_equal (parameter, "ACTION")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_ACTION;
+        rule_match->action_result = ((!!strstr (rule_match->value, "add")) == condition_equal);
+        return;
+    }
+
+    if (g_str_equal (parameter, "SUBSYSTEMS") || g_str_equal (parameter, "SUBSYSTEM")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_SUBSYSTEM;
+        return;
+    }
+
+    if (g_str_equal (parameter, "DRIVER") || g_str_equal (parameter, "DRIVERS")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_DRIVER;
+        return;
+    }
+
+    if (g_str_equal (parameter, "KERNEL")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_KERNEL;
+        compile_pattern (&rule_match->pattern, rule_match->value);
+        return;
+    }
+
+    if (g_str_equal (parameter, "DEVPATH")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_DEVPATH;
+        compile_pattern (&rule_match->pattern, rule_match->value);
+        if (rule_match->value[0] && rule_match->value[strlen (rule_match->value) - 1] != '*') {
+            gchar *aux;
+
+            aux = g_strdup_printf ("%s/*", rule_match->value);
+            compile_pattern (&rule_match->subpath_pattern, aux);
+            g_free (aux);
+        }
+        return;
+    }
+
+    if (g_str_has_prefix (parameter, "ATTRS")) {
+        gchar *attribute;
+
+        attribute = g_strdup (&parameter[5]);
+        g_strdelimit (attribute, "{}", ' ');
+        g_strstrip (attribute);
+        rule_match->compiled_parameter = compile_attribute (attribute);
+        if (rule_match->compiled_parameter == MM_UDEV_RULE_PARAMETER_UNKNOWN)
+            mm_warn ("Unknown attribute: %s", attribute);
+        g_free (attribute);
+
+        rule_match->numeric_value_valid = mm_get_uint_from_hex_str (rule_match->value, &rule_match->numeric_value);
+        rule_match->any_value = g_str_equal (rule_match->value, "?*");
+        return;
+    }
+
+    if (g_str_has_prefix (parameter, "ENV")) {
+        rule_match->compiled_parameter = MM_UDEV_RULE_PARAMETER_ENV;
+        rule_match->property = g_strdup (&parameter[3]);
+        g_strdelimit (rule_match->property, "{}", ' ');
+        g_strstrip (rule_match->property);
+        return;
+    }
+
+    mm_warn ("Unknown match condition parameter: %s", parameter);
+}
+
 static gboolean
 load_rule_match (MMUdevRuleMatch  *rule_match,
                  const gchar      *item,
@@ -202,6 +348,7 @@ load_rule_match (MMUdevRuleMatch  *rule_match,
     g_free (operator);
     rule_match->parameter = left;
     rule_match->value     = right;
+    compile_rule_match (rule_match);
     return TRUE;
 }
 
@@ -361,6 +508,104 @@ out:
     return TRUE;
 }
 
+/* Don't bother indexing shorter runs of rules */
+#define MIN_DISPATCH_RUN 4
+
+static MMUdevRuleDispatchType
+rule_get_dispatch_key (MMUdevRule *rule,
+                       guint      *out_key)
+{
+    guint    i;
+    gboolean has_vendor = FALSE;
+    gboolean has_product = FALSE;
+    guint    vendor = 0;
+    guint    product = 0;
+
+    /* Only rules which can't apply unless the vendor and/or product ID
+     * match are indexed */
+    for (i = 0; rule->conditions && i < rule->conditions->len; i++) {
+        MMUdevRuleMatch *match;
+
+        match = &g_array_index (rule->conditions, MMUdevRuleMatch, i);
+        if (match->type != MM_UDEV_RULE_MATCH_TYPE_EQUAL || !match->numeric_value_valid)
+            continue;
+        if (match->compiled_parameter == MM_UDEV_RULE_PARAMETER_ATTR_ID_VENDOR) {
+            has_vendor = TRUE;
+            vendor = match->numeric_value;
+        } else if (match->compiled_parameter == MM_UDEV_RULE_PARAMETER_ATTR_ID_PRODUCT) {
+            has_product = TRUE;
+            product = match->numeric_value;
+        }
+    }
+
+    if (has_vendor && has_product) {
+        *out_key = ((vendor & 0xFFFF) << 16) | (product & 0xFFFF);
+        return MM_UDEV_RULE_DISPATCH_TYPE_VENDOR_PRODUCT;
+    }
+    if (has_product) {
+        *out_key = product;
+        return MM_UDEV_RULE_DISPATCH_TYPE_PRODUCT;
+    }
+    if (has_vendor) {
+        *out_key = vendor;
+        return MM_UDEV_RULE_DISPATCH_TYPE_VENDOR;
+    }
+    return MM_UDEV_RULE_DISPATCH_TYPE_NONE;
+}
+
+static void
+compile_dispatch (GArray *rules)
+{
+    guint start = 0;
+    guint n_runs = 0;
+    guint n_indexed = 0;
+
+    while (start < rules->len) {
+        MMUdevRule             *first;
+        MMUdevRuleDispatchType  type;
+        guint                   key;
+        guint                   end;
+
+        first = &g_array_index (rules, MMUdevRule, start);
+        type = rule_get_dispatch_key (first, &key);
+        if (type == MM_UDEV_RULE_DISPATCH_TYPE_NONE) {
+            start++;
+            continue;
+        }
+
+        /* Labels have no conditions, so they are never within a run, and
+         * jumps always land at or out of the run boundaries */
+        for (end = start + 1; end < rules->len; end++) {
+            if (rule_get_dispatch_key (&g_array_index (rules, MMUdevRule, end), &key) != type)
+                break;
+        }
+
+        if (end - start >= MIN_DISPATCH_RUN) {
+            guint i;
+
+            first->dispatch_type = type;
+            first->dispatch_end = end;
+            first->dispatch = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+            for (i = start; i < end; i++) {
+                GArray *indices;
+
+                rule_get_dispatch_key (&g_array_index (rules, MMUdevRule, i), &key);
+                indices = g_hash_table_lookup (first->dispatch, GUINT_TO_POINTER (key));
+                if (!indices) {
+                    indices = g_array_new (FALSE, FALSE, sizeof (guint));
+                    g_hash_table_insert (first->dispatch, GUINT_TO_POINTER (key), indices);
+                }
+                g_array_append_val (indices, i);
+            }
+            n_runs++;
+            n_indexed += end - start;
+        }
+        start = end;
+    }
+
+    mm_dbg ("[rules] %u rules indexed by vendor/product ID in %u runs", n_indexed, n_runs);
+}
+
 static GList *
 list_rule_files (const gchar *rules_dir_path)
 {
@@ -432,6 +677,8 @@ mm_kernel_device_generic_rules_load (const gchar  *rules_dir,
 
     mm_dbg ("[rules] %u loaded", rules->len);
 
+    compile_dispatch (rules);
+
 out:
     if (rule_files)
         g_list_free_full (rule_files, g_free);
@@ -444,3 +691,246 @@ out:
 
     return rules;
 }
+
+/*****************************************************************************/
+
+static gboolean
+pattern_match (const gchar             *str,
+               const MMUdevRulePattern *pattern)
+{
+    switch (pattern->type) {
+    case MM_UDEV_RULE_PATTERN_TYPE_PREFIX:
+        return g_str_has_prefix (str, pattern->str);
+    case MM_UDEV_RULE_PATTERN_TYPE_SUFFIX:
+        return g_str_has_suffix (str, pattern->str);
+    case MM_UDEV_RULE_PATTERN_TYPE_CONTAINS:
+        return !!strstr (str, pattern->str);
+    case MM_UDEV_RULE_PATTERN_TYPE_EXACT:
+    default:
+        return g_str_equal (str, pattern->str);
+    }
+}
+
+static gboolean
+devpath_match (const gchar           *sysfs_path,
+               const MMUdevRuleMatch *match,
+               gboolean               condition_equal)
+{
+    /* We allow both a direct match and an implicit prefix match, so that we can
+     * add properties to the usb_device owning all ports, and then apply the
+     * property to all ports individually processed here. */
+    if (pattern_match (sysfs_path, &match->pattern) == condition_equal)
+        return TRUE;
+    if (match->subpath_pattern.str && pattern_match (sysfs_path, &match->subpath_pattern) == condition_equal)
+        return TRUE;
+
+    if (g_str_has_prefix (sysfs_path, "/sys")) {
+        if (pattern_match (&sysfs_path[4], &match->pattern) == condition_equal)
+            return TRUE;
+        if (match->subpath_pattern.str && pattern_match (&sysfs_path[4], &match->subpath_pattern) == condition_equal)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+numeric_match (const MMUdevRuleMatch *match,
+               guint                  value,
+               gboolean               condition_equal)
+{
+    return (match->numeric_value_valid && ((value == match->numeric_value) == condition_equal));
+}
+
+static gboolean
+check_condition (const MMUdevRuleMatch  *match,
+                 const MMUdevRuleDevice *device,
+                 GHashTable             *properties)
+{
+    gboolean condition_equal;
+
+    condition_equal = (match->type == MM_UDEV_RULE_MATCH_TYPE_EQUAL);
+
+    switch (match->compiled_parameter) {
+    case MM_UDEV_RULE_PARAMETER_ACTION:
+        return match->action_result;
+
+    /* We look for the subsystem string in the whole sysfs path.
+     *
+     * Note that we're not really making a difference between "SUBSYSTEMS"
+     * (where the whole device tree is checked) and "SUBSYSTEM" (where just one
+     * single device is checked), because a lot of the MM udev rules are meant
+     * to just tag the physical device (e.g. with ID_MM_DEVICE_IGNORE) instead
+     * of the single ports. In our case with the custom parsing, we do tag all
+     * independent ports.
+     */
+    case MM_UDEV_RULE_PARAMETER_SUBSYSTEM:
+        return ((device->sysfs_path && !!strstr (device->sysfs_path, match->value)) == condition_equal);
+
+    /* Exact DRIVER match? We also include the check for DRIVERS, even if we
+     * only apply it to this port driver. */
+    case MM_UDEV_RULE_PARAMETER_DRIVER:
+        return ((!g_strcmp0 (match->value, device->driver)) == condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_KERNEL:
+        return (pattern_match (device->name, &match->pattern) == condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_DEVPATH:
+        return (device->sysfs_path && devpath_match (device->sysfs_path, match, condition_equal));
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_ID_VENDOR:
+        return numeric_match (match, device->physdev_vid, condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_ID_PRODUCT:
+        return numeric_match (match, device->physdev_pid, condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_MANUFACTURER:
+        return ((device->physdev_manufacturer && g_str_equal (device->physdev_manufacturer, match->value)) == condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_PRODUCT:
+        return ((device->physdev_product && g_str_equal (device->physdev_product, match->value)) == condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_CLASS:
+        return (match->any_value || numeric_match (match, device->interface_class, condition_equal));
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_SUBCLASS:
+        return (match->any_value || numeric_match (match, device->interface_subclass, condition_equal));
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_PROTOCOL:
+        return (match->any_value || numeric_match (match, device->interface_protocol, condition_equal));
+
+    case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_NUMBER:
+        return (match->any_value || numeric_match (match, device->interface_number, condition_equal));
+
+    /* Previously set property checks */
+    case MM_UDEV_RULE_PARAMETER_ENV:
+        return ((!g_strcmp0 ((const gchar *) g_hash_table_lookup (properties, match->property), match->value)) == condition_equal);
+
+    case MM_UDEV_RULE_PARAMETER_UNKNOWN:
+    default:
+        return FALSE;
+    }
+}
+
+static guint
+apply_rule (GArray                 *rules,
+            guint                   rule_i,
+            const MMUdevRuleDevice *device,
+            GHashTable             *properties)
+{
+    MMUdevRule *rule;
+    guint       condition_i;
+    gchar      *value;
+
+    rule = &g_array_index (rules, MMUdevRule, rule_i);
+
+    for (condition_i = 0; rule->conditions && condition_i < rule->conditions->len; condition_i++) {
+        if (!check_condition (&g_array_index (rule->conditions, MMUdevRuleMatch, condition_i), device, properties))
+            return rule_i + 1;
+    }
+
+    switch (rule->result.type) {
+    case MM_UDEV_RULE_RESULT_TYPE_PROPERTY:
+        switch (rule->result.content.property.value_attribute) {
+        case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_CLASS:
+            value = g_strdup_printf ("%02x", device->interface_class);
+            break;
+        case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_SUBCLASS:
+            value = g_strdup_printf ("%02x", device->interface_subclass);
+            break;
+        case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_PROTOCOL:
+            value = g_strdup_printf ("%02x", device->interface_protocol);
+            break;
+        case MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_NUMBER:
+            value = g_strdup_printf ("%02x", device->interface_number);
+            break;
+        default:
+            value = g_strdup (rule->result.content.property.value);
+            break;
+        }
+
+        mm_dbg ("(%s/%s) property added: %s=%s",
+                device->subsystem, device->name,
+                rule->result.content.property.name, value);
+
+        /* The rules outlive the table, so the name isn't copied */
+        g_hash_table_insert (properties, rule->result.content.property.name, value);
+        break;
+
+    case MM_UDEV_RULE_RESULT_TYPE_LABEL:
+        /* noop */
+        break;
+
+    case MM_UDEV_RULE_RESULT_TYPE_GOTO_INDEX:
+        /* Jump to a new index */
+        return rule->result.content.index;
+
+    case MM_UDEV_RULE_RESULT_TYPE_GOTO_TAG:
+    case MM_UDEV_RULE_RESULT_TYPE_UNKNOWN:
+        g_assert_not_reached ();
+    }
+
+    /* Go to the next rule */
+    return rule_i + 1;
+}
+
+static guint
+apply_dispatch (GArray                 *rules,
+                guint                   rule_i,
+                const MMUdevRuleDevice *device,
+                GHashTable             *properties)
+{
+    MMUdevRule *rule;
+    GArray     *indices;
+    guint       key = 0;
+    guint       i;
+
+    rule = &g_array_index (rules, MMUdevRule, rule_i);
+
+    switch (rule->dispatch_type) {
+    case MM_UDEV_RULE_DISPATCH_TYPE_VENDOR:
+        key = device->physdev_vid;
+        break;
+    case MM_UDEV_RULE_DISPATCH_TYPE_PRODUCT:
+        key = device->physdev_pid;
+        break;
+    case MM_UDEV_RULE_DISPATCH_TYPE_VENDOR_PRODUCT:
+        key = ((guint) device->physdev_vid << 16) | device->physdev_pid;
+        break;
+    case MM_UDEV_RULE_DISPATCH_TYPE_NONE:
+    default:
+        g_assert_not_reached ();
+    }
+
+    /* Only the rules in the run for this ID may apply */
+    indices = g_hash_table_lookup (rule->dispatch, GUINT_TO_POINTER (key));
+    for (i = 0; indices && i < indices->len; i++) {
+        guint rule_index;
+        guint next;
+
+        rule_index = g_array_index (indices, guint, i);
+        next = apply_rule (rules, rule_index, device, properties);
+        if (next != rule_index + 1)
+            return next;
+    }
+
+    return rule->dispatch_end;
+}
+
+void
+mm_kernel_device_generic_rules_apply (GArray                 *rules,
+                                      const MMUdevRuleDevice *device,
+                                      GHashTable             *properties)
+{
+    guint i = 0;
+
+    g_return_if_fail (rules != NULL);
+    g_return_if_fail (device != NULL);
+    g_return_if_fail (properties != NULL);
+
+    while (i < rules->len) {
+        if (g_array_index (rules, MMUdevRule, i).dispatch)
+            i = apply_dispatch (rules, i, device, properties);
+        else
+            i = apply_rule (rules, i, device, properties);
+    }
+}
@@ -23,10 +23,58 @@ typedef enum {
     MM_UDEV_RULE_MATCH_TYPE_NOT_EQUAL,
 } MMUdevRuleMatchType;
 
+/* Parameters are resolved when loading the rules, so that no string
+ * comparison of parameter names is needed while applying them */
+typedef enum {
+    MM_UDEV_RULE_PARAMETER_UNKNOWN,
+    MM_UDEV_RULE_PARAMETER_ACTION,
+    MM_UDEV_RULE_PARAMETER_SUBSYSTEM,
+    MM_UDEV_RULE_PARAMETER_DRIVER,
+    MM_UDEV_RULE_PARAMETER_KERNEL,
+    MM_UDEV_RULE_PARAMETER_DEVPATH,
+    MM_UDEV_RULE_PARAMETER_ATTR_ID_VENDOR,
+    MM_UDEV_RULE_PARAMETER_ATTR_ID_PRODUCT,
+    MM_UDEV_RULE_PARAMETER_ATTR_MANUFACTURER,
+    MM_UDEV_RULE_PARAMETER_ATTR_PRODUCT,
+    MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_CLASS,
+    MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_SUBCLASS,
+    MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_PROTOCOL,
+    MM_UDEV_RULE_PARAMETER_ATTR_INTERFACE_NUMBER,
+    MM_UDEV_RULE_PARAMETER_ENV,
+} MMUdevRuleParameter;
+
+typedef enum {
+    MM_UDEV_RULE_PATTERN_TYPE_EXACT,
+    MM_UDEV_RULE_PATTERN_TYPE_PREFIX,
+    MM_UDEV_RULE_PATTERN_TYPE_SUFFIX,
+    MM_UDEV_RULE_PATTERN_TYPE_CONTAINS,
+} MMUdevRulePatternType;
+
+typedef struct {
+    MMUdevRulePatternType  type;
+    gchar                 *str;
+} MMUdevRulePattern;
+
 typedef struct {
     MMUdevRuleMatchType  type;
     gchar               *parameter;
     gchar               *value;
+
+    /* Compiled form */
+    MMUdevRuleParameter  compiled_parameter;
+    /* ENV: property name */
+    gchar               *property;
+    /* KERNEL and DEVPATH: value as pattern; DEVPATH also matches anything
+     * under the given path, unless already a prefix match */
+    MMUdevRulePattern    pattern;
+    MMUdevRulePattern    subpath_pattern;
+    /* ATTRS with numeric values */
+    guint                numeric_value;
+    gboolean             numeric_value_valid;
+    /* ATTRS given as '?*', always true */
+    gboolean             any_value;
+    /* ACTION: we only apply 'add' rules, so the result is known */
+    gboolean             action_result;
 } MMUdevRuleMatch;
 
 typedef enum {
@@ -38,8 +86,11 @@ typedef enum {
 } MMUdevRuleResultType;
 
 typedef struct {
-    gchar *name;
-    gchar *value;
+    gchar               *name;
+    gchar               *value;
+    /* If the value is an interface attribute (e.g. "$attr{bInterfaceNumber}"),
+     * which one; MM_UDEV_RULE_PARAMETER_UNKNOWN otherwise */
+    MMUdevRuleParameter  value_attribute;
 } MMUdevRuleResultProperty;
 
 typedef struct {
@@ -51,12 +102,49 @@ typedef struct {
     } content;
 } MMUdevRuleResult;
 
+typedef enum {
+    MM_UDEV_RULE_DISPATCH_TYPE_NONE,
+    MM_UDEV_RULE_DISPATCH_TYPE_VENDOR,
+    MM_UDEV_RULE_DISPATCH_TYPE_PRODUCT,
+    MM_UDEV_RULE_DISPATCH_TYPE_VENDOR_PRODUCT,
+} MMUdevRuleDispatchType;
+
 typedef struct {
     GArray           *conditions;
     MMUdevRuleResult  result;
+
+    /* Only set in the first rule of a run of consecutive rules which require
+     * the same kind of vendor/product ID match: maps the ID to the indices of
+     * the rules in the run that may apply, so that the rest are skipped. */
+    MMUdevRuleDispatchType  dispatch_type;
+    GHashTable             *dispatch;
+    guint                   dispatch_end;
 } MMUdevRule;
 
 GArray *mm_kernel_device_generic_rules_load (const gchar  *rules_dir,
                                              GError      **error);
 
+/* Device info the rules are matched against */
+typedef struct {
+    const gchar *subsystem;
+    const gchar *name;
+    const gchar *sysfs_path;
+    const gchar *driver;
+    guint16      physdev_vid;
+    guint16      physdev_pid;
+    const gchar *physdev_manufacturer;
+    const gchar *physdev_product;
+    guint8       interface_class;
+    guint8       interface_subclass;
+    guint8       interface_protocol;
+    guint8       interface_number;
+} MMUdevRuleDevice;
+
+/* Apply the rules to the device, adding the resulting properties to the given
+ * table. The table must own its values but not its keys, which may point to
+ * strings in the rules. */
+void mm_kernel_device_generic_rules_apply (GArray                 *rules,
+                                           const MMUdevRuleDevice *device,
+                                           GHashTable             *properties);
+
 G_END_DECLS
@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #define _LIBMM_INSIDE_MM
 #include <libmm-glib.h>
@@ -43,6 +45,8 @@ enum {
 
 static GParamSpec *properties[PROP_LAST];
 
+typedef struct _SysfsDir SysfsDir;
+
 struct _MMKernelDeviceGenericPrivate {
     /* Input properties */
     MMKernelEventProperties *properties;
@@ -62,41 +66,155 @@ struct _MMKernelDeviceGenericPrivate {
     guint16  physdev_pid;
     gchar   *physdev_manufacturer;
     gchar   *physdev_product;
+
+    /* Shared sysfs attributes of the interface and the physical device */
+    SysfsDir *interface_sysfs_dir;
+    SysfsDir *physdev_sysfs_dir;
+
+    /* Properties loaded from sysfs or set by the rules. Keys are either
+     * static or owned by the rules */
+    GHashTable *properties_table;
 };
 
-static guint
-read_sysfs_property_as_hex (const gchar *path,
-                            const gchar *property)
+/*****************************************************************************/
+/* Shared sysfs attributes
+ *
+ * All ports of the same physical device (and all ports exposed by the same
+ * interface) need the same attributes read from sysfs. Each directory is
+ * read once, with a single open() of the directory and one openat() per
+ * attribute, and the values are shared by all the kernel devices referring
+ * to it. An entry lives as long as some kernel device uses it, so it is
+ * re-read if the device is unplugged and a new one shows up in the same
+ * path. */
+
+struct _SysfsDir {
+    guint       ref_count;
+    gchar      *path;
+    GHashTable *attributes;
+};
+
+static GHashTable *sysfs_dirs;
+
+static const gchar *physdev_attributes[] = {
+    "idVendor", "idProduct", "manufacturer", "product", NULL
+};
+
+static const gchar *interface_attributes[] = {
+    "bInterfaceClass", "bInterfaceSubClass", "bInterfaceProtocol", "bInterfaceNumber", NULL
+};
+
+static gchar *
+read_attribute_at (int          dirfd,
+                   const gchar *name)
 {
-    gchar *aux;
-    gchar *contents = NULL;
-    guint val = 0;
-
-    aux = g_strdup_printf ("%s/%s", path, property);
-    if (g_file_get_contents (aux, &contents, NULL, NULL)) {
-        g_strdelimit (contents, "\r\n", ' ');
-        g_strstrip (contents);
-        mm_get_uint_from_hex_str (contents, &val);
-    }
-    g_free (contents);
-    g_free (aux);
-    return val;
+    gchar   buffer[256];
+    gssize  n_read;
+    int     fd;
+
+    fd = openat (dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    n_read = read (fd, buffer, sizeof (buffer) - 1);
+    close (fd);
+    if (n_read <= 0)
+        return NULL;
+
+    buffer[n_read] = '\0';
+    g_strdelimit (buffer, "\r\n", ' ');
+    g_strstrip (buffer);
+    return g_strdup (buffer);
 }
 
 static gchar *
-read_sysfs_property_as_string (const gchar *path,
-                               const gchar *property)
+read_link_basename_at (int          dirfd,
+                       const gchar *name)
 {
-    gchar *aux;
-    gchar *contents = NULL;
+    gchar   buffer[PATH_MAX];
+    gssize  len;
+
+    len = readlinkat (dirfd, name, buffer, sizeof (buffer) - 1);
+    if (len <= 0)
+        return NULL;
+    buffer[len] = '\0';
+    return g_path_get_basename (buffer);
+}
+
+static SysfsDir *
+sysfs_dir_get (const gchar        *path,
+               const gchar *const *attributes,
+               const gchar        *link)
+{
+    SysfsDir *dir;
+    int       dirfd;
+    guint     i;
+
+    if (G_UNLIKELY (!sysfs_dirs))
+        sysfs_dirs = g_hash_table_new (g_str_hash, g_str_equal);
 
-    aux = g_strdup_printf ("%s/%s", path, property);
-    if (g_file_get_contents (aux, &contents, NULL, NULL)) {
-        g_strdelimit (contents, "\r\n", ' ');
-        g_strstrip (contents);
+    dir = g_hash_table_lookup (sysfs_dirs, path);
+    if (dir) {
+        dir->ref_count++;
+        return dir;
     }
-    g_free (aux);
-    return contents;
+
+    dir = g_slice_new0 (SysfsDir);
+    dir->ref_count = 1;
+    dir->path = g_strdup (path);
+    dir->attributes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+    dirfd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd >= 0) {
+        for (i = 0; attributes[i]; i++) {
+            gchar *value;
+
+            value = read_attribute_at (dirfd, attributes[i]);
+            if (value)
+                g_hash_table_insert (dir->attributes, (gpointer) attributes[i], value);
+        }
+        if (link) {
+            gchar *value;
+
+            value = read_link_basename_at (dirfd, link);
+            if (value)
+                g_hash_table_insert (dir->attributes, (gpointer) link, value);
+        }
+        close (dirfd);
+    }
+
+    g_hash_table_insert (sysfs_dirs, dir->path, dir);
+    return dir;
+}
+
+static void
+sysfs_dir_unref (SysfsDir *dir)
+{
+    if (--dir->ref_count > 0)
+        return;
+
+    g_hash_table_remove (sysfs_dirs, dir->path);
+    g_hash_table_unref (dir->attributes);
+    g_free (dir->path);
+    g_slice_free (SysfsDir, dir);
+}
+
+static const gchar *
+sysfs_dir_get_string (SysfsDir    *dir,
+                      const gchar *attribute)
+{
+    return (dir ? g_hash_table_lookup (dir->attributes, attribute) : NULL);
+}
+
+static guint
+sysfs_dir_get_hex (SysfsDir    *dir,
+                   const gchar *attribute)
+{
+    const gchar *value;
+    guint        val = 0;
+
+    value = sysfs_dir_get_string (dir, attribute);
+    if (value)
+        mm_get_uint_from_hex_str (value, &val);
+    return val;
 }
 
 /*****************************************************************************/
@@ -137,7 +255,7 @@ preload_sysfs_path (MMKernelDeviceGeneric *self)
         devpath = (g_str_has_prefix (self->priv->sysfs_path, "/sys") ?
                    &self->priv->sysfs_path[4] :
                    self->priv->sysfs_path);
-        g_object_set_data_full (G_OBJECT (self), "DEVPATH", g_strdup (devpath), g_free);
+        g_hash_table_insert (self->priv->properties_table, (gpointer) "DEVPATH", g_strdup (devpath));
     }
     g_free (tmp);
 }
@@ -229,20 +347,20 @@ preload_physdev_sysfs_path (MMKernelDeviceGeneric *self)
                 self->priv->physdev_sysfs_path);
 }
 
+static void
+preload_sysfs_dirs (MMKernelDeviceGeneric *self)
+{
+    if (!self->priv->interface_sysfs_dir && self->priv->interface_sysfs_path)
+        self->priv->interface_sysfs_dir = sysfs_dir_get (self->priv->interface_sysfs_path, interface_attributes, "driver");
+    if (!self->priv->physdev_sysfs_dir && self->priv->physdev_sysfs_path)
+        self->priv->physdev_sysfs_dir = sysfs_dir_get (self->priv->physdev_sysfs_path, physdev_attributes, NULL);
+}
+
 static void
 preload_driver (MMKernelDeviceGeneric *self)
 {
-    if (!self->priv->driver && self->priv->interface_sysfs_path) {
-        gchar *tmp;
-        gchar *tmp2;
-
-        tmp = g_strdup_printf ("%s/driver", self->priv->interface_sysfs_path);
-        tmp2 = canonicalize_file_name (tmp);
-        if (tmp2 && g_file_test (tmp2, G_FILE_TEST_EXISTS))
-            self->priv->driver = g_path_get_basename (tmp2);
-        g_free (tmp2);
-        g_free (tmp);
-    }
+    if (!self->priv->driver)
+        self->priv->driver = g_strdup (sysfs_dir_get_string (self->priv->interface_sysfs_dir, "driver"));
 
     if (self->priv->driver)
         mm_dbg ("(%s/%s) driver: %s",
@@ -254,10 +372,10 @@ preload_driver (MMKernelDeviceGeneric *self)
 static void
 preload_physdev_vid (MMKernelDeviceGeneric *self)
 {
-    if (!self->priv->physdev_vid && self->priv->physdev_sysfs_path) {
+    if (!self->priv->physdev_vid) {
         guint val;
 
-        val = read_sysfs_property_as_hex (self->priv->physdev_sysfs_path, "idVendor");
+        val = sysfs_dir_get_hex (self->priv->physdev_sysfs_dir, "idVendor");
         if (val && val <= G_MAXUINT16)
             self->priv->physdev_vid = val;
     }
@@ -267,7 +385,7 @@ preload_physdev_vid (MMKernelDeviceGeneric *self)
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
                 self->priv->physdev_vid);
-        g_object_set_data_full (G_OBJECT (self), "ID_VENDOR_ID", g_strdup_printf ("%04x", self->priv->physdev_vid), g_free);
+        g_hash_table_insert (self->priv->properties_table, (gpointer) "ID_VENDOR_ID", g_strdup_printf ("%04x", self->priv->physdev_vid));
     } else
         mm_dbg ("(%s/%s) vid: unknown",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
@@ -278,10 +396,10 @@ preload_physdev_vid (MMKernelDeviceGeneric *self)
 static void
 preload_physdev_pid (MMKernelDeviceGeneric *self)
 {
-    if (!self->priv->physdev_pid && self->priv->physdev_sysfs_path) {
+    if (!self->priv->physdev_pid) {
         guint val;
 
-        val = read_sysfs_property_as_hex (self->priv->physdev_sysfs_path, "idProduct");
+        val = sysfs_dir_get_hex (self->priv->physdev_sysfs_dir, "idProduct");
         if (val && val <= G_MAXUINT16)
             self->priv->physdev_pid = val;
     }
@@ -291,7 +409,7 @@ preload_physdev_pid (MMKernelDeviceGeneric *self)
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
                 self->priv->physdev_pid);
-        g_object_set_data_full (G_OBJECT (self), "ID_MODEL_ID", g_strdup_printf ("%04x", self->priv->physdev_pid), g_free);
+        g_hash_table_insert (self->priv->properties_table, (gpointer) "ID_MODEL_ID", g_strdup_printf ("%04x", self->priv->physdev_pid));
     } else
         mm_dbg ("(%s/%s) pid: unknown",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
@@ -302,14 +420,14 @@ static void
 preload_manufacturer (MMKernelDeviceGeneric *self)
 {
     if (!self->priv->physdev_manufacturer)
-        self->priv->physdev_manufacturer = (self->priv->physdev_sysfs_path ? read_sysfs_property_as_string (self->priv->physdev_sysfs_path, "manufacturer") : NULL);
+        self->priv->physdev_manufacturer = g_strdup (sysfs_dir_get_string (self->priv->physdev_sysfs_dir, "manufacturer"));
 
     if (self->priv->physdev_manufacturer) {
         mm_dbg ("(%s/%s) manufacturer (ID_VENDOR): %s",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
                 self->priv->physdev_manufacturer);
-        g_object_set_data_full (G_OBJECT (self), "ID_VENDOR", g_strdup (self->priv->physdev_manufacturer), g_free);
+        g_hash_table_insert (self->priv->properties_table, (gpointer) "ID_VENDOR", g_strdup (self->priv->physdev_manufacturer));
     } else
         mm_dbg ("(%s/%s) manufacturer: unknown",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
@@ -320,14 +438,14 @@ static void
 preload_product (MMKernelDeviceGeneric *self)
 {
     if (!self->priv->physdev_product)
-        self->priv->physdev_product = (self->priv->physdev_sysfs_path ? read_sysfs_property_as_string (self->priv->physdev_sysfs_path, "product") : NULL);
+        self->priv->physdev_product = g_strdup (sysfs_dir_get_string (self->priv->physdev_sysfs_dir, "product"));
 
     if (self->priv->physdev_product) {
         mm_dbg ("(%s/%s) product (ID_MODEL): %s",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
                 self->priv->physdev_product);
-        g_object_set_data_full (G_OBJECT (self), "ID_MODEL", g_strdup (self->priv->physdev_product), g_free);
+        g_hash_table_insert (self->priv->properties_table, (gpointer) "ID_MODEL", g_strdup (self->priv->physdev_product));
     } else
         mm_dbg ("(%s/%s) product: unknown",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
@@ -338,7 +456,7 @@ preload_product (MMKernelDeviceGeneric *self)
 static void
 preload_interface_class (MMKernelDeviceGeneric *self)
 {
-    self->priv->interface_class = (self->priv->interface_sysfs_path ? read_sysfs_property_as_hex (self->priv->interface_sysfs_path, "bInterfaceClass") : 0x00);
+    self->priv->interface_class = sysfs_dir_get_hex (self->priv->interface_sysfs_dir, "bInterfaceClass");
     mm_dbg ("(%s/%s) interface class: 0x%02x",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
@@ -348,7 +466,7 @@ preload_interface_class (MMKernelDeviceGeneric *self)
 static void
 preload_interface_subclass (MMKernelDeviceGeneric *self)
 {
-    self->priv->interface_subclass = (self->priv->interface_sysfs_path ? read_sysfs_property_as_hex (self->priv->interface_sysfs_path, "bInterfaceSubClass") : 0x00);
+    self->priv->interface_subclass = sysfs_dir_get_hex (self->priv->interface_sysfs_dir, "bInterfaceSubClass");
     mm_dbg ("(%s/%s) interface subclass: 0x%02x",
                 mm_kernel_event_properties_get_subsystem (self->priv->properties),
                 mm_kernel_event_properties_get_name      (self->priv->properties),
@@ -358,7 +476,7 @@ preload_interface_subclass (MMKernelDeviceGeneric *self)
 static void
 preload_interface_protocol (MMKernelDeviceGeneric *self)
 {
-    self->priv->interface_protocol = (self->priv->interface_sysfs_path ? read_sysfs_property_as_hex (self->priv->interface_sysfs_path, "bInterfaceProtocol") : 0x00);
+    self->priv->interface_protocol = sysfs_dir_get_hex (self->priv->interface_sysfs_dir, "bInterfaceProtocol");
     mm_dbg ("(%s/%s) interface protocol: 0x%02x",
             mm_kernel_event_properties_get_subsystem (self->priv->properties),
             mm_kernel_event_properties_get_name      (self->priv->properties),
@@ -368,12 +486,12 @@ preload_interface_protocol (MMKernelDeviceGeneric *self)
 static void
 preload_interface_number (MMKernelDeviceGeneric *self)
 {
-    self->priv->interface_number = (self->priv->interface_sysfs_path ? read_sysfs_property_as_hex (self->priv->interface_sysfs_path, "bInterfaceNumber") : 0x00);
+    self->priv->interface_number = sysfs_dir_get_hex (self->priv->interface_sysfs_dir, "bInterfaceNumber");
     mm_dbg ("(%s/%s) interface number (ID_USB_INTERFACE_NUM): 0x%02x",
             mm_kernel_event_properties_get_subsystem (self->priv->properties),
             mm_kernel_event_properties_get_name      (self->priv->properties),
             self->priv->interface_number);
-    g_object_set_data_full (G_OBJECT (self), "ID_USB_INTERFACE_NUM", g_strdup_printf ("%02x", self->priv->interface_number), g_free);
+    g_hash_table_insert (self->priv->properties_table, (gpointer) "ID_USB_INTERFACE_NUM", g_strdup_printf ("%02x", self->priv->interface_number));
 }
 
 static void
@@ -381,11 +499,12 @@ preload_contents (MMKernelDeviceGeneric *self)
 {
     preload_sysfs_path           (self);
     preload_interface_sysfs_path (self);
+    preload_physdev_sysfs_path   (self);
+    preload_sysfs_dirs           (self);
     preload_interface_class      (self);
     preload_interface_subclass   (self);
     preload_interface_protocol   (self);
     preload_interface_number     (self);
-    preload_physdev_sysfs_path   (self);
     preload_manufacturer         (self);
     preload_product              (self);
     preload_driver               (self);
@@ -540,272 +659,28 @@ kernel_device_cmp (MMKernelDevice *a,
 
 /*****************************************************************************/
 
-static gboolean
-string_match (const gchar *str,
-              const gchar *original_pattern)
-{
-    gchar    *pattern;
-    gchar    *start;
-    gboolean  open_prefix = FALSE;
-    gboolean  open_suffix = FALSE;
-    gboolean  match;
-
-    pattern = g_strdup (original_pattern);
-    start = pattern;
-
-    if (start[0] == '*') {
-        open_prefix = TRUE;
-        start++;
-    }
-
-    if (start[strlen (start) - 1] == '*') {
-        open_suffix = TRUE;
-        start[strlen (start) - 1] = '\0';
-    }
-
-    if (open_suffix && !open_prefix)
-        match = g_str_has_prefix (str, start);
-    else if (!open_suffix && open_prefix)
-        match = g_str_has_suffix (str, start);
-    else if (open_suffix && open_prefix)
-        match = !!strstr (str, start);
-    else
-        match = g_str_equal (str, start);
-
-    g_free (pattern);
-    return match;
-}
-
-static gboolean
-check_condition (MMKernelDeviceGeneric *self,
-                 MMUdevRuleMatch       *match)
-{
-    gboolean condition_equal;
-
-    condition_equal = (match->type == MM_UDEV_RULE_MATCH_TYPE_EQUAL);
-
-    /* We only apply 'add' rules */
-    if (g_str_equal (match->parameter, "ACTION"))
-        return ((!!strstr (match->value, "add")) == condition_equal);
-
-    /* We look for the subsystem string in the whole sysfs path.
-     *
-     * Note that we're not really making a difference between "SUBSYSTEMS"
-     * (where the whole device tree is checked) and "SUBSYSTEM" (where just one
-     * single device is checked), because a lot of the MM udev rules are meant
-     * to just tag the physical device (e.g. with ID_MM_DEVICE_IGNORE) instead
-     * of the single ports. In our case with the custom parsing, we do tag all
-     * independent ports.
-     */
-    if (g_str_equal (match->parameter, "SUBSYSTEMS") || g_str_equal (match->parameter, "SUBSYSTEM"))
-        return ((self->priv->sysfs_path && !!strstr (self->priv->sysfs_path, match->value)) == condition_equal);
-
-    /* Exact DRIVER match? We also include the check for DRIVERS, even if we
-     * only apply it to this port driver. */
-    if (g_str_equal (match->parameter, "DRIVER") || g_str_equal (match->parameter, "DRIVERS"))
-        return ((!g_strcmp0 (match->value, mm_kernel_device_get_driver (MM_KERNEL_DEVICE (self)))) == condition_equal);
-
-    /* Device name checks */
-    if (g_str_equal (match->parameter, "KERNEL"))
-        return (string_match (mm_kernel_device_get_name (MM_KERNEL_DEVICE (self)), match->value) == condition_equal);
-
-    /* Device sysfs path checks; we allow both a direct match and a prefix patch */
-    if (g_str_equal (match->parameter, "DEVPATH")) {
-        const gchar *sysfs_path;
-        gchar       *prefix_match = NULL;
-        gboolean     result = FALSE;
-
-        sysfs_path   = mm_kernel_device_get_sysfs_path (MM_KERNEL_DEVICE (self));
-
-        /* If not already doing a prefix match, do an implicit one. This is so that
-         * we can add properties to the usb_device owning all ports, and then apply
-         * the property to all ports individually processed here. */
-        if (match->value[0] && match->value[strlen (match->value) - 1] != '*')
-            prefix_match = g_strdup_printf ("%s/*", match->value);
-
-        if (string_match (sysfs_path, match->value) == condition_equal) {
-            result = TRUE;
-            goto out;
-        }
-
-        if (prefix_match && string_match (sysfs_path, prefix_match) == condition_equal) {
-            result = TRUE;
-            goto out;
-        }
-
-        if (g_str_has_prefix (sysfs_path, "/sys")) {
-            if (string_match (&sysfs_path[4], match->value) == condition_equal) {
-                result = TRUE;
-                goto out;
-            }
-            if (prefix_match && string_match (&sysfs_path[4], prefix_match) == condition_equal) {
-                result = TRUE;
-                goto out;
-            }
-        }
-    out:
-        g_free (prefix_match);
-        return result;
-    }
-
-    /* Attributes checks */
-    if (g_str_has_prefix (match->parameter, "ATTRS")) {
-        gchar    *attribute;
-        gchar    *contents = NULL;
-        gboolean  result = FALSE;
-        guint     val;
-
-        attribute = g_strdup (&match->parameter[5]);
-        g_strdelimit (attribute, "{}", ' ');
-        g_strstrip (attribute);
-
-        /* VID/PID directly from our API */
-        if (g_str_equal (attribute, "idVendor"))
-            result = ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                      ((mm_kernel_device_get_physdev_vid (MM_KERNEL_DEVICE (self)) == val) == condition_equal));
-        else if (g_str_equal (attribute, "idProduct"))
-            result = ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                      ((mm_kernel_device_get_physdev_pid (MM_KERNEL_DEVICE (self)) == val) == condition_equal));
-        /* manufacturer in the physdev */
-        else if (g_str_equal (attribute, "manufacturer"))
-            result = ((self->priv->physdev_manufacturer && g_str_equal (self->priv->physdev_manufacturer, match->value)) == condition_equal);
-        /* product in the physdev */
-        else if (g_str_equal (attribute, "product"))
-            result = ((self->priv->physdev_product && g_str_equal (self->priv->physdev_product, match->value)) == condition_equal);
-        /* interface class/subclass/protocol/number in the interface */
-        else if (g_str_equal (attribute, "bInterfaceClass"))
-            result = (g_str_equal (match->value, "?*") || ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                                                           ((self->priv->interface_class == val) == condition_equal)));
-        else if (g_str_equal (attribute, "bInterfaceSubClass"))
-            result = (g_str_equal (match->value, "?*") || ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                                                           ((self->priv->interface_subclass == val) == condition_equal)));
-        else if (g_str_equal (attribute, "bInterfaceProtocol"))
-            result = (g_str_equal (match->value, "?*") || ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                                                           ((self->priv->interface_protocol == val) == condition_equal)));
-        else if (g_str_equal (attribute, "bInterfaceNumber"))
-            result = (g_str_equal (match->value, "?*") || ((mm_get_uint_from_hex_str (match->value, &val)) &&
-                                                           ((self->priv->interface_number == val) == condition_equal)));
-        else
-            mm_warn ("Unknown attribute: %s", attribute);
-
-        g_free (contents);
-        g_free (attribute);
-        return result;
-    }
-
-    /* Previously set property checks */
-    if (g_str_has_prefix (match->parameter, "ENV")) {
-        gchar    *property;
-        gboolean  result = FALSE;
-
-        property = g_strdup (&match->parameter[3]);
-        g_strdelimit (property, "{}", ' ');
-        g_strstrip (property);
-
-        result = ((!g_strcmp0 ((const gchar *) g_object_get_data (G_OBJECT (self), property), match->value)) == condition_equal);
-
-        g_free (property);
-        return result;
-    }
-
-    mm_warn ("Unknown match condition parameter: %s", match->parameter);
-    return FALSE;
-}
-
-static guint
-check_rule (MMKernelDeviceGeneric *self,
-            guint                  rule_i)
-{
-    MMUdevRule *rule;
-    gboolean    apply = TRUE;
-
-    g_assert (rule_i < self->priv->rules->len);
-
-    rule = &g_array_index (self->priv->rules, MMUdevRule, rule_i);
-    if (rule->conditions) {
-        guint condition_i;
-
-        for (condition_i = 0; condition_i < rule->conditions->len; condition_i++) {
-            MMUdevRuleMatch *match;
-
-            match = &g_array_index (rule->conditions, MMUdevRuleMatch, condition_i);
-            if (!check_condition (self, match)) {
-                apply = FALSE;
-                break;
-            }
-        }
-    }
-
-    if (apply) {
-        switch (rule->result.type) {
-        case MM_UDEV_RULE_RESULT_TYPE_PROPERTY: {
-            gchar *property_value_read = NULL;
-
-            if (g_str_equal (rule->result.content.property.value, "$attr{bInterfaceClass}"))
-                property_value_read = g_strdup_printf ("%02x", self->priv->interface_class);
-            else if (g_str_equal (rule->result.content.property.value, "$attr{bInterfaceSubClass}"))
-                property_value_read = g_strdup_printf ("%02x", self->priv->interface_subclass);
-            else if (g_str_equal (rule->result.content.property.value, "$attr{bInterfaceProtocol}"))
-                property_value_read = g_strdup_printf ("%02x", self->priv->interface_protocol);
-            else if (g_str_equal (rule->result.content.property.value, "$attr{bInterfaceNumber}"))
-                property_value_read = g_strdup_printf ("%02x", self->priv->interface_number);
-
-            /* add new property */
-            mm_dbg ("(%s/%s) property added: %s=%s",
-                    mm_kernel_event_properties_get_subsystem (self->priv->properties),
-                    mm_kernel_event_properties_get_name      (self->priv->properties),
-                    rule->result.content.property.name,
-                    property_value_read ? property_value_read : rule->result.content.property.value);
-
-            if (!property_value_read)
-                /* NOTE: we keep a reference to the list of rules ourselves, so it isn't
-                 * an issue if we re-use the same string (i.e. without g_strdup-ing it)
-                 * as a property value. */
-                g_object_set_data (G_OBJECT (self),
-                                   rule->result.content.property.name,
-                                   rule->result.content.property.value);
-            else
-                g_object_set_data_full (G_OBJECT (self),
-                                        rule->result.content.property.name,
-                                        property_value_read,
-                                        g_free);
-            break;
-        }
-
-        case MM_UDEV_RULE_RESULT_TYPE_LABEL:
-            /* noop */
-            break;
-
-        case MM_UDEV_RULE_RESULT_TYPE_GOTO_INDEX:
-            /* Jump to a new index */
-            return rule->result.content.index;
-
-        case MM_UDEV_RULE_RESULT_TYPE_GOTO_TAG:
-        case MM_UDEV_RULE_RESULT_TYPE_UNKNOWN:
-            g_assert_not_reached ();
-        }
-    }
-
-    /* Go to the next rule */
-    return rule_i + 1;
-}
-
 static void
 preload_properties (MMKernelDeviceGeneric *self)
 {
-    guint i;
+    MMUdevRuleDevice device;
 
     g_assert (self->priv->rules);
     g_assert (self->priv->rules->len > 0);
 
-    /* Start to process rules */
-    i = 0;
-    while (i < self->priv->rules->len) {
-        guint next_rule;
+    device.subsystem            = mm_kernel_event_properties_get_subsystem (self->priv->properties);
+    device.name                 = mm_kernel_event_properties_get_name      (self->priv->properties);
+    device.sysfs_path           = self->priv->sysfs_path;
+    device.driver               = self->priv->driver;
+    device.physdev_vid          = self->priv->physdev_vid;
+    device.physdev_pid          = self->priv->physdev_pid;
+    device.physdev_manufacturer = self->priv->physdev_manufacturer;
+    device.physdev_product      = self->priv->physdev_product;
+    device.interface_class      = self->priv->interface_class;
+    device.interface_subclass   = self->priv->interface_subclass;
+    device.interface_protocol   = self->priv->interface_protocol;
+    device.interface_number     = self->priv->interface_number;
 
-        next_rule = check_rule (self, i);
-        i = next_rule;
-    }
+    mm_kernel_device_generic_rules_apply (self->priv->rules, &device, self->priv->properties_table);
 }
 
 static void
@@ -836,7 +711,7 @@ kernel_device_has_property (MMKernelDevice *self,
 {
     g_return_val_if_fail (MM_IS_KERNEL_DEVICE_GENERIC (self), FALSE);
 
-    return !!g_object_get_data (G_OBJECT (self), property);
+    return g_hash_table_contains (MM_KERNEL_DEVICE_GENERIC (self)->priv->properties_table, property);
 }
 
 static const gchar *
@@ -845,7 +720,7 @@ kernel_device_get_property (MMKernelDevice *self,
 {
     g_return_val_if_fail (MM_IS_KERNEL_DEVICE_GENERIC (self), NULL);
 
-    return g_object_get_data (G_OBJECT (self), property);
+    return g_hash_table_lookup (MM_KERNEL_DEVICE_GENERIC (self)->priv->properties_table, property);
 }
 
 static gboolean
@@ -856,7 +731,7 @@ kernel_device_get_property_as_boolean (MMKernelDevice *self,
 
     g_return_val_if_fail (MM_IS_KERNEL_DEVICE_GENERIC (self), FALSE);
 
-    value = g_object_get_data (G_OBJECT (self), property);
+    value = g_hash_table_lookup (MM_KERNEL_DEVICE_GENERIC (self)->priv->properties_table, property);
     return (value && mm_common_get_boolean_from_string (value, NULL));
 }
 
@@ -869,7 +744,7 @@ kernel_device_get_property_as_int (MMKernelDevice *self,
 
     g_return_val_if_fail (MM_IS_KERNEL_DEVICE_GENERIC (self), -1);
 
-    value = g_object_get_data (G_OBJECT (self), property);
+    value = g_hash_table_lookup (MM_KERNEL_DEVICE_GENERIC (self)->priv->properties_table, property);
     return ((value && mm_get_int_from_str (value, &aux)) ? aux : 0);
 }
 
@@ -882,7 +757,7 @@ kernel_device_get_property_as_int_hex (MMKernelDevice *self,
 
     g_return_val_if_fail (MM_IS_KERNEL_DEVICE_GENERIC (self), G_MAXUINT);
 
-    value = g_object_get_data (G_OBJECT (self), property);
+    value = g_hash_table_lookup (MM_KERNEL_DEVICE_GENERIC (self)->priv->properties_table, property);
     return ((value && mm_get_uint_from_hex_str (value, &aux)) ? aux : 0);
 }
 
@@ -930,6 +805,7 @@ mm_kernel_device_generic_init (MMKernelDeviceGeneric *self)
 {
     /* Initialize private data */
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, MM_TYPE_KERNEL_DEVICE_GENERIC, MMKernelDeviceGenericPrivate);
+    self->priv->properties_table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
 }
 
 static void
@@ -1022,11 +898,16 @@ dispose (GObject *object)
 {
     MMKernelDeviceGeneric *self = MM_KERNEL_DEVICE_GENERIC (object);
 
+    g_clear_pointer (&self->priv->physdev_sysfs_dir,    sysfs_dir_unref);
+    g_clear_pointer (&self->priv->interface_sysfs_dir,  sysfs_dir_unref);
     g_clear_pointer (&self->priv->physdev_product,      g_free);
     g_clear_pointer (&self->priv->physdev_manufacturer, g_free);
     g_clear_pointer (&self->priv->physdev_sysfs_path,   g_free);
     g_clear_pointer (&self->priv->interface_sysfs_path, g_free);
     g_clear_pointer (&self->priv->sysfs_path,           g_free);
+    g_clear_pointer (&self->priv->driver,               g_free);
+    /* Keys may point to strings in the rules, so clear before them */
+    g_clear_pointer (&self->priv->properties_table,     g_hash_table_unref);
     g_clear_pointer (&self->priv->rules,                g_array_unref);
     g_clear_object  (&self->priv->properties);
 
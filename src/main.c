@@ -29,6 +29,8 @@
 #include "mm-base-manager.h"
 #include "mm-log.h"
 #include "mm-context.h"
+#include "mm-port-probe-cache.h"
+#include "mm-probe-trace.h"
 
 #if defined WITH_SYSTEMD_SUSPEND_RESUME
 # include "mm-sleep-monitor.h"
@@ -89,6 +91,8 @@ bus_acquired_cb (GDBusConnection *connection,
                                    !mm_context_get_no_auto_scan (),
                                    mm_context_get_initial_kernel_events (),
                                    mm_context_get_test_enable (),
+                                   mm_context_get_uevent_coalesce_time (),
+                                   mm_context_get_max_probes (),
                                    &error);
     if (!manager) {
         mm_warn ("Could not create manager: %s", error->message);
@@ -150,6 +154,9 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    mm_port_probe_cache_setup (mm_context_get_probe_cache_file ());
+    mm_probe_trace_setup (mm_context_get_probe_trace_file ());
+
     g_unix_signal_add (SIGTERM, quit_cb, NULL);
     g_unix_signal_add (SIGINT, quit_cb, NULL);
 
@@ -214,6 +221,9 @@ main (int argc, char *argv[])
 
     g_bus_unown_name (name_id);
 
+    mm_port_probe_cache_shutdown ();
+    mm_probe_trace_shutdown ();
+
     mm_info ("ModemManager is shut down");
 
     mm_log_shutdown ();
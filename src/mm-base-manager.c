@@ -37,8 +37,11 @@
 #include "mm-base-manager.h"
 #include "mm-device.h"
 #include "mm-plugin-manager.h"
+#include "mm-uevent-queue.h"
+#include "mm-port-index.h"
 #include "mm-auth.h"
 #include "mm-plugin.h"
+#include "mm-port-serial.h"
 #include "mm-log.h"
 
 static void initable_iface_init (GInitableIface *iface);
@@ -54,6 +57,8 @@ enum {
     PROP_ENABLE_TEST,
     PROP_PLUGIN_DIR,
     PROP_INITIAL_KERNEL_EVENTS,
+    PROP_UEVENT_COALESCE_TIME,
+    PROP_MAX_PROBES,
     LAST_PROP
 };
 
@@ -68,6 +73,8 @@ struct _MMBaseManagerPrivate {
     gchar *plugin_dir;
     /* Path to the list of initial kernel events */
     gchar *initial_kernel_events;
+    /* Maximum number of port probes to run at the same time */
+    guint max_probes;
     /* The authorization provider */
     MMAuthProvider *authp;
     GCancellable *authp_cancellable;
@@ -75,6 +82,8 @@ struct _MMBaseManagerPrivate {
     MMPluginManager *plugin_manager;
     /* The container of devices being prepared */
     GHashTable *devices;
+    /* Device owning each port */
+    MMPortIndex *ports;
     /* The Object Manager server */
     GDBusObjectManagerServer *object_manager;
 
@@ -84,25 +93,121 @@ struct _MMBaseManagerPrivate {
 #if defined WITH_UDEV
     /* The UDev client */
     GUdevClient *udev;
+    /* Time to buffer uevents before processing them, in ms */
+    guint uevent_coalesce_time;
+    /* Uevents buffered */
+    MMUeventQueue *pending_uevents;
+    guint pending_uevents_id;
 #endif
 };
 
 /*****************************************************************************/
 
+/* Virtual ports are given by name only; they are always created in the
+ * 'virtual' subsystem, see mm_plugin_create_modem() */
+#define VIRTUAL_PORT_SUBSYSTEM "virtual"
+
+static void
+track_port (MMBaseManager  *self,
+            MMDevice       *device,
+            MMKernelDevice *port)
+{
+    /* Ports are matched by subsystem and name, see mm_kernel_device_cmp() */
+    mm_port_index_add (self->priv->ports,
+                       mm_kernel_device_get_subsystem (port),
+                       mm_kernel_device_get_name (port),
+                       G_OBJECT (device));
+}
+
+static void
+untrack_port (MMBaseManager  *self,
+              MMDevice       *device,
+              MMKernelDevice *port)
+{
+    mm_port_index_remove (self->priv->ports,
+                          mm_kernel_device_get_subsystem (port),
+                          mm_kernel_device_get_name (port),
+                          G_OBJECT (device));
+}
+
+static void
+untrack_port_probes (MMBaseManager *self,
+                     MMDevice      *device,
+                     GList         *probes)
+{
+    GList *l;
+
+    for (l = probes; l; l = g_list_next (l))
+        untrack_port (self, device, mm_port_probe_peek_port (MM_PORT_PROBE (l->data)));
+}
+
+static void
+track_virtual_ports (MMBaseManager *self,
+                     MMDevice      *device)
+{
+    const gchar **ports;
+    guint         i;
+
+    ports = mm_device_virtual_peek_ports (device);
+    for (i = 0; ports && ports[i]; i++)
+        mm_port_index_add (self->priv->ports, VIRTUAL_PORT_SUBSYSTEM, ports[i], G_OBJECT (device));
+}
+
+static void
+untrack_virtual_ports (MMBaseManager *self,
+                       MMDevice      *device)
+{
+    const gchar **ports;
+    guint         i;
+
+    ports = mm_device_virtual_peek_ports (device);
+    for (i = 0; ports && ports[i]; i++)
+        mm_port_index_remove (self->priv->ports, VIRTUAL_PORT_SUBSYSTEM, ports[i], G_OBJECT (device));
+}
+
+static gboolean
+device_owns_virtual_port (MMDevice       *device,
+                          MMKernelDevice *port)
+{
+    const gchar **ports;
+    guint         i;
+
+    if (g_strcmp0 (mm_kernel_device_get_subsystem (port), VIRTUAL_PORT_SUBSYSTEM) != 0)
+        return FALSE;
+
+    ports = mm_device_virtual_peek_ports (device);
+    for (i = 0; ports && ports[i]; i++) {
+        if (g_strcmp0 (ports[i], mm_kernel_device_get_name (port)) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+remove_device (MMBaseManager *self,
+               MMDevice      *device)
+{
+    /* The device may not be tracked any more, but removing it again is
+     * harmless */
+    if (mm_device_is_virtual (device))
+        untrack_virtual_ports (self, device);
+    else {
+        untrack_port_probes (self, device, mm_device_peek_port_probe_list (device));
+        untrack_port_probes (self, device, mm_device_peek_ignored_port_probe_list (device));
+    }
+    g_hash_table_remove (self->priv->devices, mm_device_get_uid (device));
+}
+
 static MMDevice *
 find_device_by_modem (MMBaseManager *manager,
                       MMBaseModem *modem)
 {
-    GHashTableIter iter;
-    gpointer key, value;
-
-    g_hash_table_iter_init (&iter, manager->priv->devices);
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        MMDevice *candidate = MM_DEVICE (value);
+    MMDevice *device;
 
-        if (modem == mm_device_peek_modem (candidate))
-            return candidate;
-    }
+    /* The modem device is the uid of the device which created it */
+    device = g_hash_table_lookup (manager->priv->devices, mm_base_modem_get_device (modem));
+    if (device && modem == mm_device_peek_modem (device))
+        return device;
     return NULL;
 }
 
@@ -110,16 +215,18 @@ static MMDevice *
 find_device_by_port (MMBaseManager  *manager,
                      MMKernelDevice *port)
 {
-    GHashTableIter iter;
-    gpointer key, value;
+    MMDevice *device;
 
-    g_hash_table_iter_init (&iter, manager->priv->devices);
-    while (g_hash_table_iter_next (&iter, &key, &value)) {
-        MMDevice *candidate = MM_DEVICE (value);
+    device = (MMDevice *) mm_port_index_lookup (manager->priv->ports,
+                                                mm_kernel_device_get_subsystem (port),
+                                                mm_kernel_device_get_name (port));
+    if (!device)
+        return NULL;
 
-        if (mm_device_owns_port (candidate, port))
-            return candidate;
-    }
+    if (mm_device_is_virtual (device) ?
+        device_owns_virtual_port (device, port) :
+        mm_device_owns_port (device, port))
+        return device;
     return NULL;
 }
 
@@ -171,7 +278,7 @@ device_support_check_ready (MMPluginManager          *plugin_manager,
         mm_info ("Couldn't check support for device '%s': %s",
                  mm_device_get_uid (ctx->device), error->message);
         g_error_free (error);
-        g_hash_table_remove (ctx->self->priv->devices, mm_device_get_uid (ctx->device));
+        remove_device (ctx->self, ctx->device);
         find_device_support_context_free (ctx);
         return;
     }
@@ -181,10 +288,16 @@ device_support_check_ready (MMPluginManager          *plugin_manager,
     g_object_unref (plugin);
 
     if (!mm_device_create_modem (ctx->device, ctx->self->priv->object_manager, &error)) {
+        GList *l;
+
         mm_warn ("Couldn't create modem for device '%s': %s",
                  mm_device_get_uid (ctx->device), error->message);
         g_error_free (error);
-        g_hash_table_remove (ctx->self->priv->devices, mm_device_get_uid (ctx->device));
+
+        /* Don't reuse probing results which led to a failure */
+        for (l = mm_device_peek_port_probe_list (ctx->device); l; l = g_list_next (l))
+            mm_port_probe_forget_cached_results (MM_PORT_PROBE (l->data));
+        remove_device (ctx->self, ctx->device);
         find_device_support_context_free (ctx);
         return;
     }
@@ -214,6 +327,7 @@ device_removed (MMBaseManager  *self,
         device = find_device_by_port (self, kernel_device);
         if (device) {
             mm_info ("(%s/%s): released by device '%s'", subsys, name, mm_device_get_uid (device));
+            untrack_port (self, device, kernel_device);
             mm_device_release_port (device, kernel_device);
 
             /* If port probe list gets empty, remove the device object iself */
@@ -231,7 +345,7 @@ device_removed (MMBaseManager  *self,
                     /* The device may have already been removed from the tracking HT, we
                      * just try to remove it and if it fails, we ignore it */
                     mm_device_remove_modem (device);
-                    g_hash_table_remove (self->priv->devices, mm_device_get_uid (device));
+                    remove_device (self, device);
                 }
                 g_object_unref (device);
             }
@@ -252,7 +366,7 @@ device_removed (MMBaseManager  *self,
     if (device) {
         mm_dbg ("Removing device '%s'", mm_device_get_uid (device));
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, mm_device_get_uid (device));
+        remove_device (self, device);
         return;
     }
 }
@@ -330,6 +444,7 @@ device_added (MMBaseManager  *manager,
 
     /* Grab the port in the existing device. */
     mm_device_grab_port (device, port);
+    track_port (manager, device, port);
 }
 
 static gboolean
@@ -395,6 +510,54 @@ handle_kernel_event (MMBaseManager            *self,
 
 #if defined WITH_UDEV
 
+static void
+process_uevent (GUdevDevice   *device,
+                gboolean       remove,
+                gboolean       add,
+                MMBaseManager *self)
+{
+    MMKernelDevice *kernel_device;
+
+    kernel_device = mm_kernel_device_udev_new (device);
+    if (remove)
+        device_removed (self, kernel_device);
+    if (add)
+        device_added (self, kernel_device, TRUE, FALSE);
+    g_object_unref (kernel_device);
+}
+
+/* Uevents are buffered for a short time before being processed, so that
+ * bursts of events are reduced to their net effect on each port, see
+ * MMUeventQueue */
+
+static gboolean
+pending_uevents_flush (MMBaseManager *self)
+{
+    self->priv->pending_uevents_id = 0;
+
+    mm_dbg ("Processing %u coalesced uevents", mm_uevent_queue_get_length (self->priv->pending_uevents));
+    mm_uevent_queue_flush (self->priv->pending_uevents,
+                           (MMUeventQueueProcessFunc) process_uevent,
+                           self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+pending_uevents_queue (MMBaseManager *self,
+                       GUdevDevice   *device,
+                       const gchar   *sysfs_path,
+                       gboolean       remove)
+{
+    mm_uevent_queue_push (self->priv->pending_uevents, sysfs_path, G_OBJECT (device), remove);
+
+    /* The window starts with the first event buffered, and isn't extended by
+     * the next ones, so that events are never delayed longer than that */
+    if (!self->priv->pending_uevents_id)
+        self->priv->pending_uevents_id = g_timeout_add (self->priv->uevent_coalesce_time,
+                                                        (GSourceFunc) pending_uevents_flush,
+                                                        self);
+}
+
 static void
 handle_uevent (GUdevClient *client,
                const char *action,
@@ -404,7 +567,9 @@ handle_uevent (GUdevClient *client,
     MMBaseManager *self = MM_BASE_MANAGER (user_data);
     const gchar *subsys;
     const gchar *name;
-    MMKernelDevice *kernel_device;
+    const gchar *sysfs_path;
+    gboolean add;
+    gboolean remove;
 
     g_return_if_fail (action != NULL);
 
@@ -413,19 +578,23 @@ handle_uevent (GUdevClient *client,
     g_return_if_fail (subsys != NULL);
     g_return_if_fail (g_str_equal (subsys, "tty") || g_str_equal (subsys, "net") || g_str_has_prefix (subsys, "usb"));
 
-    kernel_device = mm_kernel_device_udev_new (device);
-
     /* We only care about tty/net and usb/cdc-wdm devices when adding modem ports,
      * but for remove, also handle usb parent device remove events
      */
-    name = mm_kernel_device_get_name (kernel_device);
-    if (   (g_str_equal (action, "add") || g_str_equal (action, "move") || g_str_equal (action, "change"))
-        && (!g_str_has_prefix (subsys, "usb") || (name && g_str_has_prefix (name, "cdc-wdm"))))
-        device_added (self, kernel_device, TRUE, FALSE);
-    else if (g_str_equal (action, "remove"))
-        device_removed (self, kernel_device);
+    name = g_udev_device_get_name (device);
+    add = ((g_str_equal (action, "add") || g_str_equal (action, "move") || g_str_equal (action, "change")) &&
+           (!g_str_has_prefix (subsys, "usb") || (name && g_str_has_prefix (name, "cdc-wdm"))));
+    remove = g_str_equal (action, "remove");
+    if (!add && !remove)
+        return;
 
-    g_object_unref (kernel_device);
+    sysfs_path = g_udev_device_get_sysfs_path (device);
+    if (!self->priv->uevent_coalesce_time || !sysfs_path) {
+        process_uevent (device, remove, add, self);
+        return;
+    }
+
+    pending_uevents_queue (self, device, sysfs_path, remove);
 }
 
 typedef struct {
@@ -594,7 +763,7 @@ remove_disable_ready (MMBaseModem *modem,
     if (device) {
         g_cancellable_cancel (mm_base_modem_peek_cancellable (modem));
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, device);
+        remove_device (self, device);
     }
 }
 
@@ -646,6 +815,7 @@ mm_base_manager_shutdown (MMBaseManager *self,
 
     /* Otherwise, just remove directly */
     g_hash_table_foreach_remove (self->priv->devices, (GHRFunc)foreach_remove, self);
+    mm_port_index_clear (self->priv->ports);
 }
 
 guint32
@@ -890,6 +1060,7 @@ handle_set_profile (MmGdbusTest *skeleton,
 
     /* Grab virtual ports */
     mm_device_virtual_grab_ports (device, (const gchar **)ports);
+    track_virtual_ports (self, device);
 
     /* Set plugin to use */
     plugin = mm_plugin_manager_peek_plugin (self->priv->plugin_manager, plugin_name);
@@ -920,7 +1091,7 @@ out:
 
     if (error) {
         mm_device_remove_modem (device);
-        g_hash_table_remove (self->priv->devices, mm_device_get_uid (device));
+        remove_device (self, device);
         g_dbus_method_invocation_return_gerror (invocation, error);
         g_error_free (error);
     } else
@@ -929,6 +1100,46 @@ out:
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Port statistics */
+
+static gboolean
+handle_get_port_statistics (MmGdbusTest *skeleton,
+                            GDBusMethodInvocation *invocation,
+                            MMBaseManager *self)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer value;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+    g_hash_table_iter_init (&iter, self->priv->devices);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        MMBaseModem *modem;
+        GList *ports;
+        GList *l;
+        const gchar *path;
+
+        modem = mm_device_peek_modem (MM_DEVICE (value));
+        if (!modem)
+            continue;
+
+        path = g_dbus_object_get_object_path (G_DBUS_OBJECT (modem));
+        ports = mm_base_modem_find_ports (modem, MM_PORT_SUBSYS_UNKNOWN, MM_PORT_TYPE_UNKNOWN, NULL);
+        for (l = ports; l; l = g_list_next (l)) {
+            if (MM_IS_PORT_SERIAL (l->data))
+                mm_port_serial_add_command_statistics (MM_PORT_SERIAL (l->data), path, &builder);
+        }
+        g_list_free_full (ports, g_object_unref);
+    }
+
+    mm_gdbus_test_complete_get_port_statistics (skeleton,
+                                                invocation,
+                                                g_variant_builder_end (&builder));
+    return TRUE;
+}
+
 /*****************************************************************************/
 
 MMBaseManager *
@@ -937,6 +1148,8 @@ mm_base_manager_new (GDBusConnection *connection,
                      gboolean auto_scan,
                      const gchar *initial_kernel_events,
                      gboolean enable_test,
+                     guint uevent_coalesce_time,
+                     guint max_probes,
                      GError **error)
 {
     g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), NULL);
@@ -949,6 +1162,8 @@ mm_base_manager_new (GDBusConnection *connection,
                            MM_BASE_MANAGER_AUTO_SCAN, auto_scan,
                            MM_BASE_MANAGER_INITIAL_KERNEL_EVENTS, initial_kernel_events,
                            MM_BASE_MANAGER_ENABLE_TEST, enable_test,
+                           MM_BASE_MANAGER_UEVENT_COALESCE_TIME, uevent_coalesce_time,
+                           MM_BASE_MANAGER_MAX_PROBES, max_probes,
                            NULL);
 }
 
@@ -997,6 +1212,14 @@ set_property (GObject *object,
         g_free (priv->initial_kernel_events);
         priv->initial_kernel_events = g_value_dup_string (value);
         break;
+    case PROP_UEVENT_COALESCE_TIME:
+#if defined WITH_UDEV
+        priv->uevent_coalesce_time = g_value_get_uint (value);
+#endif
+        break;
+    case PROP_MAX_PROBES:
+        priv->max_probes = g_value_get_uint (value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1027,6 +1250,16 @@ get_property (GObject *object,
     case PROP_INITIAL_KERNEL_EVENTS:
         g_value_set_string (value, priv->initial_kernel_events);
         break;
+    case PROP_UEVENT_COALESCE_TIME:
+#if defined WITH_UDEV
+        g_value_set_uint (value, priv->uevent_coalesce_time);
+#else
+        g_value_set_uint (value, 0);
+#endif
+        break;
+    case PROP_MAX_PROBES:
+        g_value_set_uint (value, priv->max_probes);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1049,6 +1282,7 @@ mm_base_manager_init (MMBaseManager *manager)
 
     /* Setup internal lists of device objects */
     priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    priv->ports = mm_port_index_new ();
 
 #if defined WITH_UDEV
     {
@@ -1057,6 +1291,8 @@ mm_base_manager_init (MMBaseManager *manager)
         /* Setup UDev client */
         priv->udev = g_udev_client_new (subsys);
     }
+
+    priv->pending_uevents = mm_uevent_queue_new ();
 #endif
 
     /* By default, enable autoscan */
@@ -1097,7 +1333,7 @@ initable_init (GInitable *initable,
 #endif
 
     /* Create plugin manager */
-    priv->plugin_manager = mm_plugin_manager_new (priv->plugin_dir, error);
+    priv->plugin_manager = mm_plugin_manager_new (priv->plugin_dir, priv->max_probes, error);
     if (!priv->plugin_manager)
         return FALSE;
 
@@ -1119,6 +1355,10 @@ initable_init (GInitable *initable,
                           "handle-set-profile",
                           G_CALLBACK (handle_set_profile),
                           initable);
+        g_signal_connect (priv->test_skeleton,
+                          "handle-get-port-statistics",
+                          G_CALLBACK (handle_get_port_statistics),
+                          initable);
         if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (priv->test_skeleton),
                                                priv->connection,
                                                MM_DBUS_PATH,
@@ -1138,9 +1378,14 @@ finalize (GObject *object)
     g_free (priv->initial_kernel_events);
     g_free (priv->plugin_dir);
 
+    mm_port_index_free (priv->ports);
     g_hash_table_destroy (priv->devices);
 
 #if defined WITH_UDEV
+    if (priv->pending_uevents_id)
+        g_source_remove (priv->pending_uevents_id);
+    mm_uevent_queue_free (priv->pending_uevents);
+
     if (priv->udev)
         g_object_unref (priv->udev);
 #endif
@@ -1225,4 +1470,20 @@ mm_base_manager_class_init (MMBaseManagerClass *manager_class)
                               "Path to a file with the list of initial kernel events",
                               NULL,
                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+    g_object_class_install_property
+        (object_class, PROP_UEVENT_COALESCE_TIME,
+         g_param_spec_uint (MM_BASE_MANAGER_UEVENT_COALESCE_TIME,
+                            "Uevent coalesce time",
+                            "Time to buffer uevents before processing them, in ms",
+                            0, G_MAXUINT, 0,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+    g_object_class_install_property
+        (object_class, PROP_MAX_PROBES,
+         g_param_spec_uint (MM_BASE_MANAGER_MAX_PROBES,
+                            "Max probes",
+                            "Maximum number of port probes to run at the same time, 0 if unlimited",
+                            0, G_MAXUINT, 0,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
 }
@@ -35,6 +35,8 @@
 #define MM_BASE_MANAGER_ENABLE_TEST "enable-test" /* Construct-only */
 #define MM_BASE_MANAGER_PLUGIN_DIR  "plugin-dir"  /* Construct-only */
 #define MM_BASE_MANAGER_INITIAL_KERNEL_EVENTS "initial-kernel-events" /* Construct-only */
+#define MM_BASE_MANAGER_UEVENT_COALESCE_TIME  "uevent-coalesce-time"  /* Construct-only */
+#define MM_BASE_MANAGER_MAX_PROBES            "max-probes"            /* Construct-only */
 
 typedef struct _MMBaseManagerPrivate MMBaseManagerPrivate;
 
@@ -54,6 +56,8 @@ MMBaseManager   *mm_base_manager_new         (GDBusConnection *bus,
                                               gboolean auto_scan,
                                               const gchar *initial_kernel_events,
                                               gboolean enable_test,
+                                              guint uevent_coalesce_time,
+                                              guint max_probes,
                                               GError **error);
 
 void             mm_base_manager_start       (MMBaseManager *manager,
@@ -13,6 +13,8 @@
  * Copyright (C) 2011 Aleksander Morgado <aleksander@gnu.org>
  */
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 
@@ -20,6 +22,18 @@
 
 #include "mm-base-modem-at.h"
 #include "mm-errors-types.h"
+#include "mm-modem-helpers.h"
+#include "mm-log.h"
+
+/* Changing the functionality level may change any non-static reply, in any
+ * of the ports of the modem */
+static void
+invalidate_cached_replies_if_needed (MMBaseModem *self,
+                                     const gchar *command)
+{
+    if (mm_port_serial_at_command_sets_functionality (command))
+        mm_base_modem_invalidate_cached_replies (self, FALSE);
+}
 
 static gboolean
 abort_async_if_port_unusable (MMBaseModem *self,
@@ -102,6 +116,11 @@ typedef struct {
     gpointer response_processor_context;
     GDestroyNotify response_processor_context_free;
     GVariant *result;
+    /* Batched commands */
+    gboolean batch_enabled;
+    guint batch_n_commands;
+    gchar **batch_responses;
+    guint batch_index;
 } AtSequenceContext;
 
 static void
@@ -127,6 +146,7 @@ at_sequence_context_free (AtSequenceContext *ctx)
         g_variant_unref (ctx->result);
     if (ctx->simple)
         g_object_unref (ctx->simple);
+    g_strfreev (ctx->batch_responses);
     g_free (ctx);
 }
 
@@ -152,15 +172,183 @@ mm_base_modem_at_sequence_full_finish (MMBaseModem *self,
     return ctx->result;
 }
 
+/* Maximum length of a batched command line, as V.250 only requires devices
+ * to accept command lines of at least 40 characters */
+#define AT_SEQUENCE_BATCH_MAX_LENGTH 40
+
+static void at_sequence_parse_response (MMPortSerialAt *port,
+                                        GAsyncResult *res,
+                                        AtSequenceContext *ctx);
+
+static gboolean
+at_command_is_batchable (const MMBaseModemAtCommand *command)
+{
+    /* Only extended commands explicitly flagged by the sequence can be
+     * concatenated: all of them are run even if the sequence would have
+     * finished earlier, and they may be re-run one by one if the batch
+     * fails. */
+    return (command->batch &&
+            command->command[0] == '+' &&
+            !strchr (command->command, ';'));
+}
+
+static void
+at_sequence_send (AtSequenceContext *ctx)
+{
+    const MMBaseModemAtCommand *iter;
+    GString *line = NULL;
+    guint timeout = 0;
+    gboolean allow_cached;
+
+    g_strfreev (ctx->batch_responses);
+    ctx->batch_responses = NULL;
+    ctx->batch_index = 0;
+    ctx->batch_n_commands = 0;
+
+    /* The first command in the sequence is never taken from the cache */
+    allow_cached = (ctx->current != ctx->sequence);
+
+    /* Merge as many consecutive commands as possible in the same line */
+    if (ctx->batch_enabled) {
+        for (iter = ctx->current; iter->command && at_command_is_batchable (iter); iter++) {
+            if (!line)
+                line = g_string_new (iter->command);
+            else if (line->len + 1 + strlen (iter->command) <= AT_SEQUENCE_BATCH_MAX_LENGTH)
+                g_string_append_printf (line, ";%s", iter->command);
+            else
+                break;
+            timeout += iter->timeout;
+            allow_cached = allow_cached && iter->allow_cached;
+            ctx->batch_n_commands++;
+        }
+    }
+
+    if (ctx->batch_n_commands > 1) {
+        mm_dbg ("Sending %u AT commands in a single line", ctx->batch_n_commands);
+        invalidate_cached_replies_if_needed (ctx->self, line->str);
+        mm_port_serial_at_command (
+            ctx->port,
+            line->str,
+            timeout,
+            FALSE,
+            allow_cached,
+            ctx->cancellable,
+            (GAsyncReadyCallback)at_sequence_parse_response,
+            ctx);
+        g_string_free (line, TRUE);
+        return;
+    }
+
+    if (line)
+        g_string_free (line, TRUE);
+    ctx->batch_n_commands = 0;
+
+    invalidate_cached_replies_if_needed (ctx->self, ctx->current->command);
+    mm_port_serial_at_command (
+        ctx->port,
+        ctx->current->command,
+        ctx->current->timeout,
+        FALSE,
+        allow_cached && ctx->current->allow_cached,
+        ctx->cancellable,
+        (GAsyncReadyCallback)at_sequence_parse_response,
+        ctx);
+}
+
+static void
+at_sequence_complete (AtSequenceContext *ctx,
+                      GVariant *result)
+{
+    GSimpleAsyncResult *simple;
+
+    /* If we got a response, set it as result */
+    if (result)
+        /* transfer-full */
+        ctx->result = result;
+
+    /* Set the whole context as result, in order to pass the response
+     * processor context during finish(). We do remove the simple async result
+     * from the context as well, so that we control its last unref. */
+    simple = ctx->simple;
+    ctx->simple = NULL;
+    g_simple_async_result_set_op_res_gpointer (
+        simple,
+        ctx,
+        (GDestroyNotify)at_sequence_context_free);
+
+    /* And complete. The whole context is owned by the result, and it will
+     * be freed when completed. */
+    g_simple_async_result_complete (simple);
+    g_object_unref (simple);
+}
+
+static void
+at_sequence_process_response (AtSequenceContext *ctx,
+                              const gchar *response,
+                              const GError *error)
+{
+    while (TRUE) {
+        GVariant *result = NULL;
+        GError *result_error = NULL;
+        gboolean continue_sequence;
+
+        if (!ctx->current->response_processor)
+            /* No need to process response, go on to next command */
+            continue_sequence = TRUE;
+        else {
+            const MMBaseModemAtCommand *next = ctx->current + 1;
+
+            /* Response processor will tell us if we need to keep on the sequence */
+            continue_sequence = !ctx->current->response_processor (
+                ctx->self,
+                ctx->response_processor_context,
+                ctx->current->command,
+                response,
+                next->command ? FALSE : TRUE,  /* Last command in sequence? */
+                error,
+                &result,
+                &result_error);
+            /* Were we told to abort the sequence? */
+            if (result_error) {
+                g_assert (result == NULL);
+                g_simple_async_result_take_error (ctx->simple, result_error);
+                g_simple_async_result_complete (ctx->simple);
+                at_sequence_context_free (ctx);
+                return;
+            }
+        }
+
+        if (!continue_sequence) {
+            at_sequence_complete (ctx, result);
+            return;
+        }
+
+        g_assert (result == NULL);
+        ctx->current++;
+
+        /* On last command, end. */
+        if (!ctx->current->command) {
+            at_sequence_complete (ctx, NULL);
+            return;
+        }
+
+        /* If the response to the next command was received in the same
+         * batch, process it right away */
+        if (!ctx->batch_responses || !ctx->batch_responses[++ctx->batch_index])
+            break;
+        response = ctx->batch_responses[ctx->batch_index];
+        error = NULL;
+    }
+
+    /* Schedule the next command in the probing group */
+    at_sequence_send (ctx);
+}
+
 static void
 at_sequence_parse_response (MMPortSerialAt *port,
                             GAsyncResult *res,
                             AtSequenceContext *ctx)
 {
-    GVariant *result = NULL;
-    GError *result_error = NULL;
-    gboolean continue_sequence;
-    GSimpleAsyncResult *simple;
     const gchar *response;
     GError *error = NULL;
 
@@ -179,76 +367,37 @@ at_sequence_parse_response (MMPortSerialAt *port,
         return;
     }
 
-    if (!ctx->current->response_processor)
-        /* No need to process response, go on to next command */
-        continue_sequence = TRUE;
-    else {
-        const MMBaseModemAtCommand *next = ctx->current + 1;
-
-        /* Response processor will tell us if we need to keep on the sequence */
-        continue_sequence = !ctx->current->response_processor (
-            ctx->self,
-            ctx->response_processor_context,
-            ctx->current->command,
-            response,
-            next->command ? FALSE : TRUE,  /* Last command in sequence? */
-            error,
-            &result,
-            &result_error);
-        /* Were we told to abort the sequence? */
-        if (result_error) {
-            g_assert (result == NULL);
-            g_simple_async_result_take_error (ctx->simple, result_error);
-            g_simple_async_result_complete (ctx->simple);
-            at_sequence_context_free (ctx);
-            if (error)
-                g_error_free (error);
-            return;
-        }
-    }
+    if (ctx->batch_n_commands > 1) {
+        if (!error) {
+            const gchar **commands;
+            guint i;
 
-    if (error)
-        g_error_free (error);
+            commands = g_new (const gchar *, ctx->batch_n_commands);
+            for (i = 0; i < ctx->batch_n_commands; i++)
+                commands[i] = ctx->current[i].command;
+            ctx->batch_responses = mm_split_concatenated_response (response, commands, ctx->batch_n_commands);
+            g_free (commands);
+        }
 
-    if (continue_sequence) {
-        g_assert (result == NULL);
-        ctx->current++;
-        if (ctx->current->command) {
-            /* Schedule the next command in the probing group */
-            mm_port_serial_at_command (
-                ctx->port,
-                ctx->current->command,
-                ctx->current->timeout,
-                FALSE,
-                ctx->current->allow_cached,
-                ctx->cancellable,
-                (GAsyncReadyCallback)at_sequence_parse_response,
-                ctx);
+        /* On any error, fall back to sending the commands one by one for the
+         * rest of the sequence */
+        if (!ctx->batch_responses) {
+            mm_dbg ("Couldn't run batched AT commands (%s), sending them one by one",
+                    error ? error->message : "unexpected response");
+            if (error)
+                g_error_free (error);
+            ctx->batch_enabled = FALSE;
+            at_sequence_send (ctx);
             return;
         }
 
-        /* On last command, end. */
+        response = ctx->batch_responses[0];
     }
 
-    /* If we got a response, set it as result */
-    if (result)
-        /* transfer-full */
-        ctx->result = result;
-
-    /* Set the whole context as result, in order to pass the response
-     * processor context during finish(). We do remove the simple async result
-     * from the context as well, so that we control its last unref. */
-    simple = ctx->simple;
-    ctx->simple = NULL;
-    g_simple_async_result_set_op_res_gpointer (
-        simple,
-        ctx,
-        (GDestroyNotify)at_sequence_context_free);
+    at_sequence_process_response (ctx, response, error);
 
-    /* And complete. The whole context is owned by the result, and it will
-     * be freed when completed. */
-    g_simple_async_result_complete (simple);
-    g_object_unref (simple);
+    if (error)
+        g_error_free (error);
 }
 
 void
@@ -295,16 +444,11 @@ mm_base_modem_at_sequence_full (MMBaseModem *self,
                                                    NULL);
     }
 
+    /* Concatenate commands if the port supports it */
+    g_object_get (port, MM_PORT_SERIAL_AT_CONCATENATION, &ctx->batch_enabled, NULL);
+
     /* Go on with the first one in the sequence */
-    mm_port_serial_at_command (
-        ctx->port,
-        ctx->current->command,
-        ctx->current->timeout,
-        FALSE,
-        FALSE,
-        ctx->cancellable,
-        (GAsyncReadyCallback)at_sequence_parse_response,
-        ctx);
+    at_sequence_send (ctx);
 }
 
 GVariant *
@@ -328,11 +472,21 @@ mm_base_modem_at_sequence (MMBaseModem *self,
                            GAsyncReadyCallback callback,
                            gpointer user_data)
 {
+    const MMBaseModemAtCommand *iter;
     MMPortSerialAt *port;
     GError *error = NULL;
 
-    /* No port given, so we'll try to guess which is best */
-    port = mm_base_modem_peek_best_at_port (self, &error);
+    /* No port given, so we'll try to guess which is best. The sequence may
+     * only be moved to another port if none of its commands is bound to the
+     * primary one. */
+    for (iter = sequence; iter->command; iter++) {
+        if (iter->affinity != MM_BASE_MODEM_AT_PORT_AFFINITY_ANY)
+            break;
+    }
+    if (!iter->command)
+        port = mm_base_modem_peek_idle_at_port (self, &error);
+    else
+        port = mm_base_modem_peek_best_at_port (self, &error);
     if (!port) {
         g_assert (error != NULL);
         g_simple_async_report_take_gerror_in_idle (G_OBJECT (self),
@@ -546,6 +700,7 @@ mm_base_modem_at_command_full (MMBaseModem *self,
     }
 
     /* Go on with the command */
+    invalidate_cached_replies_if_needed (self, command);
     mm_port_serial_at_command (
         port,
         command,
@@ -571,6 +726,7 @@ _at_command (MMBaseModem *self,
              guint timeout,
              gboolean allow_cached,
              gboolean is_raw,
+             MMBaseModemAtPortAffinity affinity,
              GAsyncReadyCallback callback,
              gpointer user_data)
 {
@@ -578,7 +734,10 @@ _at_command (MMBaseModem *self,
     GError *error = NULL;
 
     /* No port given, so we'll try to guess which is best */
-    port = mm_base_modem_peek_best_at_port (self, &error);
+    if (affinity == MM_BASE_MODEM_AT_PORT_AFFINITY_ANY)
+        port = mm_base_modem_peek_idle_at_port (self, &error);
+    else
+        port = mm_base_modem_peek_best_at_port (self, &error);
     if (!port) {
         g_assert (error != NULL);
         g_simple_async_report_take_gerror_in_idle (G_OBJECT (self),
@@ -607,7 +766,18 @@ mm_base_modem_at_command (MMBaseModem *self,
                           GAsyncReadyCallback callback,
                           gpointer user_data)
 {
-    _at_command (self, command, timeout, allow_cached, FALSE, callback, user_data);
+    _at_command (self, command, timeout, allow_cached, FALSE, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, callback, user_data);
+}
+
+void
+mm_base_modem_at_query (MMBaseModem *self,
+                        const gchar *command,
+                        guint timeout,
+                        gboolean allow_cached,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+    _at_command (self, command, timeout, allow_cached, FALSE, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY, callback, user_data);
 }
 
 void
@@ -618,5 +788,5 @@ mm_base_modem_at_command_raw (MMBaseModem *self,
                               GAsyncReadyCallback callback,
                               gpointer user_data)
 {
-    _at_command (self, command, timeout, allow_cached, TRUE, callback, user_data);
+    _at_command (self, command, timeout, allow_cached, TRUE, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, callback, user_data);
 }
@@ -51,6 +51,14 @@ typedef gboolean (* MMBaseModemAtResponseProcessor) (MMBaseModem *self,
                                                      GVariant **result,
                                                      GError **result_error);
 
+/* Which AT ports a command may be run in, when no explicit port is given */
+typedef enum {
+    /* Run in the best AT port, i.e. the primary one unless connected */
+    MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY = 0,
+    /* Side-effect free query, may run in whichever AT port is less busy */
+    MM_BASE_MODEM_AT_PORT_AFFINITY_ANY,
+} MMBaseModemAtPortAffinity;
+
 /* Struct to configure AT command operations */
 typedef struct {
     /* The AT command */
@@ -61,10 +69,20 @@ typedef struct {
     gboolean allow_cached;
     /* The response processor */
     MMBaseModemAtResponseProcessor response_processor;
+    /* Port affinity */
+    MMBaseModemAtPortAffinity affinity;
+    /* Consecutive commands with this flag may be concatenated in the same
+     * command line if the port supports it. Only flag extended commands which
+     * are always run (i.e. the sequence never finishes before the following
+     * commands on success), whose information text is prefixed with the
+     * command name, and which can safely be re-run if the line fails. */
+    gboolean batch;
 } MMBaseModemAtCommand;
 
 /* Generic AT sequence handling, using the best AT port available and without
- * explicit cancellations. */
+ * explicit cancellations. If all commands in the sequence have
+ * MM_BASE_MODEM_AT_PORT_AFFINITY_ANY, the sequence may run in the secondary
+ * port if the primary one is busy. */
 void     mm_base_modem_at_sequence         (MMBaseModem *self,
                                             const MMBaseModemAtCommand *sequence,
                                             gpointer response_processor_context,
@@ -145,6 +163,14 @@ void mm_base_modem_at_command_raw            (MMBaseModem *self,
                                               gboolean allow_cached,
                                               GAsyncReadyCallback callback,
                                               gpointer user_data);
+/* Like mm_base_modem_at_command() but for side-effect free queries, which
+ * may run in whichever AT port is less busy. */
+void mm_base_modem_at_query                  (MMBaseModem *self,
+                                              const gchar *command,
+                                              guint timeout,
+                                              gboolean allow_cached,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
 const gchar *mm_base_modem_at_command_finish (MMBaseModem *self,
                                               GAsyncResult *res,
                                               GError **error);
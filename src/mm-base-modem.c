@@ -195,9 +195,13 @@ mm_base_modem_grab_port (MMBaseModem         *self,
 
             /* Set common response parser */
             mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (port),
-                                                   mm_serial_parser_v1_parse,
-                                                   mm_serial_parser_v1_new (),
-                                                   mm_serial_parser_v1_destroy);
+                                                   mm_serial_parser_v2_parse,
+                                                   mm_serial_parser_v2_new (),
+                                                   mm_serial_parser_v2_destroy);
+            mm_port_serial_at_set_response_check (MM_PORT_SERIAL_AT (port),
+                                                  mm_serial_parser_v2_check);
+            mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (port),
+                                                  mm_serial_parser_v2_reset);
             /* Store flags already */
             mm_port_serial_at_set_flags (MM_PORT_SERIAL_AT (port), at_pflags);
         } else if (ptype == MM_PORT_TYPE_GPS) {
@@ -252,9 +256,13 @@ mm_base_modem_grab_port (MMBaseModem         *self,
 
             /* Set common response parser */
             mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (port),
-                                                   mm_serial_parser_v1_parse,
-                                                   mm_serial_parser_v1_new (),
-                                                   mm_serial_parser_v1_destroy);
+                                                   mm_serial_parser_v2_parse,
+                                                   mm_serial_parser_v2_new (),
+                                                   mm_serial_parser_v2_destroy);
+            mm_port_serial_at_set_response_check (MM_PORT_SERIAL_AT (port),
+                                                  mm_serial_parser_v2_check);
+            mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (port),
+                                                  mm_serial_parser_v2_reset);
             /* Store flags already */
             mm_port_serial_at_set_flags (MM_PORT_SERIAL_AT (port), at_pflags);
         }
@@ -276,9 +284,13 @@ mm_base_modem_grab_port (MMBaseModem         *self,
 
         /* Set common response parser */
         mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (port),
-                                               mm_serial_parser_v1_parse,
-                                               mm_serial_parser_v1_new (),
-                                               mm_serial_parser_v1_destroy);
+                                               mm_serial_parser_v2_parse,
+                                               mm_serial_parser_v2_new (),
+                                               mm_serial_parser_v2_destroy);
+        mm_port_serial_at_set_response_check (MM_PORT_SERIAL_AT (port),
+                                              mm_serial_parser_v2_check);
+        mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (port),
+                                              mm_serial_parser_v2_reset);
         /* Store flags already */
         mm_port_serial_at_set_flags (MM_PORT_SERIAL_AT (port), at_pflags);
     }
@@ -752,6 +764,45 @@ mm_base_modem_peek_best_at_port (MMBaseModem *self,
     return NULL;
 }
 
+MMPortSerialAt *
+mm_base_modem_get_idle_at_port (MMBaseModem *self,
+                                GError **error)
+{
+    MMPortSerialAt *idle;
+
+    idle = mm_base_modem_peek_idle_at_port (self, error);
+    return (idle ? g_object_ref (idle) : NULL);
+}
+
+MMPortSerialAt *
+mm_base_modem_peek_idle_at_port (MMBaseModem *self,
+                                 GError **error)
+{
+    MMPortSerialAt *best;
+    MMPortSerialAt *secondary;
+
+    best = mm_base_modem_peek_best_at_port (self, error);
+    if (!best)
+        return NULL;
+
+    /* Only the secondary port may be used as alternative, and only if it is
+     * already open; we don't want to open it just to run a query. */
+    secondary = self->priv->secondary;
+    if (best == secondary ||
+        !secondary ||
+        mm_port_get_connected (MM_PORT (secondary)) ||
+        !mm_port_serial_is_open (MM_PORT_SERIAL (secondary)))
+        return best;
+
+    /* Prefer the primary port unless the secondary one has less commands
+     * pending */
+    if (mm_port_serial_get_queue_length (MM_PORT_SERIAL (secondary)) <
+        mm_port_serial_get_queue_length (MM_PORT_SERIAL (best)))
+        return secondary;
+
+    return best;
+}
+
 gboolean
 mm_base_modem_has_at_port (MMBaseModem *self)
 {
@@ -848,6 +899,22 @@ mm_base_modem_find_ports (MMBaseModem *self,
     return out;
 }
 
+void
+mm_base_modem_invalidate_cached_replies (MMBaseModem *self,
+                                         gboolean include_persistent)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_return_if_fail (MM_IS_BASE_MODEM (self));
+
+    g_hash_table_iter_init (&iter, self->priv->ports);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        if (MM_IS_PORT_SERIAL (value))
+            mm_port_serial_invalidate_cached_replies (MM_PORT_SERIAL (value), include_persistent);
+    }
+}
+
 static void
 initialize_ready (MMBaseModem *self,
                   GAsyncResult *res)
@@ -130,6 +130,7 @@ MMPortMbim       *mm_base_modem_peek_port_mbim          (MMBaseModem *self);
 MMPortMbim       *mm_base_modem_peek_port_mbim_for_data (MMBaseModem *self, MMPort *data, GError **error);
 #endif
 MMPortSerialAt   *mm_base_modem_peek_best_at_port      (MMBaseModem *self, GError **error);
+MMPortSerialAt   *mm_base_modem_peek_idle_at_port      (MMBaseModem *self, GError **error);
 MMPort           *mm_base_modem_peek_best_data_port    (MMBaseModem *self, MMPortType type);
 GList            *mm_base_modem_peek_data_ports        (MMBaseModem *self);
 
@@ -147,6 +148,7 @@ MMPortMbim       *mm_base_modem_get_port_mbim          (MMBaseModem *self);
 MMPortMbim       *mm_base_modem_get_port_mbim_for_data (MMBaseModem *self, MMPort *data, GError **error);
 #endif
 MMPortSerialAt   *mm_base_modem_get_best_at_port      (MMBaseModem *self, GError **error);
+MMPortSerialAt   *mm_base_modem_get_idle_at_port      (MMBaseModem *self, GError **error);
 MMPort           *mm_base_modem_get_best_data_port    (MMBaseModem *self, MMPortType type);
 GList            *mm_base_modem_get_data_ports        (MMBaseModem *self);
 
@@ -158,6 +160,11 @@ GList            *mm_base_modem_find_ports            (MMBaseModem *self,
                                                        MMPortType type,
                                                        const gchar *name);
 
+/* Drop the replies cached in all the serial ports of the modem, e.g. after
+ * a change in the functionality level or in the SIM */
+void              mm_base_modem_invalidate_cached_replies (MMBaseModem *self,
+                                                           gboolean include_persistent);
+
 void     mm_base_modem_set_hotplugged (MMBaseModem *self,
                                        gboolean hotplugged);
 gboolean mm_base_modem_get_hotplugged (MMBaseModem *self);
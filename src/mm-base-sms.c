@@ -67,6 +67,11 @@ struct _MMBaseSmsPrivate {
     guint max_parts;
     GList *parts;
 
+    /* Parts of a multipart SMS taken so far, in slots indexed by their
+     * sequence number (starting at 1) */
+    MMSmsPart **part_slots;
+    guint n_taken_parts;
+
     /* Set to true when all needed parts were received,
      * parsed and assembled */
     gboolean is_assembled;
@@ -738,6 +743,9 @@ mm_base_sms_get_multipart_reference (MMBaseSms *self)
 gboolean
 mm_base_sms_multipart_is_complete (MMBaseSms *self)
 {
+    if (self->priv->part_slots)
+        return (self->priv->n_taken_parts == self->priv->max_parts);
+
     return (g_list_length (self->priv->parts) == self->priv->max_parts);
 }
 
@@ -1511,7 +1519,6 @@ static gboolean
 assemble_sms (MMBaseSms *self,
               GError **error)
 {
-    GList *l;
     guint idx;
     MMSmsPart **sorted_parts;
     GString *fulltext;
@@ -1536,23 +1543,9 @@ assemble_sms (MMBaseSms *self,
 
         sorted_parts[0] = (MMSmsPart *)self->priv->parts->data;
     } else {
-        /* Check if we have duplicate parts */
-        for (l = self->priv->parts; l; l = g_list_next (l)) {
-            idx = mm_sms_part_get_concat_sequence ((MMSmsPart *)l->data);
-
-            if (idx < 1 || idx > self->priv->max_parts) {
-                mm_warn ("Invalid part index (%u) found, ignoring", idx);
-                continue;
-            }
-
-            if (sorted_parts[idx - 1]) {
-                mm_warn ("Duplicate part index (%u) found, ignoring", idx);
-                continue;
-            }
-
-            /* Add the part to the proper index */
-            sorted_parts[idx - 1] = (MMSmsPart *)l->data;
-        }
+        /* Parts were already validated and sorted by sequence when taken */
+        g_assert (self->priv->part_slots != NULL);
+        memcpy (sorted_parts, self->priv->part_slots, self->priv->max_parts * sizeof (MMSmsPart *));
     }
 
     fulltext = g_string_new ("");
@@ -1656,6 +1649,8 @@ mm_base_sms_multipart_take_part (MMBaseSms *self,
                                  MMSmsPart *part,
                                  GError **error)
 {
+    guint sequence;
+
     if (!self->priv->is_multipart) {
         g_set_error (error,
                      MM_CORE_ERROR,
@@ -1664,36 +1659,41 @@ mm_base_sms_multipart_take_part (MMBaseSms *self,
         return FALSE;
     }
 
-    if (g_list_length (self->priv->parts) >= self->priv->max_parts) {
+    if (self->priv->n_taken_parts >= self->priv->max_parts) {
         g_set_error (error,
                      MM_CORE_ERROR,
                      MM_CORE_ERROR_FAILED,
                      "Already took %u parts, cannot take more",
-                     g_list_length (self->priv->parts));
+                     self->priv->n_taken_parts);
         return FALSE;
     }
 
-    if (g_list_find_custom (self->priv->parts,
-                            part,
-                            (GCompareFunc)cmp_sms_part_sequence)) {
+    sequence = mm_sms_part_get_concat_sequence (part);
+    if (sequence < 1 || sequence > self->priv->max_parts) {
         g_set_error (error,
                      MM_CORE_ERROR,
                      MM_CORE_ERROR_FAILED,
-                     "Cannot take part, sequence %u already taken",
-                     mm_sms_part_get_concat_sequence (part));
+                     "Cannot take part with sequence %u, valid range is [1,%u]",
+                     sequence,
+                     self->priv->max_parts);
         return FALSE;
     }
 
-    if (mm_sms_part_get_concat_sequence (part) > self->priv->max_parts) {
+    if (!self->priv->part_slots)
+        self->priv->part_slots = g_new0 (MMSmsPart *, self->priv->max_parts);
+
+    if (self->priv->part_slots[sequence - 1]) {
         g_set_error (error,
                      MM_CORE_ERROR,
                      MM_CORE_ERROR_FAILED,
-                     "Cannot take part with sequence %u, maximum is %u",
-                     mm_sms_part_get_concat_sequence (part),
-                     self->priv->max_parts);
+                     "Cannot take part, sequence %u already taken",
+                     sequence);
         return FALSE;
     }
 
+    self->priv->part_slots[sequence - 1] = part;
+    self->priv->n_taken_parts++;
+
     /* Insert sorted by concat sequence */
     self->priv->parts = g_list_insert_sorted (self->priv->parts,
                                               part,
@@ -1981,6 +1981,7 @@ finalize (GObject *object)
     MMBaseSms *self = MM_BASE_SMS (object);
 
     g_list_free_full (self->priv->parts, (GDestroyNotify)mm_sms_part_free);
+    g_free (self->priv->part_slots);
     g_free (self->priv->path);
 
     G_OBJECT_CLASS (mm_base_sms_parent_class)->finalize (object);
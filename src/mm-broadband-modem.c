@@ -128,6 +128,7 @@ static GParamSpec *properties[PROP_LAST];
 #define CIND_INDICATOR_IS_VALID(u) (u != CIND_INDICATOR_INVALID)
 
 typedef struct _PortsContext PortsContext;
+typedef struct _SmsBatchContext SmsBatchContext;
 
 struct _MMBroadbandModemPrivate {
     /* Broadband modem specific implementation */
@@ -210,6 +211,11 @@ struct _MMBroadbandModemPrivate {
     MMSmsStorage current_sms_mem1_storage;
     gboolean mem2_storage_locked;
     MMSmsStorage current_sms_mem2_storage;
+    /* Parts reported in +CMTI indications and not yet read */
+    GArray *sms_pending_parts;
+    guint sms_pending_parts_id;
+    /* Batch of parts being read, if any */
+    SmsBatchContext *sms_batch;
 
     /*<--- Modem Voice interface --->*/
     /* Properties */
@@ -784,8 +790,8 @@ modem_load_manufacturer_finish (MMIfaceModem *self,
 }
 
 static const MMBaseModemAtCommand manufacturers[] = {
-    { "+CGMI",  3, TRUE, response_processor_string_ignore_at_errors },
-    { "+GMI",   3, TRUE, response_processor_string_ignore_at_errors },
+    { "+CGMI",  3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
+    { "+GMI",   3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
     { NULL }
 };
 
@@ -824,8 +830,8 @@ modem_load_model_finish (MMIfaceModem *self,
 }
 
 static const MMBaseModemAtCommand models[] = {
-    { "+CGMM",  3, TRUE, response_processor_string_ignore_at_errors },
-    { "+GMM",   3, TRUE, response_processor_string_ignore_at_errors },
+    { "+CGMM",  3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
+    { "+GMM",   3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
     { NULL }
 };
 
@@ -864,8 +870,8 @@ modem_load_revision_finish (MMIfaceModem *self,
 }
 
 static const MMBaseModemAtCommand revisions[] = {
-    { "+CGMR",  3, TRUE, response_processor_string_ignore_at_errors },
-    { "+GMR",   3, TRUE, response_processor_string_ignore_at_errors },
+    { "+CGMR",  3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
+    { "+GMR",   3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
     { NULL }
 };
 
@@ -924,8 +930,8 @@ modem_load_equipment_identifier_finish (MMIfaceModem *self,
 }
 
 static const MMBaseModemAtCommand equipment_identifiers[] = {
-    { "+CGSN",  3, TRUE, response_processor_string_ignore_at_errors },
-    { "+GSN",   3, TRUE, response_processor_string_ignore_at_errors },
+    { "+CGSN",  3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
+    { "+GSN",   3, TRUE, response_processor_string_ignore_at_errors, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
     { NULL }
 };
 
@@ -1014,8 +1020,8 @@ parse_ati_reply (MMBaseModem *self,
 }
 
 static const MMBaseModemAtCommand device_identifier_steps[] = {
-    { "ATI",  3, TRUE, (MMBaseModemAtResponseProcessor)parse_ati_reply },
-    { "ATI1", 3, TRUE, (MMBaseModemAtResponseProcessor)parse_ati_reply },
+    { "ATI",  3, TRUE, (MMBaseModemAtResponseProcessor)parse_ati_reply, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
+    { "ATI1", 3, TRUE, (MMBaseModemAtResponseProcessor)parse_ati_reply, MM_BASE_MODEM_AT_PORT_AFFINITY_ANY },
     { NULL }
 };
 
@@ -2063,8 +2069,9 @@ modem_load_signal_quality (MMIfaceModem *_self,
     task = g_task_new (self, NULL, callback, user_data);
     g_task_set_task_data (task, ctx, (GDestroyNotify)signal_quality_context_free);
 
-    /* Check whether we can get a non-connected AT port */
-    ctx->at_port = (MMPortSerial *)mm_base_modem_get_best_at_port (MM_BASE_MODEM (self), &error);
+    /* Check whether we can get a non-connected AT port; signal quality
+     * queries may run in whichever AT port is less busy */
+    ctx->at_port = (MMPortSerial *)mm_base_modem_get_idle_at_port (MM_BASE_MODEM (self), &error);
     if (ctx->at_port) {
         if (self->priv->modem_cind_supported &&
             CIND_INDICATOR_IS_VALID (self->priv->modem_cind_indicator_signal_quality))
@@ -4099,12 +4106,12 @@ run_registration_checks_context_step (GTask *task)
         ctx->running_cs = TRUE;
         ctx->run_cs = FALSE;
         /* Check current CS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (self),
-                                  "+CREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  task);
+        mm_base_modem_at_query (MM_BASE_MODEM (self),
+                                "+CREG?",
+                                10,
+                                FALSE,
+                                (GAsyncReadyCallback)registration_status_check_ready,
+                                task);
         return;
     }
 
@@ -4112,12 +4119,12 @@ run_registration_checks_context_step (GTask *task)
         ctx->running_ps = TRUE;
         ctx->run_ps = FALSE;
         /* Check current PS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (self),
-                                  "+CGREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  task);
+        mm_base_modem_at_query (MM_BASE_MODEM (self),
+                                "+CGREG?",
+                                10,
+                                FALSE,
+                                (GAsyncReadyCallback)registration_status_check_ready,
+                                task);
         return;
     }
 
@@ -4125,12 +4132,12 @@ run_registration_checks_context_step (GTask *task)
         ctx->running_eps = TRUE;
         ctx->run_eps = FALSE;
         /* Check current EPS-registration state. */
-        mm_base_modem_at_command (MM_BASE_MODEM (self),
-                                  "+CEREG?",
-                                  10,
-                                  FALSE,
-                                  (GAsyncReadyCallback)registration_status_check_ready,
-                                  task);
+        mm_base_modem_at_query (MM_BASE_MODEM (self),
+                                "+CEREG?",
+                                10,
+                                FALSE,
+                                (GAsyncReadyCallback)registration_status_check_ready,
+                                task);
         return;
     }
 
@@ -5823,94 +5830,254 @@ modem_messaging_setup_cleanup_unsolicited_events_finish (MMIfaceModemMessaging *
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+/* Parts reported in +CMTI indications are not read right away; they're
+ * buffered for a short time and then read in batches, each of them locking
+ * the storage once and queueing all +CMGR requests at once, so that bursts
+ * of messages don't end up in a storage lock/unlock cycle per part. */
+#define SMS_BATCH_WINDOW_MSECS 100
+
+/* Parts are read again later when the storage is busy, each time waiting
+ * twice as long; after this many attempts they're given up */
+#define SMS_BATCH_MAX_RETRIES 5
+
+typedef struct {
+    MMSmsStorage storage;
+    guint        idx;
+    guint        retries;
+} SmsPendingPart;
+
+struct _SmsBatchContext {
+    MMSmsStorage  storage;
+    GArray       *indices;
+    guint         retries;
+    guint         n_pending;
+};
+
 typedef struct {
-    guint idx;
-} SmsPartContext;
+    GTask *task;
+    guint  idx;
+} SmsBatchPartContext;
+
+static void sms_pending_parts_schedule (MMBroadbandModem *self);
 
 static void
-sms_part_ready (MMBroadbandModem *self,
-                GAsyncResult *res,
-                GTask *task)
+sms_batch_context_free (SmsBatchContext *ctx)
 {
-    SmsPartContext *ctx;
-    MMSmsPart *part;
-    MM3gppPduInfo *info;
-    const gchar *response;
-    GError *error = NULL;
+    g_array_unref (ctx->indices);
+    g_slice_free (SmsBatchContext, ctx);
+}
 
-    /* Always always always unlock mem1 storage. Warned you've been. */
-    mm_broadband_modem_unlock_sms_storages (self, TRUE, FALSE);
+static gboolean
+sms_part_is_pending (MMBroadbandModem *self,
+                     MMSmsStorage      storage,
+                     guint             idx)
+{
+    SmsBatchContext *batch;
+    guint            i;
 
-    response = mm_base_modem_at_command_finish (MM_BASE_MODEM (self), res, &error);
+    for (i = 0; self->priv->sms_pending_parts && i < self->priv->sms_pending_parts->len; i++) {
+        SmsPendingPart *pending;
+
+        pending = &g_array_index (self->priv->sms_pending_parts, SmsPendingPart, i);
+        if (pending->storage == storage && pending->idx == idx)
+            return TRUE;
+    }
+
+    batch = self->priv->sms_batch;
+    if (batch && batch->storage == storage) {
+        for (i = 0; i < batch->indices->len; i++) {
+            if (g_array_index (batch->indices, guint, i) == idx)
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+sms_batch_part_ready (MMBaseModem         *_self,
+                      GAsyncResult        *res,
+                      SmsBatchPartContext *part_ctx)
+{
+    MMBroadbandModem *self = MM_BROADBAND_MODEM (_self);
+    SmsBatchContext  *ctx;
+    MMSmsPart        *part;
+    MM3gppPduInfo    *info;
+    const gchar      *response;
+    GError           *error = NULL;
+
+    response = mm_base_modem_at_command_finish (_self, res, &error);
     if (error) {
-        /* We're really ignoring this error afterwards, as we don't have a callback
-         * passed to the async operation, so just log the error here. */
-        mm_warn ("Couldn't retrieve SMS part: '%s'",
-                 error->message);
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
+        mm_warn ("Couldn't retrieve SMS part (%u): '%s'", part_ctx->idx, error->message);
+        g_error_free (error);
+    } else if (!(info = mm_3gpp_parse_cmgr_read_response (response, part_ctx->idx, &error))) {
+        mm_warn ("Couldn't parse SMS part (%u): '%s'", part_ctx->idx, error->message);
+        g_error_free (error);
+    } else {
+        part = mm_sms_part_3gpp_new_from_pdu (info->index, info->pdu, &error);
+        if (part) {
+            mm_dbg ("Correctly parsed PDU (%u)", part_ctx->idx);
+            mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
+                                                part,
+                                                MM_SMS_STATE_RECEIVED,
+                                                self->priv->modem_messaging_sms_default_storage);
+        } else {
+            /* Don't treat the error as critical */
+            mm_dbg ("Error parsing PDU (%u): %s", part_ctx->idx, error->message);
+            g_error_free (error);
+        }
+        mm_3gpp_pdu_info_free (info);
+    }
+
+    ctx = g_task_get_task_data (part_ctx->task);
+    g_assert (ctx->n_pending > 0);
+    if (--ctx->n_pending == 0) {
+        /* Always always always unlock mem1 storage. Warned you've been. */
+        mm_broadband_modem_unlock_sms_storages (self, TRUE, FALSE);
+        g_task_return_boolean (part_ctx->task, TRUE);
     }
 
+    g_object_unref (part_ctx->task);
+    g_slice_free (SmsBatchPartContext, part_ctx);
+}
+
+static void
+sms_batch_lock_storages_ready (MMBroadbandModem *self,
+                               GAsyncResult     *res,
+                               GTask            *task)
+{
+    SmsBatchContext *ctx;
+    GError          *error = NULL;
+    guint            i;
+
     ctx = g_task_get_task_data (task);
 
-    info = mm_3gpp_parse_cmgr_read_response (response, ctx->idx, &error);
-    if (!info) {
-        mm_warn ("Couldn't parse SMS part: '%s'",
-                 error->message);
+    if (!mm_broadband_modem_lock_sms_storages_finish (self, res, &error)) {
+        /* If the storage is being used by someone else, read the parts
+         * later on; otherwise, they're lost */
+        if (g_error_matches (error, MM_CORE_ERROR, MM_CORE_ERROR_RETRY) &&
+            ctx->retries < SMS_BATCH_MAX_RETRIES) {
+            for (i = 0; i < ctx->indices->len; i++) {
+                SmsPendingPart pending;
+
+                pending.storage = ctx->storage;
+                pending.idx = g_array_index (ctx->indices, guint, i);
+                pending.retries = ctx->retries + 1;
+                g_array_insert_val (self->priv->sms_pending_parts, i, pending);
+            }
+        } else if (ctx->retries > 0)
+            mm_warn ("Couldn't lock storage to read %u SMS parts after %u attempts, dropping them: '%s'",
+                     ctx->indices->len, ctx->retries + 1, error->message);
+        else
+            mm_warn ("Couldn't lock storage to read %u SMS parts: '%s'",
+                     ctx->indices->len, error->message);
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
-    part = mm_sms_part_3gpp_new_from_pdu (info->index, info->pdu, &error);
-    if (part) {
-        mm_dbg ("Correctly parsed PDU (%d)", ctx->idx);
-        mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
-                                            part,
-                                            MM_SMS_STATE_RECEIVED,
-                                            self->priv->modem_messaging_sms_default_storage);
-    } else {
-        /* Don't treat the error as critical */
-        mm_dbg ("Error parsing PDU (%d): %s", ctx->idx, error->message);
-        g_error_free (error);
-    }
+    /* Storage now set and locked; queue all the reads at once, the port
+     * sends them one after the other */
+    mm_dbg ("Reading %u SMS parts", ctx->indices->len);
+    ctx->n_pending = ctx->indices->len;
+    for (i = 0; i < ctx->indices->len; i++) {
+        SmsBatchPartContext *part_ctx;
+        gchar               *command;
 
-    /* All done */
-    mm_3gpp_pdu_info_free (info);
-    g_task_return_boolean (task, TRUE);
+        part_ctx = g_slice_new (SmsBatchPartContext);
+        part_ctx->task = g_object_ref (task);
+        part_ctx->idx = g_array_index (ctx->indices, guint, i);
+
+        command = g_strdup_printf ("+CMGR=%u", part_ctx->idx);
+        mm_base_modem_at_command (MM_BASE_MODEM (self),
+                                  command,
+                                  10,
+                                  FALSE,
+                                  (GAsyncReadyCallback)sms_batch_part_ready,
+                                  part_ctx);
+        g_free (command);
+    }
     g_object_unref (task);
 }
 
 static void
-indication_lock_storages_ready (MMBroadbandModem *self,
-                                GAsyncResult *res,
-                                GTask *task)
+sms_batch_ready (MMBroadbandModem *self,
+                 GAsyncResult     *res)
 {
-    SmsPartContext *ctx;
-    gchar *command;
-    GError *error = NULL;
+    self->priv->sms_batch = NULL;
 
-    if (!mm_broadband_modem_lock_sms_storages_finish (self, res, &error)) {
-        /* TODO: we should either make this lock() never fail, by automatically
-         * retrying after some time, or otherwise retry here. */
-        g_task_return_error (task, error);
-        g_object_unref (task);
-        return;
+    /* Errors were already reported */
+    g_task_propagate_boolean (G_TASK (res), NULL);
+
+    /* Go on with the parts reported while reading, and with the ones that
+     * couldn't be read because the storage was busy */
+    sms_pending_parts_schedule (self);
+}
+
+static void
+sms_pending_parts_read (MMBroadbandModem *self)
+{
+    SmsBatchContext *ctx;
+    GTask           *task;
+    guint            i;
+
+    /* Read all parts in the same storage as the first one */
+    ctx = g_slice_new0 (SmsBatchContext);
+    ctx->storage = g_array_index (self->priv->sms_pending_parts, SmsPendingPart, 0).storage;
+    ctx->indices = g_array_new (FALSE, FALSE, sizeof (guint));
+    for (i = 0; i < self->priv->sms_pending_parts->len;) {
+        SmsPendingPart *pending;
+
+        pending = &g_array_index (self->priv->sms_pending_parts, SmsPendingPart, i);
+        if (pending->storage != ctx->storage) {
+            i++;
+            continue;
+        }
+        g_array_append_val (ctx->indices, pending->idx);
+        ctx->retries = MAX (ctx->retries, pending->retries);
+        g_array_remove_index (self->priv->sms_pending_parts, i);
     }
 
-    /* Storage now set and locked */
+    task = g_task_new (self, NULL, (GAsyncReadyCallback)sms_batch_ready, NULL);
+    g_task_set_task_data (task, ctx, (GDestroyNotify)sms_batch_context_free);
+    self->priv->sms_batch = ctx;
 
-    /* Retrieve the message */
-    ctx = g_task_get_task_data (task);
-    command = g_strdup_printf ("+CMGR=%d", ctx->idx);
-    mm_base_modem_at_command (MM_BASE_MODEM (self),
-                              command,
-                              10,
-                              FALSE,
-                              (GAsyncReadyCallback)sms_part_ready,
-                              task);
-    g_free (command);
+    /* First, request to set the proper storage to read from */
+    mm_broadband_modem_lock_sms_storages (self,
+                                          ctx->storage,
+                                          MM_SMS_STORAGE_UNKNOWN,
+                                          (GAsyncReadyCallback)sms_batch_lock_storages_ready,
+                                          task);
+}
+
+static gboolean
+sms_pending_parts_timeout (MMBroadbandModem *self)
+{
+    self->priv->sms_pending_parts_id = 0;
+    sms_pending_parts_read (self);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+sms_pending_parts_schedule (MMBroadbandModem *self)
+{
+    guint retries = 0;
+    guint i;
+
+    if (self->priv->sms_pending_parts_id || self->priv->sms_batch || !self->priv->sms_pending_parts->len)
+        return;
+
+    /* Back off while the storage stays busy */
+    for (i = 0; i < self->priv->sms_pending_parts->len; i++)
+        retries = MAX (retries, g_array_index (self->priv->sms_pending_parts, SmsPendingPart, i).retries);
+
+    /* The timeout keeps its own reference, so that the parts can still be read
+     * if the indications handler goes away */
+    self->priv->sms_pending_parts_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
+                                                           SMS_BATCH_WINDOW_MSECS << retries,
+                                                           (GSourceFunc) sms_pending_parts_timeout,
+                                                           g_object_ref (self),
+                                                           g_object_unref);
 }
 
 static void
@@ -5918,8 +6085,7 @@ cmti_received (MMPortSerialAt *port,
                GMatchInfo *info,
                MMBroadbandModem *self)
 {
-    SmsPartContext *ctx;
-    GTask *task;
+    SmsPendingPart pending;
     guint idx = 0;
     MMSmsStorage storage;
     gchar *str;
@@ -5945,18 +6111,19 @@ cmti_received (MMPortSerialAt *port,
         return;
     }
 
-    ctx = g_new (SmsPartContext, 1);
-    ctx->idx = idx;
+    if (!self->priv->sms_pending_parts)
+        self->priv->sms_pending_parts = g_array_new (FALSE, FALSE, sizeof (SmsPendingPart));
 
-    task = g_task_new (self, NULL, NULL, NULL);
-    g_task_set_task_data (task, ctx, g_free);
+    if (sms_part_is_pending (self, storage, idx)) {
+        mm_dbg ("Skipping CMTI indication, part already pending");
+        return;
+    }
 
-    /* First, request to set the proper storage to read from */
-    mm_broadband_modem_lock_sms_storages (self,
-                                          storage,
-                                          MM_SMS_STORAGE_UNKNOWN,
-                                          (GAsyncReadyCallback)indication_lock_storages_ready,
-                                          task);
+    pending.storage = storage;
+    pending.idx = idx;
+    pending.retries = 0;
+    g_array_append_val (self->priv->sms_pending_parts, pending);
+    sms_pending_parts_schedule (self);
 }
 
 static void
@@ -6203,8 +6370,21 @@ modem_messaging_enable_unsolicited_events (MMIfaceModemMessaging *self,
 
 typedef struct {
     MMSmsStorage list_storage;
+    /* Port where the +CMGL entries are being streamed, if any */
+    MMPortSerialAt *port;
+    GRegex *entry_regex;
+    guint n_streamed;
 } ListPartsContext;
 
+static void
+list_parts_context_free (ListPartsContext *ctx)
+{
+    g_assert (!ctx->port);
+    if (ctx->entry_regex)
+        g_regex_unref (ctx->entry_regex);
+    g_free (ctx);
+}
+
 static gboolean
 modem_messaging_load_initial_sms_parts_finish (MMIfaceModemMessaging *self,
                                                GAsyncResult *res,
@@ -6213,6 +6393,19 @@ modem_messaging_load_initial_sms_parts_finish (MMIfaceModemMessaging *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+static void
+list_parts_stop_streaming (ListPartsContext *ctx)
+{
+    if (!ctx->port)
+        return;
+
+    /* Drop the reference to the task before disabling the handler, so that
+     * nothing points to it once it's completed */
+    mm_port_serial_at_add_unsolicited_msg_handler (ctx->port, ctx->entry_regex, NULL, NULL, NULL);
+    mm_port_serial_at_enable_unsolicited_msg_handler (ctx->port, ctx->entry_regex, FALSE);
+    g_clear_object (&ctx->port);
+}
+
 static MMSmsState
 sms_state_from_str (const gchar *str)
 {
@@ -6243,6 +6436,92 @@ sms_pdu_type_from_str (const gchar *str)
     return MM_SMS_PDU_TYPE_UNKNOWN;
 }
 
+static void
+sms_text_part_list_take_entry (MMBroadbandModem *self,
+                               GMatchInfo *match_info,
+                               MMSmsStorage storage)
+{
+    MMSmsPart *part;
+    guint matches, idx;
+    gchar *number, *timestamp, *text, *ucs2_text, *stat;
+    gsize ucs2_len = 0;
+    GByteArray *raw;
+
+    matches = g_match_info_get_match_count (match_info);
+    if (matches != 7) {
+        mm_dbg ("Failed to match entire CMGL response (count %d)", matches);
+        return;
+    }
+
+    if (!mm_get_uint_from_match_info (match_info, 1, &idx)) {
+        mm_dbg ("Failed to convert message index");
+        return;
+    }
+
+    /* Get part state */
+    stat = mm_get_string_unquoted_from_match_info (match_info, 2);
+    if (!stat) {
+        mm_dbg ("Failed to get part status");
+        return;
+    }
+
+    /* Get and parse number */
+    number = mm_get_string_unquoted_from_match_info (match_info, 3);
+    if (!number) {
+        mm_dbg ("Failed to get message sender number");
+        g_free (stat);
+        return;
+    }
+
+    number = mm_broadband_modem_take_and_convert_to_utf8 (self, number);
+
+    /* Get and parse timestamp (always expected in ASCII) */
+    timestamp = mm_get_string_unquoted_from_match_info (match_info, 5);
+
+    /* Get and parse text */
+    text = mm_broadband_modem_take_and_convert_to_utf8 (self,
+                                                        g_match_info_fetch (match_info, 6));
+
+    /* The raw SMS data can only be GSM, UCS2, or unknown (8-bit), so we
+     * need to convert to UCS2 here.
+     */
+    ucs2_text = g_convert (text, -1, "UCS-2BE//TRANSLIT", "UTF-8", NULL, &ucs2_len, NULL);
+    g_assert (ucs2_text);
+    raw = g_byte_array_sized_new (ucs2_len);
+    g_byte_array_append (raw, (const guint8 *) ucs2_text, ucs2_len);
+    g_free (ucs2_text);
+
+    /* all take() methods pass ownership of the value as well */
+    part = mm_sms_part_new (idx,
+                            sms_pdu_type_from_str (stat));
+    mm_sms_part_take_number (part, number);
+    mm_sms_part_take_timestamp (part, timestamp);
+    mm_sms_part_take_text (part, text);
+    mm_sms_part_take_data (part, raw);
+    mm_sms_part_set_class (part, -1);
+
+    mm_dbg ("Correctly parsed SMS list entry (%d)", idx);
+    mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
+                                        part,
+                                        sms_state_from_str (stat),
+                                        storage);
+    g_free (stat);
+}
+
+static void
+sms_text_part_list_entry_received (MMPortSerialAt *port,
+                                   GMatchInfo *match_info,
+                                   GTask *task)
+{
+    ListPartsContext *ctx;
+
+    ctx = g_task_get_task_data (task);
+    sms_text_part_list_take_entry (MM_BROADBAND_MODEM (g_task_get_source_object (task)),
+                                   match_info,
+                                   ctx->list_storage);
+    ctx->n_streamed++;
+}
+
 static void
 sms_text_part_list_ready (MMBroadbandModem *self,
                           GAsyncResult *res,
@@ -6254,19 +6533,23 @@ sms_text_part_list_ready (MMBroadbandModem *self,
     const gchar *response;
     GError *error = NULL;
 
-    response = mm_base_modem_at_command_finish (MM_BASE_MODEM (self), res, &error);
+    ctx = g_task_get_task_data (task);
+    list_parts_stop_streaming (ctx);
+
+    response = mm_base_modem_at_command_full_finish (MM_BASE_MODEM (self), res, &error);
     if (error) {
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
-    /* +CMGL: <index>,<stat>,<oa/da>,[alpha],<scts><CR><LF><data><CR><LF> */
-    r = g_regex_new ("\\+CMGL:\\s*(\\d+)\\s*,\\s*([^,]*),\\s*([^,]*),\\s*([^,]*),\\s*([^\\r\\n]*)\\r\\n([^\\r\\n]*)",
-                     0, 0, NULL);
+    /* Entries already taken while the response was arriving are no longer in
+     * the response, look for any leftover ones */
+    r = g_regex_new (MM_3GPP_TEXT_CMGL_ENTRY, 0, 0, NULL);
     g_assert (r);
 
-    if (!g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, NULL)) {
+    if (!g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, NULL) &&
+        !ctx->n_streamed) {
         g_task_return_new_error (task,
                                  MM_CORE_ERROR,
                                  MM_CORE_ERROR_INVALID_ARGS,
@@ -6277,76 +6560,8 @@ sms_text_part_list_ready (MMBroadbandModem *self,
         return;
     }
 
-    ctx = g_task_get_task_data (task);
-
     while (g_match_info_matches (match_info)) {
-        MMSmsPart *part;
-        guint matches, idx;
-        gchar *number, *timestamp, *text, *ucs2_text, *stat;
-        gsize ucs2_len = 0;
-        GByteArray *raw;
-
-        matches = g_match_info_get_match_count (match_info);
-        if (matches != 7) {
-            mm_dbg ("Failed to match entire CMGL response (count %d)", matches);
-            goto next;
-        }
-
-        if (!mm_get_uint_from_match_info (match_info, 1, &idx)) {
-            mm_dbg ("Failed to convert message index");
-            goto next;
-        }
-
-        /* Get part state */
-        stat = mm_get_string_unquoted_from_match_info (match_info, 2);
-        if (!stat) {
-            mm_dbg ("Failed to get part status");
-            goto next;
-        }
-
-        /* Get and parse number */
-        number = mm_get_string_unquoted_from_match_info (match_info, 3);
-        if (!number) {
-            mm_dbg ("Failed to get message sender number");
-            g_free (stat);
-            goto next;
-        }
-
-        number = mm_broadband_modem_take_and_convert_to_utf8 (MM_BROADBAND_MODEM (self),
-                                                              number);
-
-        /* Get and parse timestamp (always expected in ASCII) */
-        timestamp = mm_get_string_unquoted_from_match_info (match_info, 5);
-
-        /* Get and parse text */
-        text = mm_broadband_modem_take_and_convert_to_utf8 (MM_BROADBAND_MODEM (self),
-                                                            g_match_info_fetch (match_info, 6));
-
-        /* The raw SMS data can only be GSM, UCS2, or unknown (8-bit), so we
-         * need to convert to UCS2 here.
-         */
-        ucs2_text = g_convert (text, -1, "UCS-2BE//TRANSLIT", "UTF-8", NULL, &ucs2_len, NULL);
-        g_assert (ucs2_text);
-        raw = g_byte_array_sized_new (ucs2_len);
-        g_byte_array_append (raw, (const guint8 *) ucs2_text, ucs2_len);
-        g_free (ucs2_text);
-
-        /* all take() methods pass ownership of the value as well */
-        part = mm_sms_part_new (idx,
-                                sms_pdu_type_from_str (stat));
-        mm_sms_part_take_number (part, number);
-        mm_sms_part_take_timestamp (part, timestamp);
-        mm_sms_part_take_text (part, text);
-        mm_sms_part_take_data (part, raw);
-        mm_sms_part_set_class (part, -1);
-
-        mm_dbg ("Correctly parsed SMS list entry (%d)", idx);
-        mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
-                                            part,
-                                            sms_state_from_str (stat),
-                                            ctx->list_storage);
-        g_free (stat);
-next:
+        sms_text_part_list_take_entry (self, match_info, ctx->list_storage);
         g_match_info_next (match_info, NULL);
     }
     g_match_info_free (match_info);
@@ -6374,6 +6589,52 @@ sms_state_from_index (guint index)
     }
 }
 
+static void
+sms_pdu_part_list_take_entry (MMBroadbandModem *self,
+                              MM3gppPduInfo *info,
+                              MMSmsStorage storage)
+{
+    MMSmsPart *part;
+    GError *error = NULL;
+
+    part = mm_sms_part_3gpp_new_from_pdu (info->index, info->pdu, &error);
+    if (part) {
+        mm_dbg ("Correctly parsed PDU (%d)", info->index);
+        mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
+                                            part,
+                                            sms_state_from_index (info->status),
+                                            storage);
+    } else {
+        /* Don't treat the error as critical */
+        mm_dbg ("Error parsing PDU (%d): %s", info->index, error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+sms_pdu_part_list_entry_received (MMPortSerialAt *port,
+                                  GMatchInfo *match_info,
+                                  GTask *task)
+{
+    ListPartsContext *ctx;
+    MM3gppPduInfo *info;
+    GError *error = NULL;
+
+    info = mm_3gpp_parse_pdu_cmgl_entry (match_info, &error);
+    if (!info) {
+        mm_dbg ("Couldn't parse SMS list entry: %s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    ctx = g_task_get_task_data (task);
+    sms_pdu_part_list_take_entry (MM_BROADBAND_MODEM (g_task_get_source_object (task)),
+                                  info,
+                                  ctx->list_storage);
+    ctx->n_streamed++;
+    mm_3gpp_pdu_info_free (info);
+}
+
 static void
 sms_pdu_part_list_ready (MMBroadbandModem *self,
                          GAsyncResult *res,
@@ -6385,16 +6646,21 @@ sms_pdu_part_list_ready (MMBroadbandModem *self,
     GList *info_list;
     GList *l;
 
+    ctx = g_task_get_task_data (task);
+    list_parts_stop_streaming (ctx);
+
     /* Always always always unlock mem1 storage. Warned you've been. */
     mm_broadband_modem_unlock_sms_storages (self, TRUE, FALSE);
 
-    response = mm_base_modem_at_command_finish (MM_BASE_MODEM (self), res, &error);
+    response = mm_base_modem_at_command_full_finish (MM_BASE_MODEM (self), res, &error);
     if (error) {
         g_task_return_error (task, error);
         g_object_unref (task);
         return;
     }
 
+    /* Entries already taken while the response was arriving are no longer in
+     * the response, look for any leftover ones */
     info_list = mm_3gpp_parse_pdu_cmgl_response (response, &error);
     if (error) {
         g_task_return_error (task, error);
@@ -6402,25 +6668,11 @@ sms_pdu_part_list_ready (MMBroadbandModem *self,
         return;
     }
 
-    ctx = g_task_get_task_data (task);
+    for (l = info_list; l; l = g_list_next (l))
+        sms_pdu_part_list_take_entry (self, l->data, ctx->list_storage);
 
-    for (l = info_list; l; l = g_list_next (l)) {
-        MM3gppPduInfo *info = l->data;
-        MMSmsPart *part;
-
-        part = mm_sms_part_3gpp_new_from_pdu (info->index, info->pdu, &error);
-        if (part) {
-            mm_dbg ("Correctly parsed PDU (%d)", info->index);
-            mm_iface_modem_messaging_take_part (MM_IFACE_MODEM_MESSAGING (self),
-                                                part,
-                                                sms_state_from_index (info->status),
-                                                ctx->list_storage);
-        } else {
-            /* Don't treat the error as critical */
-            mm_dbg ("Error parsing PDU (%d): %s", info->index, error->message);
-            g_clear_error (&error);
-        }
-    }
+    if (ctx->n_streamed)
+        mm_dbg ("Took %u SMS list entries while the response was arriving", ctx->n_streamed);
 
     mm_3gpp_pdu_info_list_free (info_list);
 
@@ -6434,7 +6686,10 @@ list_parts_lock_storages_ready (MMBroadbandModem *self,
                                 GAsyncResult *res,
                                 GTask *task)
 {
+    ListPartsContext *ctx;
+    MMPortSerialAt *port;
     GError *error = NULL;
+    gboolean pdu_mode;
 
     if (!mm_broadband_modem_lock_sms_storages_finish (self, res, &error)) {
         /* TODO: we should either make this lock() never fail, by automatically
@@ -6446,18 +6701,47 @@ list_parts_lock_storages_ready (MMBroadbandModem *self,
 
     /* Storage now set and locked */
 
+    port = mm_base_modem_peek_best_at_port (MM_BASE_MODEM (self), &error);
+    if (!port) {
+        mm_broadband_modem_unlock_sms_storages (self, TRUE, FALSE);
+        g_task_return_error (task, error);
+        g_object_unref (task);
+        return;
+    }
+
+    ctx = g_task_get_task_data (task);
+    pdu_mode = self->priv->modem_messaging_sms_pdu_mode;
+
+    /* Take each entry as soon as it's fully received, instead of waiting for
+     * the whole listing; the port removes the matched entries from the buffer,
+     * so the final response only has the ones we didn't see. */
+    ctx->entry_regex = (pdu_mode ?
+                        mm_3gpp_pdu_cmgl_entry_regex_get () :
+                        mm_3gpp_text_cmgl_entry_regex_get ());
+    g_assert (ctx->entry_regex);
+    ctx->port = g_object_ref (port);
+    mm_port_serial_at_add_unsolicited_msg_handler (
+        port,
+        ctx->entry_regex,
+        (MMPortSerialAtUnsolicitedMsgFn) (pdu_mode ?
+                                          sms_pdu_part_list_entry_received :
+                                          sms_text_part_list_entry_received),
+        task,
+        NULL);
+
     /* Get SMS parts from ALL types.
      * Different command to be used if we are on Text or PDU mode */
-    mm_base_modem_at_command (MM_BASE_MODEM (self),
-                              (MM_BROADBAND_MODEM (self)->priv->modem_messaging_sms_pdu_mode ?
-                               "+CMGL=4" :
-                               "+CMGL=\"ALL\""),
-                              20,
-                              FALSE,
-                              (GAsyncReadyCallback) (MM_BROADBAND_MODEM (self)->priv->modem_messaging_sms_pdu_mode ?
-                                                     sms_pdu_part_list_ready :
-                                                     sms_text_part_list_ready),
-                              task);
+    mm_base_modem_at_command_full (MM_BASE_MODEM (self),
+                                   port,
+                                   pdu_mode ? "+CMGL=4" : "+CMGL=\"ALL\"",
+                                   20,
+                                   FALSE,
+                                   FALSE,
+                                   NULL,
+                                   (GAsyncReadyCallback) (pdu_mode ?
+                                                          sms_pdu_part_list_ready :
+                                                          sms_text_part_list_ready),
+                                   task);
 }
 
 static void
@@ -6469,11 +6753,11 @@ modem_messaging_load_initial_sms_parts (MMIfaceModemMessaging *self,
     ListPartsContext *ctx;
     GTask *task;
 
-    ctx = g_new (ListPartsContext, 1);
+    ctx = g_new0 (ListPartsContext, 1);
     ctx->list_storage = storage;
 
     task = g_task_new (self, NULL, callback, user_data);
-    g_task_set_task_data (task, ctx, g_free);
+    g_task_set_task_data (task, ctx, (GDestroyNotify) list_parts_context_free);
 
     mm_dbg ("Listing SMS parts in storage '%s'",
             mm_sms_storage_get_string (storage));
@@ -6723,11 +7007,13 @@ ring_response_processor (MMBaseModem *self,
     return FALSE;
 }
 
+/* Both commands are always run unless one of them fails, so they may be sent
+ * in the same command line */
 static const MMBaseModemAtCommand ring_sequence[] = {
     /* Show caller number on RING. */
-    { "+CLIP=1", 3, FALSE, ring_response_processor },
+    { "+CLIP=1", 3, FALSE, ring_response_processor, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, TRUE },
     /* Show difference between data call and voice call */
-    { "+CRC=1", 3, FALSE, ring_response_processor },
+    { "+CRC=1", 3, FALSE, ring_response_processor, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, TRUE },
     { NULL }
 };
 
@@ -8303,9 +8589,11 @@ modem_time_load_network_timezone (MMIfaceModemTime *self,
 /*****************************************************************************/
 /* Check support (Time interface) */
 
+/* Both commands are always run unless +CTZU fails, so they may be sent in the
+ * same command line */
 static const MMBaseModemAtCommand time_check_sequence[] = {
-    { "+CTZU=1",  3, TRUE, mm_base_modem_response_processor_no_result_continue },
-    { "+CCLK?",   3, TRUE, mm_base_modem_response_processor_string },
+    { "+CTZU=1",  3, TRUE, mm_base_modem_response_processor_no_result_continue, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, TRUE },
+    { "+CCLK?",   3, TRUE, mm_base_modem_response_processor_string, MM_BASE_MODEM_AT_PORT_AFFINITY_PRIMARY, TRUE },
     { NULL }
 };
 
@@ -10364,6 +10652,10 @@ mm_broadband_modem_update_sim_hot_swap_detected (MMBroadbandModem *self)
         self->priv->sim_hot_swap_ports_ctx = NULL;
     }
 
+    /* Some of the test command replies (e.g. +CLCK=?) depend on the SIM, so
+     * don't keep any cached reply in any port */
+    mm_base_modem_invalidate_cached_replies (MM_BASE_MODEM (self), TRUE);
+
     mm_base_modem_set_reprobe (MM_BASE_MODEM (self), TRUE);
     mm_base_modem_disable (MM_BASE_MODEM (self),
                            (GAsyncReadyCallback) after_hotswap_event_disable_ready,
@@ -10664,6 +10956,9 @@ finalize (GObject *object)
     if (self->priv->modem_3gpp_registration_regex)
         mm_3gpp_creg_regex_destroy (self->priv->modem_3gpp_registration_regex);
 
+    if (self->priv->sms_pending_parts)
+        g_array_unref (self->priv->sms_pending_parts);
+
     G_OBJECT_CLASS (mm_broadband_modem_parent_class)->finalize (object);
 }
 
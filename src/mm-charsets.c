@@ -111,6 +111,132 @@ charset_iconv_from (MMModemCharset charset)
     return NULL;
 }
 
+/*****************************************************************************/
+/* Converter cache
+ *
+ * Opening an iconv descriptor is much more expensive than the short
+ * conversions we usually do (operator names, USSD, SMS text...), so the
+ * descriptors are kept open for each pair of charsets, and reset before each
+ * use. Behaves like g_convert(). */
+
+static GHashTable *converters;
+
+static gchar *
+charset_convert (const gchar *str,
+                 gssize len,
+                 const gchar *to_codeset,
+                 const gchar *from_codeset,
+                 gsize *bytes_read,
+                 gsize *bytes_written,
+                 GError **error)
+{
+    GIConv converter;
+    gchar *key;
+
+    if (G_UNLIKELY (!converters))
+        converters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    key = g_strdup_printf ("%s\n%s", to_codeset, from_codeset);
+    converter = (GIConv) g_hash_table_lookup (converters, key);
+    if (!converter) {
+        converter = g_iconv_open (to_codeset, from_codeset);
+        if (converter == (GIConv) -1) {
+            g_set_error (error,
+                         G_CONVERT_ERROR,
+                         G_CONVERT_ERROR_NO_CONVERSION,
+                         "Conversion from character set '%s' to '%s' is not supported",
+                         from_codeset, to_codeset);
+            g_free (key);
+            return NULL;
+        }
+        g_hash_table_insert (converters, key, converter);
+    } else
+        g_free (key);
+
+    /* Clear any shift state left by a previous conversion */
+    g_iconv (converter, NULL, NULL, NULL, NULL);
+
+    return g_convert_with_iconv (str, len, converter, bytes_read, bytes_written, error);
+}
+
+/*****************************************************************************/
+/* UCS-2 fast paths
+ *
+ * UCS-2 is by far the most common charset used by modems besides UTF-8 and
+ * IRA, so it's converted by hand. Only characters in the BMP are handled here;
+ * anything else is left to iconv. */
+
+/* Appends the UTF-8 string to the array as UCS-2BE. Returns FALSE, leaving the
+ * array untouched, if it can't be handled. */
+static gboolean
+utf8_to_ucs2 (const gchar *utf8,
+              GByteArray *array)
+{
+    const gchar *p;
+    guint initial_len;
+
+    if (!g_utf8_validate (utf8, -1, NULL))
+        return FALSE;
+
+    initial_len = array->len;
+    for (p = utf8; *p; p = g_utf8_next_char (p)) {
+        gunichar c;
+        guint8 be[2];
+
+        c = g_utf8_get_char (p);
+        if (c > 0xFFFF) {
+            g_byte_array_set_size (array, initial_len);
+            return FALSE;
+        }
+        be[0] = c >> 8;
+        be[1] = c & 0xFF;
+        g_byte_array_append (array, be, 2);
+    }
+    return TRUE;
+}
+
+/* Returns NULL if the string can't be handled */
+static gchar *
+utf8_to_ucs2_hex (const gchar *utf8)
+{
+    GByteArray *ucs2;
+    gchar *hex = NULL;
+
+    ucs2 = g_byte_array_sized_new (strlen (utf8) * 2 + 1);
+    if (utf8_to_ucs2 (utf8, ucs2))
+        hex = mm_utils_bin2hexstr (ucs2->data, ucs2->len);
+    g_byte_array_unref (ucs2);
+    return hex;
+}
+
+/* Returns NULL if the UCS-2BE input can't be handled */
+static gchar *
+ucs2_to_utf8 (const guint8 *ucs2,
+              gsize len)
+{
+    GString *utf8;
+    gsize i;
+
+    if (len % 2)
+        return NULL;
+
+    utf8 = g_string_sized_new ((len / 2) * 3 + 1);
+    for (i = 0; i < len; i += 2) {
+        gunichar c;
+
+        c = (ucs2[i] << 8) | ucs2[i + 1];
+        /* Surrogates aren't valid UCS-2 */
+        if (c >= 0xD800 && c <= 0xDFFF) {
+            g_string_free (utf8, TRUE);
+            return NULL;
+        }
+        g_string_append_unichar (utf8, c);
+    }
+    return g_string_free (utf8, FALSE);
+}
+
+/*****************************************************************************/
+
 gboolean
 mm_modem_charset_byte_array_append (GByteArray *array,
                                     const char *utf8,
@@ -128,7 +254,20 @@ mm_modem_charset_byte_array_append (GByteArray *array,
     iconv_to = charset_iconv_to (charset);
     g_return_val_if_fail (iconv_to != NULL, FALSE);
 
-    converted = g_convert (utf8, -1, iconv_to, "UTF-8", NULL, &written, &error);
+    if (charset == MM_MODEM_CHARSET_UCS2) {
+        guint initial_len = array->len;
+
+        if (quoted)
+            g_byte_array_append (array, (const guint8 *) "\"", 1);
+        if (utf8_to_ucs2 (utf8, array)) {
+            if (quoted)
+                g_byte_array_append (array, (const guint8 *) "\"", 1);
+            return TRUE;
+        }
+        g_byte_array_set_size (array, initial_len);
+    }
+
+    converted = charset_convert (utf8, -1, iconv_to, "UTF-8", NULL, &written, &error);
     if (!converted) {
         if (error) {
             mm_warn ("failed to convert '%s' to %s character set: (%d) %s",
@@ -169,9 +308,17 @@ mm_modem_charset_hex_to_utf8 (const char *src, MMModemCharset charset)
     if (charset == MM_MODEM_CHARSET_UTF8 || charset == MM_MODEM_CHARSET_IRA)
         return unconverted;
 
-    converted = g_convert (unconverted, unconverted_len,
-                           "UTF-8//TRANSLIT", iconv_from,
-                           NULL, NULL, &error);
+    if (charset == MM_MODEM_CHARSET_UCS2) {
+        converted = ucs2_to_utf8 ((const guint8 *) unconverted, unconverted_len);
+        if (converted) {
+            g_free (unconverted);
+            return converted;
+        }
+    }
+
+    converted = charset_convert (unconverted, unconverted_len,
+                                 "UTF-8//TRANSLIT", iconv_from,
+                                 NULL, NULL, &error);
     if (!converted || error) {
         g_clear_error (&error);
         converted = NULL;
@@ -200,9 +347,15 @@ mm_modem_charset_utf8_to_hex (const char *src, MMModemCharset charset)
     if (charset == MM_MODEM_CHARSET_UTF8 || charset == MM_MODEM_CHARSET_IRA)
         return g_strdup (src);
 
-    converted = g_convert (src, strlen (src),
-                           iconv_to, "UTF-8//TRANSLIT",
-                           NULL, &converted_len, &error);
+    if (charset == MM_MODEM_CHARSET_UCS2) {
+        hex = utf8_to_ucs2_hex (src);
+        if (hex)
+            return hex;
+    }
+
+    converted = charset_convert (src, strlen (src),
+                                 iconv_to, "UTF-8//TRANSLIT",
+                                 NULL, &converted_len, &error);
     if (!converted || error) {
         g_clear_error (&error);
         g_free (converted);
@@ -312,24 +465,6 @@ gsm_def_char_to_utf8 (const guint8 gsm, guint8 out_utf8[2])
     return gsm_def_utf8_alphabet[gsm].len;
 }
 
-static gboolean
-utf8_to_gsm_def_char (const char *utf8, guint32 len, guint8 *out_gsm)
-{
-    int i;
-
-    if (len > 0 && len < 4) {
-        for (i = 0; i < GSM_DEF_ALPHABET_SIZE; i++) {
-            if (gsm_def_utf8_alphabet[i].len == len) {
-                if (memcmp (&gsm_def_utf8_alphabet[i].chars[0], utf8, len) == 0) {
-                    *out_gsm = i;
-                    return TRUE;
-                }
-            }
-        }
-    }
-    return FALSE;
-}
-
 
 #define EONE(a, g)        { {a, 0x00, 0x00}, 1, g }
 #define ETHR(a, b, c, g)  { {a, b,    c},    3, g }
@@ -351,36 +486,134 @@ static const GsmUtf8Mapping gsm_ext_utf8_alphabet[GSM_EXT_ALPHABET_SIZE] = {
 
 #define GSM_ESCAPE_CHAR 0x1b
 
-static guint8
-gsm_ext_char_to_utf8 (const guint8 gsm, guint8 out_utf8[3])
+/* Reverse mapping from Unicode code points to GSM septets, built from the
+ * alphabets above on first use. Septets of the extended alphabet are flagged,
+ * as they need to be preceded by the escape septet. */
+#define GSM_REVERSE_EXT_FLAG 0x80
+#define GSM_REVERSE_NONE     0xFF
+
+typedef struct {
+    gunichar c;
+    guint8 gsm;
+} GsmReverseMapping;
+
+static guint8 gsm_reverse_latin1[256];
+/* Characters out of the Latin-1 range: Greek capitals and the Euro sign */
+static GsmReverseMapping gsm_reverse_other[16];
+static guint gsm_reverse_other_len;
+/* Extended alphabet septet to its entry in gsm_ext_utf8_alphabet, plus one */
+static guint8 gsm_ext_index[GSM_DEF_ALPHABET_SIZE];
+
+static void
+gsm_reverse_add (gunichar c, guint8 gsm)
 {
-    int i;
+    if (c < G_N_ELEMENTS (gsm_reverse_latin1)) {
+        gsm_reverse_latin1[c] = gsm;
+        return;
+    }
+
+    g_assert (gsm_reverse_other_len < G_N_ELEMENTS (gsm_reverse_other));
+    gsm_reverse_other[gsm_reverse_other_len].c = c;
+    gsm_reverse_other[gsm_reverse_other_len].gsm = gsm;
+    gsm_reverse_other_len++;
+}
+
+static void
+gsm_tables_init (void)
+{
+    static volatile gsize initialized = 0;
+    guint i;
+
+    if (!g_once_init_enter (&initialized))
+        return;
+
+    memset (gsm_reverse_latin1, GSM_REVERSE_NONE, sizeof (gsm_reverse_latin1));
+
+    for (i = 0; i < GSM_DEF_ALPHABET_SIZE; i++) {
+        /* The escape code doesn't represent a character by itself */
+        if (i == GSM_ESCAPE_CHAR)
+            continue;
+        gsm_reverse_add (g_utf8_get_char (gsm_def_utf8_alphabet[i].chars), i);
+    }
 
     for (i = 0; i < GSM_EXT_ALPHABET_SIZE; i++) {
-        if (gsm == gsm_ext_utf8_alphabet[i].gsm) {
-            memcpy (&out_utf8[0], &gsm_ext_utf8_alphabet[i].chars[0], gsm_ext_utf8_alphabet[i].len);
-            return gsm_ext_utf8_alphabet[i].len;
-        }
+        gsm_reverse_add (g_utf8_get_char (gsm_ext_utf8_alphabet[i].chars),
+                         gsm_ext_utf8_alphabet[i].gsm | GSM_REVERSE_EXT_FLAG);
+        gsm_ext_index[gsm_ext_utf8_alphabet[i].gsm] = i + 1;
     }
-    return 0;
+
+    g_once_init_leave (&initialized, 1);
 }
 
-static gboolean
-utf8_to_gsm_ext_char (const char *utf8, guint32 len, guint8 *out_gsm)
+static guint8
+gsm_reverse_lookup (gunichar c)
 {
-    int i;
+    guint i;
 
-    if (len > 0 && len < 4) {
-        for (i = 0; i < GSM_EXT_ALPHABET_SIZE; i++) {
-            if (gsm_ext_utf8_alphabet[i].len == len) {
-                if (memcmp (&gsm_ext_utf8_alphabet[i].chars[0], utf8, len) == 0) {
-                    *out_gsm = gsm_ext_utf8_alphabet[i].gsm;
-                    return TRUE;
-                }
-            }
+    if (c < G_N_ELEMENTS (gsm_reverse_latin1))
+        return gsm_reverse_latin1[c];
+
+    for (i = 0; i < gsm_reverse_other_len; i++) {
+        if (gsm_reverse_other[i].c == c)
+            return gsm_reverse_other[i].gsm;
+    }
+    return GSM_REVERSE_NONE;
+}
+
+static guint8
+gsm_ext_char_to_utf8 (const guint8 gsm, guint8 out_utf8[3])
+{
+    const GsmUtf8Mapping *mapping;
+
+    if (gsm >= GSM_DEF_ALPHABET_SIZE || !gsm_ext_index[gsm])
+        return 0;
+
+    mapping = &gsm_ext_utf8_alphabet[gsm_ext_index[gsm] - 1];
+    memcpy (&out_utf8[0], &mapping->chars[0], mapping->len);
+    return mapping->len;
+}
+
+/* Converts the UTF-8 string into unpacked GSM septets, appended to @gsm if
+ * given, and returns the number of septets required. Characters which are not
+ * in the GSM alphabets are not converted, but are counted as one septet and
+ * reported in @out_unsupported. The string must be valid UTF-8. */
+static guint
+utf8_to_gsm (const char *utf8, GByteArray *gsm, guint *out_unsupported)
+{
+    const char *p;
+    guint len = 0, unsupported = 0;
+
+    gsm_tables_init ();
+
+    for (p = utf8; *p; p = g_utf8_next_char (p)) {
+        guint8 septets[2];
+        guint8 gch;
+
+        gch = gsm_reverse_lookup (g_utf8_get_char (p));
+        if (gch == GSM_REVERSE_NONE) {
+            unsupported++;
+            len++;
+            continue;
+        }
+
+        if (gch & GSM_REVERSE_EXT_FLAG) {
+            /* Add the escape char */
+            septets[0] = GSM_ESCAPE_CHAR;
+            septets[1] = gch & ~GSM_REVERSE_EXT_FLAG;
+            len += 2;
+            if (gsm)
+                g_byte_array_append (gsm, septets, 2);
+        } else {
+            septets[0] = gch;
+            len++;
+            if (gsm)
+                g_byte_array_append (gsm, septets, 1);
         }
     }
-    return FALSE;
+
+    if (out_unsupported)
+        *out_unsupported = unsupported;
+    return len;
 }
 
 guint8 *
@@ -392,6 +625,8 @@ mm_charset_gsm_unpacked_to_utf8 (const guint8 *gsm, guint32 len)
     g_return_val_if_fail (gsm != NULL, NULL);
     g_return_val_if_fail (len < 4096, NULL);
 
+    gsm_tables_init ();
+
     /* worst case initial length */
     utf8 = g_byte_array_sized_new (len * 2 + 1);
 
@@ -400,8 +635,9 @@ mm_charset_gsm_unpacked_to_utf8 (const guint8 *gsm, guint32 len)
         guint8 ulen;
 
         if (gsm[i] == GSM_ESCAPE_CHAR) {
-            /* Extended alphabet, decode next char */
-            ulen = gsm_ext_char_to_utf8 (gsm[i+1], uchars);
+            /* Extended alphabet, decode next char; a trailing escape
+             * char has nothing to decode */
+            ulen = (i + 1 < len ? gsm_ext_char_to_utf8 (gsm[i+1], uchars) : 0);
             if (ulen)
                 i += 1;
         } else {
@@ -423,16 +659,13 @@ guint8 *
 mm_charset_utf8_to_unpacked_gsm (const char *utf8, guint32 *out_len)
 {
     GByteArray *gsm;
-    const char *c = utf8, *next = c;
-    static const guint8 gesc = GSM_ESCAPE_CHAR;
-    int i = 0;
 
     g_return_val_if_fail (utf8 != NULL, NULL);
     g_return_val_if_fail (out_len != NULL, NULL);
     g_return_val_if_fail (g_utf8_validate (utf8, -1, NULL), NULL);
 
-    /* worst case initial length */
-    gsm = g_byte_array_sized_new (g_utf8_strlen (utf8, -1) * 2 + 1);
+    /* worst case initial length, each byte may need an escaped septet */
+    gsm = g_byte_array_sized_new (strlen (utf8) * 2 + 1);
 
     if (*utf8 == 0x00) {
         /* Zero-length string */
@@ -441,42 +674,12 @@ mm_charset_utf8_to_unpacked_gsm (const char *utf8, guint32 *out_len)
         return g_byte_array_free (gsm, FALSE);
     }
 
-    while (next && *next) {
-        guint8 gch = 0x3f;  /* 0x3f == '?' */
-
-        next = g_utf8_next_char (c);
-
-        /* Try escaped chars first, then default alphabet */
-        if (utf8_to_gsm_ext_char (c, next - c, &gch)) {
-            /* Add the escape char */
-            g_byte_array_append (gsm, &gesc, 1);
-            g_byte_array_append (gsm, &gch, 1);
-        } else if (utf8_to_gsm_def_char (c, next - c, &gch))
-            g_byte_array_append (gsm, &gch, 1);
-
-        c = next;
-        i++;
-    }
+    utf8_to_gsm (utf8, gsm, NULL);
 
     *out_len = gsm->len;
     return g_byte_array_free (gsm, FALSE);
 }
 
-static gboolean
-gsm_is_subset (gunichar c, const char *utf8, gsize ulen, guint *out_clen)
-{
-    guint8 gsm;
-
-    *out_clen = 1;
-    if (utf8_to_gsm_def_char (utf8, ulen, &gsm))
-        return TRUE;
-    if (utf8_to_gsm_ext_char (utf8, ulen, &gsm)) {
-        *out_clen = 2;
-        return TRUE;
-    }
-    return FALSE;
-}
-
 static gboolean
 ira_is_subset (gunichar c, const char *utf8, gsize ulen, guint *out_clen)
 {
@@ -571,7 +774,6 @@ typedef struct {
 } SubsetEntry;
 
 SubsetEntry subset_table[] = {
-    { MM_MODEM_CHARSET_GSM,     gsm_is_subset },
     { MM_MODEM_CHARSET_IRA,     ira_is_subset },
     { MM_MODEM_CHARSET_UCS2,    ucs2_is_subset },
     { MM_MODEM_CHARSET_8859_1,  iso88591_is_subset },
@@ -605,6 +807,12 @@ mm_charset_get_encoded_len (const char *utf8,
     if (charset == MM_MODEM_CHARSET_UTF8)
         return strlen (utf8);
 
+    /* GSM is counted with the same logic used when converting */
+    if (charset == MM_MODEM_CHARSET_GSM) {
+        g_return_val_if_fail (g_utf8_validate (utf8, -1, NULL), 0);
+        return utf8_to_gsm (utf8, NULL, out_unsupported);
+    }
+
     /* Find the charset in our subset table */
     for (e = &subset_table[0];
          e->cs != charset && e->cs != MM_MODEM_CHARSET_UNKNOWN;
@@ -642,12 +850,32 @@ gsm_unpack (const guint8 *gsm,
             guint8 start_offset,  /* in _bits_ */
             guint32 *out_unpacked_len)
 {
-    GByteArray *unpacked;
-    int i;
-
-    unpacked = g_byte_array_sized_new (num_septets + 1);
+    guint8 *unpacked;
+    guint32 i;
+    guint j;
+
+    unpacked = g_malloc (num_septets + 1);
+
+    /* Each group of 8 septets fills 7 octets, so process them at once. With
+     * a bit offset, the last septet of the group spills over an 8th octet. */
+    gsm += start_offset / 8;
+    start_offset %= 8;
+    for (i = 0; i + 8 <= num_septets; i += 8) {
+        const guint8 *octets;
+        guint64 bits = 0;
+
+        octets = &gsm[(i / 8) * 7];
+        for (j = 0; j < (start_offset ? 8 : 7); j++)
+            bits |= ((guint64) octets[j]) << (j * 8);
+        bits >>= start_offset;
+
+        for (j = 0; j < 8; j++) {
+            unpacked[i + j] = bits & 0x7F;
+            bits >>= 7;
+        }
+    }
 
-    for (i = 0; i < num_septets; i++) {
+    for (; i < num_septets; i++) {
         guint8 bits_here, bits_in_next, octet, offset, c;
         guint32 start_bit;
 
@@ -665,11 +893,11 @@ gsm_unpack (const guint8 *gsm,
             octet = gsm[(start_bit / 8) + 1];
             c |= (octet & (0xFF >> (8 - bits_in_next))) << bits_here;
         }
-        g_byte_array_append (unpacked, &c, 1);
+        unpacked[i] = c;
     }
 
-    *out_unpacked_len = unpacked->len;
-    return g_byte_array_free (unpacked, FALSE);
+    *out_unpacked_len = num_septets;
+    return unpacked;
 }
 
 guint8 *
@@ -679,8 +907,9 @@ gsm_pack (const guint8 *src,
           guint32 *out_packed_len)
 {
     guint8 *packed;
-    guint octet = 0, lshift, plen;
-    int i = 0;
+    guint plen;
+    guint32 i;
+    guint j;
 
     g_return_val_if_fail (start_offset < 8, NULL);
 
@@ -691,16 +920,35 @@ gsm_pack (const guint8 *src,
 
     packed = g_malloc0 (plen);
 
-    for (i = 0, lshift = start_offset; i < src_len; i++) {
+    /* Each group of 8 septets fills 7 octets (plus part of an 8th one when
+     * there is a bit offset), so pack them at once */
+    for (i = 0; i + 8 <= src_len; i += 8) {
+        guint8 *octets;
+        guint64 bits = 0;
+
+        for (j = 0; j < 8; j++)
+            bits |= ((guint64) (src[i + j] & 0x7F)) << (j * 7);
+        bits <<= start_offset;
+
+        octets = &packed[(i / 8) * 7];
+        for (j = 0; j < (start_offset ? 8 : 7); j++)
+            octets[j] |= (bits >> (j * 8)) & 0xFF;
+    }
+
+    for (; i < src_len; i++) {
+        guint32 start_bit, octet;
+        guint8 lshift;
+
+        start_bit = start_offset + (i * 7);
+        octet = start_bit / 8;
+        lshift = start_bit % 8;
+
         packed[octet] |= (src[i] & 0x7F) << lshift;
         if (lshift > 1) {
             /* Grab the lost bits and add to next octet */
             g_assert (octet + 1 < plen);
-            packed[octet + 1] = (src[i] & 0x7F) >> (8 - lshift);
+            packed[octet + 1] |= (src[i] & 0x7F) >> (8 - lshift);
         }
-        if (lshift)
-            octet++;
-        lshift = lshift ? lshift - 1 : 7;
     }
 
     if (out_packed_len)
@@ -739,9 +987,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
         GError *error = NULL;
 
         iconv_from = charset_iconv_from (charset);
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", iconv_from,
-                          NULL, NULL, &error);
+        utf8 = charset_convert (str, strlen (str),
+                                "UTF-8//TRANSLIT", iconv_from,
+                                NULL, NULL, &error);
         if (!utf8 || error) {
             g_clear_error (&error);
             utf8 = NULL;
@@ -782,9 +1030,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
          * the partial conversion length to re-convert the part of the string
          * that is UTF-8, if any.
          */
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
-                          &bread, &bwritten, NULL);
+        utf8 = charset_convert (str, strlen (str),
+                                "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
+                                &bread, &bwritten, NULL);
 
         /* Valid conversion, or we didn't get enough valid UTF-8 */
         if (utf8 || (bwritten <= 2)) {
@@ -796,9 +1044,9 @@ mm_charset_take_and_convert_to_utf8 (gchar *str, MMModemCharset charset)
          * location and get what we can.
          */
         str[bread] = '\0';
-        utf8 = g_convert (str, strlen (str),
-                          "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
-                          NULL, NULL, NULL);
+        utf8 = charset_convert (str, strlen (str),
+                                "UTF-8//TRANSLIT", "UTF-8//TRANSLIT",
+                                NULL, NULL, NULL);
         g_free (str);
         break;
     }
@@ -862,9 +1110,9 @@ mm_utf8_take_and_convert_to_charset (gchar *str,
         GError *error = NULL;
 
         iconv_to = charset_iconv_from (charset);
-        encoded = g_convert (str, strlen (str),
-                             iconv_to, "UTF-8",
-                             NULL, NULL, &error);
+        encoded = charset_convert (str, strlen (str),
+                                   iconv_to, "UTF-8",
+                                   NULL, NULL, &error);
         if (!encoded || error) {
             g_clear_error (&error);
             encoded = NULL;
@@ -880,10 +1128,16 @@ mm_utf8_take_and_convert_to_charset (gchar *str,
         GError *error = NULL;
         gchar *hex;
 
+        encoded = utf8_to_ucs2_hex (str);
+        if (encoded) {
+            g_free (str);
+            break;
+        }
+
         iconv_to = charset_iconv_from (charset);
-        encoded = g_convert (str, strlen (str),
-                             iconv_to, "UTF-8",
-                             NULL, &encoded_len, &error);
+        encoded = charset_convert (str, strlen (str),
+                                   iconv_to, "UTF-8",
+                                   NULL, &encoded_len, &error);
         if (!encoded || error) {
             g_clear_error (&error);
             encoded = NULL;
@@ -31,11 +31,19 @@
 # define NO_AUTO_SCAN_DEFAULT     TRUE
 #endif
 
+#define DEFAULT_UEVENT_COALESCE_TIME_MSECS 100
+#define DEFAULT_MAX_PROBES                 16
+
 static gboolean     help_flag;
 static gboolean     version_flag;
 static gboolean     debug;
 static gboolean     no_auto_scan = NO_AUTO_SCAN_DEFAULT;
 static const gchar *initial_kernel_events;
+static const gchar *probe_cache;
+static gboolean     no_probe_cache;
+static gint         uevent_coalesce_time = DEFAULT_UEVENT_COALESCE_TIME_MSECS;
+static gint         max_probes = DEFAULT_MAX_PROBES;
+static const gchar *probe_trace;
 
 static const GOptionEntry entries[] = {
     {
@@ -48,6 +56,33 @@ static const GOptionEntry entries[] = {
         "Path to initial kernel events file",
         "[PATH]"
     },
+    {
+        "probe-cache", 0, 0, G_OPTION_ARG_FILENAME, &probe_cache,
+        "Path to the port probing results cache file",
+        "[PATH]"
+    },
+    {
+        "no-probe-cache", 0, 0, G_OPTION_ARG_NONE, &no_probe_cache,
+        "Don't cache port probing results",
+        NULL
+    },
+#if defined WITH_UDEV
+    {
+        "uevent-coalesce-time", 0, 0, G_OPTION_ARG_INT, &uevent_coalesce_time,
+        "Time to buffer udev events before processing them, in ms (0 to disable)",
+        "[MSECS]"
+    },
+#endif
+    {
+        "max-probes", 0, 0, G_OPTION_ARG_INT, &max_probes,
+        "Maximum number of ports to probe at the same time (0 for unlimited)",
+        "[N]"
+    },
+    {
+        "probe-trace", 0, 0, G_OPTION_ARG_FILENAME, &probe_trace,
+        "Path to a file where to record the timeline of port probing (Chrome trace format)",
+        "[PATH]"
+    },
     {
         "debug", 0, 0, G_OPTION_ARG_NONE, &debug,
         "Run with extended debugging capabilities",
@@ -84,6 +119,24 @@ mm_context_get_no_auto_scan (void)
     return no_auto_scan;
 }
 
+guint
+mm_context_get_uevent_coalesce_time (void)
+{
+    return (uevent_coalesce_time > 0 ? (guint) uevent_coalesce_time : 0);
+}
+
+guint
+mm_context_get_max_probes (void)
+{
+    return (max_probes > 0 ? (guint) max_probes : 0);
+}
+
+const gchar *
+mm_context_get_probe_trace_file (void)
+{
+    return probe_trace;
+}
+
 /*****************************************************************************/
 /* Log context */
 
@@ -226,6 +279,20 @@ mm_context_get_test_plugin_dir (void)
     return test_plugin_dir ? test_plugin_dir : PLUGINDIR;
 }
 
+const gchar *
+mm_context_get_probe_cache_file (void)
+{
+    if (no_probe_cache)
+        return NULL;
+    if (probe_cache)
+        return probe_cache;
+    /* Test sessions must not modify the system cache unless explicitly
+     * requested */
+    if (test_session)
+        return NULL;
+    return PROBECACHEDIR "/probe-cache";
+}
+
 /*****************************************************************************/
 
 static void
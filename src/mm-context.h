@@ -29,6 +29,10 @@ void mm_context_init (gint    argc,
 gboolean     mm_context_get_debug                 (void);
 const gchar *mm_context_get_initial_kernel_events (void);
 gboolean     mm_context_get_no_auto_scan          (void);
+guint        mm_context_get_uevent_coalesce_time  (void);
+guint        mm_context_get_max_probes            (void);
+const gchar *mm_context_get_probe_trace_file      (void);
+const gchar *mm_context_get_probe_cache_file      (void);
 
 /* Logging support */
 const gchar *mm_context_get_log_level               (void);
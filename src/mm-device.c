@@ -506,6 +506,12 @@ mm_device_peek_port_probe_list (MMDevice *self)
     return self->priv->port_probes;
 }
 
+GList *
+mm_device_peek_ignored_port_probe_list (MMDevice *self)
+{
+    return self->priv->ignored_port_probes;
+}
+
 GList *
 mm_device_get_port_probe_list (MMDevice *self)
 {
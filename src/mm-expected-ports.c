@@ -0,0 +1,138 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <string.h>
+
+#include "mm-expected-ports.h"
+
+struct _MMExpectedPorts {
+    /* Number of ports expected */
+    guint       n_ports;
+    /* Set of port identifiers expected, or NULL if only the number of ports
+     * is known */
+    GHashTable *port_ids;
+};
+
+/*****************************************************************************/
+
+guint
+mm_expected_ports_get_length (MMExpectedPorts *self)
+{
+    return self->n_ports;
+}
+
+gboolean
+mm_expected_ports_all_found (MMExpectedPorts *self,
+                             GPtrArray       *found_ids)
+{
+    GHashTable *found;
+    guint       i;
+
+    if (!self->port_ids)
+        return (found_ids->len >= self->n_ports);
+
+    found = g_hash_table_new (g_str_hash, g_str_equal);
+    for (i = 0; i < found_ids->len; i++) {
+        const gchar *port_id;
+
+        port_id = g_ptr_array_index (found_ids, i);
+        if (port_id && g_hash_table_contains (self->port_ids, port_id))
+            g_hash_table_add (found, (gpointer) port_id);
+    }
+    i = g_hash_table_size (found);
+    g_hash_table_unref (found);
+
+    return (i == self->n_ports);
+}
+
+static gint
+port_id_cmp (const gchar **a,
+             const gchar **b)
+{
+    return strcmp (*a, *b);
+}
+
+gchar **
+mm_expected_ports_build_ids (GPtrArray *found_ids)
+{
+    GPtrArray *port_ids;
+    guint      i;
+
+    port_ids = g_ptr_array_new ();
+    for (i = 0; i < found_ids->len; i++) {
+        const gchar *port_id;
+
+        port_id = g_ptr_array_index (found_ids, i);
+        if (!port_id) {
+            g_ptr_array_free (port_ids, TRUE);
+            return NULL;
+        }
+        g_ptr_array_add (port_ids, (gpointer) port_id);
+    }
+    if (!port_ids->len) {
+        g_ptr_array_free (port_ids, TRUE);
+        return NULL;
+    }
+
+    g_ptr_array_sort (port_ids, (GCompareFunc) port_id_cmp);
+
+    /* Copy removing duplicates */
+    found_ids = port_ids;
+    port_ids = g_ptr_array_new ();
+    for (i = 0; i < found_ids->len; i++) {
+        if (!i || !g_str_equal (g_ptr_array_index (found_ids, i), g_ptr_array_index (found_ids, i - 1)))
+            g_ptr_array_add (port_ids, g_strdup (g_ptr_array_index (found_ids, i)));
+    }
+    g_ptr_array_add (port_ids, NULL);
+    g_ptr_array_free (found_ids, TRUE);
+
+    return (gchar **) g_ptr_array_free (port_ids, FALSE);
+}
+
+/*****************************************************************************/
+
+MMExpectedPorts *
+mm_expected_ports_new_count (guint n_ports)
+{
+    MMExpectedPorts *self;
+
+    g_return_val_if_fail (n_ports > 0, NULL);
+
+    self = g_slice_new0 (MMExpectedPorts);
+    self->n_ports = n_ports;
+    return self;
+}
+
+MMExpectedPorts *
+mm_expected_ports_new_ids (const gchar * const *port_ids)
+{
+    MMExpectedPorts *self;
+    guint            i;
+
+    g_return_val_if_fail (port_ids && port_ids[0], NULL);
+
+    self = g_slice_new0 (MMExpectedPorts);
+    self->port_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    for (i = 0; port_ids[i]; i++)
+        g_hash_table_add (self->port_ids, g_strdup (port_ids[i]));
+    self->n_ports = g_hash_table_size (self->port_ids);
+    return self;
+}
+
+void
+mm_expected_ports_free (MMExpectedPorts *self)
+{
+    if (self->port_ids)
+        g_hash_table_unref (self->port_ids);
+    g_slice_free (MMExpectedPorts, self);
+}
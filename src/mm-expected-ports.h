@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_EXPECTED_PORTS_H
+#define MM_EXPECTED_PORTS_H
+
+#include <glib.h>
+
+/* Ports a device is expected to expose.
+ *
+ * The expectation is either a plain number of ports, given explicitly (e.g.
+ * in udev), or the set of persistent port identifiers found the last time
+ * the device was handled. A learned set is only met when every one of its
+ * ports is found, so extra ports never make up for a missing one; and as
+ * the ports found when an expectation is met always include the expected
+ * ones, learning from them never shrinks the set. Only a probing which ran
+ * for the whole default time may do that. */
+
+typedef struct _MMExpectedPorts MMExpectedPorts;
+
+MMExpectedPorts *mm_expected_ports_new_count  (guint                n_ports);
+MMExpectedPorts *mm_expected_ports_new_ids    (const gchar * const *port_ids);
+void             mm_expected_ports_free       (MMExpectedPorts     *self);
+
+guint            mm_expected_ports_get_length (MMExpectedPorts     *self);
+
+/* The found ports are given by their persistent identifiers, with NULL
+ * elements for ports which can't be identified */
+gboolean         mm_expected_ports_all_found  (MMExpectedPorts     *self,
+                                               GPtrArray           *found_ids);
+
+/* Sorted set of identifiers to learn from the found ports, or NULL if any
+ * of them can't be identified */
+gchar          **mm_expected_ports_build_ids  (GPtrArray           *found_ids);
+
+#endif /* MM_EXPECTED_PORTS_H */
@@ -34,6 +34,24 @@
 
 /*****************************************************************************/
 
+GRegex *
+mm_static_regex_get (MMStaticRegex *self)
+{
+    if (g_once_init_enter (&self->regex)) {
+        GRegex *regex;
+        GError *error = NULL;
+
+        /* Patterns are built-in, so a compilation failure is a bug */
+        regex = g_regex_new (self->pattern, self->compile_options | G_REGEX_OPTIMIZE, 0, &error);
+        g_assert_no_error (error);
+        g_once_init_leave (&self->regex, (gsize) regex);
+    }
+
+    return g_regex_ref ((GRegex *) self->regex);
+}
+
+/*****************************************************************************/
+
 gchar *
 mm_strip_quotes (gchar *str)
 {
@@ -131,6 +149,95 @@ mm_split_string_groups (const gchar *str)
 
 /*****************************************************************************/
 
+/* Whether the line is information text of the given extended command, i.e.
+ * if it starts with "+<name>:" */
+static gboolean
+line_is_command_text (const gchar *line,
+                      const gchar *command)
+{
+    gsize name_len;
+
+    if (!g_ascii_strncasecmp (command, "AT", 2))
+        command += 2;
+    if (command[0] != '+')
+        return FALSE;
+
+    name_len = strcspn (command, "=?;");
+    return (!g_ascii_strncasecmp (line, command, name_len) && line[name_len] == ':');
+}
+
+/*
+ * Splits the response to a command line with several concatenated extended
+ * commands (e.g. AT+CTZU=1;+CCLK?) into the responses of each command.
+ *
+ * The whole line gets a single final result code, so the information text of
+ * each command is found by its "+<name>:" prefix, in the same order as the
+ * commands; lines without such prefix are kept together with the previous
+ * line (e.g. the PDU lines of +CMGL), and commands not reporting any
+ * information text get an empty response. If some line can't be assigned to
+ * any command, NULL is returned.
+ */
+gchar **
+mm_split_concatenated_response (const gchar  *response,
+                                const gchar **commands,
+                                guint         n_commands)
+{
+    GString **texts;
+    gchar **lines;
+    gchar **split = NULL;
+    gint current = -1;
+    guint i;
+    guint j;
+
+    g_return_val_if_fail (n_commands > 0, NULL);
+
+    if (!response)
+        return NULL;
+
+    texts = g_new0 (GString *, n_commands);
+    lines = g_strsplit (response, "\r\n", -1);
+
+    for (i = 0; lines[i]; i++) {
+        if (!lines[i][0])
+            continue;
+
+        /* Text of this command or of any of the following ones? */
+        for (j = (current < 0 ? 0 : current); j < n_commands; j++) {
+            if (line_is_command_text (lines[i], commands[j]))
+                break;
+        }
+
+        if (j < n_commands) {
+            /* The same command may report several lines with its prefix */
+            current = j;
+            if (texts[current])
+                g_string_append (texts[current], "\r\n");
+            else
+                texts[current] = g_string_new (NULL);
+        } else if (current < 0)
+            goto out;
+        else
+            g_string_append (texts[current], "\r\n");
+
+        g_string_append (texts[current], lines[i]);
+    }
+
+    split = g_new0 (gchar *, n_commands + 1);
+    for (i = 0; i < n_commands; i++)
+        split[i] = texts[i] ? g_strdup (texts[i]->str) : g_strdup ("");
+
+out:
+    for (i = 0; i < n_commands; i++) {
+        if (texts[i])
+            g_string_free (texts[i], TRUE);
+    }
+    g_free (texts);
+    g_strfreev (lines);
+    return split;
+}
+
+/*****************************************************************************/
+
 static int uint_compare_func (gconstpointer a, gconstpointer b)
 {
    return (*(guint *)a - *(guint *)b);
@@ -605,6 +712,8 @@ MMFlowControl
 mm_parse_ifc_test_response (const gchar  *response,
                             GError      **error)
 {
+    static MMStaticRegex ifc_test_regex =
+        MM_STATIC_REGEX_INIT ("(?:\\+IFC:)?\\s*\\((.*)\\),\\((.*)\\)(?:\\r\\n)?", 0);
     GRegex        *r;
     GError        *inner_error = NULL;
     GMatchInfo    *match_info  = NULL;
@@ -612,7 +721,7 @@ mm_parse_ifc_test_response (const gchar  *response,
     MMFlowControl  ta_mask     = MM_FLOW_CONTROL_UNKNOWN;
     MMFlowControl  mask        = MM_FLOW_CONTROL_UNKNOWN;
 
-    r = g_regex_new ("(?:\\+IFC:)?\\s*\\((.*)\\),\\((.*)\\)(?:\\r\\n)?", 0, 0, NULL);
+    r = mm_static_regex_get (&ifc_test_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -886,6 +995,8 @@ GArray *
 mm_3gpp_parse_ws46_test_response (const gchar  *response,
                                   GError      **error)
 {
+    static MMStaticRegex ws46_test_regex =
+        MM_STATIC_REGEX_INIT ("(?:\\+WS46:)?\\s*\\((.*)\\)(?:\\r\\n)?", 0);
     GArray     *modes = NULL;
     GArray     *tech_values = NULL;
     GRegex     *r;
@@ -899,7 +1010,7 @@ mm_3gpp_parse_ws46_test_response (const gchar  *response,
     gboolean    supported_3g = FALSE;
     gboolean    supported_2g = FALSE;
 
-    r = g_regex_new ("(?:\\+WS46:)?\\s*\\((.*)\\)(?:\\r\\n)?", 0, 0, NULL);
+    r = mm_static_regex_get (&ws46_test_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -1066,11 +1177,14 @@ GList *
 mm_3gpp_parse_cops_test_response (const gchar *reply,
                                   GError **error)
 {
+    static MMStaticRegex cops_test_regex =
+        MM_STATIC_REGEX_INIT ("\\((\\d),\"([^\"\\)]*)\",([^,\\)]*),([^,\\)]*)[\\)]?,(\\d)\\)", G_REGEX_UNGREEDY);
+    static MMStaticRegex cops_test_pre_umts_regex =
+        MM_STATIC_REGEX_INIT ("\\((\\d),([^,\\)]*),([^,\\)]*),([^\\)]*)\\)", G_REGEX_UNGREEDY);
     GRegex *r;
     GList *info_list = NULL;
     GMatchInfo *match_info;
     gboolean umts_format = TRUE;
-    GError *inner_error = NULL;
 
     g_return_val_if_fail (reply != NULL, NULL);
     if (error)
@@ -1099,15 +1213,7 @@ mm_3gpp_parse_cops_test_response (const gchar *reply,
      *       +COPS: (2,"","T-Mobile","31026",0),(1,"AT&T","AT&T","310410"),0)
      */
 
-    r = g_regex_new ("\\((\\d),\"([^\"\\)]*)\",([^,\\)]*),([^,\\)]*)[\\)]?,(\\d)\\)", G_REGEX_UNGREEDY, 0, &inner_error);
-    if (inner_error) {
-        mm_err ("Invalid regular expression: %s", inner_error->message);
-        g_error_free (inner_error);
-        g_set_error_literal (error,
-                             MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                             "Could not parse scan results");
-        return NULL;
-    }
+    r = mm_static_regex_get (&cops_test_regex);
 
     /* If we didn't get any hits, try the pre-UMTS format match */
     if (!g_regex_match (r, reply, 0, &match_info)) {
@@ -1128,15 +1234,7 @@ mm_3gpp_parse_cops_test_response (const gchar *reply,
          *       +COPS: (2,"T - Mobile",,"31026"),(1,"Einstein PCS",,"31064"),(1,"Cingular",,"31041"),,(0,1,3),(0,2)
          */
 
-        r = g_regex_new ("\\((\\d),([^,\\)]*),([^,\\)]*),([^\\)]*)\\)", G_REGEX_UNGREEDY, 0, &inner_error);
-        if (inner_error) {
-            mm_err ("Invalid regular expression: %s", inner_error->message);
-            g_error_free (inner_error);
-            g_set_error_literal (error,
-                                 MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                                 "Could not parse scan results");
-            return NULL;
-        }
+        r = mm_static_regex_get (&cops_test_pre_umts_regex);
 
         g_regex_match (r, reply, 0, &match_info);
         umts_format = FALSE;
@@ -1221,6 +1319,8 @@ mm_3gpp_parse_cops_read_response (const gchar              *response,
                                   MMModemAccessTechnology  *out_act,
                                   GError                  **error)
 {
+    static MMStaticRegex cops_read_regex =
+        MM_STATIC_REGEX_INIT ("\\+COPS:\\s*(\\d+),(\\d+),([^,]*)(?:,(\\d+))?(?:\\r\\n)?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -1237,7 +1337,7 @@ mm_3gpp_parse_cops_read_response (const gchar              *response,
      * or:
      *   +COPS: <mode>,<format>,<oper>,<AcT>
      */
-    r = g_regex_new ("\\+COPS:\\s*(\\d+),(\\d+),([^,]*)(?:,(\\d+))?(?:\\r\\n)?", 0, 0, NULL);
+    r = mm_static_regex_get (&cops_read_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -1357,6 +1457,8 @@ GList *
 mm_3gpp_parse_cgdcont_test_response (const gchar *response,
                                      GError **error)
 {
+    static MMStaticRegex cgdcont_test_regex =
+        MM_STATIC_REGEX_INIT ("\\+CGDCONT:\\s*\\(\\s*(\\d+)\\s*-?\\s*(\\d+)?[^\\)]*\\)\\s*,\\s*\\(?\"(\\S+)\"", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info;
     GError *inner_error = NULL;
@@ -1367,9 +1469,7 @@ mm_3gpp_parse_cgdcont_test_response (const gchar *response,
         return NULL;
     }
 
-    r = g_regex_new ("\\+CGDCONT:\\s*\\(\\s*(\\d+)\\s*-?\\s*(\\d+)?[^\\)]*\\)\\s*,\\s*\\(?\"(\\S+)\"",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, &inner_error);
+    r = mm_static_regex_get (&cgdcont_test_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -1445,6 +1545,8 @@ GList *
 mm_3gpp_parse_cgdcont_read_response (const gchar *reply,
                                      GError **error)
 {
+    static MMStaticRegex cgdcont_read_regex =
+        MM_STATIC_REGEX_INIT ("\\+CGDCONT:\\s*(\\d+)\\s*,([^, \\)]*)\\s*,([^, \\)]*)\\s*,([^, \\)]*)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GError *inner_error = NULL;
     GRegex *r;
     GMatchInfo *match_info;
@@ -1455,9 +1557,7 @@ mm_3gpp_parse_cgdcont_read_response (const gchar *reply,
         return NULL;
 
     list = NULL;
-    r = g_regex_new ("\\+CGDCONT:\\s*(\\d+)\\s*,([^, \\)]*)\\s*,([^, \\)]*)\\s*,([^, \\)]*)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, &inner_error);
+    r = mm_static_regex_get (&cgdcont_read_regex);
     if (r) {
         g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &inner_error);
 
@@ -1532,6 +1632,8 @@ GList *
 mm_3gpp_parse_cgact_read_response (const gchar *reply,
                                    GError **error)
 {
+    static MMStaticRegex cgact_read_regex =
+        MM_STATIC_REGEX_INIT ("\\+CGACT:\\s*(\\d+),(\\d+)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     GError *inner_error = NULL;
     GRegex *r;
     GMatchInfo *match_info;
@@ -1542,8 +1644,7 @@ mm_3gpp_parse_cgact_read_response (const gchar *reply,
         return NULL;
 
     list = NULL;
-    r = g_regex_new ("\\+CGACT:\\s*(\\d+),(\\d+)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW, 0, &inner_error);
+    r = mm_static_regex_get (&cgact_read_regex);
     g_assert (r);
 
     g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &inner_error);
@@ -1799,6 +1900,8 @@ mm_3gpp_parse_cmgf_test_response (const gchar *reply,
                                   gboolean *sms_text_supported,
                                   GError **error)
 {
+    static MMStaticRegex cmgf_test_regex =
+        MM_STATIC_REGEX_INIT ("\\(?\\s*(\\d+)\\s*[-,]?\\s*(\\d+)?\\s*\\)?", 0);
     GRegex *r;
     GMatchInfo *match_info;
     gchar *s;
@@ -1810,9 +1913,7 @@ mm_3gpp_parse_cmgf_test_response (const gchar *reply,
     while (isspace (*reply))
         reply++;
 
-    r = g_regex_new ("\\(?\\s*(\\d+)\\s*[-,]?\\s*(\\d+)?\\s*\\)?", 0, 0, error);
-    if (!r)
-        return FALSE;
+    r = mm_static_regex_get (&cmgf_test_regex);
 
     if (!g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
         g_set_error (error,
@@ -1853,6 +1954,8 @@ mm_3gpp_parse_cmgr_read_response (const gchar *reply,
                                   guint index,
                                   GError **error)
 {
+    static MMStaticRegex cmgr_read_regex =
+        MM_STATIC_REGEX_INIT ("\\+CMGR:\\s*(\\d+)\\s*,([^,]*),\\s*(\\d+)\\s*([^\\r\\n]*)", 0);
     GRegex *r;
     GMatchInfo *match_info;
     gint count;
@@ -1862,7 +1965,7 @@ mm_3gpp_parse_cmgr_read_response (const gchar *reply,
 
     /* +CMGR: <stat>,<alpha>,<length>(whitespace)<pdu> */
     /* The <alpha> and <length> fields are matched, but not currently used */
-    r = g_regex_new ("\\+CMGR:\\s*(\\d+)\\s*,([^,]*),\\s*(\\d+)\\s*([^\\r\\n]*)", 0, 0, NULL);
+    r = mm_static_regex_get (&cmgr_read_regex);
     g_assert (r);
 
     if (!g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
@@ -1927,6 +2030,8 @@ mm_3gpp_parse_crsm_response (const gchar *reply,
                              gchar **hex,
                              GError **error)
 {
+    static MMStaticRegex crsm_regex =
+        MM_STATIC_REGEX_INIT ("\\+CRSM:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,\\s*\"?([0-9a-fA-F]+)\"?", G_REGEX_RAW);
     GRegex *r;
     GMatchInfo *match_info;
 
@@ -1943,8 +2048,7 @@ mm_3gpp_parse_crsm_response (const gchar *reply,
         return FALSE;
     }
 
-    r = g_regex_new ("\\+CRSM:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,\\s*\"?([0-9a-fA-F]+)\"?",
-                     G_REGEX_RAW, 0, NULL);
+    r = mm_static_regex_get (&crsm_regex);
     g_assert (r != NULL);
 
     if (g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL) &&
@@ -2029,6 +2133,16 @@ mm_3gpp_parse_cgcontrdp_response (const gchar  *response,
                                   gchar       **out_dns_secondary_address,
                                   GError      **error)
 {
+    static MMStaticRegex cgcontrdp_regex =
+        MM_STATIC_REGEX_INIT ("\\+CGCONTRDP: "
+                              "(\\d+),(\\d+),([^,]*)" /* cid, bearer id, apn */
+                              "(?:,([^,]*))?" /* (a)ip+mask        or (b)ip */
+                              "(?:,([^,]*))?" /* (a)gateway        or (b)mask */
+                              "(?:,([^,]*))?" /* (a)dns1           or (b)gateway */
+                              "(?:,([^,]*))?" /* (a)dns2           or (b)dns1 */
+                              "(?:,([^,]*))?" /* (a)p-cscf primary or (b)dns2 */
+                              "(?:,(.*))?"    /* others, ignored */
+                              "(?:\\r\\n)?", 0);
     GRegex     *r;
     GMatchInfo *match_info;
     GError     *inner_error = NULL;
@@ -2057,16 +2171,7 @@ mm_3gpp_parse_cgcontrdp_response (const gchar  *response,
      * The format of the response changed in TS 27.007 v9.4.0, we try to detect
      * both formats ('a' if >= v9.4.0, 'b' if < v9.4.0) with a single regex here.
      */
-    r = g_regex_new ("\\+CGCONTRDP: "
-                     "(\\d+),(\\d+),([^,]*)" /* cid, bearer id, apn */
-                     "(?:,([^,]*))?" /* (a)ip+mask        or (b)ip */
-                     "(?:,([^,]*))?" /* (a)gateway        or (b)mask */
-                     "(?:,([^,]*))?" /* (a)dns1           or (b)gateway */
-                     "(?:,([^,]*))?" /* (a)dns2           or (b)dns1 */
-                     "(?:,([^,]*))?" /* (a)p-cscf primary or (b)dns2 */
-                     "(?:,(.*))?"    /* others, ignored */
-                     "(?:\\r\\n)?",
-                     0, 0, NULL);
+    r = mm_static_regex_get (&cgcontrdp_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -2172,6 +2277,8 @@ mm_3gpp_parse_cfun_query_response (const gchar  *response,
                                    guint        *out_state,
                                    GError      **error)
 {
+    static MMStaticRegex cfun_query_regex =
+        MM_STATIC_REGEX_INIT ("\\+CFUN: (\\d+)(?:,(?:\\d+))?(?:\\r\\n)?", 0);
     GRegex     *r;
     GMatchInfo *match_info;
     GError     *inner_error = NULL;
@@ -2183,7 +2290,7 @@ mm_3gpp_parse_cfun_query_response (const gchar  *response,
      * +CFUN: 1,0
      *   ..but we don't care about the second number
      */
-    r = g_regex_new ("\\+CFUN: (\\d+)(?:,(?:\\d+))?(?:\\r\\n)?", 0, 0, NULL);
+    r = mm_static_regex_get (&cfun_query_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -2230,6 +2337,8 @@ mm_3gpp_parse_cesq_response (const gchar  *response,
                              guint        *out_rsrp,
                              GError      **error)
 {
+    static MMStaticRegex cesq_regex =
+        MM_STATIC_REGEX_INIT ("\\+CESQ: (\\d+),(\\d+),(\\d+),(\\d+),(\\d+),(\\d+)(?:\\r\\n)?", 0);
     GRegex     *r;
     GMatchInfo *match_info;
     GError     *inner_error = NULL;
@@ -2251,7 +2360,7 @@ mm_3gpp_parse_cesq_response (const gchar  *response,
     /* Response may be e.g.:
      * +CESQ: 99,99,255,255,20,80
      */
-    r = g_regex_new ("\\+CESQ: (\\d+),(\\d+),(\\d+),(\\d+),(\\d+),(\\d+)(?:\\r\\n)?", 0, 0, NULL);
+    r = mm_static_regex_get (&cesq_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, response, strlen (response), 0, 0, &match_info, &inner_error);
@@ -2511,6 +2620,8 @@ mm_3gpp_parse_cpms_test_response (const gchar *reply,
                                   GArray **mem2,
                                   GArray **mem3)
 {
+    static MMStaticRegex cpms_test_regex =
+        MM_STATIC_REGEX_INIT ("\\s*\"([^,\\)]+)\"\\s*", 0);
     GRegex *r;
     gchar **split;
     guint i;
@@ -2535,7 +2646,7 @@ mm_3gpp_parse_cpms_test_response (const gchar *reply,
         return FALSE;
     }
 
-    r = g_regex_new ("\\s*\"([^,\\)]+)\"\\s*", 0, 0, NULL);
+    r = mm_static_regex_get (&cpms_test_regex);
     g_assert (r);
 
     for (i = 0; i < N_EXPECTED_GROUPS; i++) {
@@ -2613,11 +2724,13 @@ mm_3gpp_parse_cpms_query_response (const gchar *reply,
                                    MMSmsStorage *memw,
                                    GError **error)
 {
+    static MMStaticRegex cpms_query_regex =
+        MM_STATIC_REGEX_INIT (CPMS_QUERY_REGEX, G_REGEX_RAW);
     GRegex *r = NULL;
     gboolean ret = FALSE;
     GMatchInfo *match_info = NULL;
 
-    r = g_regex_new (CPMS_QUERY_REGEX, G_REGEX_RAW, 0, NULL);
+    r = mm_static_regex_get (&cpms_query_regex);
 
     g_assert (r);
 
@@ -2682,6 +2795,8 @@ gboolean
 mm_3gpp_parse_cscs_test_response (const gchar *reply,
                                   MMModemCharset *out_charsets)
 {
+    static MMStaticRegex cscs_test_regex =
+        MM_STATIC_REGEX_INIT ("\\s*([^,\\)]+)\\s*", 0);
     MMModemCharset charsets = MM_MODEM_CHARSET_UNKNOWN;
     GRegex *r;
     GMatchInfo *match_info;
@@ -2707,9 +2822,7 @@ mm_3gpp_parse_cscs_test_response (const gchar *reply,
     }
 
     /* Now parse each charset */
-    r = g_regex_new ("\\s*([^,\\)]+)\\s*", 0, 0, NULL);
-    if (!r)
-        return FALSE;
+    r = mm_static_regex_get (&cscs_test_regex);
 
     if (g_regex_match_full (r, p, strlen (p), 0, 0, &match_info, NULL)) {
         while (g_match_info_matches (match_info)) {
@@ -2736,6 +2849,8 @@ gboolean
 mm_3gpp_parse_clck_test_response (const gchar *reply,
                                   MMModem3gppFacility *out_facilities)
 {
+    static MMStaticRegex clck_test_regex =
+        MM_STATIC_REGEX_INIT ("\\s*\"([^,\\)]+)\"\\s*", 0);
     GRegex *r;
     GMatchInfo *match_info;
 
@@ -2749,7 +2864,7 @@ mm_3gpp_parse_clck_test_response (const gchar *reply,
     reply = mm_strip_tag (reply, "+CLCK:");
 
     /* Now parse each facility */
-    r = g_regex_new ("\\s*\"([^,\\)]+)\"\\s*", 0, 0, NULL);
+    r = mm_static_regex_get (&clck_test_regex);
     g_assert (r != NULL);
 
     *out_facilities = MM_MODEM_3GPP_FACILITY_NONE;
@@ -2778,6 +2893,8 @@ gboolean
 mm_3gpp_parse_clck_write_response (const gchar *reply,
                                    gboolean *enabled)
 {
+    static MMStaticRegex clck_write_regex =
+        MM_STATIC_REGEX_INIT ("\\s*([01])\\s*", 0);
     GRegex *r;
     GMatchInfo *match_info;
     gboolean success = FALSE;
@@ -2787,7 +2904,7 @@ mm_3gpp_parse_clck_write_response (const gchar *reply,
 
     reply = mm_strip_tag (reply, "+CLCK:");
 
-    r = g_regex_new ("\\s*([01])\\s*", 0, 0, NULL);
+    r = mm_static_regex_get (&clck_write_regex);
     g_assert (r != NULL);
 
     if (g_regex_match (r, reply, 0, &match_info)) {
@@ -2819,6 +2936,8 @@ mm_3gpp_parse_clck_write_response (const gchar *reply,
 GStrv
 mm_3gpp_parse_cnum_exec_response (const gchar *reply)
 {
+    static MMStaticRegex cnum_exec_regex =
+        MM_STATIC_REGEX_INIT ("\\+CNUM:\\s*((\"([^\"]|(\\\"))*\")|([^,]*)),\"(?<num>\\S+)\",\\d", G_REGEX_UNGREEDY);
     GArray *array = NULL;
     GRegex *r;
     GMatchInfo *match_info;
@@ -2827,8 +2946,7 @@ mm_3gpp_parse_cnum_exec_response (const gchar *reply)
     if (!reply || !reply[0])
         return NULL;
 
-    r = g_regex_new ("\\+CNUM:\\s*((\"([^\"]|(\\\"))*\")|([^,]*)),\"(?<num>\\S+)\",\\d",
-                     G_REGEX_UNGREEDY, 0, NULL);
+    r = mm_static_regex_get (&cnum_exec_regex);
     g_assert (r != NULL);
 
     g_regex_match (r, reply, 0, &match_info);
@@ -3048,6 +3166,8 @@ GHashTable *
 mm_3gpp_parse_cind_test_response (const gchar *reply,
                                   GError **error)
 {
+    static MMStaticRegex cind_test_regex =
+        MM_STATIC_REGEX_INIT ("\\(([^,]*),\\((\\d+)[-,](\\d+).*\\)", G_REGEX_UNGREEDY);
     GHashTable *hash;
     GRegex *r;
     GMatchInfo *match_info;
@@ -3061,13 +3181,7 @@ mm_3gpp_parse_cind_test_response (const gchar *reply,
     while (isspace (*reply))
         reply++;
 
-    r = g_regex_new ("\\(([^,]*),\\((\\d+)[-,](\\d+).*\\)", G_REGEX_UNGREEDY, 0, NULL);
-    if (!r) {
-        g_set_error_literal (error,
-                             MM_CORE_ERROR, MM_CORE_ERROR_FAILED,
-                             "Could not parse scan results.");
-        return NULL;
-    }
+    r = mm_static_regex_get (&cind_test_regex);
 
     hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) cind_response_free);
 
@@ -3108,6 +3222,8 @@ GByteArray *
 mm_3gpp_parse_cind_read_response (const gchar *reply,
                                   GError **error)
 {
+    static MMStaticRegex cind_read_regex =
+        MM_STATIC_REGEX_INIT ("(\\d+)[^0-9]+", G_REGEX_UNGREEDY);
     GByteArray *array = NULL;
     GRegex *r = NULL;
     GMatchInfo *match_info;
@@ -3125,7 +3241,7 @@ mm_3gpp_parse_cind_read_response (const gchar *reply,
 
     reply = mm_strip_tag (reply, CIND_TAG);
 
-    r = g_regex_new ("(\\d+)[^0-9]+", G_REGEX_UNGREEDY, 0, NULL);
+    r = mm_static_regex_get (&cind_read_regex);
     g_assert (r != NULL);
 
     if (!g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, NULL)) {
@@ -3190,10 +3306,60 @@ mm_3gpp_pdu_info_list_free (GList *info_list)
     g_list_free_full (info_list, (GDestroyNotify)mm_3gpp_pdu_info_free);
 }
 
+GRegex *
+mm_3gpp_pdu_cmgl_entry_regex_get (void)
+{
+    /* Same fields as in mm_3gpp_parse_pdu_cmgl_response(), but only matching
+     * entries whose PDU line is already complete, without consuming the
+     * <CR><LF> after it, which starts the next entry. */
+    return g_regex_new ("\\r\\n\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,([^\\r\\n]*)\\r\\n([^\\r\\n]*)(?=\\r\\n)",
+                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                        0,
+                        NULL);
+}
+
+GRegex *
+mm_3gpp_text_cmgl_entry_regex_get (void)
+{
+    /* As with PDU entries, only those whose data line is already complete */
+    return g_regex_new ("\\r\\n" MM_3GPP_TEXT_CMGL_ENTRY "(?=\\r\\n)",
+                        G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                        0,
+                        NULL);
+}
+
+MM3gppPduInfo *
+mm_3gpp_parse_pdu_cmgl_entry (GMatchInfo *match_info,
+                              GError **error)
+{
+    MM3gppPduInfo *info;
+
+    info = g_new0 (MM3gppPduInfo, 1);
+    if (!mm_get_int_from_match_info (match_info, 1, &info->index) ||
+        !mm_get_int_from_match_info (match_info, 2, &info->status) ||
+        !(info->pdu = mm_get_string_unquoted_from_match_info (match_info, 4))) {
+        gchar *str;
+
+        str = g_match_info_fetch (match_info, 0);
+        g_set_error (error,
+                     MM_CORE_ERROR,
+                     MM_CORE_ERROR_FAILED,
+                     "Error parsing +CMGL entry: '%s'",
+                     str);
+        g_free (str);
+        mm_3gpp_pdu_info_free (info);
+        return NULL;
+    }
+
+    return info;
+}
+
 GList *
 mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
                                  GError **error)
 {
+    static MMStaticRegex pdu_cmgl_regex =
+        MM_STATIC_REGEX_INIT ("\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,(.*)\\r\\n([^\\r\\n]*)(\\r\\n)?", G_REGEX_RAW);
     GError *inner_error = NULL;
     GList *list = NULL;
     GMatchInfo *match_info;
@@ -3206,20 +3372,17 @@ mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
      *
      * We just read <index>, <stat> and the PDU itself.
      */
-    r = g_regex_new ("\\+CMGL:\\s*(\\d+)\\s*,\\s*(\\d+)\\s*,(.*)\\r\\n([^\\r\\n]*)(\\r\\n)?",
-                     G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    r = mm_static_regex_get (&pdu_cmgl_regex);
     g_assert (r != NULL);
 
     g_regex_match_full (r, str, strlen (str), 0, 0, &match_info, &inner_error);
     while (!inner_error && g_match_info_matches (match_info)) {
         MM3gppPduInfo *info;
 
-        info = g_new0 (MM3gppPduInfo, 1);
-        if (mm_get_int_from_match_info (match_info, 1, &info->index) &&
-            mm_get_int_from_match_info (match_info, 2, &info->status) &&
-            (info->pdu = mm_get_string_unquoted_from_match_info (match_info, 4)) != NULL) {
-            /* Append to our list of results and keep on */
-            list = g_list_append (list, info);
+        info = mm_3gpp_parse_pdu_cmgl_entry (match_info, NULL);
+        if (info) {
+            /* Add to our list of results and keep on */
+            list = g_list_prepend (list, info);
             g_match_info_next (match_info, &inner_error);
         } else {
             inner_error = g_error_new (MM_CORE_ERROR,
@@ -3238,7 +3401,7 @@ mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
         return NULL;
     }
 
-    return list;
+    return g_list_reverse (list);
 }
 
 /*************************************************************************/
@@ -3863,6 +4026,8 @@ mm_cdma_parse_crm_test_response (const gchar *reply,
                                  MMModemCdmaRmProtocol *max,
                                  GError **error)
 {
+    static MMStaticRegex crm_test_regex =
+        MM_STATIC_REGEX_INIT ("\\+CRM:\\s*\\((\\d+)-(\\d+)\\)", G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW);
     gboolean result = FALSE;
     GRegex *r;
     GMatchInfo *match_info = NULL;
@@ -3873,9 +4038,7 @@ mm_cdma_parse_crm_test_response (const gchar *reply,
      *   <--- +CRM: (0-2)
      */
 
-    r = g_regex_new ("\\+CRM:\\s*\\((\\d+)-(\\d+)\\)",
-                     G_REGEX_DOLLAR_ENDONLY | G_REGEX_RAW,
-                     0, error);
+    r = mm_static_regex_get (&crm_test_regex);
     g_assert (r != NULL);
 
     if (g_regex_match_full (r, reply, strlen (reply), 0, 0, &match_info, &match_error)) {
@@ -4148,6 +4311,8 @@ mm_parse_cclk_response (const char *response,
                         MMNetworkTimezone **tzp,
                         GError **error)
 {
+    static MMStaticRegex cclk_regex =
+        MM_STATIC_REGEX_INIT ("[+]CCLK: \"(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d+)([-+]\\d+)?\"", 0);
     GRegex *r;
     GMatchInfo *match_info = NULL;
     GError *match_error = NULL;
@@ -4158,7 +4323,7 @@ mm_parse_cclk_response (const char *response,
     g_assert (iso8601p || tzp); /* at least one */
 
     /* Sample reply: +CCLK: "15/03/05,14:14:26-32" */
-    r = g_regex_new ("[+]CCLK: \"(\\d+)/(\\d+)/(\\d+),(\\d+):(\\d+):(\\d+)([-+]\\d+)?\"", 0, 0, NULL);
+    r = mm_static_regex_get (&cclk_regex);
     g_assert (r != NULL);
 
     if (!g_regex_match_full (r, response, -1, 0, 0, &match_info, &match_error)) {
@@ -47,12 +47,34 @@
     (MM_MODEM_CAPABILITY_GSM_UMTS |     \
      MM_MODEM_CAPABILITY_3GPP_LTE)
 
+/* Regular expression compiled on first use and kept for the whole lifetime of
+ * the process, so that parsers don't compile it again on every call, e.g.:
+ *
+ *   static MMStaticRegex cfun_regex = MM_STATIC_REGEX_INIT ("\\+CFUN: (\\d+)", 0);
+ *   GRegex *r = mm_static_regex_get (&cfun_regex);
+ *
+ * mm_static_regex_get() is thread-safe and returns a new reference, to be
+ * released with g_regex_unref(). */
+typedef struct {
+    const gchar        *pattern;
+    GRegexCompileFlags  compile_options;
+    volatile gsize      regex;
+} MMStaticRegex;
+
+#define MM_STATIC_REGEX_INIT(pattern, compile_options) { (pattern), (compile_options), 0 }
+
+GRegex *mm_static_regex_get (MMStaticRegex *self);
+
 gchar       *mm_strip_quotes (gchar *str);
 const gchar *mm_strip_tag    (const gchar *str,
                               const gchar *cmd);
 
 gchar **mm_split_string_groups (const gchar *str);
 
+gchar **mm_split_concatenated_response (const gchar  *response,
+                                        const gchar **commands,
+                                        guint         n_commands);
+
 GArray *mm_parse_uint_list (const gchar  *str,
                             GError      **error);
 
@@ -276,6 +298,18 @@ void   mm_3gpp_pdu_info_list_free      (GList *info_list);
 GList *mm_3gpp_parse_pdu_cmgl_response (const gchar *str,
                                         GError **error);
 
+/* AT+CMGL=4 entries, matched one by one while the response arrives */
+GRegex        *mm_3gpp_pdu_cmgl_entry_regex_get (void);
+MM3gppPduInfo *mm_3gpp_parse_pdu_cmgl_entry     (GMatchInfo *match_info,
+                                                 GError **error);
+
+/* AT+CMGL="ALL" entries in text mode:
+ * +CMGL: <index>,<stat>,<oa/da>,[alpha],<scts><CR><LF><data><CR><LF> */
+#define MM_3GPP_TEXT_CMGL_ENTRY "\\+CMGL:\\s*(\\d+)\\s*,\\s*([^,]*),\\s*([^,]*),\\s*([^,]*),\\s*([^\\r\\n]*)\\r\\n([^\\r\\n]*)"
+
+/* Same, matched one by one while the response arrives */
+GRegex        *mm_3gpp_text_cmgl_entry_regex_get (void);
+
 /* AT+CMGR (Read message) response parser */
 MM3gppPduInfo *mm_3gpp_parse_cmgr_read_response (const gchar *reply,
                                                  guint index,
@@ -0,0 +1,251 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <string.h>
+
+#include "mm-plugin-filter-index.h"
+
+/* Sets of entries are stored as bitmasks, one bit per entry */
+#define BITSET_WORD(i) ((i) / 64)
+#define BITSET_BIT(i)  (G_GUINT64_CONSTANT (1) << ((i) % 64))
+
+struct _MMPluginFilterIndex {
+    guint     max_entries;
+    guint     n_words;
+    guint     n_entries;
+    gpointer *data;
+
+    /* Entries without the given filter, which always pass it */
+    guint64 *no_subsystem_filter;
+    guint64 *no_driver_filter;
+    guint64 *no_ids_filter;
+    guint64 *no_udev_tag_filter;
+
+    /* Filter value to set of entries accepting it */
+    GHashTable *subsystems;
+    GHashTable *drivers;
+    GHashTable *vendor_ids;
+    GHashTable *product_ids;
+    GHashTable *udev_tags;
+};
+
+/*****************************************************************************/
+
+static guint64 *
+bitset_lookup_or_add (MMPluginFilterIndex *self,
+                      GHashTable          *table,
+                      gpointer             key,
+                      gboolean             string_key)
+{
+    guint64 *bitset;
+
+    bitset = g_hash_table_lookup (table, key);
+    if (!bitset) {
+        bitset = g_new0 (guint64, self->n_words);
+        g_hash_table_insert (table, string_key ? g_strdup (key) : key, bitset);
+    }
+    return bitset;
+}
+
+static void
+bitset_or (MMPluginFilterIndex *self,
+           guint64             *bitset,
+           const guint64       *other)
+{
+    guint i;
+
+    if (!other)
+        return;
+    for (i = 0; i < self->n_words; i++)
+        bitset[i] |= other[i];
+}
+
+static gboolean
+bitset_intersects (MMPluginFilterIndex *self,
+                   const guint64       *bitset,
+                   const guint64       *other)
+{
+    guint i;
+
+    for (i = 0; i < self->n_words; i++) {
+        if (bitset[i] & other[i])
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#define VENDOR_PRODUCT_KEY(vendor, product) \
+    GUINT_TO_POINTER (((guint)(vendor) << 16) | (guint)(product))
+
+/*****************************************************************************/
+
+void
+mm_plugin_filter_index_add (MMPluginFilterIndex            *self,
+                            gpointer                        data,
+                            const MMPluginFilterIndexEntry *entry)
+{
+    guint    n;
+    guint    word;
+    guint64  bit;
+    guint    i;
+
+    g_return_if_fail (self->n_entries < self->max_entries);
+
+    n = self->n_entries++;
+    self->data[n] = data;
+    word = BITSET_WORD (n);
+    bit = BITSET_BIT (n);
+
+    if (entry->subsystems) {
+        for (i = 0; entry->subsystems[i]; i++) {
+            bitset_lookup_or_add (self, self->subsystems, (gpointer) entry->subsystems[i], TRUE)[word] |= bit;
+            /* New kernels may report as 'usbmisc' the subsystem */
+            if (g_str_equal (entry->subsystems[i], "usb"))
+                bitset_lookup_or_add (self, self->subsystems, (gpointer) "usbmisc", TRUE)[word] |= bit;
+        }
+    } else
+        self->no_subsystem_filter[word] |= bit;
+
+    if (entry->drivers) {
+        for (i = 0; entry->drivers[i]; i++)
+            bitset_lookup_or_add (self, self->drivers, (gpointer) entry->drivers[i], TRUE)[word] |= bit;
+    } else
+        self->no_driver_filter[word] |= bit;
+
+    if ((entry->vendor_ids || entry->product_ids) && !entry->ids_fallback) {
+        if (entry->vendor_ids) {
+            for (i = 0; entry->vendor_ids[i]; i++)
+                bitset_lookup_or_add (self, self->vendor_ids, GUINT_TO_POINTER (entry->vendor_ids[i]), FALSE)[word] |= bit;
+        }
+        if (entry->product_ids) {
+            for (i = 0; entry->product_ids[i].l; i++)
+                bitset_lookup_or_add (self,
+                                      self->product_ids,
+                                      VENDOR_PRODUCT_KEY (entry->product_ids[i].l, entry->product_ids[i].r),
+                                      FALSE)[word] |= bit;
+        }
+    } else
+        self->no_ids_filter[word] |= bit;
+
+    if (entry->udev_tags) {
+        for (i = 0; entry->udev_tags[i]; i++)
+            bitset_lookup_or_add (self, self->udev_tags, (gpointer) entry->udev_tags[i], TRUE)[word] |= bit;
+    } else
+        self->no_udev_tag_filter[word] |= bit;
+}
+
+GList *
+mm_plugin_filter_index_lookup (MMPluginFilterIndex         *self,
+                               const gchar                 *subsystem,
+                               const gchar * const         *drivers,
+                               guint16                      vendor,
+                               guint16                      product,
+                               MMPluginFilterIndexTagFunc   has_tag,
+                               gpointer                     user_data)
+{
+    guint64 *candidates;
+    guint64 *accepted;
+    GList   *list = NULL;
+    guint    i;
+
+    candidates = g_new (guint64, self->n_words);
+    accepted = g_new (guint64, self->n_words);
+
+    /* Subsystem */
+    memcpy (candidates, self->no_subsystem_filter, self->n_words * sizeof (guint64));
+    bitset_or (self, candidates, g_hash_table_lookup (self->subsystems, subsystem));
+
+    /* Drivers; any of the device drivers may be the one expected */
+    memcpy (accepted, self->no_driver_filter, self->n_words * sizeof (guint64));
+    for (i = 0; drivers && drivers[i]; i++)
+        bitset_or (self, accepted, g_hash_table_lookup (self->drivers, drivers[i]));
+    for (i = 0; i < self->n_words; i++)
+        candidates[i] &= accepted[i];
+
+    /* Vendor and product IDs; a plugin with both accepts the port if any of
+     * them matches */
+    memcpy (accepted, self->no_ids_filter, self->n_words * sizeof (guint64));
+    if (vendor) {
+        bitset_or (self, accepted, g_hash_table_lookup (self->vendor_ids, GUINT_TO_POINTER (vendor)));
+        if (product)
+            bitset_or (self, accepted, g_hash_table_lookup (self->product_ids, VENDOR_PRODUCT_KEY (vendor, product)));
+    }
+    for (i = 0; i < self->n_words; i++)
+        candidates[i] &= accepted[i];
+
+    /* Udev tags; only check the ones which may still make a difference, as
+     * checking a tag requires a property lookup in the port */
+    memcpy (accepted, self->no_udev_tag_filter, self->n_words * sizeof (guint64));
+    if (has_tag) {
+        GHashTableIter  iter;
+        gpointer        tag;
+        gpointer        bitset;
+
+        g_hash_table_iter_init (&iter, self->udev_tags);
+        while (g_hash_table_iter_next (&iter, &tag, &bitset)) {
+            if (bitset_intersects (self, candidates, bitset) && has_tag ((const gchar *) tag, user_data))
+                bitset_or (self, accepted, bitset);
+        }
+    }
+    for (i = 0; i < self->n_words; i++)
+        candidates[i] &= accepted[i];
+
+    /* Build the list in the same order as entries were added */
+    for (i = self->n_entries; i > 0; i--) {
+        if (candidates[BITSET_WORD (i - 1)] & BITSET_BIT (i - 1))
+            list = g_list_prepend (list, self->data[i - 1]);
+    }
+
+    g_free (candidates);
+    g_free (accepted);
+    return list;
+}
+
+/*****************************************************************************/
+
+MMPluginFilterIndex *
+mm_plugin_filter_index_new (guint max_entries)
+{
+    MMPluginFilterIndex *self;
+
+    self = g_slice_new0 (MMPluginFilterIndex);
+    self->max_entries = max_entries;
+    self->n_words = MAX (1, (max_entries + 63) / 64);
+    self->data = g_new0 (gpointer, max_entries);
+    self->no_subsystem_filter = g_new0 (guint64, self->n_words);
+    self->no_driver_filter = g_new0 (guint64, self->n_words);
+    self->no_ids_filter = g_new0 (guint64, self->n_words);
+    self->no_udev_tag_filter = g_new0 (guint64, self->n_words);
+    self->subsystems = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    self->drivers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    self->vendor_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    self->product_ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    self->udev_tags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    return self;
+}
+
+void
+mm_plugin_filter_index_free (MMPluginFilterIndex *self)
+{
+    g_hash_table_unref (self->subsystems);
+    g_hash_table_unref (self->drivers);
+    g_hash_table_unref (self->vendor_ids);
+    g_hash_table_unref (self->product_ids);
+    g_hash_table_unref (self->udev_tags);
+    g_free (self->no_subsystem_filter);
+    g_free (self->no_driver_filter);
+    g_free (self->no_ids_filter);
+    g_free (self->no_udev_tag_filter);
+    g_free (self->data);
+    g_slice_free (MMPluginFilterIndex, self);
+}
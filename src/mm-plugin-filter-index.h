@@ -0,0 +1,63 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PLUGIN_FILTER_INDEX_H
+#define MM_PLUGIN_FILTER_INDEX_H
+
+#include <glib.h>
+
+#include "mm-private-boxed-types.h"
+
+/* Index of the pre-probing filters of all plugins.
+ *
+ * Each plugin is added once with its subsystem, driver, vendor/product ID
+ * and udev tag filters, and the index then gives the plugins which may
+ * support a port with a few hash table lookups, instead of running the
+ * filters of every plugin one by one. The result is a superset: the
+ * remaining filters (forbidden drivers, vendor/product strings...) must
+ * still be applied on each candidate. */
+
+typedef struct _MMPluginFilterIndex MMPluginFilterIndex;
+
+typedef struct {
+    /* All arrays are NULL-terminated, or NULL if no filter given */
+    const gchar          **subsystems;
+    const gchar          **drivers;
+    const guint16         *vendor_ids;
+    const mm_uint16_pair  *product_ids;
+    const gchar          **udev_tags;
+    /* Whether a port not matching the vendor or product IDs may still be
+     * supported (e.g. after probing vendor strings) */
+    gboolean               ids_fallback;
+} MMPluginFilterIndexEntry;
+
+/* Returns TRUE if the port being looked up has the given udev tag */
+typedef gboolean (* MMPluginFilterIndexTagFunc) (const gchar *tag,
+                                                 gpointer     user_data);
+
+MMPluginFilterIndex *mm_plugin_filter_index_new  (guint                           max_entries);
+void                 mm_plugin_filter_index_free (MMPluginFilterIndex            *self);
+void                 mm_plugin_filter_index_add  (MMPluginFilterIndex            *self,
+                                                  gpointer                        data,
+                                                  const MMPluginFilterIndexEntry *entry);
+
+/* Returns the data of the candidate entries, in the order they were added */
+GList *mm_plugin_filter_index_lookup (MMPluginFilterIndex         *self,
+                                      const gchar                 *subsystem,
+                                      const gchar * const         *drivers,
+                                      guint16                      vendor,
+                                      guint16                      product,
+                                      MMPluginFilterIndexTagFunc   has_tag,
+                                      gpointer                     user_data);
+
+#endif /* MM_PLUGIN_FILTER_INDEX_H */
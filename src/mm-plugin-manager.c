@@ -27,6 +27,9 @@
 
 #include "mm-plugin-manager.h"
 #include "mm-plugin.h"
+#include "mm-port-probe-cache.h"
+#include "mm-expected-ports.h"
+#include "mm-probe-trace.h"
 #include "mm-log.h"
 
 static void initable_iface_init (GInitableIface *iface);
@@ -38,6 +41,7 @@ G_DEFINE_TYPE_EXTENDED (MMPluginManager, mm_plugin_manager, G_TYPE_OBJECT, 0,
 enum {
     PROP_0,
     PROP_PLUGIN_DIR,
+    PROP_MAX_PROBES,
     LAST_PROP
 };
 
@@ -51,9 +55,22 @@ struct _MMPluginManagerPrivate {
     GList *plugins;
     /* Last, the generic plugin. */
     MMPlugin *generic;
+    /* Index of the pre-probing filters of all plugins except for the generic
+     * one, built once all plugins are loaded */
+    MMPluginFilterIndex *filter_index;
 
     /* List of ongoing device support checks */
     GList *device_contexts;
+
+    /* Maximum number of port probes allowed to run at the same time, or 0 if
+     * unlimited */
+    guint max_probes;
+    /* Number of port probes currently running */
+    guint n_running_probes;
+    /* Buses with port probes waiting to be run, in round-robin order */
+    GList *probe_buses;
+    /* Scheduled dispatching of waiting port probes */
+    guint probe_dispatch_id;
 };
 
 /*****************************************************************************/
@@ -62,16 +79,23 @@ struct _MMPluginManagerPrivate {
 static GList *
 plugin_manager_build_plugins_list (MMPluginManager *self,
                                    MMDevice        *device,
-                                   MMKernelDevice  *port)
+                                   MMKernelDevice  *port,
+                                   MMPortProbeFlag *out_shared_probe_flags)
 {
     GList *list = NULL;
+    GList *candidates;
     GList *l;
     gboolean supported_found = FALSE;
+    MMPortProbeFlag shared_probe_flags = MM_PORT_PROBE_NONE;
+
+    /* Only the plugins passing the indexed filters need a full check */
+    candidates = mm_plugin_list_candidates (self->priv->filter_index, device, port);
 
-    for (l = self->priv->plugins; l && !supported_found; l = g_list_next (l)) {
+    for (l = candidates; l && !supported_found; l = g_list_next (l)) {
         MMPluginSupportsHint hint;
+        MMPortProbeFlag plugin_probe_flags;
 
-        hint = mm_plugin_discard_port_early (MM_PLUGIN (l->data), device, port);
+        hint = mm_plugin_discard_port_early (MM_PLUGIN (l->data), device, port, &plugin_probe_flags);
         switch (hint) {
         case MM_PLUGIN_SUPPORTS_HINT_UNSUPPORTED:
             /* Fully discard */
@@ -79,10 +103,12 @@ plugin_manager_build_plugins_list (MMPluginManager *self,
         case MM_PLUGIN_SUPPORTS_HINT_MAYBE:
             /* Maybe supported, add to tail of list */
             list = g_list_append (list, g_object_ref (l->data));
+            shared_probe_flags |= plugin_probe_flags;
             break;
         case MM_PLUGIN_SUPPORTS_HINT_LIKELY:
             /* Likely supported, add to head of list */
             list = g_list_prepend (list, g_object_ref (l->data));
+            shared_probe_flags |= plugin_probe_flags;
             break;
         case MM_PLUGIN_SUPPORTS_HINT_SUPPORTED:
             /* Really supported, clean existing list and add it alone */
@@ -91,6 +117,7 @@ plugin_manager_build_plugins_list (MMPluginManager *self,
                 list = NULL;
             }
             list = g_list_prepend (list, g_object_ref (l->data));
+            shared_probe_flags = plugin_probe_flags;
             /* This will end the loop as well */
             supported_found = TRUE;
             break;
@@ -99,10 +126,16 @@ plugin_manager_build_plugins_list (MMPluginManager *self,
         }
     }
 
+    g_list_free (candidates);
+
     /* Add the generic plugin at the end of the list */
     if (self->priv->generic)
         list = g_list_append (list, g_object_ref (self->priv->generic));
 
+    /* Union of the probings which the candidate plugins need, so that they can
+     * all be run in a single AT probing session */
+    *out_shared_probe_flags = shared_probe_flags;
+
     return list;
 }
 
@@ -177,10 +210,16 @@ struct _PortContext {
     volatile gint ref_count;
     /* The name of the context */
     gchar *name;
+    /* The plugin manager; not a full reference, as queued contexts are owned
+     * by the manager itself. Port contexts are only run within a device
+     * context, which keeps a full reference on the manager. */
+    MMPluginManager *self;
     /* The device where the port is*/
     MMDevice *device;
     /* The reported kernel port object */
     MMKernelDevice *port;
+    /* The bus where the port is, for the probe scheduler */
+    gchar *bus;
 
     /* The operation task */
     GTask *task;
@@ -201,12 +240,25 @@ struct _PortContext {
     MMPlugin *best_plugin;
     /* A plugin was suggested for this port. */
     MMPlugin *suggested_plugin;
+    /* Probings needed by any of the plugins, to be run in the first AT
+     * probing session on the port */
+    MMPortProbeFlag shared_probe_flags;
 
     /* The probe has been deferred */
     guint defer_id;
     /* The probe must be deferred until a result is suggested by other
      * port probe results (e.g. for WWAN ports). */
     gboolean defer_until_suggested;
+
+    /* The probe is waiting in the probe scheduler */
+    gboolean probe_queued;
+    /* The probe holds one of the running slots of the probe scheduler */
+    gboolean probe_running;
+
+    /* Start times of the ongoing stages, for the probing trace */
+    gint64 trace_run_start;
+    gint64 trace_queue_start;
+    gint64 trace_plugin_start;
 };
 
 static void
@@ -219,6 +271,10 @@ port_context_unref (PortContext *port_context)
         /* The port support check task must have been completed previously */
         g_assert (!port_context->task);
 
+        /* The probe scheduler must not know about the port any more */
+        g_assert (!port_context->probe_queued);
+        g_assert (!port_context->probe_running);
+
         if (port_context->best_plugin)
             g_object_unref (port_context->best_plugin);
         if (port_context->suggested_plugin)
@@ -228,6 +284,7 @@ port_context_unref (PortContext *port_context)
         if (port_context->cancellable)
             g_object_unref (port_context->cancellable);
         g_free (port_context->name);
+        g_free (port_context->bus);
         g_timer_destroy (port_context->timer);
         g_object_unref (port_context->port);
         g_object_unref (port_context->device);
@@ -242,6 +299,223 @@ port_context_ref (PortContext *port_context)
     return port_context;
 }
 
+/*****************************************************************************/
+/* Probe scheduler
+ *
+ * Port probes of all devices are run through a global scheduler, which limits
+ * how many of them may run at the same time, so that the startup with lots of
+ * modems doesn't end up thrashing the USB buses and the CPU.
+ *
+ * Probes of ports for which the plugin is already known (either from other
+ * ports of the same device or from the probing cache) are run first, as they
+ * are expected to be the shortest ones. Within each priority level, buses
+ * are served in round-robin order, so that a single bus full of modems cannot
+ * delay the ones in other buses.
+ *
+ * A probe holds its running slot until it's completed, except while it waits
+ * for a result suggested by other ports of the same device, as those may
+ * need the slot themselves.
+ */
+
+typedef struct {
+    gchar  *name;
+    GQueue *priority;
+    GQueue *normal;
+} ProbeBus;
+
+static void port_context_next (PortContext *port_context);
+
+static gchar *
+probe_scheduler_build_bus_name (MMKernelDevice *port)
+{
+    const gchar *sysfs_path;
+    const gchar *physdev_uid;
+    const gchar *p;
+
+    /* Ports in the same USB bus share its bandwidth, so identify the bus by
+     * its root hub, e.g. 'usb1' in '/sys/devices/pci0000:00/0000:00:14.0/usb1/1-2/...' */
+    sysfs_path = mm_kernel_device_get_sysfs_path (port);
+    for (p = (sysfs_path ? strstr (sysfs_path, "/usb") : NULL); p; p = strstr (p + 1, "/usb")) {
+        const gchar *end;
+
+        end = p + 4;
+        while (g_ascii_isdigit (*end))
+            end++;
+        if (end > p + 4 && (*end == '/' || *end == '\0'))
+            return g_strndup (p + 1, end - p - 1);
+    }
+
+    /* Otherwise, consider each device in its own bus */
+    physdev_uid = mm_kernel_device_get_physdev_uid (port);
+    return g_strdup (physdev_uid ? physdev_uid : mm_kernel_device_get_name (port));
+}
+
+static void
+probe_bus_free (ProbeBus *bus)
+{
+    g_queue_free_full (bus->priority, (GDestroyNotify) port_context_unref);
+    g_queue_free_full (bus->normal, (GDestroyNotify) port_context_unref);
+    g_free (bus->name);
+    g_slice_free (ProbeBus, bus);
+}
+
+static PortContext *
+probe_scheduler_pop (MMPluginManager *self)
+{
+    GList *l;
+    guint  i;
+
+    for (i = 0; i < 2; i++) {
+        for (l = self->priv->probe_buses; l; l = g_list_next (l)) {
+            ProbeBus    *bus;
+            PortContext *port_context;
+
+            bus = (ProbeBus *)(l->data);
+            port_context = g_queue_pop_head (i == 0 ? bus->priority : bus->normal);
+            if (!port_context)
+                continue;
+
+            /* Move the bus to the end of the list, or remove it if it doesn't
+             * have more probes waiting */
+            self->priv->probe_buses = g_list_delete_link (self->priv->probe_buses, l);
+            if (g_queue_is_empty (bus->priority) && g_queue_is_empty (bus->normal))
+                probe_bus_free (bus);
+            else
+                self->priv->probe_buses = g_list_append (self->priv->probe_buses, bus);
+            return port_context;
+        }
+    }
+
+    return NULL;
+}
+
+static gboolean
+probe_scheduler_dispatch (MMPluginManager *self)
+{
+    self->priv->probe_dispatch_id = 0;
+
+    while (!self->priv->max_probes || self->priv->n_running_probes < self->priv->max_probes) {
+        PortContext *port_context;
+
+        port_context = probe_scheduler_pop (self);
+        if (!port_context)
+            break;
+
+        port_context->probe_queued = FALSE;
+        port_context->probe_running = TRUE;
+        self->priv->n_running_probes++;
+        mm_probe_trace_add (mm_device_get_uid (port_context->device),
+                            mm_kernel_device_get_name (port_context->port),
+                            "waiting for probing slot",
+                            port_context->trace_queue_start,
+                            port_context->bus);
+        mm_dbg ("[plugin manager] task %s: probing started (%u running)",
+                port_context->name, self->priv->n_running_probes);
+
+        /* The reference we got from the queue keeps the context valid even
+         * if it gets completed right away */
+        port_context_next (port_context);
+        port_context_unref (port_context);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+probe_scheduler_schedule (MMPluginManager *self)
+{
+    if (!self->priv->probe_dispatch_id && self->priv->probe_buses)
+        self->priv->probe_dispatch_id = g_idle_add ((GSourceFunc) probe_scheduler_dispatch, self);
+}
+
+static void
+probe_scheduler_queue (PortContext *port_context,
+                       gboolean     priority)
+{
+    MMPluginManager *self;
+    ProbeBus        *bus = NULL;
+    GList           *l;
+
+    g_assert (!port_context->probe_queued);
+    g_assert (!port_context->probe_running);
+
+    self = port_context->self;
+    for (l = self->priv->probe_buses; l; l = g_list_next (l)) {
+        if (g_str_equal (((ProbeBus *)(l->data))->name, port_context->bus)) {
+            bus = (ProbeBus *)(l->data);
+            break;
+        }
+    }
+
+    if (!bus) {
+        bus = g_slice_new0 (ProbeBus);
+        bus->name = g_strdup (port_context->bus);
+        bus->priority = g_queue_new ();
+        bus->normal = g_queue_new ();
+        self->priv->probe_buses = g_list_append (self->priv->probe_buses, bus);
+    }
+
+    mm_dbg ("[plugin manager] task %s: waiting to be probed in bus %s%s",
+            port_context->name, bus->name, priority ? " (priority)" : "");
+    g_queue_push_tail (priority ? bus->priority : bus->normal, port_context_ref (port_context));
+    port_context->probe_queued = TRUE;
+    port_context->trace_queue_start = g_get_monotonic_time ();
+
+    probe_scheduler_schedule (self);
+}
+
+static void
+probe_scheduler_unqueue (PortContext *port_context)
+{
+    MMPluginManager *self;
+    GList           *l;
+
+    g_assert (port_context->probe_queued);
+
+    self = port_context->self;
+    for (l = self->priv->probe_buses; l; l = g_list_next (l)) {
+        ProbeBus *bus;
+
+        bus = (ProbeBus *)(l->data);
+        if (!g_queue_remove (bus->priority, port_context) &&
+            !g_queue_remove (bus->normal, port_context))
+            continue;
+
+        if (g_queue_is_empty (bus->priority) && g_queue_is_empty (bus->normal)) {
+            self->priv->probe_buses = g_list_delete_link (self->priv->probe_buses, l);
+            probe_bus_free (bus);
+        }
+        break;
+    }
+
+    port_context->probe_queued = FALSE;
+    mm_probe_trace_add (mm_device_get_uid (port_context->device),
+                        mm_kernel_device_get_name (port_context->port),
+                        "waiting for probing slot",
+                        port_context->trace_queue_start,
+                        "cancelled");
+    port_context_unref (port_context);
+}
+
+static void
+probe_scheduler_release (PortContext *port_context)
+{
+    MMPluginManager *self;
+
+    if (!port_context->probe_running)
+        return;
+
+    self = port_context->self;
+    g_assert (self->priv->n_running_probes > 0);
+    port_context->probe_running = FALSE;
+    self->priv->n_running_probes--;
+
+    probe_scheduler_schedule (self);
+}
+
+/*****************************************************************************/
+/* Port context (cont.) */
+
 static MMPlugin *
 port_context_run_finish (MMPluginManager  *self,
                          GAsyncResult     *res,
@@ -260,6 +534,15 @@ port_context_complete (PortContext *port_context)
     task = port_context->task;
     port_context->task = NULL;
 
+    /* Let other probes run */
+    probe_scheduler_release (port_context);
+
+    mm_probe_trace_add (mm_device_get_uid (port_context->device),
+                        mm_kernel_device_get_name (port_context->port),
+                        "port support check",
+                        port_context->trace_run_start,
+                        port_context->best_plugin ? mm_plugin_get_name (port_context->best_plugin) : "unsupported");
+
     /* Log about the time required to complete the checks */
     mm_dbg ("[plugin manager] task %s: finished in '%lf' seconds",
             port_context->name, g_timer_elapsed (port_context->timer, NULL));
@@ -271,8 +554,6 @@ port_context_complete (PortContext *port_context)
     g_object_unref (task);
 }
 
-static void port_context_next (PortContext *port_context);
-
 static void
 port_context_supported (PortContext *port_context,
                         MMPlugin    *plugin)
@@ -327,9 +608,9 @@ port_context_set_suggestion (PortContext *port_context,
             /* Advance to the suggested plugin and re-check support there */
             port_context->suggested_plugin = g_object_ref (suggested_plugin);
             port_context->current = g_list_find (port_context->current, port_context->suggested_plugin);
-            /* Schedule checking support */
+            /* Schedule checking support, the plugin is known so go first */
             g_assert (port_context->defer_id == 0);
-            port_context->defer_id = g_idle_add ((GSourceFunc) port_context_defer_ready, port_context);
+            probe_scheduler_queue (port_context, TRUE);
             return;
         }
 
@@ -452,6 +733,27 @@ port_context_defer_until_suggested (PortContext *port_context,
     mm_dbg ("[plugin manager] task %s: deferring support check until result suggested",
             port_context->name);
     port_context->defer_until_suggested = TRUE;
+
+    /* Other ports of the device may need the slot to suggest a result */
+    probe_scheduler_release (port_context);
+}
+
+static const gchar *
+plugin_supports_result_get_string (MMPluginSupportsResult result)
+{
+    switch (result) {
+    case MM_PLUGIN_SUPPORTS_PORT_UNKNOWN:
+        return "unknown";
+    case MM_PLUGIN_SUPPORTS_PORT_UNSUPPORTED:
+        return "unsupported";
+    case MM_PLUGIN_SUPPORTS_PORT_DEFER:
+        return "defer";
+    case MM_PLUGIN_SUPPORTS_PORT_DEFER_UNTIL_SUGGESTED:
+        return "defer until suggested";
+    case MM_PLUGIN_SUPPORTS_PORT_SUPPORTED:
+        return "supported";
+    }
+    return NULL;
 }
 
 static void
@@ -464,6 +766,17 @@ plugin_supports_port_ready (MMPlugin     *plugin,
 
     /* Get supports check results */
     support_result = mm_plugin_supports_port_finish (plugin, res, &error);
+    if (mm_probe_trace_is_enabled ()) {
+        gchar *name;
+
+        name = g_strdup_printf ("plugin %s", mm_plugin_get_name (plugin));
+        mm_probe_trace_add (mm_device_get_uid (port_context->device),
+                            mm_kernel_device_get_name (port_context->port),
+                            name,
+                            port_context->trace_plugin_start,
+                            plugin_supports_result_get_string (support_result));
+        g_free (name);
+    }
     if (error) {
         g_assert_cmpuint (support_result, ==, MM_PLUGIN_SUPPORTS_PORT_UNKNOWN);
         mm_warn ("[plugin manager] task %s: error when checking support with plugin '%s': '%s'",
@@ -517,9 +830,11 @@ port_context_next (PortContext *port_context)
     plugin = MM_PLUGIN (port_context->current->data);
     mm_dbg ("[plugin manager] task %s: checking with plugin '%s'",
             port_context->name, mm_plugin_get_name (plugin));
+    port_context->trace_plugin_start = g_get_monotonic_time ();
     mm_plugin_supports_port (plugin,
                              port_context->device,
                              port_context->port,
+                             port_context->shared_probe_flags,
                              port_context->cancellable,
                              (GAsyncReadyCallback) plugin_supports_port_ready,
                              port_context_ref (port_context));
@@ -543,6 +858,14 @@ port_context_cancel (PortContext *port_context)
     /* The port context is cancelled now */
     g_cancellable_cancel (port_context->cancellable);
 
+    /* If the task is waiting to be probed, we can cancel and complete it right
+     * away */
+    if (port_context->probe_queued) {
+        probe_scheduler_unqueue (port_context);
+        port_context_complete (port_context);
+        return TRUE;
+    }
+
     /* If the task was deferred, we can cancel and complete it right away */
     if (port_context->defer_id) {
         g_source_remove (port_context->defer_id);
@@ -566,6 +889,7 @@ static void
 port_context_run (MMPluginManager     *self,
                   PortContext         *port_context,
                   GList               *plugins,
+                  MMPortProbeFlag      shared_probe_flags,
                   MMPlugin            *suggested,
                   GAsyncReadyCallback  callback,
                   gpointer             user_data)
@@ -579,6 +903,8 @@ port_context_run (MMPluginManager     *self,
     /* Setup plugins to probe and first one to check. */
     port_context->plugins = g_list_copy_deep (plugins, (GCopyFunc) g_object_ref, NULL);
     port_context->current = port_context->plugins;
+    port_context->shared_probe_flags = shared_probe_flags;
+    port_context->trace_run_start = g_get_monotonic_time ();
 
     /* If we got one suggested, it will be the first one */
     if (suggested) {
@@ -634,8 +960,8 @@ port_context_run (MMPluginManager     *self,
 
     mm_dbg ("[plugin manager) task %s: started", port_context->name);
 
-    /* Go probe with the first plugin */
-    port_context_next (port_context);
+    /* Go probe with the first plugin once the scheduler allows it */
+    probe_scheduler_queue (port_context, !!suggested);
 }
 
 static PortContext *
@@ -648,8 +974,10 @@ port_context_new (MMPluginManager *self,
 
     port_context            = g_slice_new0 (PortContext);
     port_context->ref_count = 1;
+    port_context->self      = self;
     port_context->device    = g_object_ref (device);
     port_context->port      = g_object_ref (port);
+    port_context->bus       = probe_scheduler_build_bus_name (port);
     port_context->timer     = g_timer_new ();
 
     /* Set context name */
@@ -671,6 +999,13 @@ port_context_new (MMPluginManager *self,
 /* The wait time we define must always be less than the probing time */
 G_STATIC_ASSERT (MIN_WAIT_TIME_MSECS < MIN_PROBING_TIME_MSECS);
 
+/* Udev tag in the physical device giving how many ports it exposes, for
+ * devices with a fixed layout; none of the shipped rules set it. When the
+ * expected ports are known (either from this tag or from the ports found in
+ * a previous run), the min wait and probing times are cut short as soon as
+ * all are grabbed. */
+#define ID_MM_EXPECTED_PORTS "ID_MM_EXPECTED_PORTS"
+
 /*
  * Device context
  *
@@ -712,6 +1047,12 @@ struct _DeviceContext {
      * to 0. */
     guint min_probing_time_id;
 
+    /* Ports the device is expected to expose, or NULL if unknown */
+    MMExpectedPorts *expected_ports;
+    /* Key of the device in the probing cache, only set if the expected number
+     * of ports is not given in udev, so that the ports can be learned */
+    gchar *cache_key;
+
     /* Signal connection ids for the grabbed/released signals from the device.
      * These are the signals that will give us notifications of what ports are
      * available (or suddenly unavailable) in the device. */
@@ -720,6 +1061,9 @@ struct _DeviceContext {
 
     /* Port support check contexts being run */
     GList *port_contexts;
+
+    /* Start time of the support check, for the probing trace */
+    gint64 trace_start;
 };
 
 static void
@@ -738,6 +1082,9 @@ device_context_unref (DeviceContext *device_context)
         g_assert (!device_context->task);
 
         g_free (device_context->name);
+        g_free (device_context->cache_key);
+        if (device_context->expected_ports)
+            mm_expected_ports_free (device_context->expected_ports);
         g_timer_destroy (device_context->timer);
         if (device_context->cancellable)
             g_object_unref (device_context->cancellable);
@@ -798,6 +1145,20 @@ device_context_run_finish (MMPluginManager  *self,
     return MM_PLUGIN (g_task_propagate_pointer (G_TASK (res), error));
 }
 
+/* Persistent identifiers of the ports grabbed in the device so far, NULL
+ * for the ones which can't be identified */
+static GPtrArray *
+device_context_build_found_port_ids (DeviceContext *device_context)
+{
+    GPtrArray *found_ids;
+    GList     *l;
+
+    found_ids = g_ptr_array_new_with_free_func (g_free);
+    for (l = mm_device_peek_port_probe_list (device_context->device); l; l = g_list_next (l))
+        g_ptr_array_add (found_ids, mm_port_probe_cache_build_port_id (mm_port_probe_peek_port (MM_PORT_PROBE (l->data))));
+    return found_ids;
+}
+
 static void
 device_context_complete (DeviceContext *device_context)
 {
@@ -811,6 +1172,11 @@ device_context_complete (DeviceContext *device_context)
     /* Log about the time required to complete the checks */
     mm_dbg ("[plugin manager] task %s: finished in '%lf' seconds",
             device_context->name, g_timer_elapsed (device_context->timer, NULL));
+    mm_probe_trace_add (mm_device_get_uid (device_context->device),
+                        NULL,
+                        "device support check",
+                        device_context->trace_start,
+                        device_context->best_plugin ? mm_plugin_get_name (device_context->best_plugin) : "unsupported");
 
     /* Remove signal handlers */
     if (device_context->grabbed_id) {
@@ -836,8 +1202,32 @@ device_context_complete (DeviceContext *device_context)
     if (!device_context->best_plugin)
         g_task_return_new_error (task, MM_CORE_ERROR, MM_CORE_ERROR_UNSUPPORTED,
                                  "not supported by any plugin");
-    else
+    else {
+        GList *l;
+
+        /* Store probing results, so that they can be reused the next time
+         * the device is found */
+        for (l = mm_device_peek_port_probe_list (device_context->device); l; l = g_list_next (l))
+            mm_port_probe_save_results (MM_PORT_PROBE (l->data),
+                                        mm_plugin_get_name (device_context->best_plugin));
+
+        /* Learn which ports the device exposes. If the probing was cut short,
+         * the ports found include all the expected ones, so the expectation
+         * can only shrink after a probing which waited the default times */
+        if (device_context->cache_key) {
+            GPtrArray  *found_ids;
+            gchar     **port_ids;
+
+            found_ids = device_context_build_found_port_ids (device_context);
+            port_ids = mm_expected_ports_build_ids (found_ids);
+            if (port_ids)
+                mm_port_probe_cache_set_expected_ports (device_context->cache_key, (const gchar * const *) port_ids);
+            g_strfreev (port_ids);
+            g_ptr_array_unref (found_ids);
+        }
+
         g_task_return_pointer (task, g_object_ref (device_context->best_plugin), g_object_unref);
+    }
     g_object_unref (task);
 }
 
@@ -966,6 +1356,21 @@ device_context_set_best_plugin (DeviceContext *device_context,
             port_context->name, mm_plugin_get_name (best_plugin));
 }
 
+static gboolean
+device_context_expects_more_ports (DeviceContext *device_context)
+{
+    GPtrArray *found_ids;
+    gboolean   all_found;
+
+    if (!device_context->expected_ports)
+        return FALSE;
+
+    found_ids = device_context_build_found_port_ids (device_context);
+    all_found = mm_expected_ports_all_found (device_context->expected_ports, found_ids);
+    g_ptr_array_unref (found_ids);
+    return !all_found;
+}
+
 static void
 device_context_continue (DeviceContext *device_context)
 {
@@ -974,8 +1379,15 @@ device_context_continue (DeviceContext *device_context)
     guint    n = 0;
     guint    n_active = 0;
 
-    /* If there are no running port contexts around, we're free to finish */
+    /* If there are no running port contexts around, we're free to finish,
+     * unless we know there are still ports to come */
     if (!device_context->port_contexts) {
+        if (device_context->min_probing_time_id &&
+            !g_cancellable_is_cancelled (device_context->cancellable) &&
+            device_context_expects_more_ports (device_context)) {
+            mm_dbg ("[plugin manager] task %s: waiting for more ports to appear", device_context->name);
+            return;
+        }
         mm_dbg ("[plugin manager] task %s: no more ports to probe", device_context->name);
         device_context_complete (device_context);
         return;
@@ -1067,6 +1479,7 @@ device_context_run_port_context (DeviceContext *device_context,
                                  PortContext   *port_context)
 {
     GList           *plugins;
+    MMPortProbeFlag  shared_probe_flags;
     MMPlugin        *suggested = NULL;
     MMPluginManager *self;
 
@@ -1076,7 +1489,7 @@ device_context_run_port_context (DeviceContext *device_context,
     /* Setup plugins to probe and first one to check.
      * Make sure this plugins list is built after the MIN WAIT TIME has been expired
      * (so that per-driver filters work correctly) */
-    plugins = plugin_manager_build_plugins_list (self, device_context->device, port_context->port);
+    plugins = plugin_manager_build_plugins_list (self, device_context->device, port_context->port, &shared_probe_flags);
 
     /* If we got one already set in the device context, it will be the first one,
      * unless it is the generic plugin */
@@ -1084,10 +1497,30 @@ device_context_run_port_context (DeviceContext *device_context,
         !g_str_equal (mm_plugin_get_name (device_context->best_plugin), MM_PLUGIN_GENERIC_NAME)) {
         suggested = device_context->best_plugin;
     }
+    /* Otherwise, if the port was already handled by a given plugin in the past,
+     * start with that one */
+    else {
+        MMPortProbe *probe;
+        const gchar *cached_plugin = NULL;
+        GList       *l;
+
+        probe = MM_PORT_PROBE (mm_device_peek_port_probe (device_context->device, port_context->port));
+        if (probe)
+            cached_plugin = mm_port_probe_get_cached_plugin (probe);
+        for (l = plugins; cached_plugin && l; l = g_list_next (l)) {
+            if (g_str_equal (mm_plugin_get_name (MM_PLUGIN (l->data)), cached_plugin)) {
+                mm_dbg ("[plugin manager] task %s: plugin '%s' found in probing cache",
+                        port_context->name, cached_plugin);
+                suggested = MM_PLUGIN (l->data);
+                break;
+            }
+        }
+    }
 
     port_context_run (self,
                       port_context,
                       plugins,
+                      shared_probe_flags,
                       suggested,
                       (GAsyncReadyCallback) port_context_run_ready,
                       common_async_context_new (self,
@@ -1104,6 +1537,11 @@ device_context_min_wait_time_elapsed (DeviceContext *device_context)
 
     device_context->min_wait_time_id = 0;
     mm_dbg ("[plugin manager] task %s: min wait time elapsed", device_context->name);
+    mm_probe_trace_add (mm_device_get_uid (device_context->device),
+                        NULL,
+                        "waiting for ports",
+                        device_context->trace_start,
+                        NULL);
 
     /* Move list of port contexts out of the wait list */
     g_assert (!device_context->port_contexts);
@@ -1149,6 +1587,40 @@ device_context_port_released (DeviceContext  *device_context,
             device_context->name, mm_kernel_device_get_name (port));
 }
 
+static void
+device_context_load_expected_ports (DeviceContext  *device_context,
+                                    MMKernelDevice *port)
+{
+    gint    n_ports;
+    gchar **port_ids;
+
+    /* Already loaded? */
+    if (device_context->expected_ports || device_context->cache_key)
+        return;
+
+    n_ports = mm_kernel_device_get_global_property_as_int (port, ID_MM_EXPECTED_PORTS);
+    if (n_ports > 0) {
+        device_context->expected_ports = mm_expected_ports_new_count ((guint) n_ports);
+        mm_dbg ("[plugin manager] task %s: %d ports expected (udev)",
+                device_context->name, n_ports);
+        return;
+    }
+
+    /* Not all ports report vendor/product IDs, so this may be retried with
+     * the next port grabbed */
+    device_context->cache_key = mm_port_probe_cache_build_device_key (port);
+    if (!device_context->cache_key)
+        return;
+
+    port_ids = mm_port_probe_cache_get_expected_ports (device_context->cache_key);
+    if (port_ids && port_ids[0]) {
+        device_context->expected_ports = mm_expected_ports_new_ids ((const gchar * const *) port_ids);
+        mm_dbg ("[plugin manager] task %s: %u ports expected (probing cache)",
+                device_context->name, mm_expected_ports_get_length (device_context->expected_ports));
+    }
+    g_strfreev (port_ids);
+}
+
 static void
 device_context_port_grabbed (DeviceContext  *device_context,
                              MMKernelDevice *port)
@@ -1187,12 +1659,27 @@ device_context_port_grabbed (DeviceContext  *device_context,
     mm_dbg ("[plugin manager] task %s: new support task for port",
             port_context->name);
 
+    device_context_load_expected_ports (device_context, port);
+
     /* Îf still waiting the min wait time, store it in the waiting list */
     if (device_context->min_wait_time_id) {
         mm_dbg ("[plugin manager) task %s: deferred until min wait time elapsed",
                 port_context->name);
         /* Store the port reference in the list within the device */
         device_context->wait_port_contexts = g_list_prepend (device_context->wait_port_contexts, port_context);
+
+        /* If all expected ports are already here, there's no point in waiting
+         * any longer for others to appear */
+        if (device_context->expected_ports && !device_context_expects_more_ports (device_context)) {
+            mm_dbg ("[plugin manager] task %s: all %u expected ports grabbed",
+                    device_context->name, mm_expected_ports_get_length (device_context->expected_ports));
+            g_source_remove (device_context->min_wait_time_id);
+            if (device_context->min_probing_time_id) {
+                g_source_remove (device_context->min_probing_time_id);
+                device_context->min_probing_time_id = 0;
+            }
+            device_context_min_wait_time_elapsed (device_context);
+        }
         return;
     }
 
@@ -1250,6 +1737,8 @@ device_context_run (MMPluginManager     *self,
     g_assert (!device_context->min_wait_time_id);
     g_assert (!device_context->min_probing_time_id);
 
+    device_context->trace_start = g_get_monotonic_time ();
+
     /* Connect to device port grabbed/released notifications from the device */
     device_context->grabbed_id = g_signal_connect_swapped (device_context->device,
                                                            MM_DEVICE_PORT_GRABBED,
@@ -1540,6 +2029,7 @@ load_plugins (MMPluginManager *self,
     GDir *dir = NULL;
     const gchar *fname;
     gchar *plugindir_display = NULL;
+    GList *l;
 
     if (!g_module_supported ()) {
         g_set_error (error,
@@ -1604,6 +2094,11 @@ load_plugins (MMPluginManager *self,
     mm_dbg ("[plugin manager] successfully loaded %u plugins",
             g_list_length (self->priv->plugins) + !!self->priv->generic);
 
+    /* Index the pre-probing filters of the vendor specific plugins */
+    self->priv->filter_index = mm_plugin_filter_index_new (g_list_length (self->priv->plugins));
+    for (l = self->priv->plugins; l; l = g_list_next (l))
+        mm_plugin_add_to_filter_index (MM_PLUGIN (l->data), self->priv->filter_index);
+
 out:
     if (dir)
         g_dir_close (dir);
@@ -1615,12 +2110,14 @@ out:
 
 MMPluginManager *
 mm_plugin_manager_new (const gchar *plugin_dir,
+                       guint max_probes,
                        GError **error)
 {
     return g_initable_new (MM_TYPE_PLUGIN_MANAGER,
                            NULL,
                            error,
                            MM_PLUGIN_MANAGER_PLUGIN_DIR, plugin_dir,
+                           MM_PLUGIN_MANAGER_MAX_PROBES, max_probes,
                            NULL);
 }
 
@@ -1646,6 +2143,9 @@ set_property (GObject *object,
         g_free (priv->plugin_dir);
         priv->plugin_dir = g_value_dup_string (value);
         break;
+    case PROP_MAX_PROBES:
+        priv->max_probes = g_value_get_uint (value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1664,6 +2164,9 @@ get_property (GObject *object,
     case PROP_PLUGIN_DIR:
         g_value_set_string (value, priv->plugin_dir);
         break;
+    case PROP_MAX_PROBES:
+        g_value_set_uint (value, priv->max_probes);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1684,6 +2187,25 @@ dispose (GObject *object)
 {
     MMPluginManager *self = MM_PLUGIN_MANAGER (object);
 
+    /* Cancel the probes still waiting in the scheduler, which also removes
+     * them from the queues and completes their tasks */
+    while (self->priv->probe_buses) {
+        ProbeBus    *bus;
+        PortContext *port_context;
+
+        bus = (ProbeBus *)(self->priv->probe_buses->data);
+        port_context = g_queue_peek_head (bus->priority);
+        if (!port_context)
+            port_context = g_queue_peek_head (bus->normal);
+        g_assert (port_context && port_context->probe_queued);
+        if (!port_context_cancel (port_context))
+            probe_scheduler_unqueue (port_context);
+    }
+    if (self->priv->probe_dispatch_id) {
+        g_source_remove (self->priv->probe_dispatch_id);
+        self->priv->probe_dispatch_id = 0;
+    }
+
     /* Cleanup list of plugins */
     if (self->priv->plugins) {
         g_list_free_full (self->priv->plugins, g_object_unref);
@@ -1691,6 +2213,11 @@ dispose (GObject *object)
     }
     g_clear_object (&self->priv->generic);
 
+    if (self->priv->filter_index) {
+        mm_plugin_filter_index_free (self->priv->filter_index);
+        self->priv->filter_index = NULL;
+    }
+
     g_free (self->priv->plugin_dir);
     self->priv->plugin_dir = NULL;
 
@@ -1723,4 +2250,12 @@ mm_plugin_manager_class_init (MMPluginManagerClass *manager_class)
                               "Where to look for plugins",
                               NULL,
                               G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+    g_object_class_install_property
+        (object_class, PROP_MAX_PROBES,
+         g_param_spec_uint (MM_PLUGIN_MANAGER_MAX_PROBES,
+                            "Max probes",
+                            "Maximum number of port probes to run at the same time, 0 if unlimited",
+                            0, G_MAXUINT, 0,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
 }
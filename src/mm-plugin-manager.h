@@ -32,6 +32,7 @@
 #define MM_PLUGIN_MANAGER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), MM_TYPE_PLUGIN_MANAGER, MMPluginManagerClass))
 
 #define MM_PLUGIN_MANAGER_PLUGIN_DIR "plugin-dir" /* Construct-only */
+#define MM_PLUGIN_MANAGER_MAX_PROBES "max-probes" /* Construct-only */
 
 typedef struct _MMPluginManager MMPluginManager;
 typedef struct _MMPluginManagerClass MMPluginManagerClass;
@@ -48,6 +49,7 @@ struct _MMPluginManagerClass {
 
 GType            mm_plugin_manager_get_type (void);
 MMPluginManager *mm_plugin_manager_new                         (const gchar          *plugindir,
+                                                                guint                 max_probes,
                                                                 GError              **error);
 void             mm_plugin_manager_device_support_check        (MMPluginManager      *self,
                                                                 MMDevice             *device,
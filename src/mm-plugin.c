@@ -50,6 +50,15 @@ static gchar *virtual_port[] = {"smd0", NULL};
      self->priv->forbidden_icera ||             \
      self->priv->custom_init)
 
+#define HAS_CUSTOM_AT_PROBING(self)             \
+    (self->priv->custom_init ||                 \
+     self->priv->custom_at_probe)
+
+/* Probings which may be run by one plugin on behalf of others: they are just
+ * additional commands sent in the same AT probing session. Icera probing is
+ * not shared, as it is slow in non-Icera devices. */
+#define SHARED_PROBE_FLAGS (MM_PORT_PROBE_AT_VENDOR | MM_PORT_PROBE_AT_PRODUCT)
+
 
 struct _MMPluginPrivate {
     gchar *name;
@@ -586,6 +595,46 @@ typedef struct {
     MMPortProbeFlag flags;
 } PortProbeRunContext;
 
+static MMPortProbeFlag
+build_probe_run_flags (MMPlugin       *self,
+                       MMKernelDevice *port,
+                       gboolean        need_vendor_probing,
+                       gboolean        need_product_probing)
+{
+    MMPortProbeFlag probe_run_flags;
+
+    probe_run_flags = MM_PORT_PROBE_NONE;
+    if (!g_str_has_prefix (mm_kernel_device_get_name (port), "cdc-wdm")) {
+        /* Serial ports... */
+        if (self->priv->at)
+            probe_run_flags |= MM_PORT_PROBE_AT;
+        else if (self->priv->single_at)
+            probe_run_flags |= MM_PORT_PROBE_AT;
+        if (self->priv->qcdm)
+            probe_run_flags |= MM_PORT_PROBE_QCDM;
+    } else {
+        /* cdc-wdm ports... */
+        if (self->priv->qmi && !g_strcmp0 (mm_kernel_device_get_driver (port), "qmi_wwan"))
+            probe_run_flags |= MM_PORT_PROBE_QMI;
+        else if (self->priv->mbim && !g_strcmp0 (mm_kernel_device_get_driver (port), "cdc_mbim"))
+            probe_run_flags |= MM_PORT_PROBE_MBIM;
+        else
+            probe_run_flags |= MM_PORT_PROBE_AT;
+    }
+
+    /* For potential AT ports, check for more things */
+    if (probe_run_flags & MM_PORT_PROBE_AT) {
+        if (need_vendor_probing)
+            probe_run_flags |= MM_PORT_PROBE_AT_VENDOR;
+        if (need_product_probing)
+            probe_run_flags |= MM_PORT_PROBE_AT_PRODUCT;
+        if (self->priv->icera_probe || self->priv->allowed_icera || self->priv->forbidden_icera)
+            probe_run_flags |= MM_PORT_PROBE_AT_ICERA;
+    }
+
+    return probe_run_flags;
+}
+
 static void
 port_probe_run_context_free (PortProbeRunContext *ctx)
 {
@@ -684,6 +733,7 @@ void
 mm_plugin_supports_port (MMPlugin            *self,
                          MMDevice            *device,
                          MMKernelDevice      *port,
+                         MMPortProbeFlag      shared_probe_flags,
                          GCancellable        *cancellable,
                          GAsyncReadyCallback  callback,
                          gpointer             user_data)
@@ -694,6 +744,7 @@ mm_plugin_supports_port (MMPlugin            *self,
     gboolean need_vendor_probing;
     gboolean need_product_probing;
     MMPortProbeFlag probe_run_flags;
+    MMPortProbeFlag shared_run_flags;
     gchar *probe_list_str;
 
     g_return_if_fail (MM_IS_PLUGIN (self));
@@ -741,34 +792,7 @@ mm_plugin_supports_port (MMPlugin            *self,
     }
 
     /* Build flags depending on what probing needed */
-    probe_run_flags = MM_PORT_PROBE_NONE;
-    if (!g_str_has_prefix (mm_kernel_device_get_name (port), "cdc-wdm")) {
-        /* Serial ports... */
-        if (self->priv->at)
-            probe_run_flags |= MM_PORT_PROBE_AT;
-        else if (self->priv->single_at)
-            probe_run_flags |= MM_PORT_PROBE_AT;
-        if (self->priv->qcdm)
-            probe_run_flags |= MM_PORT_PROBE_QCDM;
-    } else {
-        /* cdc-wdm ports... */
-        if (self->priv->qmi && !g_strcmp0 (mm_kernel_device_get_driver (port), "qmi_wwan"))
-            probe_run_flags |= MM_PORT_PROBE_QMI;
-        else if (self->priv->mbim && !g_strcmp0 (mm_kernel_device_get_driver (port), "cdc_mbim"))
-            probe_run_flags |= MM_PORT_PROBE_MBIM;
-        else
-            probe_run_flags |= MM_PORT_PROBE_AT;
-    }
-
-    /* For potential AT ports, check for more things */
-    if (probe_run_flags & MM_PORT_PROBE_AT) {
-        if (need_vendor_probing)
-            probe_run_flags |= MM_PORT_PROBE_AT_VENDOR;
-        if (need_product_probing)
-            probe_run_flags |= MM_PORT_PROBE_AT_PRODUCT;
-        if (self->priv->icera_probe || self->priv->allowed_icera || self->priv->forbidden_icera)
-            probe_run_flags |= MM_PORT_PROBE_AT_ICERA;
-    }
+    probe_run_flags = build_probe_run_flags (self, port, need_vendor_probing, need_product_probing);
 
     /* If no explicit probing was required, just request to grab it without probing anything.
      * This may happen, e.g. with cdc-wdm ports which do not need QMI/MBIM probing. */
@@ -803,6 +827,15 @@ mm_plugin_supports_port (MMPlugin            *self,
     /* Store context in task */
     g_task_set_task_data (task, ctx, (GDestroyNotify) port_probe_run_context_free);
 
+    /* If the port is going to be AT probed anyway, also run the probings that
+     * other candidate plugins need, so that the port isn't opened once more
+     * for each of them. Plugins with custom AT initialization or probing
+     * commands don't share, as the results depend on their own setup. The
+     * post-probing filters still use only the flags of this plugin. */
+    shared_run_flags = ctx->flags;
+    if ((ctx->flags & MM_PORT_PROBE_AT) && !HAS_CUSTOM_AT_PROBING (self))
+        shared_run_flags |= (shared_probe_flags & SHARED_PROBE_FLAGS);
+
     /* Launch the probe */
     probe_list_str = mm_port_probe_flag_build_string_from_mask (ctx->flags);
     mm_dbg ("(%s) [%s] probe required: '%s'",
@@ -812,7 +845,7 @@ mm_plugin_supports_port (MMPlugin            *self,
     g_free (probe_list_str);
 
     mm_port_probe_run (probe,
-                       ctx->flags,
+                       shared_run_flags,
                        self->priv->send_delay,
                        self->priv->remove_echo,
                        self->priv->send_lf,
@@ -826,13 +859,17 @@ mm_plugin_supports_port (MMPlugin            *self,
 /*****************************************************************************/
 
 MMPluginSupportsHint
-mm_plugin_discard_port_early (MMPlugin       *self,
-                              MMDevice       *device,
-                              MMKernelDevice *port)
+mm_plugin_discard_port_early (MMPlugin        *self,
+                              MMDevice        *device,
+                              MMKernelDevice  *port,
+                              MMPortProbeFlag *out_shared_probe_flags)
 {
     gboolean need_vendor_probing = FALSE;
     gboolean need_product_probing = FALSE;
 
+    if (out_shared_probe_flags)
+        *out_shared_probe_flags = MM_PORT_PROBE_NONE;
+
     /* If fully filtered by pre-probing filters, port unsupported */
     if (apply_pre_probing_filters (self,
                                    device,
@@ -841,6 +878,12 @@ mm_plugin_discard_port_early (MMPlugin       *self,
                                    &need_product_probing))
         return MM_PLUGIN_SUPPORTS_HINT_UNSUPPORTED;
 
+    /* Report the probings that could be run on behalf of this plugin while
+     * another one is probing */
+    if (out_shared_probe_flags && !HAS_CUSTOM_AT_PROBING (self))
+        *out_shared_probe_flags = (build_probe_run_flags (self, port, need_vendor_probing, need_product_probing) &
+                                   SHARED_PROBE_FLAGS);
+
     /* If there are no post-probing filters, this plugin is the only one (except
      * for the generic one) which will grab the port */
     if (!HAS_POST_PROBING_FILTERS (self))
@@ -856,6 +899,103 @@ mm_plugin_discard_port_early (MMPlugin       *self,
 
 /*****************************************************************************/
 
+void
+mm_plugin_add_to_filter_index (MMPlugin            *self,
+                               MMPluginFilterIndex *index)
+{
+    MMPluginFilterIndexEntry entry;
+
+    g_return_if_fail (MM_IS_PLUGIN (self));
+
+    entry.subsystems = (const gchar **) self->priv->subsystems;
+    entry.drivers = (const gchar **) self->priv->drivers;
+    entry.vendor_ids = self->priv->vendor_ids;
+    entry.product_ids = self->priv->product_ids;
+    entry.udev_tags = (const gchar **) self->priv->udev_tags;
+    /* Ports not matching the IDs may still be checked with vendor/product
+     * strings, see apply_pre_probing_filters() */
+    entry.ids_fallback = (self->priv->vendor_strings ||
+                          self->priv->product_strings ||
+                          self->priv->forbidden_product_strings);
+
+    mm_plugin_filter_index_add (index, self, &entry);
+}
+
+static gboolean
+port_has_udev_tag (const gchar    *tag,
+                   MMKernelDevice *port)
+{
+    return mm_kernel_device_get_global_property_as_boolean (port, tag);
+}
+
+GList *
+mm_plugin_list_candidates (MMPluginFilterIndex *index,
+                           MMDevice            *device,
+                           MMKernelDevice      *port)
+{
+    static const gchar *virtual_drivers [] = { "virtual", NULL };
+    const gchar **drivers;
+
+    /* Same drivers as the ones used in the pre-probing filters */
+    drivers = (is_virtual_port (mm_kernel_device_get_name (port)) ?
+               virtual_drivers :
+               mm_device_get_drivers (device));
+
+    return mm_plugin_filter_index_lookup (index,
+                                          mm_kernel_device_get_subsystem (port),
+                                          (const gchar * const *) drivers,
+                                          mm_device_get_vendor (device),
+                                          mm_device_get_product (device),
+                                          (MMPluginFilterIndexTagFunc) port_has_udev_tag,
+                                          port);
+}
+
+/*****************************************************************************/
+
+static void
+apply_probed_port_setup (MMBaseModem *modem,
+                         MMPortProbe *probe)
+{
+    GList *ports;
+    GList *l;
+    gboolean bulk_write;
+    gboolean concat;
+
+    bulk_write = mm_port_probe_is_at_bulk_write (probe);
+    concat = mm_port_probe_is_at_concat (probe);
+
+    ports = mm_base_modem_find_ports (modem,
+                                      MM_PORT_SUBSYS_UNKNOWN,
+                                      MM_PORT_TYPE_AT,
+                                      mm_port_probe_get_port_name (probe));
+    for (l = ports; l; l = g_list_next (l)) {
+        /* If full-buffer writes were validated during probing, don't pace
+         * the writes in the grabbed AT port; otherwise, explicitly keep the
+         * byte-at-a-time pacing */
+        if (mm_port_get_subsys (MM_PORT (l->data)) == MM_PORT_SUBSYS_TTY) {
+            if (bulk_write)
+                mm_dbg ("(%s/%s): enabling full-buffer writes",
+                        mm_port_probe_get_port_subsys (probe),
+                        mm_port_probe_get_port_name (probe));
+            g_object_set (l->data,
+                          MM_PORT_SERIAL_SEND_CHUNK_SIZE, (guint) (bulk_write ? 0 : 1),
+                          NULL);
+        }
+
+        /* If command concatenation was validated during probing, allow
+         * batching AT sequences in the grabbed AT port */
+        if (concat) {
+            mm_dbg ("(%s/%s): enabling command concatenation",
+                    mm_port_probe_get_port_subsys (probe),
+                    mm_port_probe_get_port_name (probe));
+            g_object_set (l->data,
+                          MM_PORT_SERIAL_AT_CONCATENATION, TRUE,
+                          NULL);
+        }
+    }
+    g_list_free_full (ports, g_object_unref);
+}
+
 MMBaseModem *
 mm_plugin_create_modem (MMPlugin  *self,
                         MMDevice *device,
@@ -955,7 +1095,8 @@ mm_plugin_create_modem (MMPlugin  *self,
                          mm_port_probe_get_port_name (MM_PORT_PROBE (l->data)),
                          inner_error ? inner_error->message : "unknown error");
                 g_clear_error (&inner_error);
-            }
+            } else
+                apply_probed_port_setup (modem, probe);
         }
     } else if (virtual_ports) {
         guint i;
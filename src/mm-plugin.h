@@ -26,6 +26,7 @@
 #include "mm-port-probe.h"
 #include "mm-device.h"
 #include "mm-kernel-device.h"
+#include "mm-plugin-filter-index.h"
 
 #define MM_PLUGIN_GENERIC_NAME "Generic"
 #define MM_PLUGIN_MAJOR_VERSION 4
@@ -124,14 +125,25 @@ GType mm_plugin_get_type (void);
 const gchar *mm_plugin_get_name (MMPlugin *plugin);
 
 /* This method will run all pre-probing filters, to see if we can discard this
- * plugin from the probing logic as soon as possible. */
-MMPluginSupportsHint mm_plugin_discard_port_early (MMPlugin       *plugin,
-                                                   MMDevice       *device,
-                                                   MMKernelDevice *port);
+ * plugin from the probing logic as soon as possible. It also reports which
+ * probings the plugin would need, which other plugins may run on its behalf. */
+MMPluginSupportsHint mm_plugin_discard_port_early (MMPlugin        *plugin,
+                                                   MMDevice        *device,
+                                                   MMKernelDevice  *port,
+                                                   MMPortProbeFlag *out_shared_probe_flags);
+
+/* Pre-probing filter index, to find the plugins which may support a port
+ * without checking the filters of every plugin */
+void   mm_plugin_add_to_filter_index (MMPlugin            *plugin,
+                                      MMPluginFilterIndex *index);
+GList *mm_plugin_list_candidates     (MMPluginFilterIndex *index,
+                                      MMDevice            *device,
+                                      MMKernelDevice      *port);
 
 void                   mm_plugin_supports_port        (MMPlugin             *plugin,
                                                        MMDevice             *device,
                                                        MMKernelDevice       *port,
+                                                       MMPortProbeFlag       shared_probe_flags,
                                                        GCancellable         *cancellable,
                                                        GAsyncReadyCallback   callback,
                                                        gpointer              user_data);
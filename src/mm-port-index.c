@@ -0,0 +1,108 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include "mm-port-index.h"
+
+struct _MMPortIndex {
+    /* "subsystem/name" to owner */
+    GHashTable *ports;
+};
+
+/*****************************************************************************/
+
+static gchar *
+build_port_key (const gchar *subsystem,
+                const gchar *name)
+{
+    return g_strdup_printf ("%s/%s", subsystem, name);
+}
+
+void
+mm_port_index_add (MMPortIndex *self,
+                   const gchar *subsystem,
+                   const gchar *name,
+                   GObject     *owner)
+{
+    g_return_if_fail (subsystem != NULL);
+    g_return_if_fail (name != NULL);
+    g_return_if_fail (G_IS_OBJECT (owner));
+
+    g_hash_table_insert (self->ports, build_port_key (subsystem, name), g_object_ref (owner));
+}
+
+gboolean
+mm_port_index_remove (MMPortIndex *self,
+                      const gchar *subsystem,
+                      const gchar *name,
+                      GObject     *owner)
+{
+    gchar    *key;
+    gboolean  removed = FALSE;
+
+    g_return_val_if_fail (subsystem != NULL, FALSE);
+    g_return_val_if_fail (name != NULL, FALSE);
+
+    key = build_port_key (subsystem, name);
+    if (g_hash_table_lookup (self->ports, key) == owner)
+        removed = g_hash_table_remove (self->ports, key);
+    g_free (key);
+    return removed;
+}
+
+GObject *
+mm_port_index_lookup (MMPortIndex *self,
+                      const gchar *subsystem,
+                      const gchar *name)
+{
+    GObject *owner;
+    gchar   *key;
+
+    g_return_val_if_fail (subsystem != NULL, NULL);
+    g_return_val_if_fail (name != NULL, NULL);
+
+    key = build_port_key (subsystem, name);
+    owner = g_hash_table_lookup (self->ports, key);
+    g_free (key);
+    return owner;
+}
+
+guint
+mm_port_index_get_length (MMPortIndex *self)
+{
+    return g_hash_table_size (self->ports);
+}
+
+void
+mm_port_index_clear (MMPortIndex *self)
+{
+    g_hash_table_remove_all (self->ports);
+}
+
+/*****************************************************************************/
+
+MMPortIndex *
+mm_port_index_new (void)
+{
+    MMPortIndex *self;
+
+    self = g_slice_new0 (MMPortIndex);
+    self->ports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    return self;
+}
+
+void
+mm_port_index_free (MMPortIndex *self)
+{
+    g_hash_table_unref (self->ports);
+    g_slice_free (MMPortIndex, self);
+}
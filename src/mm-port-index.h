@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PORT_INDEX_H
+#define MM_PORT_INDEX_H
+
+#include <glib-object.h>
+
+/* Index of the object owning each port.
+ *
+ * Ports are identified by subsystem and name, the same way kernel devices are
+ * matched. Each port has at most one owner, of which a reference is kept
+ * while indexed. Removing a port only succeeds if given the current owner, so
+ * that a stale removal (e.g. of a device already replaced by a new one
+ * grabbing the same port) doesn't drop the new owner. */
+
+typedef struct _MMPortIndex MMPortIndex;
+
+MMPortIndex *mm_port_index_new        (void);
+void         mm_port_index_free       (MMPortIndex *self);
+
+void         mm_port_index_add        (MMPortIndex *self,
+                                       const gchar *subsystem,
+                                       const gchar *name,
+                                       GObject     *owner);
+gboolean     mm_port_index_remove     (MMPortIndex *self,
+                                       const gchar *subsystem,
+                                       const gchar *name,
+                                       GObject     *owner);
+GObject     *mm_port_index_lookup     (MMPortIndex *self,
+                                       const gchar *subsystem,
+                                       const gchar *name);
+guint        mm_port_index_get_length (MMPortIndex *self);
+void         mm_port_index_clear      (MMPortIndex *self);
+
+#endif /* MM_PORT_INDEX_H */
@@ -52,7 +52,7 @@ mm_port_probe_response_processor_is_at (const gchar *command,
 
         /* If error is NOT known by the parser, or if the error is actually
          * the generic parsing filter error, request to abort */
-        if (!mm_serial_parser_v1_is_known_error (error) ||
+        if (!mm_serial_parser_v2_is_known_error (error) ||
             g_error_matches (error,
                              MM_SERIAL_ERROR,
                              MM_SERIAL_ERROR_PARSE_FAILED)) {
@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "mm-port-probe-cache.h"
+#include "mm-log.h"
+
+/* Bump whenever the meaning of the stored results changes, so that old
+ * caches get discarded */
+#define CACHE_FORMAT_VERSION 2
+
+#define CACHE_GROUP_INFO "ModemManager"
+#define CACHE_KEY_VERSION "version"
+
+/* Changes are written to disk once no more have been done in this time */
+#define CACHE_SAVE_TIMEOUT_SECS 5
+
+typedef struct {
+    gchar    *path;
+    GKeyFile *key_file;
+    guint     save_id;
+} ProbeCache;
+
+static ProbeCache *cache;
+
+/*****************************************************************************/
+
+void
+mm_port_probe_cache_entry_clear (MMPortProbeCacheEntry *entry)
+{
+    g_free (entry->vendor);
+    g_free (entry->product);
+    g_free (entry->plugin);
+    memset (entry, 0, sizeof (MMPortProbeCacheEntry));
+}
+
+/*****************************************************************************/
+
+gchar *
+mm_port_probe_cache_build_port_id (MMKernelDevice *port)
+{
+    const gchar *interface;
+    const gchar *driver;
+
+    /* Without the interface number there is no way to tell the ports of the
+     * same device apart in a persistent way */
+    interface = mm_kernel_device_get_property (port, "ID_USB_INTERFACE_NUM");
+    if (!interface)
+        return NULL;
+
+    driver = mm_kernel_device_get_driver (port);
+
+    return g_strdup_printf ("%s/%s/%s",
+                            interface,
+                            driver ? driver : "",
+                            mm_kernel_device_get_subsystem (port));
+}
+
+gchar *
+mm_port_probe_cache_build_key (MMKernelDevice *port)
+{
+    gchar *device_key;
+    gchar *port_id;
+    gchar *key;
+
+    device_key = mm_port_probe_cache_build_device_key (port);
+    port_id = mm_port_probe_cache_build_port_id (port);
+    key = (device_key && port_id) ? g_strdup_printf ("%s/%s", device_key, port_id) : NULL;
+    g_free (device_key);
+    g_free (port_id);
+    return key;
+}
+
+/*****************************************************************************/
+
+static gboolean
+cache_save (void)
+{
+    GError *error = NULL;
+    gchar  *dirname;
+    gchar  *data;
+    gsize   len;
+
+    cache->save_id = 0;
+
+    dirname = g_path_get_dirname (cache->path);
+    g_mkdir_with_parents (dirname, 0755);
+    g_free (dirname);
+
+    data = g_key_file_to_data (cache->key_file, &len, NULL);
+    if (!g_file_set_contents (cache->path, data, len, &error)) {
+        mm_warn ("Couldn't write port probing cache '%s': %s", cache->path, error->message);
+        g_error_free (error);
+    } else
+        mm_dbg ("Port probing cache written to '%s'", cache->path);
+    g_free (data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+cache_schedule_save (void)
+{
+    if (cache->save_id)
+        g_source_remove (cache->save_id);
+    cache->save_id = g_timeout_add_seconds (CACHE_SAVE_TIMEOUT_SECS,
+                                            (GSourceFunc) cache_save,
+                                            NULL);
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_port_probe_cache_lookup (const gchar           *key,
+                            MMPortProbeCacheEntry *entry)
+{
+    GKeyFile *kf;
+
+    g_return_val_if_fail (key != NULL, FALSE);
+    g_return_val_if_fail (entry != NULL, FALSE);
+
+    if (!cache || !g_key_file_has_group (cache->key_file, key))
+        return FALSE;
+
+    kf = cache->key_file;
+    memset (entry, 0, sizeof (MMPortProbeCacheEntry));
+    entry->flags            = (guint32) g_key_file_get_uint64 (kf, key, "flags", NULL);
+    entry->is_at            = g_key_file_get_boolean (kf, key, "at", NULL);
+    entry->is_qcdm          = g_key_file_get_boolean (kf, key, "qcdm", NULL);
+    entry->is_qmi           = g_key_file_get_boolean (kf, key, "qmi", NULL);
+    entry->is_mbim          = g_key_file_get_boolean (kf, key, "mbim", NULL);
+    entry->is_icera         = g_key_file_get_boolean (kf, key, "icera", NULL);
+    entry->vendor           = g_key_file_get_string  (kf, key, "vendor", NULL);
+    entry->product          = g_key_file_get_string  (kf, key, "product", NULL);
+    entry->is_at_bulk_write = g_key_file_get_boolean (kf, key, "at-bulk-write", NULL);
+    entry->is_at_concat     = g_key_file_get_boolean (kf, key, "at-concat", NULL);
+    entry->plugin           = g_key_file_get_string  (kf, key, "plugin", NULL);
+
+    /* An entry without results is useless */
+    if (!entry->flags || !entry->plugin) {
+        mm_port_probe_cache_entry_clear (entry);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+mm_port_probe_cache_store (const gchar                 *key,
+                           const MMPortProbeCacheEntry *entry)
+{
+    GKeyFile *kf;
+
+    g_return_if_fail (key != NULL);
+    g_return_if_fail (entry != NULL);
+
+    if (!cache)
+        return;
+
+    kf = cache->key_file;
+    g_key_file_remove_group (kf, key, NULL);
+    g_key_file_set_uint64  (kf, key, "flags", entry->flags);
+    g_key_file_set_boolean (kf, key, "at", entry->is_at);
+    g_key_file_set_boolean (kf, key, "qcdm", entry->is_qcdm);
+    g_key_file_set_boolean (kf, key, "qmi", entry->is_qmi);
+    g_key_file_set_boolean (kf, key, "mbim", entry->is_mbim);
+    g_key_file_set_boolean (kf, key, "icera", entry->is_icera);
+    if (entry->vendor)
+        g_key_file_set_string (kf, key, "vendor", entry->vendor);
+    if (entry->product)
+        g_key_file_set_string (kf, key, "product", entry->product);
+    g_key_file_set_boolean (kf, key, "at-bulk-write", entry->is_at_bulk_write);
+    g_key_file_set_boolean (kf, key, "at-concat", entry->is_at_concat);
+    if (entry->plugin)
+        g_key_file_set_string (kf, key, "plugin", entry->plugin);
+
+    cache_schedule_save ();
+}
+
+void
+mm_port_probe_cache_remove (const gchar *key)
+{
+    g_return_if_fail (key != NULL);
+
+    if (!cache || !g_key_file_remove_group (cache->key_file, key, NULL))
+        return;
+
+    mm_dbg ("Port probing cache entry removed: %s", key);
+    cache_schedule_save ();
+}
+
+/*****************************************************************************/
+
+gchar *
+mm_port_probe_cache_build_device_key (MMKernelDevice *port)
+{
+    guint16      vid;
+    guint16      pid;
+    const gchar *revision;
+
+    vid = mm_kernel_device_get_physdev_vid (port);
+    pid = mm_kernel_device_get_physdev_pid (port);
+    if (!vid || !pid)
+        return NULL;
+
+    revision = mm_kernel_device_get_global_property (port, "ID_REVISION");
+
+    /* Port keys always have a '/', so they never clash with device keys */
+    return g_strdup_printf ("%04x:%04x:%s", vid, pid, revision ? revision : "");
+}
+
+gchar **
+mm_port_probe_cache_get_expected_ports (const gchar *device_key)
+{
+    g_return_val_if_fail (device_key != NULL, NULL);
+
+    if (!cache)
+        return NULL;
+
+    return g_key_file_get_string_list (cache->key_file, device_key, "ports", NULL, NULL);
+}
+
+void
+mm_port_probe_cache_set_expected_ports (const gchar         *device_key,
+                                        const gchar * const *port_ids)
+{
+    gchar    **current;
+    gboolean   changed;
+    guint      i;
+
+    g_return_if_fail (device_key != NULL);
+    g_return_if_fail (port_ids != NULL);
+
+    if (!cache)
+        return;
+
+    current = mm_port_probe_cache_get_expected_ports (device_key);
+    changed = !current;
+    for (i = 0; !changed && (current[i] || port_ids[i]); i++)
+        changed = (!current[i] || !port_ids[i] || !g_str_equal (current[i], port_ids[i]));
+    g_strfreev (current);
+    if (!changed)
+        return;
+
+    g_key_file_set_string_list (cache->key_file, device_key, "ports", port_ids, g_strv_length ((gchar **) port_ids));
+    cache_schedule_save ();
+}
+
+/*****************************************************************************/
+
+void
+mm_port_probe_cache_setup (const gchar *path)
+{
+    GError *error = NULL;
+
+    g_assert (!cache);
+
+    if (!path) {
+        mm_dbg ("Port probing cache disabled");
+        return;
+    }
+
+    cache = g_slice_new0 (ProbeCache);
+    cache->path = g_strdup (path);
+    cache->key_file = g_key_file_new ();
+
+    if (!g_key_file_load_from_file (cache->key_file, path, G_KEY_FILE_NONE, &error)) {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            mm_warn ("Couldn't load port probing cache '%s': %s", path, error->message);
+        g_error_free (error);
+    } else if (g_key_file_get_integer (cache->key_file, CACHE_GROUP_INFO, CACHE_KEY_VERSION, NULL) != CACHE_FORMAT_VERSION) {
+        mm_info ("Discarding port probing cache '%s': unsupported format", path);
+        g_key_file_free (cache->key_file);
+        cache->key_file = g_key_file_new ();
+    } else
+        mm_dbg ("Port probing cache loaded from '%s'", path);
+
+    g_key_file_set_integer (cache->key_file, CACHE_GROUP_INFO, CACHE_KEY_VERSION, CACHE_FORMAT_VERSION);
+}
+
+void
+mm_port_probe_cache_shutdown (void)
+{
+    if (!cache)
+        return;
+
+    /* Flush pending changes right away */
+    if (cache->save_id) {
+        g_source_remove (cache->save_id);
+        cache_save ();
+    }
+
+    g_key_file_free (cache->key_file);
+    g_free (cache->path);
+    g_slice_free (ProbeCache, cache);
+    cache = NULL;
+}
@@ -0,0 +1,74 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PORT_PROBE_CACHE_H
+#define MM_PORT_PROBE_CACHE_H
+
+#include <glib.h>
+
+#include "mm-kernel-device.h"
+
+/* Persistent cache of port probing results.
+ *
+ * Results are keyed by the identity of the port in the physical device
+ * (USB vendor/product IDs, device revision, interface number, driver and
+ * subsystem), so that they are valid across daemon restarts, USB resets
+ * and suspend/resume cycles, and are stored in a key file on disk. */
+
+typedef struct {
+    /* Mask of MMPortProbeFlag values with known results */
+    guint32   flags;
+    gboolean  is_at;
+    gboolean  is_qcdm;
+    gboolean  is_qmi;
+    gboolean  is_mbim;
+    gboolean  is_icera;
+    gchar    *vendor;
+    gchar    *product;
+    gboolean  is_at_bulk_write;
+    gboolean  is_at_concat;
+    /* Name of the plugin that ended up handling the device */
+    gchar    *plugin;
+} MMPortProbeCacheEntry;
+
+void mm_port_probe_cache_entry_clear (MMPortProbeCacheEntry *entry);
+
+/* Load the cache from the given file; if NULL, caching is disabled */
+void mm_port_probe_cache_setup    (const gchar *path);
+/* Write any pending change to disk and release the cache */
+void mm_port_probe_cache_shutdown (void);
+
+/* Returns NULL if the port can't be uniquely identified */
+gchar *mm_port_probe_cache_build_key (MMKernelDevice *port);
+
+gboolean mm_port_probe_cache_lookup (const gchar                 *key,
+                                     MMPortProbeCacheEntry       *entry);
+void     mm_port_probe_cache_store  (const gchar                 *key,
+                                     const MMPortProbeCacheEntry *entry);
+void     mm_port_probe_cache_remove (const gchar                 *key);
+
+/* Per-device information, keyed by vendor/product IDs and revision; returns
+ * NULL if the device can't be identified */
+gchar *mm_port_probe_cache_build_device_key (MMKernelDevice *port);
+
+/* Identifier of the port within its device, the same across daemon restarts
+ * and USB resets; returns NULL if the port can't be uniquely identified */
+gchar *mm_port_probe_cache_build_port_id (MMKernelDevice *port);
+
+/* Identifiers of the ports the device exposed the last time it was handled,
+ * or NULL if unknown */
+gchar **mm_port_probe_cache_get_expected_ports (const gchar         *device_key);
+void    mm_port_probe_cache_set_expected_ports (const gchar         *device_key,
+                                                const gchar * const *port_ids);
+
+#endif /* MM_PORT_PROBE_CACHE_H */
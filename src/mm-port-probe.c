@@ -28,8 +28,11 @@
 #include "mm-log.h"
 #include "mm-port-serial-at.h"
 #include "mm-port-serial.h"
+#include "mm-modem-helpers.h"
 #include "mm-serial-parsers.h"
 #include "mm-port-probe-at.h"
+#include "mm-port-probe-cache.h"
+#include "mm-probe-trace.h"
 #include "libqcdm/src/commands.h"
 #include "libqcdm/src/utils.h"
 #include "libqcdm/src/errors.h"
@@ -86,9 +89,22 @@ struct _MMPortProbePrivate {
     gboolean is_qmi;
     gboolean is_mbim;
 
+    /* Serial write calibration results */
+    gboolean is_at_bulk_write_checked;
+    gboolean is_at_bulk_write;
+
+    /* Command concatenation check results */
+    gboolean is_at_concat_checked;
+    gboolean is_at_concat;
+
     /* From udev tags */
     gboolean is_ignored;
 
+    /* Persistent probing results */
+    gchar *cache_key;
+    gboolean from_cache;
+    gchar *cached_plugin;
+
     /* Current probing task. Only one can be available at a time */
     GTask *task;
 };
@@ -98,6 +114,10 @@ struct _MMPortProbePrivate {
  * Always make sure that the stored task is NULL when the task is completed.
  */
 
+static void port_probe_trace_finish (MMPortProbe *self,
+                                     GTask       *task,
+                                     const gchar *result);
+
 static gboolean
 port_probe_task_return_error_if_cancelled (MMPortProbe *self)
 {
@@ -107,6 +127,7 @@ port_probe_task_return_error_if_cancelled (MMPortProbe *self)
     self->priv->task = NULL;
 
     if (g_task_return_error_if_cancelled (task)) {
+        port_probe_trace_finish (self, task, "cancelled");
         g_object_unref (task);
         return TRUE;
     }
@@ -123,6 +144,7 @@ port_probe_task_return_error (MMPortProbe *self,
 
     task = self->priv->task;
     self->priv->task = NULL;
+    port_probe_trace_finish (self, task, error->message);
     g_task_return_error (task, error);
     g_object_unref (task);
 }
@@ -135,16 +157,25 @@ port_probe_task_return_boolean (MMPortProbe *self,
 
     task = self->priv->task;
     self->priv->task = NULL;
+    port_probe_trace_finish (self, task, "done");
     g_task_return_boolean (task, result);
     g_object_unref (task);
 }
 
 /*****************************************************************************/
 
+static void port_probe_cached_results_stale (MMPortProbe     *self,
+                                             MMPortProbeFlag  probed);
+
 void
 mm_port_probe_set_result_at (MMPortProbe *self,
                              gboolean at)
 {
+    /* If the port was reported as AT in the cache, the cached results are
+     * no longer valid; probe everything else again */
+    if (!at && self->priv->from_cache && self->priv->is_at)
+        port_probe_cached_results_stale (self, MM_PORT_PROBE_AT);
+
     self->priv->is_at = at;
     self->priv->flags |= MM_PORT_PROBE_AT;
 
@@ -162,8 +193,8 @@ mm_port_probe_set_result_at (MMPortProbe *self,
         mm_dbg ("(%s/%s) port is not AT-capable",
                 mm_kernel_device_get_subsystem (self->priv->port),
                 mm_kernel_device_get_name (self->priv->port));
-        self->priv->vendor = NULL;
-        self->priv->product = NULL;
+        g_clear_pointer (&self->priv->vendor, g_free);
+        g_clear_pointer (&self->priv->product, g_free);
         self->priv->is_icera = FALSE;
         self->priv->flags |= (MM_PORT_PROBE_AT_VENDOR |
                               MM_PORT_PROBE_AT_PRODUCT |
@@ -233,6 +264,10 @@ void
 mm_port_probe_set_result_qcdm (MMPortProbe *self,
                                gboolean qcdm)
 {
+    /* Same as with AT ports, if the port was reported as QCDM in the cache */
+    if (!qcdm && self->priv->from_cache && self->priv->is_qcdm)
+        port_probe_cached_results_stale (self, MM_PORT_PROBE_QCDM);
+
     self->priv->is_qcdm = qcdm;
     self->priv->flags |= MM_PORT_PROBE_QCDM;
 
@@ -264,6 +299,10 @@ void
 mm_port_probe_set_result_qmi (MMPortProbe *self,
                               gboolean qmi)
 {
+    /* Same as with AT ports, if the port was reported as QMI in the cache */
+    if (!qmi && self->priv->from_cache && self->priv->is_qmi)
+        port_probe_cached_results_stale (self, MM_PORT_PROBE_QMI);
+
     self->priv->is_qmi = qmi;
     self->priv->flags |= MM_PORT_PROBE_QMI;
 
@@ -294,6 +333,10 @@ void
 mm_port_probe_set_result_mbim (MMPortProbe *self,
                                gboolean mbim)
 {
+    /* Same as with AT ports, if the port was reported as MBIM in the cache */
+    if (!mbim && self->priv->from_cache && self->priv->is_mbim)
+        port_probe_cached_results_stale (self, MM_PORT_PROBE_MBIM);
+
     self->priv->is_mbim = mbim;
     self->priv->flags |= MM_PORT_PROBE_MBIM;
 
@@ -325,6 +368,7 @@ mm_port_probe_set_result_mbim (MMPortProbe *self,
 typedef struct {
     /* ---- Generic task context ---- */
     guint32 flags;
+    guint32 requested_flags;
     guint source_id;
     GCancellable *cancellable;
 
@@ -358,6 +402,8 @@ typedef struct {
     /* Current AT Result processor */
     void (* at_result_processor) (MMPortProbe *self,
                                   GVariant *result);
+    /* Flag to restore the verbose response format after calibration */
+    gboolean at_restore_format;
 
 #if defined WITH_QMI
     /* ---- QMI probing specific context ---- */
@@ -368,11 +414,17 @@ typedef struct {
     /* ---- MBIM probing specific context ---- */
     MMPortMbim *mbim_port;
 #endif
+
+    /* ---- Probing trace ---- */
+    gint64 trace_start;
+    const gchar *trace_stage;
+    gint64 trace_stage_start;
 } PortProbeRunContext;
 
-static gboolean serial_probe_at       (MMPortProbe *self);
-static gboolean serial_probe_qcdm     (MMPortProbe *self);
-static void     serial_probe_schedule (MMPortProbe *self);
+static gboolean serial_probe_at         (MMPortProbe *self);
+static gboolean serial_probe_qcdm       (MMPortProbe *self);
+static void     serial_probe_schedule   (MMPortProbe *self);
+static void     port_probe_run_dispatch (MMPortProbe *self);
 
 static void
 port_probe_run_context_free (PortProbeRunContext *ctx)
@@ -422,6 +474,49 @@ port_probe_run_context_free (PortProbeRunContext *ctx)
     g_slice_free (PortProbeRunContext, ctx);
 }
 
+/***************************************************************/
+/* Probing trace */
+
+static void
+port_probe_trace_stage (MMPortProbe         *self,
+                        PortProbeRunContext *ctx,
+                        const gchar         *stage)
+{
+    gint64 now;
+
+    if (!mm_probe_trace_is_enabled ())
+        return;
+
+    now = g_get_monotonic_time ();
+    if (ctx->trace_stage)
+        mm_probe_trace_add (mm_device_get_uid (self->priv->device),
+                            mm_kernel_device_get_name (self->priv->port),
+                            ctx->trace_stage,
+                            ctx->trace_stage_start,
+                            NULL);
+    ctx->trace_stage = stage;
+    ctx->trace_stage_start = now;
+}
+
+static void
+port_probe_trace_finish (MMPortProbe *self,
+                         GTask       *task,
+                         const gchar *result)
+{
+    PortProbeRunContext *ctx;
+
+    if (!mm_probe_trace_is_enabled ())
+        return;
+
+    ctx = g_task_get_task_data (task);
+    port_probe_trace_stage (self, ctx, NULL);
+    mm_probe_trace_add (mm_device_get_uid (self->priv->device),
+                        mm_kernel_device_get_name (self->priv->port),
+                        "port probing",
+                        ctx->trace_start,
+                        result);
+}
+
 /***************************************************************/
 /* QMI & MBIM */
 
@@ -469,6 +564,7 @@ wdm_probe_qmi (MMPortProbe *self)
     ctx = g_task_get_task_data (self->priv->task);
 
 #if defined WITH_QMI
+    port_probe_trace_stage (self, ctx, "QMI open");
     mm_dbg ("(%s/%s) probing QMI...",
             mm_kernel_device_get_subsystem (self->priv->port),
             mm_kernel_device_get_name (self->priv->port));
@@ -545,6 +641,7 @@ wdm_probe_mbim (MMPortProbe *self)
     ctx = g_task_get_task_data (self->priv->task);
 
 #if defined WITH_MBIM
+    port_probe_trace_stage (self, ctx, "MBIM open");
     mm_dbg ("(%s/%s) probing MBIM...",
             mm_kernel_device_get_subsystem (self->priv->port),
             mm_kernel_device_get_name (self->priv->port));
@@ -663,6 +760,17 @@ serial_probe_qcdm_parse_response (MMPortSerialQcdm *port,
 
     /* Set probing result */
     mm_port_probe_set_result_qcdm (self, is_qcdm);
+
+    /* If the port was wrongly reported as QCDM in the cache, AT probing is
+     * needed again */
+    if ((ctx->flags & MM_PORT_PROBE_AT) &&
+        !(self->priv->flags & MM_PORT_PROBE_AT)) {
+        mm_port_serial_close (ctx->serial);
+        g_clear_object (&ctx->serial);
+        port_probe_run_dispatch (self);
+        return;
+    }
+
     /* Reschedule probing */
     serial_probe_schedule (self);
 }
@@ -685,6 +793,7 @@ serial_probe_qcdm (MMPortProbe *self)
     if (port_probe_task_return_error_if_cancelled (self))
         return G_SOURCE_REMOVE;
 
+    port_probe_trace_stage (self, ctx, "QCDM");
     mm_dbg ("(%s/%s) probing QCDM...",
             mm_kernel_device_get_subsystem (self->priv->port),
             mm_kernel_device_get_name (self->priv->port));
@@ -819,6 +928,79 @@ is_non_at_response (const guint8 *data, gsize len)
     return FALSE;
 }
 
+static void
+serial_probe_at_bulk_write_result_processor (MMPortProbe *self,
+                                             GVariant *result)
+{
+    PortProbeRunContext *ctx;
+    gboolean             bulk_write = FALSE;
+
+    g_assert (self->priv->task);
+    ctx = g_task_get_task_data (self->priv->task);
+
+    if (result) {
+        /* If any result given, it must be a boolean */
+        g_assert (g_variant_is_of_type (result, G_VARIANT_TYPE_BOOLEAN));
+        bulk_write = g_variant_get_boolean (result);
+    }
+
+    self->priv->is_at_bulk_write_checked = TRUE;
+    self->priv->is_at_bulk_write = bulk_write;
+
+    mm_dbg ("(%s/%s) port %s full-buffer writes",
+            mm_kernel_device_get_subsystem (self->priv->port),
+            mm_kernel_device_get_name (self->priv->port),
+            bulk_write ? "supports" : "doesn't support");
+
+    /* A mangled calibration line may have left the modem with numeric
+     * responses (e.g. if the last 'V1' lost a byte), so always restore the
+     * verbose format with a paced command before going on */
+    ctx->at_restore_format = TRUE;
+    if (ctx->serial)
+        g_object_set (ctx->serial,
+                      MM_PORT_SERIAL_SEND_CHUNK_SIZE, (guint) 1,
+                      NULL);
+}
+
+static void
+serial_probe_at_restore_format_result_processor (MMPortProbe *self,
+                                                 GVariant *result)
+{
+    PortProbeRunContext *ctx;
+
+    g_assert (self->priv->task);
+    ctx = g_task_get_task_data (self->priv->task);
+
+    ctx->at_restore_format = FALSE;
+
+    /* Go on with full-buffer writes only if calibration succeeded */
+    if (self->priv->is_at_bulk_write && ctx->serial)
+        g_object_set (ctx->serial,
+                      MM_PORT_SERIAL_SEND_CHUNK_SIZE, (guint) 0,
+                      NULL);
+}
+
+static void
+serial_probe_at_concat_result_processor (MMPortProbe *self,
+                                         GVariant *result)
+{
+    gboolean concat = FALSE;
+
+    if (result) {
+        /* If any result given, it must be a boolean */
+        g_assert (g_variant_is_of_type (result, G_VARIANT_TYPE_BOOLEAN));
+        concat = g_variant_get_boolean (result);
+    }
+
+    self->priv->is_at_concat_checked = TRUE;
+    self->priv->is_at_concat = concat;
+
+    mm_dbg ("(%s/%s) port %s command concatenation",
+            mm_kernel_device_get_subsystem (self->priv->port),
+            mm_kernel_device_get_name (self->priv->port),
+            concat ? "supports" : "doesn't support");
+}
+
 static void
 serial_probe_at_icera_result_processor (MMPortProbe *self,
                                         GVariant *result)
@@ -1023,6 +1205,77 @@ static const MMPortProbeAtCommand product_probing[] = {
     { NULL }
 };
 
+static gboolean
+serial_probe_at_bulk_write_response_processor (const gchar *command,
+                                               const gchar *response,
+                                               gboolean last_command,
+                                               const GError *error,
+                                               GVariant **result,
+                                               GError **result_error)
+{
+    /* Any error (including known ones, e.g. ERROR due to a mangled command)
+     * means full-buffer writes can't be trusted; never abort probing here */
+    *result = g_variant_new_boolean (!error);
+    return TRUE;
+}
+
+/* Full-buffer write calibration: a long command line made of settings we
+ * rely on anyway (result codes enabled, verbose format), which any mangled
+ * byte during an unpaced write will turn into an ERROR or no reply at all. */
+static const MMPortProbeAtCommand bulk_write_probing[] = {
+    { "Q0V1Q0V1Q0V1Q0V1Q0V1Q0V1Q0V1", 3, serial_probe_at_bulk_write_response_processor },
+    { NULL }
+};
+
+static gboolean
+serial_probe_at_restore_format_response_processor (const gchar *command,
+                                                   const gchar *response,
+                                                   gboolean last_command,
+                                                   const GError *error,
+                                                   GVariant **result,
+                                                   GError **result_error)
+{
+    /* If the modem was in numeric mode the reply may not even be parsed,
+     * but the command is still run; never abort probing here */
+    *result = NULL;
+    return TRUE;
+}
+
+static const MMPortProbeAtCommand restore_format_probing[] = {
+    { "V1", 3, serial_probe_at_restore_format_response_processor },
+    { NULL }
+};
+
+static gboolean
+serial_probe_at_concat_response_processor (const gchar *command,
+                                           const gchar *response,
+                                           gboolean last_command,
+                                           const GError *error,
+                                           GVariant **result,
+                                           GError **result_error)
+{
+    static const gchar *commands[] = { "+CMEE?", "+CSCS?" };
+    gchar **split;
+    gboolean concat = FALSE;
+
+    /* Two different side-effect free queries in the same line; both replies
+     * must come back, in order, before the single final result code */
+    if (!error) {
+        split = mm_split_concatenated_response (response, commands, G_N_ELEMENTS (commands));
+        concat = (split && split[0][0] && split[1][0]);
+        g_strfreev (split);
+    }
+
+    /* Never abort probing here */
+    *result = g_variant_new_boolean (concat);
+    return TRUE;
+}
+
+static const MMPortProbeAtCommand concat_probing[] = {
+    { "+CMEE?;+CSCS?", 3, serial_probe_at_concat_response_processor },
+    { NULL }
+};
+
 static const MMPortProbeAtCommand icera_probing[] = {
     { "%IPSYS?", 3, mm_port_probe_response_processor_string },
     { "%IPSYS?", 3, mm_port_probe_response_processor_string },
@@ -1057,6 +1310,7 @@ static void
 serial_probe_schedule (MMPortProbe *self)
 {
     PortProbeRunContext *ctx;
+    const gchar         *stage = NULL;
 
     g_assert (self->priv->task);
     ctx = g_task_get_task_data (self->priv->task);
@@ -1070,6 +1324,7 @@ serial_probe_schedule (MMPortProbe *self)
     if (!ctx->at_custom_init_run &&
         ctx->at_custom_init &&
         ctx->at_custom_init_finish) {
+        port_probe_trace_stage (self, ctx, "AT custom init");
         ctx->at_custom_init (self,
                              MM_PORT_SERIAL_AT (ctx->serial),
                              ctx->at_probing_cancellable,
@@ -1092,6 +1347,38 @@ serial_probe_schedule (MMPortProbe *self)
         else
             ctx->at_commands = at_probing;
         ctx->at_result_processor = serial_probe_at_result_processor;
+        stage = "AT";
+    }
+    /* Port is AT, paced writes configured and full-buffer writes not
+     * checked yet? */
+    else if (self->priv->is_at &&
+             !self->priv->is_at_bulk_write_checked &&
+             ctx->at_send_delay > 0 &&
+             MM_IS_PORT_SERIAL_AT (ctx->serial) &&
+             mm_port_get_subsys (MM_PORT (ctx->serial)) == MM_PORT_SUBSYS_TTY) {
+        /* Prepare full-buffer write calibration; the remaining probing
+         * commands will also be sent unpaced if this succeeds */
+        g_object_set (ctx->serial,
+                      MM_PORT_SERIAL_SEND_CHUNK_SIZE, (guint) 0,
+                      NULL);
+        ctx->at_result_processor = serial_probe_at_bulk_write_result_processor;
+        ctx->at_commands = bulk_write_probing;
+        stage = "AT bulk write";
+    }
+    /* Full-buffer write calibration just run? */
+    else if (ctx->at_restore_format) {
+        /* Restore verbose responses, always with paced writes */
+        ctx->at_result_processor = serial_probe_at_restore_format_result_processor;
+        ctx->at_commands = restore_format_probing;
+        stage = "AT format restore";
+    }
+    /* Port is AT and command concatenation not checked yet? */
+    else if (self->priv->is_at &&
+             !self->priv->is_at_concat_checked &&
+             MM_IS_PORT_SERIAL_AT (ctx->serial)) {
+        ctx->at_result_processor = serial_probe_at_concat_result_processor;
+        ctx->at_commands = concat_probing;
+        stage = "AT concat";
     }
     /* Vendor requested and not already probed? */
     else if ((ctx->flags & MM_PORT_PROBE_AT_VENDOR) &&
@@ -1099,6 +1386,7 @@ serial_probe_schedule (MMPortProbe *self)
         /* Prepare AT vendor probing */
         ctx->at_result_processor = serial_probe_at_vendor_result_processor;
         ctx->at_commands = vendor_probing;
+        stage = "AT vendor";
     }
     /* Product requested and not already probed? */
     else if ((ctx->flags & MM_PORT_PROBE_AT_PRODUCT) &&
@@ -1106,6 +1394,7 @@ serial_probe_schedule (MMPortProbe *self)
         /* Prepare AT product probing */
         ctx->at_result_processor = serial_probe_at_product_result_processor;
         ctx->at_commands = product_probing;
+        stage = "AT product";
     }
     /* Icera support check requested and not already done? */
     else if ((ctx->flags & MM_PORT_PROBE_AT_ICERA) &&
@@ -1115,11 +1404,13 @@ serial_probe_schedule (MMPortProbe *self)
         ctx->at_commands = icera_probing;
         /* By default, wait 2 seconds between ICERA probing retries */
         ctx->at_commands_wait_secs = 2;
+        stage = "AT icera";
     }
 
     /* If a next AT group detected, go for it */
     if (ctx->at_result_processor &&
         ctx->at_commands) {
+        port_probe_trace_stage (self, ctx, stage);
         ctx->source_id = g_idle_add ((GSourceFunc) serial_probe_at, self);
         return;
     }
@@ -1204,6 +1495,8 @@ serial_open_at (MMPortProbe *self)
         gpointer parser;
         MMPortSubsys subsys = MM_PORT_SUBSYS_TTY;
 
+        port_probe_trace_stage (self, ctx, "AT open");
+
         if (g_str_has_prefix (mm_kernel_device_get_subsystem (self->priv->port), "usb"))
             subsys = MM_PORT_SUBSYS_USB;
 
@@ -1219,10 +1512,11 @@ serial_open_at (MMPortProbe *self)
         }
 
         g_object_set (ctx->serial,
-                      MM_PORT_SERIAL_SPEW_CONTROL,   TRUE,
-                      MM_PORT_SERIAL_SEND_DELAY,     (subsys == MM_PORT_SUBSYS_TTY ? ctx->at_send_delay : 0),
-                      MM_PORT_SERIAL_AT_REMOVE_ECHO, ctx->at_remove_echo,
-                      MM_PORT_SERIAL_AT_SEND_LF,     ctx->at_send_lf,
+                      MM_PORT_SERIAL_SPEW_CONTROL,    TRUE,
+                      MM_PORT_SERIAL_SEND_DELAY,      (subsys == MM_PORT_SUBSYS_TTY ? ctx->at_send_delay : 0),
+                      MM_PORT_SERIAL_SEND_CHUNK_SIZE, (guint) (self->priv->is_at_bulk_write ? 0 : 1),
+                      MM_PORT_SERIAL_AT_REMOVE_ECHO,  ctx->at_remove_echo,
+                      MM_PORT_SERIAL_AT_SEND_LF,      ctx->at_send_lf,
                       NULL);
 
         if (mm_kernel_device_has_property (self->priv->port, "ID_MM_TTY_BAUDRATE"))
@@ -1230,14 +1524,16 @@ serial_open_at (MMPortProbe *self)
                           MM_PORT_SERIAL_BAUD, mm_kernel_device_get_property_as_int (self->priv->port, "ID_MM_TTY_BAUDRATE"),
                           NULL);
 
-        parser = mm_serial_parser_v1_new ();
-        mm_serial_parser_v1_add_filter (parser,
+        parser = mm_serial_parser_v2_new ();
+        mm_serial_parser_v2_add_filter (parser,
                                         serial_parser_filter_cb,
                                         NULL);
         mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (ctx->serial),
-                                               mm_serial_parser_v1_parse,
+                                               mm_serial_parser_v2_parse,
                                                parser,
-                                               mm_serial_parser_v1_destroy);
+                                               mm_serial_parser_v2_destroy);
+        mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (ctx->serial),
+                                              mm_serial_parser_v2_reset);
     }
 
     /* Try to open the port */
@@ -1323,6 +1619,49 @@ mm_port_probe_run_finish (MMPortProbe   *self,
     return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+static void
+port_probe_run_dispatch (MMPortProbe *self)
+{
+    PortProbeRunContext *ctx;
+    guint32              pending;
+
+    ctx = g_task_get_task_data (self->priv->task);
+    pending = ctx->flags & ~self->priv->flags;
+
+    /* If any AT probing is needed, start by opening as AT port */
+    if (pending & MM_PORT_PROBE_AT ||
+        pending & MM_PORT_PROBE_AT_VENDOR ||
+        pending & MM_PORT_PROBE_AT_PRODUCT ||
+        pending & MM_PORT_PROBE_AT_ICERA) {
+        if (!ctx->at_probing_cancellable) {
+            ctx->at_probing_cancellable = g_cancellable_new ();
+            /* If the main cancellable is cancelled, so will be the at-probing one */
+            if (ctx->cancellable)
+                ctx->at_probing_cancellable_linked = g_cancellable_connect (ctx->cancellable,
+                                                                            (GCallback) at_cancellable_cancel,
+                                                                            g_object_ref (ctx->at_probing_cancellable),
+                                                                            g_object_unref);
+        }
+        ctx->source_id = g_idle_add ((GSourceFunc) serial_open_at, self);
+        return;
+    }
+
+    /* If QCDM probing needed, start by opening as QCDM port */
+    if (pending & MM_PORT_PROBE_QCDM) {
+        ctx->source_id = g_idle_add ((GSourceFunc) serial_probe_qcdm, self);
+        return;
+    }
+
+    /* If QMI/MBIM probing needed, go on */
+    if (pending & MM_PORT_PROBE_QMI || pending & MM_PORT_PROBE_MBIM) {
+        ctx->source_id = g_idle_add ((GSourceFunc) wdm_probe, self);
+        return;
+    }
+
+    /* Shouldn't happen */
+    g_assert_not_reached ();
+}
+
 void
 mm_port_probe_run (MMPortProbe                *self,
                    MMPortProbeFlag             flags,
@@ -1353,10 +1692,12 @@ mm_port_probe_run (MMPortProbe                *self,
     ctx->at_remove_echo = at_remove_echo;
     ctx->at_send_lf = at_send_lf;
     ctx->flags = MM_PORT_PROBE_NONE;
+    ctx->requested_flags = flags;
     ctx->at_custom_probe = at_custom_probe;
     ctx->at_custom_init = at_custom_init ? (MMPortProbeAtCustomInit)at_custom_init->async : NULL;
     ctx->at_custom_init_finish = at_custom_init ? (MMPortProbeAtCustomInitFinish)at_custom_init->finish : NULL;
     ctx->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+    ctx->trace_start = g_get_monotonic_time ();
 
     /* The context will be owned by the task */
     g_task_set_task_data (self->priv->task, ctx, (GDestroyNotify) port_probe_run_context_free);
@@ -1395,36 +1736,7 @@ mm_port_probe_run (MMPortProbe                *self,
             probe_list_str);
     g_free (probe_list_str);
 
-    /* If any AT probing is needed, start by opening as AT port */
-    if (ctx->flags & MM_PORT_PROBE_AT ||
-        ctx->flags & MM_PORT_PROBE_AT_VENDOR ||
-        ctx->flags & MM_PORT_PROBE_AT_PRODUCT ||
-        ctx->flags & MM_PORT_PROBE_AT_ICERA) {
-        ctx->at_probing_cancellable = g_cancellable_new ();
-        /* If the main cancellable is cancelled, so will be the at-probing one */
-        if (cancellable)
-            ctx->at_probing_cancellable_linked = g_cancellable_connect (cancellable,
-                                                                        (GCallback) at_cancellable_cancel,
-                                                                        g_object_ref (ctx->at_probing_cancellable),
-                                                                        g_object_unref);
-        ctx->source_id = g_idle_add ((GSourceFunc) serial_open_at, self);
-        return;
-    }
-
-    /* If QCDM probing needed, start by opening as QCDM port */
-    if (ctx->flags & MM_PORT_PROBE_QCDM) {
-        ctx->source_id = g_idle_add ((GSourceFunc) serial_probe_qcdm, self);
-        return;
-    }
-
-    /* If QMI/MBIM probing needed, go on */
-    if (ctx->flags & MM_PORT_PROBE_QMI || ctx->flags & MM_PORT_PROBE_MBIM) {
-        ctx->source_id = g_idle_add ((GSourceFunc) wdm_probe, self);
-        return;
-    }
-
-    /* Shouldn't happen */
-    g_assert_not_reached ();
+    port_probe_run_dispatch (self);
 }
 
 gboolean
@@ -1619,6 +1931,22 @@ mm_port_probe_get_port (MMPortProbe *self)
     return MM_KERNEL_DEVICE (g_object_ref (self->priv->port));
 };
 
+gboolean
+mm_port_probe_is_at_bulk_write (MMPortProbe *self)
+{
+    g_return_val_if_fail (MM_IS_PORT_PROBE (self), FALSE);
+
+    return self->priv->is_at_bulk_write;
+}
+
+gboolean
+mm_port_probe_is_at_concat (MMPortProbe *self)
+{
+    g_return_val_if_fail (MM_IS_PORT_PROBE (self), FALSE);
+
+    return self->priv->is_at_concat;
+}
+
 const gchar *
 mm_port_probe_get_vendor (MMPortProbe *self)
 {
@@ -1717,16 +2045,141 @@ mm_port_probe_get_parent_path (MMPortProbe *self)
     return mm_kernel_device_get_parent_sysfs_path (self->priv->port);
 }
 
+/*****************************************************************************/
+/* Persistent probing results */
+
+static void
+port_probe_cached_results_stale (MMPortProbe     *self,
+                                 MMPortProbeFlag  probed)
+{
+    mm_dbg ("(%s/%s) cached probing results are stale",
+            mm_kernel_device_get_subsystem (self->priv->port),
+            mm_kernel_device_get_name (self->priv->port));
+    mm_port_probe_forget_cached_results (self);
+
+    /* Only the result being set is kept; everything else requested in the
+     * ongoing probing gets probed again */
+    self->priv->flags &= probed;
+    self->priv->is_at_bulk_write_checked = FALSE;
+    self->priv->is_at_bulk_write = FALSE;
+    self->priv->is_at_concat_checked = FALSE;
+    self->priv->is_at_concat = FALSE;
+    if (self->priv->task) {
+        PortProbeRunContext *ctx;
+
+        ctx = g_task_get_task_data (self->priv->task);
+        ctx->flags = ctx->requested_flags;
+    }
+}
+
+static void
+port_probe_load_cached_results (MMPortProbe *self)
+{
+    MMPortProbeCacheEntry entry;
+
+    if (self->priv->is_ignored)
+        return;
+
+    self->priv->cache_key = mm_port_probe_cache_build_key (self->priv->port);
+    if (!self->priv->cache_key || !mm_port_probe_cache_lookup (self->priv->cache_key, &entry))
+        return;
+
+    mm_dbg ("(%s/%s) probing results loaded from cache (plugin: %s)",
+            mm_kernel_device_get_subsystem (self->priv->port),
+            mm_kernel_device_get_name (self->priv->port),
+            entry.plugin);
+
+    self->priv->flags = entry.flags;
+    self->priv->is_at = entry.is_at;
+    self->priv->is_qcdm = entry.is_qcdm;
+    self->priv->is_qmi = entry.is_qmi;
+    self->priv->is_mbim = entry.is_mbim;
+    self->priv->is_icera = entry.is_icera;
+    self->priv->is_at_bulk_write_checked = entry.is_at;
+    self->priv->is_at_bulk_write = entry.is_at_bulk_write;
+    self->priv->is_at_concat_checked = entry.is_at;
+    self->priv->is_at_concat = entry.is_at_concat;
+
+    /* Transfer ownership of the strings */
+    self->priv->vendor = entry.vendor;
+    self->priv->product = entry.product;
+    self->priv->cached_plugin = entry.plugin;
+    self->priv->from_cache = TRUE;
+
+    /* Cached results are validated by running again only the cheap probing
+     * of the port type found, i.e. AT, QCDM, QMI or MBIM; if the port doesn't
+     * reply as expected, all cached results get discarded */
+    if (self->priv->is_at)
+        self->priv->flags &= ~MM_PORT_PROBE_AT;
+    else if (self->priv->is_qcdm)
+        self->priv->flags &= ~MM_PORT_PROBE_QCDM;
+    else if (self->priv->is_qmi)
+        self->priv->flags &= ~MM_PORT_PROBE_QMI;
+    else if (self->priv->is_mbim)
+        self->priv->flags &= ~MM_PORT_PROBE_MBIM;
+}
+
+const gchar *
+mm_port_probe_get_cached_plugin (MMPortProbe *self)
+{
+    g_return_val_if_fail (MM_IS_PORT_PROBE (self), NULL);
+
+    return self->priv->cached_plugin;
+}
+
+void
+mm_port_probe_save_results (MMPortProbe *self,
+                            const gchar *plugin_name)
+{
+    MMPortProbeCacheEntry entry;
+
+    g_return_if_fail (MM_IS_PORT_PROBE (self));
+    g_return_if_fail (plugin_name != NULL);
+
+    if (!self->priv->cache_key || self->priv->is_ignored || !self->priv->flags)
+        return;
+
+    memset (&entry, 0, sizeof (entry));
+    entry.flags = self->priv->flags;
+    entry.is_at = self->priv->is_at;
+    entry.is_qcdm = self->priv->is_qcdm;
+    entry.is_qmi = self->priv->is_qmi;
+    entry.is_mbim = self->priv->is_mbim;
+    entry.is_icera = self->priv->is_icera;
+    entry.vendor = self->priv->vendor;
+    entry.product = self->priv->product;
+    entry.is_at_bulk_write = self->priv->is_at_bulk_write;
+    entry.is_at_concat = self->priv->is_at_concat;
+    entry.plugin = (gchar *) plugin_name;
+
+    mm_port_probe_cache_store (self->priv->cache_key, &entry);
+}
+
+void
+mm_port_probe_forget_cached_results (MMPortProbe *self)
+{
+    g_return_if_fail (MM_IS_PORT_PROBE (self));
+
+    if (self->priv->cache_key)
+        mm_port_probe_cache_remove (self->priv->cache_key);
+    self->priv->from_cache = FALSE;
+    g_clear_pointer (&self->priv->cached_plugin, g_free);
+}
+
 /*****************************************************************************/
 
 MMPortProbe *
 mm_port_probe_new (MMDevice       *device,
                    MMKernelDevice *port)
 {
-    return MM_PORT_PROBE (g_object_new (MM_TYPE_PORT_PROBE,
+    MMPortProbe *self;
+
+    self = MM_PORT_PROBE (g_object_new (MM_TYPE_PORT_PROBE,
                                         MM_PORT_PROBE_DEVICE, device,
                                         MM_PORT_PROBE_PORT,   port,
                                         NULL));
+    port_probe_load_cached_results (self);
+    return self;
 }
 
 static void
@@ -1792,6 +2245,8 @@ finalize (GObject *object)
 
     g_free (self->priv->vendor);
     g_free (self->priv->product);
+    g_free (self->priv->cache_key);
+    g_free (self->priv->cached_plugin);
 
     G_OBJECT_CLASS (mm_port_probe_parent_class)->finalize (object);
 }
@@ -132,6 +132,14 @@ const gchar  *mm_port_probe_get_vendor       (MMPortProbe *self);
 const gchar  *mm_port_probe_get_product      (MMPortProbe *self);
 gboolean      mm_port_probe_is_icera         (MMPortProbe *self);
 gboolean      mm_port_probe_is_ignored       (MMPortProbe *self);
+gboolean      mm_port_probe_is_at_bulk_write (MMPortProbe *self);
+gboolean      mm_port_probe_is_at_concat     (MMPortProbe *self);
+
+/* Persistent probing results */
+const gchar *mm_port_probe_get_cached_plugin     (MMPortProbe *self);
+void         mm_port_probe_save_results          (MMPortProbe *self,
+                                                  const gchar *plugin_name);
+void         mm_port_probe_forget_cached_results (MMPortProbe *self);
 
 /* Additional helpers */
 gboolean mm_port_probe_list_has_at_port   (GList *list);
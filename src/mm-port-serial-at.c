@@ -32,24 +32,36 @@ enum {
     PROP_INIT_SEQUENCE_ENABLED,
     PROP_INIT_SEQUENCE,
     PROP_SEND_LF,
+    PROP_CONCATENATION,
     LAST_PROP
 };
 
+typedef struct _UnsolicitedMsgIndexNode UnsolicitedMsgIndexNode;
+
 struct _MMPortSerialAtPrivate {
     /* Response parser data */
     MMPortSerialAtResponseParserFn response_parser_fn;
+    MMPortSerialAtResponseCheckFn response_check_fn;
+    MMPortSerialAtResponseResetFn response_reset_fn;
+    guint response_removals;
     gpointer response_parser_user_data;
     GDestroyNotify response_parser_notify;
 
     GSList *unsolicited_msg_handlers;
+    UnsolicitedMsgIndexNode *unsolicited_msg_index;
+    gboolean unsolicited_msg_index_dirty;
 
     MMPortSerialAtFlag flags;
 
+    /* Reply cache expiration per command, in seconds */
+    GHashTable *reply_cache_ttls;
+
     /* Properties */
     gboolean remove_echo;
     guint init_sequence_enabled;
     gchar **init_sequence;
     gboolean send_lf;
+    gboolean concatenation;
 };
 
 /*****************************************************************************/
@@ -91,25 +103,56 @@ mm_port_serial_at_set_response_parser (MMPortSerialAt *self,
     if (self->priv->response_parser_notify)
         self->priv->response_parser_notify (self->priv->response_parser_user_data);
 
+    /* The check and reset functions work on the user data of the previous
+     * parser, so they're dropped; they must be set again afterwards */
+    if (self->priv->response_check_fn || self->priv->response_reset_fn)
+        mm_dbg ("(%s) response parser replaced: check and reset functions dropped",
+                mm_port_get_device (MM_PORT (self)));
+
     self->priv->response_parser_fn = fn;
+    self->priv->response_check_fn = NULL;
+    self->priv->response_reset_fn = NULL;
     self->priv->response_parser_user_data = user_data;
     self->priv->response_parser_notify = notify;
 }
 
 void
-mm_port_serial_at_remove_echo (GByteArray *response)
+mm_port_serial_at_set_response_check (MMPortSerialAt *self,
+                                      MMPortSerialAtResponseCheckFn fn)
 {
-    guint i;
+    g_return_if_fail (MM_IS_PORT_SERIAL_AT (self));
+    g_return_if_fail (self->priv->response_parser_fn != NULL);
+
+    self->priv->response_check_fn = fn;
+}
+
+void
+mm_port_serial_at_set_response_reset (MMPortSerialAt *self,
+                                      MMPortSerialAtResponseResetFn fn)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL_AT (self));
+    g_return_if_fail (self->priv->response_parser_fn != NULL);
+
+    self->priv->response_reset_fn = fn;
+}
+
+void
+mm_port_serial_at_remove_echo (MMPortSerialBuffer *response)
+{
+    const guint8 *data;
+    gsize len;
+    gsize i;
 
-    if (response->len <= 2)
+    data = mm_port_serial_buffer_peek (response, &len);
+    if (len <= 2)
         return;
 
-    for (i = 0; i < (response->len - 1); i++) {
+    for (i = 0; i < (len - 1); i++) {
         /* If there is any content before the first
          * <CR><LF>, assume it's echo or garbage, and skip it */
-        if (response->data[i] == '\r' && response->data[i + 1] == '\n') {
+        if (data[i] == '\r' && data[i + 1] == '\n') {
             if (i > 0)
-                g_byte_array_remove_range (response, 0, i);
+                mm_port_serial_buffer_consume (response, i);
             /* else, good, we're already started with <CR><LF> */
             break;
         }
@@ -118,12 +161,14 @@ mm_port_serial_at_remove_echo (GByteArray *response)
 
 static MMPortSerialResponseType
 parse_response (MMPortSerial *port,
-                GByteArray *response,
+                MMPortSerialBuffer *response,
                 GByteArray **parsed_response,
                 GError **error)
 {
     MMPortSerialAt *self = MM_PORT_SERIAL_AT (port);
     GString *string;
+    const guint8 *data;
+    gsize len;
     gsize parsed_len;
     GError *inner_error = NULL;
 
@@ -133,28 +178,49 @@ parse_response (MMPortSerial *port,
     if (self->priv->remove_echo)
         mm_port_serial_at_remove_echo (response);
 
+    /* If any content was removed from the response since the last time
+     * (e.g. echo, unsolicited messages or a full reply), whatever the parser
+     * kept from previous calls is no longer valid */
+    if (mm_port_serial_buffer_get_removals (response) != self->priv->response_removals) {
+        self->priv->response_removals = mm_port_serial_buffer_get_removals (response);
+        if (self->priv->response_reset_fn)
+            self->priv->response_reset_fn (self->priv->response_parser_user_data);
+    }
+
     /* If there's no response to receive, we're done; e.g. if we only got
      * unsolicited messages */
-    if (!response->len)
+    data = mm_port_serial_buffer_peek (response, &len);
+    if (!len)
         return MM_PORT_SERIAL_RESPONSE_NONE;
 
-    /* Construct the string that AT-parsing functions expect */
-    string = g_string_sized_new (response->len + 1);
-    g_string_append_len (string, (const char *) response->data, response->len);
+    /* Don't copy the whole response for the parser until it may be complete,
+     * or we would be copying it again and again while a long response is
+     * being received */
+    if (self->priv->response_check_fn &&
+        !self->priv->response_check_fn (self->priv->response_parser_user_data, (const gchar *) data, len))
+        return MM_PORT_SERIAL_RESPONSE_NONE;
 
-    /* Fully cleanup the response array, we'll consider the contents we got
-     * as the full reply that the command may expect. */
-    g_byte_array_remove_range (response, 0, response->len);
+    /* Construct the string that AT-parsing functions expect */
+    string = g_string_sized_new (len + 1);
+    g_string_append_len (string, (const char *) data, len);
 
     /* Parse it; returns FALSE if there is nothing we can do with this
      * response yet. */
     if (!self->priv->response_parser_fn (self->priv->response_parser_user_data, string, &inner_error)) {
-        /* Copy what we got back in the response buffer. */
-        g_byte_array_append (response, (const guint8 *) string->str, string->len);
+        /* The parser may have cleaned up the string (e.g. leading NULs), if
+         * so, keep its contents as the new response buffer. */
+        if (string->len != len) {
+            mm_port_serial_buffer_clear (response);
+            mm_port_serial_buffer_append (response, (const guint8 *) string->str, string->len);
+        }
         g_string_free (string, TRUE);
         return MM_PORT_SERIAL_RESPONSE_NONE;
     }
 
+    /* Fully cleanup the response buffer, we'll consider the contents we got
+     * as the full reply that the command may expect. */
+    mm_port_serial_buffer_clear (response);
+
     /* If we got an error, propagate it without any further response string */
     if (inner_error) {
         g_string_free (string, TRUE);
@@ -162,7 +228,9 @@ parse_response (MMPortSerial *port,
         return MM_PORT_SERIAL_RESPONSE_ERROR;
     }
 
-    /* Otherwise, build a new GByteArray considered as parsed response */
+    /* Otherwise, build a new GByteArray considered as parsed response. The
+     * GString contents are taken as they are, including the trailing NUL
+     * byte that mm_port_serial_at_command_finish() relies on. */
     parsed_len = string->len;
     *parsed_response = g_byte_array_new_take ((guint8 *) g_string_free (string, FALSE), parsed_len);
     return MM_PORT_SERIAL_RESPONSE_BUFFER;
@@ -172,12 +240,253 @@ parse_response (MMPortSerial *port,
 
 typedef struct {
     GRegex *regex;
+    gchar *prefix;
+    gboolean candidate;
     MMPortSerialAtUnsolicitedMsgFn callback;
     gboolean enable;
     gpointer user_data;
     GDestroyNotify notify;
 } MMAtUnsolicitedMsgHandler;
 
+/*****************************************************************************/
+/* Unsolicited message index
+ *
+ * Most unsolicited message handlers are given as regexes matching a whole
+ * line which starts with a literal prefix, e.g. "\r\n\+CREG:...". Instead
+ * of running every handler regex on the whole response buffer after each read,
+ * the literal prefixes are indexed in a trie, and the buffer is scanned once
+ * looking for line starts matching any of them. Only the handlers whose prefix
+ * was found, plus those without a usable prefix, get their regex run.
+ */
+
+struct _UnsolicitedMsgIndexNode {
+    guint8 c;
+    /* Handlers whose prefix ends in this node */
+    GSList *handlers;
+    UnsolicitedMsgIndexNode *child;
+    UnsolicitedMsgIndexNode *next;
+};
+
+static gboolean
+pattern_has_toplevel_alternation (const gchar *p)
+{
+    guint depth = 0;
+    gboolean in_class = FALSE;
+
+    for (; *p; p++) {
+        if (*p == '\\') {
+            if (!*(++p))
+                break;
+        } else if (in_class) {
+            if (*p == ']')
+                in_class = FALSE;
+        } else if (*p == '[')
+            in_class = TRUE;
+        else if (*p == '(')
+            depth++;
+        else if (*p == ')' && depth > 0)
+            depth--;
+        else if (*p == '|' && depth == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+gchar *
+mm_port_serial_at_build_unsolicited_msg_prefix (GRegex *regex)
+{
+    const gchar *p;
+    GString *prefix;
+
+    /* Compile flags changing how literals match can't be indexed */
+    if (g_regex_get_compile_flags (regex) & (G_REGEX_CASELESS | G_REGEX_EXTENDED))
+        return NULL;
+
+    /* A top-level alternation may match without the prefix */
+    if (pattern_has_toplevel_alternation (g_regex_get_pattern (regex)))
+        return NULL;
+
+    /* Only regexes matching right after a <CR><LF> can be indexed */
+    p = g_regex_get_pattern (regex);
+    if (g_str_has_prefix (p, "\\r\\n"))
+        p += 4;
+    else if (g_str_has_prefix (p, "\r\n"))
+        p += 2;
+    else
+        return NULL;
+
+    prefix = g_string_new (NULL);
+    while (*p) {
+        gchar c;
+
+        if ((guint8) *p >= 0x80)
+            break;
+
+        if (*p == '\\') {
+            /* Escaped non-alphanumeric chars are literals; anything else is a
+             * special sequence, e.g. \s or \d */
+            if (!p[1] || !g_ascii_ispunct (p[1]))
+                break;
+            c = p[1];
+            p += 2;
+        } else if (strchr (".^$*+?()[]{}|", *p))
+            break;
+        else
+            c = *p++;
+
+        /* Quantifiers which make the last char optional end the prefix
+         * without it */
+        if (*p == '*' || *p == '?' || *p == '{')
+            break;
+
+        g_string_append_c (prefix, c);
+
+        /* If repeated, the last char is still required once */
+        if (*p == '+')
+            break;
+    }
+
+    if (!prefix->len) {
+        g_string_free (prefix, TRUE);
+        return NULL;
+    }
+
+    return g_string_free (prefix, FALSE);
+}
+
+static void
+unsolicited_msg_index_free (UnsolicitedMsgIndexNode *node)
+{
+    while (node) {
+        UnsolicitedMsgIndexNode *next;
+
+        next = node->next;
+        unsolicited_msg_index_free (node->child);
+        g_slist_free (node->handlers);
+        g_slice_free (UnsolicitedMsgIndexNode, node);
+        node = next;
+    }
+}
+
+static void
+unsolicited_msg_index_add (UnsolicitedMsgIndexNode  **level,
+                           MMAtUnsolicitedMsgHandler *handler)
+{
+    UnsolicitedMsgIndexNode *node;
+    const gchar *p;
+
+    g_assert (handler->prefix && handler->prefix[0]);
+
+    for (p = handler->prefix; ; level = &node->child) {
+        for (node = *level; node && node->c != (guint8) *p; node = node->next);
+        if (!node) {
+            node = g_slice_new0 (UnsolicitedMsgIndexNode);
+            node->c = (guint8) *p;
+            node->next = *level;
+            *level = node;
+        }
+        if (!*(++p))
+            break;
+    }
+
+    node->handlers = g_slist_prepend (node->handlers, handler);
+}
+
+static void
+unsolicited_msg_index_rebuild (MMPortSerialAt *self)
+{
+    UnsolicitedMsgIndexNode *root = NULL;
+    GSList *l;
+
+    unsolicited_msg_index_free (self->priv->unsolicited_msg_index);
+
+    for (l = self->priv->unsolicited_msg_handlers; l; l = g_slist_next (l)) {
+        MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) l->data;
+
+        if (handler->prefix)
+            unsolicited_msg_index_add (&root, handler);
+    }
+
+    self->priv->unsolicited_msg_index = root;
+    self->priv->unsolicited_msg_index_dirty = FALSE;
+}
+
+static void
+unsolicited_msg_index_lookup (UnsolicitedMsgIndexNode *level,
+                              const guint8            *data,
+                              gsize                    len)
+{
+    gsize i;
+
+    for (i = 0; i < len && level; i++) {
+        UnsolicitedMsgIndexNode *node;
+        GSList *l;
+
+        for (node = level; node && node->c != data[i]; node = node->next);
+        if (!node)
+            return;
+
+        for (l = node->handlers; l; l = g_slist_next (l))
+            ((MMAtUnsolicitedMsgHandler *) l->data)->candidate = TRUE;
+
+        level = node->child;
+    }
+}
+
+/* Flag as candidates the handlers that may match in the response */
+static void
+unsolicited_msg_index_scan (MMPortSerialAt *self,
+                            const guint8   *data,
+                            gsize           len)
+{
+    GSList *l;
+    gsize i;
+
+    /* Handlers without prefix are always candidates */
+    for (l = self->priv->unsolicited_msg_handlers; l; l = g_slist_next (l)) {
+        MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) l->data;
+
+        handler->candidate = !handler->prefix;
+    }
+
+    for (i = 0; i + 2 < len; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n')
+            unsolicited_msg_index_lookup (self->priv->unsolicited_msg_index,
+                                          &data[i + 2],
+                                          len - i - 2);
+    }
+}
+
+/* Remove the given [start,end) ranges from the response, in place */
+static void
+response_remove_ranges (MMPortSerialBuffer *response,
+                        GArray             *ranges)
+{
+    guint8 *data;
+    gsize len;
+    guint i;
+    guint write;
+
+    g_assert (ranges->len > 0 && ranges->len % 2 == 0);
+
+    data = mm_port_serial_buffer_peek (response, &len);
+    write = (guint) g_array_index (ranges, gint, 0);
+    for (i = 0; i < ranges->len; i += 2) {
+        guint end;
+        guint next;
+
+        end = (guint) g_array_index (ranges, gint, i + 1);
+        next = (i + 2 < ranges->len ? (guint) g_array_index (ranges, gint, i + 2) : len);
+        if (next > end) {
+            memmove (&data[write], &data[end], next - end);
+            write += next - end;
+        }
+    }
+
+    mm_port_serial_buffer_truncate (response, write);
+}
+
 static gint
 unsolicited_msg_handler_cmp (MMAtUnsolicitedMsgHandler *handler,
                              GRegex *regex)
@@ -211,9 +520,11 @@ mm_port_serial_at_add_unsolicited_msg_handler (MMPortSerialAt *self,
         /* The new handler is always PREPENDED, so that e.g. plugins can provide
          * more specific matches for URCs that are also handled by the generic
          * plugin. */
-        handler = g_slice_new (MMAtUnsolicitedMsgHandler);
+        handler = g_slice_new0 (MMAtUnsolicitedMsgHandler);
         handler->regex = g_regex_ref (regex);
+        handler->prefix = mm_port_serial_at_build_unsolicited_msg_prefix (regex);
         self->priv->unsolicited_msg_handlers = g_slist_prepend (self->priv->unsolicited_msg_handlers, handler);
+        self->priv->unsolicited_msg_index_dirty = TRUE;
     }
 
     handler->callback = callback;
@@ -242,66 +553,68 @@ mm_port_serial_at_enable_unsolicited_msg_handler (MMPortSerialAt *self,
     }
 }
 
-static gboolean
-remove_eval_cb (const GMatchInfo *match_info,
-                GString *result,
-                gpointer user_data)
-{
-    int *result_len = (int *) user_data;
-    int start;
-    int end;
-
-    if (g_match_info_fetch_pos  (match_info, 0, &start, &end))
-        *result_len -= (end - start);
-
-    return FALSE;
-}
-
 static void
-parse_unsolicited (MMPortSerial *port, GByteArray *response)
+parse_unsolicited (MMPortSerial *port, MMPortSerialBuffer *response)
 {
     MMPortSerialAt *self = MM_PORT_SERIAL_AT (port);
+    const guint8 *data;
+    gsize len;
     GSList *iter;
 
     /* Remove echo */
     if (self->priv->remove_echo)
         mm_port_serial_at_remove_echo (response);
 
+    data = mm_port_serial_buffer_peek (response, &len);
+    if (!len)
+        return;
+
+    if (self->priv->unsolicited_msg_index_dirty)
+        unsolicited_msg_index_rebuild (self);
+    unsolicited_msg_index_scan (self, data, len);
+
     for (iter = self->priv->unsolicited_msg_handlers; iter; iter = iter->next) {
         MMAtUnsolicitedMsgHandler *handler = (MMAtUnsolicitedMsgHandler *) iter->data;
         GMatchInfo *match_info;
-        gboolean matches;
+        GArray *ranges = NULL;
+
+        if (!handler->enable || !handler->candidate)
+            continue;
 
-        if (!handler->enable)
+        if (!g_regex_match_full (handler->regex,
+                                 (const char *) data,
+                                 len,
+                                 0, 0, &match_info, NULL)) {
+            g_match_info_free (match_info);
             continue;
+        }
+
+        while (g_match_info_matches (match_info)) {
+            gint start;
+            gint end;
 
-        matches = g_regex_match_full (handler->regex,
-                                      (const char *) response->data,
-                                      response->len,
-                                      0, 0, &match_info, NULL);
-        if (handler->callback) {
-            while (g_match_info_matches (match_info)) {
+            if (handler->callback)
                 handler->callback (self, match_info, handler->user_data);
-                g_match_info_next (match_info, NULL);
+
+            if (g_match_info_fetch_pos (match_info, 0, &start, &end) && end > start) {
+                if (!ranges)
+                    ranges = g_array_new (FALSE, FALSE, sizeof (gint));
+                g_array_append_val (ranges, start);
+                g_array_append_val (ranges, end);
             }
+
+            g_match_info_next (match_info, NULL);
         }
 
         g_match_info_free (match_info);
 
-        if (matches) {
-            /* Remove matches */
-            char *str;
-            int result_len = response->len;
-
-            str = g_regex_replace_eval (handler->regex,
-                                        (const char *) response->data,
-                                        response->len,
-                                        0, 0,
-                                        remove_eval_cb, &result_len, NULL);
-
-            g_byte_array_remove_range (response, 0, response->len);
-            g_byte_array_append (response, (const guint8 *) str, result_len);
-            g_free (str);
+        if (ranges) {
+            /* Remove matches, and look again for candidates as removing
+             * content may leave new line starts */
+            response_remove_ranges (response, ranges);
+            g_array_unref (ranges);
+            data = mm_port_serial_buffer_peek (response, &len);
+            unsolicited_msg_index_scan (self, data, len);
         }
     }
 }
@@ -348,19 +661,18 @@ mm_port_serial_at_command_finish (MMPortSerialAt *self,
                                   GAsyncResult *res,
                                   GError **error)
 {
-    GString *str;
+    GBytes *response;
+    gconstpointer data;
+    gsize len;
 
     if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
         return NULL;
 
-    str = (GString *)g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
-    return str->str;
-}
-
-static void
-string_free (GString *str)
-{
-    g_string_free (str, TRUE);
+    /* The parsed reply is always built as a NUL-terminated string (see
+     * parse_response()), so it can be given as it is to the caller */
+    response = (GBytes *)g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+    data = g_bytes_get_data (response, &len);
+    return (len ? (const gchar *)data : "");
 }
 
 static void
@@ -368,32 +680,173 @@ serial_command_ready (MMPortSerial *port,
                       GAsyncResult *res,
                       GSimpleAsyncResult *simple)
 {
-    GByteArray *response_buffer;
+    GBytes *response;
     GError *error = NULL;
-    GString *response;
 
-    response_buffer = mm_port_serial_command_finish (port, res, &error);
-    if (!response_buffer) {
+    response = mm_port_serial_command_finish (port, res, &error);
+    if (!response)
         g_simple_async_result_take_error (simple, error);
-        g_simple_async_result_complete (simple);
-        g_object_unref (simple);
+    else
+        g_simple_async_result_set_op_res_gpointer (simple,
+                                                   response,
+                                                   (GDestroyNotify)g_bytes_unref);
+    g_simple_async_result_complete (simple);
+    g_object_unref (simple);
+}
+
+/*****************************************************************************/
+/* Reply cache policy */
+
+/* Commands reporting static device identity/capabilities, whose replies are
+ * kept across port reopen until explicitly invalidated. */
+static const gchar *static_reply_commands[] = {
+    "+CGMI", "+GMI", "+CGMM", "+GMM", "+CGMR", "+GMR",
+    "+CGSN", "+GSN", "+GCAP", "+CLAC", "I", "I1", "I2", "I3"
+};
+
+static gboolean
+command_is_static (const gchar *cmd,
+                   gsize cmdlen)
+{
+    guint i;
+
+    /* Test commands (e.g. +CPMS=?) report supported values, which don't change */
+    if (cmdlen > 2 && cmd[cmdlen - 2] == '=' && cmd[cmdlen - 1] == '?' && !memchr (cmd, ';', cmdlen))
+        return TRUE;
+
+    for (i = 0; i < G_N_ELEMENTS (static_reply_commands); i++) {
+        if (strlen (static_reply_commands[i]) == cmdlen &&
+            !g_ascii_strncasecmp (cmd, static_reply_commands[i], cmdlen))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+get_reply_cache_policy (MMPortSerial *self,
+                        const GByteArray *command,
+                        guint *ttl,
+                        gboolean *persistent)
+{
+    const gchar *cmd;
+    gsize cmdlen;
+
+    cmd = (const gchar *) command->data;
+    cmdlen = command->len;
+
+    /* Skip the AT prefix and the trailing CR/LF */
+    if (cmdlen >= 2 && !g_ascii_strncasecmp (cmd, "AT", 2)) {
+        cmd += 2;
+        cmdlen -= 2;
+    }
+    while (cmdlen > 0 && (cmd[cmdlen - 1] == '\r' || cmd[cmdlen - 1] == '\n'))
+        cmdlen--;
+
+    *ttl = 0;
+    *persistent = FALSE;
+
+    if (command_is_static (cmd, cmdlen)) {
+        *persistent = TRUE;
         return;
     }
 
-    /* Build a GString just with the response we need, and clear the
-     * processed range from the response buffer */
-    response = g_string_new_len ((const gchar *)response_buffer->data, response_buffer->len);
-    if (response_buffer->len > 0)
-        g_byte_array_remove_range (response_buffer, 0, response_buffer->len);
-    g_byte_array_unref (response_buffer);
+    /* Other replies are kept until invalidated or the port is closed, unless
+     * an expiration was explicitly requested for the command */
+    if (MM_PORT_SERIAL_AT (self)->priv->reply_cache_ttls) {
+        gchar *key;
 
-    g_simple_async_result_set_op_res_gpointer (simple,
-                                               response,
-                                               (GDestroyNotify)string_free);
-    g_simple_async_result_complete (simple);
-    g_object_unref (simple);
+        key = g_ascii_strup (cmd, cmdlen);
+        *ttl = GPOINTER_TO_UINT (g_hash_table_lookup (MM_PORT_SERIAL_AT (self)->priv->reply_cache_ttls, key));
+        g_free (key);
+    }
+}
+
+void
+mm_port_serial_at_set_reply_cache_ttl (MMPortSerialAt *self,
+                                       const gchar *command,
+                                       guint ttl)
+{
+    g_return_if_fail (MM_IS_PORT_SERIAL_AT (self));
+    g_return_if_fail (command != NULL);
+
+    if (!g_ascii_strncasecmp (command, "AT", 2))
+        command += 2;
+
+    if (!self->priv->reply_cache_ttls)
+        self->priv->reply_cache_ttls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    if (ttl)
+        g_hash_table_insert (self->priv->reply_cache_ttls,
+                             g_ascii_strup (command, -1),
+                             GUINT_TO_POINTER (ttl));
+    else {
+        gchar *key;
+
+        key = g_ascii_strup (command, -1);
+        g_hash_table_remove (self->priv->reply_cache_ttls, key);
+        g_free (key);
+    }
+}
+
+gboolean
+mm_port_serial_at_command_sets_functionality (const gchar *command)
+{
+    const gchar *p;
+
+    p = command;
+    if (!g_ascii_strncasecmp (p, "AT", 2))
+        p += 2;
+
+    /* Look at each command in a concatenated line */
+    while (p) {
+        if (!g_ascii_strncasecmp (p, "+CFUN=", 6))
+            return TRUE;
+        p = strchr (p, ';');
+        if (p)
+            p++;
+    }
+
+    return FALSE;
+}
+
+/*****************************************************************************/
+/* Command statistics */
+
+static gchar *
+build_command_stats_key (MMPortSerial *self,
+                         const GByteArray *command)
+{
+    GString *key;
+    guint i;
+
+    /* Aggregate by command name and type, e.g. AT+CGDCONT=? (test),
+     * AT+CGDCONT? (read), AT+CGDCONT= (set) or AT+CGMI (execution) */
+    key = g_string_sized_new (16);
+    for (i = 0; i < command->len; i++) {
+        gchar c = (gchar) command->data[i];
+
+        if (c == '=' || c == '?' || c == ';' || c == '\r' || c == '\n')
+            break;
+        g_string_append_c (key, g_ascii_toupper (c));
+    }
+
+    if (i < command->len) {
+        if (command->data[i] == '=' && i + 1 < command->len && command->data[i + 1] == '?')
+            g_string_append (key, "=?");
+        else if (command->data[i] == '=' || command->data[i] == '?')
+            g_string_append_c (key, (gchar) command->data[i]);
+    }
+
+    /* Several commands in the same line */
+    if (memchr (command->data, ';', command->len))
+        g_string_append (key, ";...");
+
+    return g_string_free (key, FALSE);
 }
 
+/*****************************************************************************/
+
 void
 mm_port_serial_at_command (MMPortSerialAt *self,
                            const char *command,
@@ -418,6 +871,10 @@ mm_port_serial_at_command (MMPortSerialAt *self,
                                      TRUE));
     g_return_if_fail (buf != NULL);
 
+    /* Changing the functionality level may change any non-static reply */
+    if (mm_port_serial_at_command_sets_functionality (command))
+        mm_port_serial_invalidate_cached_replies (MM_PORT_SERIAL (self), FALSE);
+
     simple = g_simple_async_result_new (G_OBJECT (self),
                                         callback,
                                         user_data,
@@ -488,16 +945,15 @@ mm_port_serial_at_get_flags (MMPortSerialAt *self)
 
 /*****************************************************************************/
 
-void
-mm_port_serial_at_run_init_sequence (MMPortSerialAt *self)
+/* Maximum length of the init sequence sent in a single line, as V.250 only
+ * requires devices to accept command lines of at least 40 characters */
+#define INIT_SEQUENCE_LINE_MAX_LENGTH 40
+
+static void
+init_sequence_run_commands (MMPortSerialAt *self)
 {
     guint i;
 
-    if (!self->priv->init_sequence)
-        return;
-
-    mm_dbg ("(%s): running init sequence...", mm_port_get_device (MM_PORT (self)));
-
     /* Just queue the init commands, don't wait for reply */
     for (i = 0; self->priv->init_sequence[i]; i++) {
         mm_port_serial_at_command (self,
@@ -511,6 +967,95 @@ mm_port_serial_at_run_init_sequence (MMPortSerialAt *self)
     }
 }
 
+/* Build a single command line with the whole init sequence, or NULL if the
+ * sequence can't be safely concatenated */
+static gchar *
+init_sequence_build_line (MMPortSerialAt *self)
+{
+    GString *line;
+    gboolean previous_extended = FALSE;
+    guint i;
+
+    line = g_string_new (NULL);
+    for (i = 0; self->priv->init_sequence[i]; i++) {
+        const gchar *command = self->priv->init_sequence[i];
+
+        /* Only single commands are concatenated; lines with several
+         * commands may rely on being sent on their own (e.g. Nokia's
+         * "E1 E0") */
+        if (!command[0] ||
+            strpbrk (command, " ;") ||
+            !g_ascii_strncasecmp (command, "AT", 2)) {
+            g_string_free (line, TRUE);
+            return NULL;
+        }
+
+        /* Extended commands need a separator before the next command, basic
+         * commands are just appended */
+        if (previous_extended)
+            g_string_append_c (line, ';');
+        g_string_append (line, command);
+        previous_extended = !(g_ascii_isalpha (command[0]) || command[0] == '&');
+    }
+
+    if (i < 2 || line->len > INIT_SEQUENCE_LINE_MAX_LENGTH) {
+        g_string_free (line, TRUE);
+        return NULL;
+    }
+
+    return g_string_free (line, FALSE);
+}
+
+static void
+init_sequence_line_ready (MMPortSerialAt *self,
+                          GAsyncResult *res)
+{
+    GError *error = NULL;
+
+    mm_port_serial_at_command_finish (self, res, &error);
+    if (!error)
+        return;
+
+    /* Commands before the failing one may have been run, but the init
+     * commands can all be safely run again one by one */
+    mm_dbg ("(%s): couldn't run init sequence in a single line: %s",
+            mm_port_get_device (MM_PORT (self)), error->message);
+    g_error_free (error);
+    if (self->priv->init_sequence)
+        init_sequence_run_commands (self);
+}
+
+void
+mm_port_serial_at_run_init_sequence (MMPortSerialAt *self)
+{
+    gchar *line = NULL;
+
+    if (!self->priv->init_sequence)
+        return;
+
+    mm_dbg ("(%s): running init sequence...", mm_port_get_device (MM_PORT (self)));
+
+    /* If the port supports command concatenation, save the round trips of
+     * each init command */
+    if (self->priv->concatenation)
+        line = init_sequence_build_line (self);
+
+    if (!line) {
+        init_sequence_run_commands (self);
+        return;
+    }
+
+    mm_port_serial_at_command (self,
+                               line,
+                               3,
+                               FALSE,
+                               FALSE,
+                               NULL,
+                               (GAsyncReadyCallback) init_sequence_line_ready,
+                               NULL);
+    g_free (line);
+}
+
 static void
 config (MMPortSerial *_self)
 {
@@ -573,6 +1118,9 @@ set_property (GObject *object,
     case PROP_SEND_LF:
         self->priv->send_lf = g_value_get_boolean (value);
         break;
+    case PROP_CONCATENATION:
+        self->priv->concatenation = g_value_get_boolean (value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -600,6 +1148,9 @@ get_property (GObject *object,
     case PROP_SEND_LF:
         g_value_set_boolean (value, self->priv->send_lf);
         break;
+    case PROP_CONCATENATION:
+        g_value_set_boolean (value, self->priv->concatenation);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -618,16 +1169,22 @@ finalize (GObject *object)
             handler->notify (handler->user_data);
 
         g_regex_unref (handler->regex);
+        g_free (handler->prefix);
         g_slice_free (MMAtUnsolicitedMsgHandler, handler);
         self->priv->unsolicited_msg_handlers = g_slist_delete_link (self->priv->unsolicited_msg_handlers,
                                                                     self->priv->unsolicited_msg_handlers);
     }
 
+    unsolicited_msg_index_free (self->priv->unsolicited_msg_index);
+
     if (self->priv->response_parser_notify)
         self->priv->response_parser_notify (self->priv->response_parser_user_data);
 
     g_strfreev (self->priv->init_sequence);
 
+    if (self->priv->reply_cache_ttls)
+        g_hash_table_unref (self->priv->reply_cache_ttls);
+
     G_OBJECT_CLASS (mm_port_serial_at_parent_class)->finalize (object);
 }
 
@@ -648,6 +1205,8 @@ mm_port_serial_at_class_init (MMPortSerialAtClass *klass)
     serial_class->parse_response = parse_response;
     serial_class->debug_log = debug_log;
     serial_class->config = config;
+    serial_class->get_reply_cache_policy = get_reply_cache_policy;
+    serial_class->build_command_stats_key = build_command_stats_key;
 
     g_object_class_install_property
         (object_class, PROP_REMOVE_ECHO,
@@ -680,4 +1239,12 @@ mm_port_serial_at_class_init (MMPortSerialAtClass *klass)
                                "Send line-feed at the end of each AT command sent",
                                FALSE,
                                G_PARAM_READWRITE));
+
+    g_object_class_install_property
+        (object_class, PROP_CONCATENATION,
+         g_param_spec_boolean (MM_PORT_SERIAL_AT_CONCATENATION,
+                               "Concatenation",
+                               "Several extended commands may be concatenated in the same command line",
+                               FALSE,
+                               G_PARAM_READWRITE));
 }
@@ -57,6 +57,18 @@ typedef gboolean (*MMPortSerialAtResponseParserFn) (gpointer user_data,
                                                     GString *response,
                                                     GError **error);
 
+/* Optional check run before the response parser on a read-only view of the
+ * response buffer; if it returns FALSE the response is not complete yet and
+ * the parser is not run. Gets the same user data as the parser. */
+typedef gboolean (*MMPortSerialAtResponseCheckFn) (gpointer user_data,
+                                                   const gchar *response,
+                                                   gsize response_len);
+
+/* Optional reset for parsers keeping state across calls; run whenever
+ * contents already given to the parser or check are removed from the
+ * response buffer. Gets the same user data as the parser. */
+typedef void (*MMPortSerialAtResponseResetFn) (gpointer user_data);
+
 typedef void (*MMPortSerialAtUnsolicitedMsgFn) (MMPortSerialAt *port,
                                                 GMatchInfo *match_info,
                                                 gpointer user_data);
@@ -65,6 +77,7 @@ typedef void (*MMPortSerialAtUnsolicitedMsgFn) (MMPortSerialAt *port,
 #define MM_PORT_SERIAL_AT_INIT_SEQUENCE_ENABLED "init-sequence-enabled"
 #define MM_PORT_SERIAL_AT_INIT_SEQUENCE         "init-sequence"
 #define MM_PORT_SERIAL_AT_SEND_LF               "send-lf"
+#define MM_PORT_SERIAL_AT_CONCATENATION         "concatenation"
 
 struct _MMPortSerialAt {
     MMPortSerial parent;
@@ -90,11 +103,20 @@ void     mm_port_serial_at_enable_unsolicited_msg_handler (MMPortSerialAt *self,
                                                            GRegex *regex,
                                                            gboolean enable);
 
+/* Setting a new response parser drops any previously set check and reset
+ * functions, as they work on the parser user data; those must always be set
+ * after the parser they belong to. */
 void     mm_port_serial_at_set_response_parser (MMPortSerialAt *self,
                                                 MMPortSerialAtResponseParserFn fn,
                                                 gpointer user_data,
                                                 GDestroyNotify notify);
 
+void     mm_port_serial_at_set_response_check  (MMPortSerialAt *self,
+                                                MMPortSerialAtResponseCheckFn fn);
+
+void     mm_port_serial_at_set_response_reset  (MMPortSerialAt *self,
+                                                MMPortSerialAtResponseResetFn fn);
+
 void         mm_port_serial_at_command        (MMPortSerialAt *self,
                                                const char *command,
                                                guint32 timeout_seconds,
@@ -107,6 +129,17 @@ const gchar *mm_port_serial_at_command_finish (MMPortSerialAt *self,
                                                GAsyncResult *res,
                                                GError **error);
 
+/* Replies cached when a command is sent with @allow_cached are kept until
+ * invalidated or the port is closed; optionally, make the replies to the
+ * given command expire after @ttl seconds (0 to never expire). */
+void     mm_port_serial_at_set_reply_cache_ttl (MMPortSerialAt *self,
+                                                const gchar *command,
+                                                guint ttl);
+
+/* Whether any of the commands in the given line changes the functionality
+ * level, which invalidates the non-static cached replies */
+gboolean mm_port_serial_at_command_sets_functionality (const gchar *command);
+
 /*
  * Convert a string into a quoted and escaped string. Returns a new
  * allocated string. Follows ITU V.250 5.4.2.2 "String constants".
@@ -114,7 +147,8 @@ const gchar *mm_port_serial_at_command_finish (MMPortSerialAt *self,
 gchar   *mm_port_serial_at_quote_string (const char *string);
 
 /* Just for unit tests */
-void     mm_port_serial_at_remove_echo (GByteArray *response);
+void     mm_port_serial_at_remove_echo                  (MMPortSerialBuffer *response);
+gchar   *mm_port_serial_at_build_unsolicited_msg_prefix (GRegex *regex);
 
 void     mm_port_serial_at_set_flags (MMPortSerialAt *self,
                                       MMPortSerialAtFlag flags);
@@ -0,0 +1,198 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <string.h>
+
+#include "mm-port-serial-buffer.h"
+
+#define MIN_BUFFER_SIZE 16
+
+struct _MMPortSerialBuffer {
+    guint8 *data;
+    /* Allocated size of the ring */
+    gsize   size;
+    /* Offset of the first valid byte in the ring */
+    gsize   head;
+    /* Amount of valid bytes, starting at head and possibly wrapping around */
+    gsize   len;
+    /* Number of times contents were removed */
+    guint   removals;
+};
+
+/*****************************************************************************/
+
+/* Move the contents to a new ring of the given size, starting at offset 0 */
+static void
+buffer_realloc (MMPortSerialBuffer *self,
+                gsize               size)
+{
+    guint8 *data;
+    gsize   first;
+
+    g_assert (size >= self->len);
+
+    data = g_malloc (size);
+    first = MIN (self->len, self->size - self->head);
+    memcpy (data, &self->data[self->head], first);
+    memcpy (&data[first], self->data, self->len - first);
+
+    g_free (self->data);
+    self->data = data;
+    self->size = size;
+    self->head = 0;
+}
+
+static void
+buffer_linearize (MMPortSerialBuffer *self)
+{
+    if (self->head + self->len <= self->size)
+        return;
+    buffer_realloc (self, self->size);
+}
+
+/*****************************************************************************/
+
+gsize
+mm_port_serial_buffer_get_length (const MMPortSerialBuffer *self)
+{
+    return self->len;
+}
+
+guint
+mm_port_serial_buffer_get_removals (const MMPortSerialBuffer *self)
+{
+    return self->removals;
+}
+
+guint8 *
+mm_port_serial_buffer_peek (MMPortSerialBuffer *self,
+                            gsize              *len)
+{
+    buffer_linearize (self);
+    *len = self->len;
+    return &self->data[self->head];
+}
+
+void
+mm_port_serial_buffer_append (MMPortSerialBuffer *self,
+                              const guint8       *data,
+                              gsize               len)
+{
+    gsize tail;
+    gsize first;
+
+    if (!len)
+        return;
+
+    if (self->len + len > self->size)
+        buffer_realloc (self, MAX (self->size * 2, self->len + len));
+
+    tail = self->head + self->len;
+    if (tail >= self->size)
+        tail -= self->size;
+
+    first = MIN (len, self->size - tail);
+    memcpy (&self->data[tail], data, first);
+    memcpy (self->data, &data[first], len - first);
+    self->len += len;
+}
+
+void
+mm_port_serial_buffer_consume (MMPortSerialBuffer *self,
+                               gsize               len)
+{
+    len = MIN (len, self->len);
+    if (!len)
+        return;
+
+    self->removals++;
+    self->len -= len;
+    if (!self->len) {
+        self->head = 0;
+        return;
+    }
+
+    self->head += len;
+    if (self->head >= self->size)
+        self->head -= self->size;
+}
+
+void
+mm_port_serial_buffer_remove_range (MMPortSerialBuffer *self,
+                                    gsize               offset,
+                                    gsize               len)
+{
+    guint8 *p;
+    gsize   suffix;
+
+    if (offset >= self->len || !len)
+        return;
+    len = MIN (len, self->len - offset);
+    if (!offset) {
+        mm_port_serial_buffer_consume (self, len);
+        return;
+    }
+
+    buffer_linearize (self);
+    p = &self->data[self->head];
+    suffix = self->len - offset - len;
+
+    /* Move whichever side of the removed range is shorter */
+    if (offset < suffix) {
+        memmove (&p[len], p, offset);
+        self->head += len;
+    } else
+        memmove (&p[offset], &p[offset + len], suffix);
+    self->len -= len;
+    self->removals++;
+}
+
+void
+mm_port_serial_buffer_truncate (MMPortSerialBuffer *self,
+                                gsize               len)
+{
+    if (len >= self->len)
+        return;
+    self->removals++;
+    self->len = len;
+    if (!self->len)
+        self->head = 0;
+}
+
+void
+mm_port_serial_buffer_clear (MMPortSerialBuffer *self)
+{
+    self->removals++;
+    self->head = 0;
+    self->len = 0;
+}
+
+/*****************************************************************************/
+
+MMPortSerialBuffer *
+mm_port_serial_buffer_new (gsize reserved_size)
+{
+    MMPortSerialBuffer *self;
+
+    self = g_slice_new0 (MMPortSerialBuffer);
+    self->size = MAX (reserved_size, MIN_BUFFER_SIZE);
+    self->data = g_malloc (self->size);
+    return self;
+}
+
+void
+mm_port_serial_buffer_free (MMPortSerialBuffer *self)
+{
+    g_free (self->data);
+    g_slice_free (MMPortSerialBuffer, self);
+}
@@ -0,0 +1,49 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PORT_SERIAL_BUFFER_H
+#define MM_PORT_SERIAL_BUFFER_H
+
+#include <glib.h>
+
+/* Ring buffer used to accumulate the data read from a serial port.
+ *
+ * Data is consumed from the front in O(1), without moving the remaining
+ * contents. Parsers get a contiguous view of the whole contents with
+ * mm_port_serial_buffer_peek(), which only needs to move data around when
+ * the contents wrap around the end of the ring. */
+typedef struct _MMPortSerialBuffer MMPortSerialBuffer;
+
+MMPortSerialBuffer *mm_port_serial_buffer_new          (gsize reserved_size);
+void                mm_port_serial_buffer_free         (MMPortSerialBuffer *self);
+
+gsize               mm_port_serial_buffer_get_length   (const MMPortSerialBuffer *self);
+/* Number of times contents were removed from the buffer; anything keeping
+ * offsets into previously seen contents must drop them when it changes */
+guint               mm_port_serial_buffer_get_removals (const MMPortSerialBuffer *self);
+guint8             *mm_port_serial_buffer_peek         (MMPortSerialBuffer *self,
+                                                        gsize              *len);
+
+void                mm_port_serial_buffer_append       (MMPortSerialBuffer *self,
+                                                        const guint8       *data,
+                                                        gsize               len);
+void                mm_port_serial_buffer_consume      (MMPortSerialBuffer *self,
+                                                        gsize               len);
+void                mm_port_serial_buffer_remove_range (MMPortSerialBuffer *self,
+                                                        gsize               offset,
+                                                        gsize               len);
+void                mm_port_serial_buffer_truncate     (MMPortSerialBuffer *self,
+                                                        gsize               len);
+void                mm_port_serial_buffer_clear        (MMPortSerialBuffer *self);
+
+#endif /* MM_PORT_SERIAL_BUFFER_H */
@@ -38,7 +38,7 @@ struct _MMPortSerialQcdmPrivate {
 /*****************************************************************************/
 
 static gboolean
-find_qcdm_start (GByteArray *response, gsize *start)
+find_qcdm_start (const guint8 *data, gsize len, gsize *start)
 {
     int i, last = -1;
 
@@ -48,8 +48,8 @@ find_qcdm_start (GByteArray *response, gsize *start)
      * with 0x7E and ending with 0x7E, and (3) a non-QCDM frame that still
      * uses HDLC framing (like Sierra CnS) that starts and ends with 0x7E.
      */
-    for (i = 0; i < response->len; i++) {
-        if (response->data[i] == 0x7E) {
+    for (i = 0; i < len; i++) {
+        if (data[i] == 0x7E) {
             if (i > last + 3) {
                 /* Got a full QCDM frame; 3 non-0x7E bytes and a terminator */
                 if (start)
@@ -65,11 +65,13 @@ find_qcdm_start (GByteArray *response, gsize *start)
 }
 
 static MMPortSerialResponseType
-parse_qcdm (GByteArray *response,
+parse_qcdm (MMPortSerialBuffer *response,
             gboolean want_log,
             GByteArray **parsed_response,
             GError **error)
 {
+    const guint8 *data;
+    gsize len;
     gsize start = 0;
     gsize used = 0;
     gsize unescaped_len = 0;
@@ -77,7 +79,8 @@ parse_qcdm (GByteArray *response,
     qcdmbool more = FALSE;
 
     /* Get the offset into the buffer of where the QCDM frame starts */
-    if (!find_qcdm_start (response, &start)) {
+    data = mm_port_serial_buffer_peek (response, &len);
+    if (!find_qcdm_start (data, len, &start)) {
         /* Discard the unparsable data right away, we do need a QCDM
          * start, and anything that comes before it is unknown data
          * that we'll never use. */
@@ -85,14 +88,15 @@ parse_qcdm (GByteArray *response,
     }
 
     /* If there is anything before the start marker, remove it */
-    g_byte_array_remove_range (response, 0, start);
-    if (response->len == 0)
+    mm_port_serial_buffer_consume (response, start);
+    data = mm_port_serial_buffer_peek (response, &len);
+    if (len == 0)
         return MM_PORT_SERIAL_RESPONSE_NONE;
 
     /* Try to decapsulate the response into a buffer */
     unescaped_buffer = g_malloc (1024);
-    if (!dm_decapsulate_buffer ((const char *)(response->data),
-                                response->len,
+    if (!dm_decapsulate_buffer ((const char *) data,
+                                len,
                                 (char *)unescaped_buffer,
                                 1024,
                                 &unescaped_len,
@@ -133,13 +137,13 @@ parse_qcdm (GByteArray *response,
     /* Remove the data we used from the input buffer, leaving out any
      * additional data that may already been received (e.g. from the following
      * message). */
-    g_byte_array_remove_range (response, 0, used);
+    mm_port_serial_buffer_consume (response, used);
     return MM_PORT_SERIAL_RESPONSE_BUFFER;
 }
 
 static MMPortSerialResponseType
 parse_response (MMPortSerial *port,
-                GByteArray *response,
+                MMPortSerialBuffer *response,
                 GByteArray **parsed_response,
                 GError **error)
 {
@@ -161,14 +165,14 @@ serial_command_ready (MMPortSerial *port,
                       GAsyncResult *res,
                       GTask *task)
 {
-    GByteArray *response;
+    GBytes *response;
     GError *error = NULL;
 
     response = mm_port_serial_command_finish (port, res, &error);
     if (!response)
         g_task_return_error (task, error);
     else
-        g_task_return_pointer (task, response, (GDestroyNotify)g_byte_array_unref);
+        g_task_return_pointer (task, g_bytes_unref_to_array (response), (GDestroyNotify)g_byte_array_unref);
 
     g_object_unref (task);
 }
@@ -287,7 +291,7 @@ mm_port_serial_qcdm_enable_unsolicited_msg_handler (MMPortSerialQcdm *self,
 }
 
 static void
-parse_unsolicited (MMPortSerial *port, GByteArray *response)
+parse_unsolicited (MMPortSerial *port, MMPortSerialBuffer *response)
 {
     MMPortSerialQcdm *self = MM_PORT_SERIAL_QCDM (port);
     GByteArray *log_buffer = NULL;
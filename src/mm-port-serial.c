@@ -54,6 +54,7 @@ enum {
     PROP_PARITY,
     PROP_STOPBITS,
     PROP_SEND_DELAY,
+    PROP_SEND_CHUNK_SIZE,
     PROP_FD,
     PROP_SPEW_CONTROL,
     PROP_FLASH_OK,
@@ -73,13 +74,29 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 #define SERIAL_BUF_SIZE 2048
 
+/* Maximum number of replies kept in the cache */
+#define REPLY_CACHE_MAX_ENTRIES 32
+
+/* Maximum number of different commands with their own statistics; any other
+ * command is aggregated in a common entry */
+#define COMMAND_STATS_MAX_ENTRIES 64
+#define COMMAND_STATS_OTHER_KEY   "other"
+
+/* Upper bounds (ms) of the buckets of the command latency histogram; the last
+ * bucket holds anything above the last bound */
+static const guint latency_histogram_bounds[] = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+#define LATENCY_HISTOGRAM_N_BUCKETS (G_N_ELEMENTS (latency_histogram_bounds) + 1)
+
 struct _MMPortSerialPrivate {
     guint32 open_count;
     gboolean forced_close;
     int fd;
     GHashTable *reply_cache;
+    guint reply_cache_hits;
+    guint reply_cache_misses;
+    GHashTable *command_stats;
     GQueue *queue;
-    GByteArray *response;
+    MMPortSerialBuffer *response;
 
     /* For real ports, iochannel, and we implement the eagain limit */
     GIOChannel *iochannel;
@@ -95,6 +112,7 @@ struct _MMPortSerialPrivate {
     char parity;
     guint stopbits;
     guint64 send_delay;
+    guint send_chunk_size;
     gboolean spew_control;
     gboolean flash_ok;
 
@@ -127,6 +145,12 @@ typedef struct {
     guint32 idx;
     gboolean started;
     gboolean done;
+
+    /* Timing, in monotonic time */
+    guint queue_depth;
+    gint64 enqueued_time;
+    gint64 sent_time;
+    gint64 first_byte_time;
 } CommandContext;
 
 static void
@@ -144,7 +168,7 @@ command_context_complete_and_free (CommandContext *ctx, gboolean idle)
     g_slice_free (CommandContext, ctx);
 }
 
-GByteArray *
+GBytes *
 mm_port_serial_command_finish (MMPortSerial *self,
                                GAsyncResult *res,
                                GError **error)
@@ -152,7 +176,7 @@ mm_port_serial_command_finish (MMPortSerial *self,
     if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res), error))
         return NULL;
 
-    return g_byte_array_ref (g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res)));
+    return g_bytes_ref (g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res)));
 }
 
 void
@@ -200,6 +224,8 @@ mm_port_serial_command (MMPortSerial *self,
     if (!allow_cached)
         port_serial_set_cached_reply (self, ctx->command, NULL);
 
+    ctx->queue_depth = g_queue_get_length (self->priv->queue);
+    ctx->enqueued_time = g_get_monotonic_time ();
     g_queue_push_tail (self->priv->queue, ctx);
 
     if (g_queue_get_length (self->priv->queue) == 1)
@@ -507,18 +533,21 @@ port_serial_process_command (MMPortSerial *self,
     /* Only print command the first time */
     if (ctx->started == FALSE) {
         ctx->started = TRUE;
+        ctx->sent_time = g_get_monotonic_time ();
         serial_debug (self, "-->", (const char *) ctx->command->data, ctx->command->len);
     }
 
-    if (self->priv->send_delay == 0 || mm_port_get_subsys (MM_PORT (self)) != MM_PORT_SUBSYS_TTY) {
-        /* Send the whole command in one write */
-        send_len = (gssize)ctx->command->len;
-        p = (gchar *)ctx->command->data;
+    if (self->priv->send_delay == 0 ||
+        self->priv->send_chunk_size == 0 ||
+        mm_port_get_subsys (MM_PORT (self)) != MM_PORT_SUBSYS_TTY) {
+        /* Send the whole pending command in one write */
+        send_len = (gssize)(ctx->command->len - ctx->idx);
     } else {
-        /* Send just one byte of the command */
-        send_len = 1;
-        p = (gchar *)&ctx->command->data[ctx->idx];
+        /* Send just one chunk of the command; the send delay is applied
+         * between chunks */
+        send_len = (gssize) MIN (self->priv->send_chunk_size, ctx->command->len - ctx->idx);
     }
+    p = (gchar *)&ctx->command->data[ctx->idx];
 
     /* GIOChannel based setup */
     if (self->priv->iochannel) {
@@ -604,31 +633,144 @@ port_serial_process_command (MMPortSerial *self,
     return TRUE;
 }
 
+/*****************************************************************************/
+/* Reply cache */
+
+typedef struct {
+    GBytes *response;
+    gint64 expiration; /* monotonic time, 0 if it never expires */
+    gint64 last_used;
+    gboolean persistent;
+} CachedReply;
+
+static void
+cached_reply_free (CachedReply *cached)
+{
+    g_bytes_unref (cached->response);
+    g_slice_free (CachedReply, cached);
+}
+
+static void
+reply_cache_evict_one (MMPortSerial *self)
+{
+    GHashTableIter iter;
+    gpointer key;
+    CachedReply *cached;
+    gpointer victim = NULL;
+    CachedReply *victim_cached = NULL;
+
+    /* Evict the least recently used reply, preferring non-persistent ones */
+    g_hash_table_iter_init (&iter, self->priv->reply_cache);
+    while (g_hash_table_iter_next (&iter, &key, (gpointer *)&cached)) {
+        if (!victim_cached ||
+            (victim_cached->persistent && !cached->persistent) ||
+            (victim_cached->persistent == cached->persistent &&
+             cached->last_used < victim_cached->last_used)) {
+            victim = key;
+            victim_cached = cached;
+        }
+    }
+
+    if (victim)
+        g_hash_table_remove (self->priv->reply_cache, victim);
+}
+
 static void
 port_serial_set_cached_reply (MMPortSerial *self,
                               const GByteArray *command,
-                              const GByteArray *response)
+                              GBytes *response)
 {
     g_return_if_fail (self != NULL);
     g_return_if_fail (MM_IS_PORT_SERIAL (self));
     g_return_if_fail (command != NULL);
 
     if (response) {
-        GByteArray *cmd_copy = g_byte_array_sized_new (command->len);
-        GByteArray *rsp_copy = g_byte_array_sized_new (response->len);
+        GByteArray *cmd_copy;
+        CachedReply *cached;
+        guint ttl = 0;
+        gboolean persistent = FALSE;
+
+        if (MM_PORT_SERIAL_GET_CLASS (self)->get_reply_cache_policy)
+            MM_PORT_SERIAL_GET_CLASS (self)->get_reply_cache_policy (self, command, &ttl, &persistent);
+
+        if (!g_hash_table_contains (self->priv->reply_cache, command) &&
+            g_hash_table_size (self->priv->reply_cache) >= REPLY_CACHE_MAX_ENTRIES)
+            reply_cache_evict_one (self);
 
+        cmd_copy = g_byte_array_sized_new (command->len);
         g_byte_array_append (cmd_copy, command->data, command->len);
-        g_byte_array_append (rsp_copy, response->data, response->len);
-        g_hash_table_insert (self->priv->reply_cache, cmd_copy, rsp_copy);
+
+        /* Replies are immutable, so the cache just keeps a reference */
+        cached = g_slice_new (CachedReply);
+        cached->response = g_bytes_ref (response);
+        cached->last_used = g_get_monotonic_time ();
+        cached->expiration = (ttl ? cached->last_used + (ttl * G_USEC_PER_SEC) : 0);
+        cached->persistent = persistent;
+
+        g_hash_table_insert (self->priv->reply_cache, cmd_copy, cached);
     } else
         g_hash_table_remove (self->priv->reply_cache, command);
 }
 
-static const GByteArray *
+static GBytes *
 port_serial_get_cached_reply (MMPortSerial *self,
                               GByteArray *command)
 {
-    return (const GByteArray *)g_hash_table_lookup (self->priv->reply_cache, command);
+    CachedReply *cached;
+    gint64 now;
+
+    now = g_get_monotonic_time ();
+    cached = (CachedReply *)g_hash_table_lookup (self->priv->reply_cache, command);
+    if (cached && cached->expiration && now >= cached->expiration) {
+        g_hash_table_remove (self->priv->reply_cache, command);
+        cached = NULL;
+    }
+
+    if (!cached) {
+        self->priv->reply_cache_misses++;
+        mm_dbg ("(%s) reply cache miss (hits: %u, misses: %u)",
+                mm_port_get_device (MM_PORT (self)),
+                self->priv->reply_cache_hits,
+                self->priv->reply_cache_misses);
+        return NULL;
+    }
+
+    cached->last_used = now;
+    self->priv->reply_cache_hits++;
+    mm_dbg ("(%s) reply cache hit (hits: %u, misses: %u)",
+            mm_port_get_device (MM_PORT (self)),
+            self->priv->reply_cache_hits,
+            self->priv->reply_cache_misses);
+    return cached->response;
+}
+
+static gboolean
+cached_reply_is_not_persistent (gpointer key,
+                                CachedReply *cached,
+                                gpointer user_data)
+{
+    return !cached->persistent;
+}
+
+void
+mm_port_serial_invalidate_cached_replies (MMPortSerial *self,
+                                          gboolean include_persistent)
+{
+    guint n_removed;
+
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+
+    if (include_persistent) {
+        n_removed = g_hash_table_size (self->priv->reply_cache);
+        g_hash_table_remove_all (self->priv->reply_cache);
+    } else
+        n_removed = g_hash_table_foreach_remove (self->priv->reply_cache,
+                                                 (GHRFunc)cached_reply_is_not_persistent,
+                                                 NULL);
+
+    if (n_removed > 0)
+        mm_dbg ("(%s) invalidated %u cached replies",
+                mm_port_get_device (MM_PORT (self)), n_removed);
 }
 
 static void
@@ -650,9 +792,139 @@ port_serial_schedule_queue_process (MMPortSerial *self, guint timeout_ms)
         self->priv->queue_id = g_idle_add (port_serial_queue_process, self);
 }
 
+/*****************************************************************************/
+/* Command statistics */
+
+typedef struct {
+    guint n_commands;
+    guint n_timeouts;
+    guint n_errors;
+    guint max_queue_depth;
+    /* Times in us */
+    guint64 queue_time_sum;
+    guint64 queue_time_max;
+    guint64 wire_time_sum;
+    guint n_wire_times;
+    guint64 total_time_sum;
+    guint64 total_time_max;
+    guint histogram[LATENCY_HISTOGRAM_N_BUCKETS];
+} CommandStats;
+
+static void
+command_stats_free (CommandStats *stats)
+{
+    g_slice_free (CommandStats, stats);
+}
+
+static void
+port_serial_record_command_stats (MMPortSerial *self,
+                                  CommandContext *ctx,
+                                  const GError *error)
+{
+    CommandStats *stats;
+    gchar *key;
+    guint64 queue_time;
+    guint64 total_time;
+    guint64 total_time_ms;
+    guint i;
+
+    /* Skip commands never sent, e.g. those replied from the cache */
+    if (!ctx->sent_time)
+        return;
+
+    if (MM_PORT_SERIAL_GET_CLASS (self)->build_command_stats_key)
+        key = MM_PORT_SERIAL_GET_CLASS (self)->build_command_stats_key (self, ctx->command);
+    else
+        key = g_strdup_printf ("0x%02x", ctx->command->len > 0 ? ctx->command->data[0] : 0);
+
+    stats = g_hash_table_lookup (self->priv->command_stats, key);
+    if (!stats && g_hash_table_size (self->priv->command_stats) >= COMMAND_STATS_MAX_ENTRIES) {
+        g_free (key);
+        key = g_strdup (COMMAND_STATS_OTHER_KEY);
+        stats = g_hash_table_lookup (self->priv->command_stats, key);
+    }
+    if (!stats) {
+        stats = g_slice_new0 (CommandStats);
+        g_hash_table_insert (self->priv->command_stats, key, stats);
+    } else
+        g_free (key);
+
+    queue_time = ctx->sent_time - ctx->enqueued_time;
+    total_time = g_get_monotonic_time () - ctx->enqueued_time;
+
+    stats->n_commands++;
+    if (g_error_matches (error, MM_SERIAL_ERROR, MM_SERIAL_ERROR_RESPONSE_TIMEOUT))
+        stats->n_timeouts++;
+    else if (error)
+        stats->n_errors++;
+    stats->max_queue_depth = MAX (stats->max_queue_depth, ctx->queue_depth);
+    stats->queue_time_sum += queue_time;
+    stats->queue_time_max = MAX (stats->queue_time_max, queue_time);
+    if (ctx->first_byte_time) {
+        stats->wire_time_sum += (ctx->first_byte_time - ctx->sent_time);
+        stats->n_wire_times++;
+    }
+    stats->total_time_sum += total_time;
+    stats->total_time_max = MAX (stats->total_time_max, total_time);
+
+    total_time_ms = total_time / 1000;
+    for (i = 0; i < G_N_ELEMENTS (latency_histogram_bounds); i++) {
+        if (total_time_ms < latency_histogram_bounds[i])
+            break;
+    }
+    stats->histogram[i]++;
+}
+
+void
+mm_port_serial_add_command_statistics (MMPortSerial *self,
+                                       const gchar *modem_path,
+                                       GVariantBuilder *builder)
+{
+    GHashTableIter iter;
+    const gchar *key;
+    CommandStats *stats;
+
+    g_return_if_fail (MM_IS_PORT_SERIAL (self));
+
+    g_hash_table_iter_init (&iter, self->priv->command_stats);
+    while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&stats)) {
+        GVariantBuilder histogram;
+        GVariantBuilder bounds;
+        guint i;
+
+        g_variant_builder_init (&histogram, G_VARIANT_TYPE ("au"));
+        for (i = 0; i < LATENCY_HISTOGRAM_N_BUCKETS; i++)
+            g_variant_builder_add (&histogram, "u", stats->histogram[i]);
+
+        g_variant_builder_init (&bounds, G_VARIANT_TYPE ("au"));
+        for (i = 0; i < G_N_ELEMENTS (latency_histogram_bounds); i++)
+            g_variant_builder_add (&bounds, "u", latency_histogram_bounds[i]);
+
+        g_variant_builder_open (builder, G_VARIANT_TYPE ("a{sv}"));
+        if (modem_path)
+            g_variant_builder_add (builder, "{sv}", "modem", g_variant_new_string (modem_path));
+        g_variant_builder_add (builder, "{sv}", "port",             g_variant_new_string (mm_port_get_device (MM_PORT (self))));
+        g_variant_builder_add (builder, "{sv}", "command",          g_variant_new_string (key));
+        g_variant_builder_add (builder, "{sv}", "count",            g_variant_new_uint32 (stats->n_commands));
+        g_variant_builder_add (builder, "{sv}", "timeouts",         g_variant_new_uint32 (stats->n_timeouts));
+        g_variant_builder_add (builder, "{sv}", "errors",           g_variant_new_uint32 (stats->n_errors));
+        g_variant_builder_add (builder, "{sv}", "max-queue-depth",  g_variant_new_uint32 (stats->max_queue_depth));
+        g_variant_builder_add (builder, "{sv}", "queue-time-avg",   g_variant_new_uint32 ((guint32) (stats->queue_time_sum / stats->n_commands / 1000)));
+        g_variant_builder_add (builder, "{sv}", "queue-time-max",   g_variant_new_uint32 ((guint32) (stats->queue_time_max / 1000)));
+        g_variant_builder_add (builder, "{sv}", "wire-time-avg",    g_variant_new_uint32 (stats->n_wire_times ? (guint32) (stats->wire_time_sum / stats->n_wire_times / 1000) : 0));
+        g_variant_builder_add (builder, "{sv}", "total-time-avg",   g_variant_new_uint32 ((guint32) (stats->total_time_sum / stats->n_commands / 1000)));
+        g_variant_builder_add (builder, "{sv}", "total-time-max",   g_variant_new_uint32 ((guint32) (stats->total_time_max / 1000)));
+        g_variant_builder_add (builder, "{sv}", "histogram",        g_variant_builder_end (&histogram));
+        g_variant_builder_add (builder, "{sv}", "histogram-bounds", g_variant_builder_end (&bounds));
+        g_variant_builder_close (builder);
+    }
+}
+
+/*****************************************************************************/
+
 static void
 port_serial_got_response (MMPortSerial *self,
-                          GByteArray   *parsed_response,
+                          GBytes       *parsed_response,
                           const GError *error)
 {
     /* Either one or the other, not both */
@@ -682,6 +954,8 @@ port_serial_got_response (MMPortSerial *self,
 
         ctx = (CommandContext *) g_queue_pop_head (self->priv->queue);
         if (ctx) {
+            port_serial_record_command_stats (self, ctx, error);
+
             /* Complete the command context with the appropriate result */
             if (error)
                 g_simple_async_result_set_from_error (ctx->result, error);
@@ -689,12 +963,12 @@ port_serial_got_response (MMPortSerial *self,
                 if (ctx->allow_cached)
                     port_serial_set_cached_reply (self, ctx->command, parsed_response);
                 g_simple_async_result_set_op_res_gpointer (ctx->result,
-                                                           g_byte_array_ref (parsed_response),
-                                                           (GDestroyNotify) g_byte_array_unref);
+                                                           g_bytes_ref (parsed_response),
+                                                           (GDestroyNotify) g_bytes_unref);
             }
 
-            /* Don't complete in idle. We need the caller remove the response range which
-             * was processed, and that must be done before processing any new queued command */
+            /* Don't complete in idle, the reply must be processed before any new
+             * queued command is */
             command_context_complete_and_free (ctx, FALSE);
         }
 
@@ -772,17 +1046,16 @@ port_serial_queue_process (gpointer data)
         return G_SOURCE_REMOVE;
 
     if (ctx->allow_cached) {
-        const GByteArray *cached;
+        GBytes *cached;
 
         cached = port_serial_get_cached_reply (self, ctx->command);
         if (cached) {
-            GByteArray *parsed_response;
-
-            parsed_response = g_byte_array_sized_new (cached->len);
-            g_byte_array_append (parsed_response, cached->data, cached->len);
+            /* The cached entry may be replaced while completing, so keep
+             * our own reference to the reply */
+            g_bytes_ref (cached);
             /* Note: may complete last operation and unref the MMPortSerial */
-            port_serial_got_response (self, parsed_response, NULL);
-            g_byte_array_unref (parsed_response);
+            port_serial_got_response (self, cached, NULL);
+            g_bytes_unref (cached);
             return G_SOURCE_REMOVE;
         }
 
@@ -797,7 +1070,7 @@ port_serial_queue_process (gpointer data)
         return G_SOURCE_REMOVE;
     }
 
-    /* Schedule the next byte of the command to be sent */
+    /* Schedule the next chunk of the command to be sent */
     if (!ctx->done) {
         port_serial_schedule_queue_process (self,
                                             (mm_port_get_subsys (MM_PORT (self)) == MM_PORT_SUBSYS_TTY ?
@@ -837,6 +1110,7 @@ parse_response_buffer (MMPortSerial *self)
 {
     GError *error = NULL;
     GByteArray *parsed_response = NULL;
+    GBytes *response;
 
     /* Parse unsolicited messages in the subclass.
      *
@@ -859,12 +1133,14 @@ parse_response_buffer (MMPortSerial *self)
                                                              &parsed_response,
                                                              &error)) {
     case MM_PORT_SERIAL_RESPONSE_BUFFER:
-        /* We have a valid response to process */
+        /* We have a valid response to process. We own the only reference to
+         * the parsed array, so its contents are handed over without copying */
         g_assert (parsed_response);
+        response = g_byte_array_free_to_bytes (parsed_response);
         self->priv->n_consecutive_timeouts = 0;
         /* Note: may complete last operation and unref the MMPortSerial */
-        port_serial_got_response (self, parsed_response, NULL);
-        g_byte_array_unref (parsed_response);
+        port_serial_got_response (self, response, NULL);
+        g_bytes_unref (response);
         break;
     case MM_PORT_SERIAL_RESPONSE_ERROR:
         /* We have an error to process */
@@ -897,15 +1173,13 @@ common_input_available (MMPortSerial *self,
         device = mm_port_get_device (MM_PORT (self));
         mm_dbg ("(%s) unexpected port hangup!", device);
 
-        if (self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
+        mm_port_serial_buffer_clear (self->priv->response);
         port_serial_close_force (self);
         return G_SOURCE_REMOVE;
     }
 
     if (condition & G_IO_ERR) {
-        if (self->priv->response->len)
-            g_byte_array_remove_range (self->priv->response, 0, self->priv->response->len);
+        mm_port_serial_buffer_clear (self->priv->response);
         return G_SOURCE_CONTINUE;
     }
 
@@ -961,13 +1235,27 @@ common_input_available (MMPortSerial *self,
 
         g_assert (bytes_read > 0);
         serial_debug (self, "<--", buf, bytes_read);
-        g_byte_array_append (self->priv->response, (const guint8 *) buf, bytes_read);
+
+        /* Keep track of when the reply to the current command starts */
+        ctx = g_queue_peek_head (self->priv->queue);
+        if (ctx && ctx->done && !ctx->first_byte_time)
+            ctx->first_byte_time = g_get_monotonic_time ();
+
+        mm_port_serial_buffer_append (self->priv->response, (const guint8 *) buf, bytes_read);
 
         /* Make sure the response doesn't grow too long */
-        if ((self->priv->response->len > SERIAL_BUF_SIZE) && self->priv->spew_control) {
+        if ((mm_port_serial_buffer_get_length (self->priv->response) > SERIAL_BUF_SIZE) && self->priv->spew_control) {
+            GByteArray *full;
+            const guint8 *data;
+            gsize len;
+
             /* Notify listeners and then trim the buffer */
-            g_signal_emit (self, signals[BUFFER_FULL], 0, self->priv->response);
-            g_byte_array_remove_range (self->priv->response, 0, (SERIAL_BUF_SIZE / 2));
+            data = mm_port_serial_buffer_peek (self->priv->response, &len);
+            full = g_byte_array_sized_new (len);
+            g_byte_array_append (full, data, len);
+            g_signal_emit (self, signals[BUFFER_FULL], 0, full);
+            g_byte_array_unref (full);
+            mm_port_serial_buffer_consume (self->priv->response, (SERIAL_BUF_SIZE / 2));
         }
 
         /* See if we can parse anything. The response parsing may actually
@@ -1287,6 +1575,14 @@ mm_port_serial_is_open (MMPortSerial *self)
     return !!self->priv->open_count;
 }
 
+guint
+mm_port_serial_get_queue_length (MMPortSerial *self)
+{
+    g_return_val_if_fail (MM_IS_PORT_SERIAL (self), 0);
+
+    return g_queue_get_length (self->priv->queue);
+}
+
 static void
 _close_internal (MMPortSerial *self, gboolean force)
 {
@@ -1410,6 +1706,9 @@ _close_internal (MMPortSerial *self, gboolean force)
     }
 
     g_clear_object (&self->priv->cancellable);
+
+    /* Only static replies are kept across reopen */
+    mm_port_serial_invalidate_cached_replies (self, FALSE);
 }
 
 void
@@ -1842,20 +2141,12 @@ ba_equal (gconstpointer v1, gconstpointer v2)
     const GByteArray *a = v1;
     const GByteArray *b = v2;
 
-    if (!a && b)
-        return -1;
-    else if (a && !b)
-        return 1;
-    else if (!a && !b)
-        return 0;
+    if (!a || !b)
+        return (a == b);
 
-    g_assert (a && b);
-    if (a->len < b->len)
-        return -1;
-    else if (a->len > b->len)
-        return 1;
+    if (a->len != b->len)
+        return FALSE;
 
-    g_assert (a->len == b->len);
     return !memcmp (a->data, b->data, a->len);
 }
 
@@ -1883,7 +2174,8 @@ mm_port_serial_init (MMPortSerial *self)
 {
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, MM_TYPE_PORT_SERIAL, MMPortSerialPrivate);
 
-    self->priv->reply_cache = g_hash_table_new_full (ba_hash, ba_equal, ba_free, ba_free);
+    self->priv->reply_cache = g_hash_table_new_full (ba_hash, ba_equal, ba_free, (GDestroyNotify)cached_reply_free);
+    self->priv->command_stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)command_stats_free);
 
     self->priv->fd = -1;
     self->priv->baud = 57600;
@@ -1891,9 +2183,10 @@ mm_port_serial_init (MMPortSerial *self)
     self->priv->parity = 'n';
     self->priv->stopbits = 1;
     self->priv->send_delay = 1000;
+    self->priv->send_chunk_size = 1;
 
     self->priv->queue = g_queue_new ();
-    self->priv->response = g_byte_array_sized_new (500);
+    self->priv->response = mm_port_serial_buffer_new (500);
 }
 
 static void
@@ -1923,6 +2216,9 @@ set_property (GObject *object,
     case PROP_SEND_DELAY:
         self->priv->send_delay = g_value_get_uint64 (value);
         break;
+    case PROP_SEND_CHUNK_SIZE:
+        self->priv->send_chunk_size = g_value_get_uint (value);
+        break;
     case PROP_SPEW_CONTROL:
         self->priv->spew_control = g_value_get_boolean (value);
         break;
@@ -1962,6 +2258,9 @@ get_property (GObject *object,
     case PROP_SEND_DELAY:
         g_value_set_uint64 (value, self->priv->send_delay);
         break;
+    case PROP_SEND_CHUNK_SIZE:
+        g_value_set_uint (value, self->priv->send_chunk_size);
+        break;
     case PROP_SPEW_CONTROL:
         g_value_set_boolean (value, self->priv->spew_control);
         break;
@@ -1995,7 +2294,8 @@ finalize (GObject *object)
         g_source_remove (self->priv->queue_id);
 
     g_hash_table_destroy (self->priv->reply_cache);
-    g_byte_array_unref (self->priv->response);
+    g_hash_table_destroy (self->priv->command_stats);
+    mm_port_serial_buffer_free (self->priv->response);
     g_queue_free (self->priv->queue);
 
     G_OBJECT_CLASS (mm_port_serial_parent_class)->finalize (object);
@@ -2060,10 +2360,19 @@ mm_port_serial_class_init (MMPortSerialClass *klass)
         (object_class, PROP_SEND_DELAY,
          g_param_spec_uint64 (MM_PORT_SERIAL_SEND_DELAY,
                               "SendDelay",
-                              "Send delay for each byte in microseconds",
+                              "Send delay for each chunk in microseconds",
                               0, G_MAXUINT64, 0,
                               G_PARAM_READWRITE));
 
+    g_object_class_install_property
+        (object_class, PROP_SEND_CHUNK_SIZE,
+         g_param_spec_uint (MM_PORT_SERIAL_SEND_CHUNK_SIZE,
+                            "SendChunkSize",
+                            "Maximum number of bytes written at once when a send "
+                            "delay is given, 0 to write the whole command at once",
+                            0, G_MAXUINT, 1,
+                            G_PARAM_READWRITE));
+
     g_object_class_install_property
         (object_class, PROP_SPEW_CONTROL,
          g_param_spec_boolean (MM_PORT_SERIAL_SPEW_CONTROL,
@@ -23,6 +23,7 @@
 
 #include "mm-modem-helpers.h"
 #include "mm-port.h"
+#include "mm-port-serial-buffer.h"
 
 #define MM_TYPE_PORT_SERIAL            (mm_port_serial_get_type ())
 #define MM_PORT_SERIAL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), MM_TYPE_PORT_SERIAL, MMPortSerial))
@@ -31,14 +32,15 @@
 #define MM_IS_PORT_SERIAL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  MM_TYPE_PORT_SERIAL))
 #define MM_PORT_SERIAL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  MM_TYPE_PORT_SERIAL, MMPortSerialClass))
 
-#define MM_PORT_SERIAL_BAUD         "baud"
-#define MM_PORT_SERIAL_BITS         "bits"
-#define MM_PORT_SERIAL_PARITY       "parity"
-#define MM_PORT_SERIAL_STOPBITS     "stopbits"
-#define MM_PORT_SERIAL_SEND_DELAY   "send-delay"
-#define MM_PORT_SERIAL_FD           "fd" /* Construct-only */
-#define MM_PORT_SERIAL_SPEW_CONTROL "spew-control" /* Construct-only */
-#define MM_PORT_SERIAL_FLASH_OK     "flash-ok" /* Construct-only */
+#define MM_PORT_SERIAL_BAUD            "baud"
+#define MM_PORT_SERIAL_BITS            "bits"
+#define MM_PORT_SERIAL_PARITY          "parity"
+#define MM_PORT_SERIAL_STOPBITS        "stopbits"
+#define MM_PORT_SERIAL_SEND_DELAY      "send-delay"
+#define MM_PORT_SERIAL_SEND_CHUNK_SIZE "send-chunk-size"
+#define MM_PORT_SERIAL_FD              "fd" /* Construct-only */
+#define MM_PORT_SERIAL_SPEW_CONTROL    "spew-control" /* Construct-only */
+#define MM_PORT_SERIAL_FLASH_OK        "flash-ok" /* Construct-only */
 
 typedef enum {
     MM_PORT_SERIAL_RESPONSE_NONE,
@@ -60,9 +62,9 @@ struct _MMPortSerialClass {
 
     /* Called for subclasses to parse unsolicited responses.  If any recognized
      * unsolicited response is found, it should be removed from the 'response'
-     * byte array before returning.
+     * buffer before returning.
      */
-    void     (*parse_unsolicited) (MMPortSerial *self, GByteArray *response);
+    void     (*parse_unsolicited) (MMPortSerial *self, MMPortSerialBuffer *response);
 
     /*
      * Called to parse the device's response to a command or determine if the
@@ -77,11 +79,11 @@ struct _MMPortSerialClass {
      * If there is no response, @MM_PORT_SERIAL_RESPONSE_NONE will be returned,
      * and neither @error nor @parsed_response will be set.
      *
-     * The implementation is allowed to cleanup the @response byte array, e.g. to
+     * The implementation is allowed to cleanup the @response buffer, e.g. to
      * just remove 1 single response if more than one found.
      */
     MMPortSerialResponseType (*parse_response) (MMPortSerial *self,
-                                                GByteArray *response,
+                                                MMPortSerialBuffer *response,
                                                 GByteArray **parsed_response,
                                                 GError **error);
 
@@ -99,6 +101,22 @@ struct _MMPortSerialClass {
                                    const char *buf,
                                    gsize len);
 
+    /* Called to get how a reply to the given command should be cached: the
+     * amount of seconds it is valid for (0 if it never expires) and whether
+     * it should be kept after the port is closed. If not given, replies never
+     * expire and are dropped when the port is closed.
+     */
+    void (*get_reply_cache_policy) (MMPortSerial *self,
+                                    const GByteArray *command,
+                                    guint *ttl,
+                                    gboolean *persistent);
+
+    /* Called to build the key under which the statistics of the given command
+     * are aggregated. If not given, the first byte of the command is used.
+     */
+    gchar * (*build_command_stats_key) (MMPortSerial *self,
+                                        const GByteArray *command);
+
     /* Signals */
     void (*buffer_full)           (MMPortSerial *port, const GByteArray *buffer);
     void (*timed_out)             (MMPortSerial *port, guint n_consecutive_replies);
@@ -146,10 +164,25 @@ void        mm_port_serial_command        (MMPortSerial *self,
                                            GCancellable *cancellable,
                                            GAsyncReadyCallback callback,
                                            gpointer user_data);
-GByteArray *mm_port_serial_command_finish (MMPortSerial *self,
+/* The returned reply is shared with the reply cache, so it must not be
+ * modified; just unref it once done. */
+GBytes     *mm_port_serial_command_finish (MMPortSerial *self,
                                            GAsyncResult *res,
                                            GError **error);
 
+/* Number of commands either waiting in the queue or being processed */
+guint    mm_port_serial_get_queue_length  (MMPortSerial *self);
+
+/* Drop cached replies; persistent ones only if @include_persistent is TRUE */
+void     mm_port_serial_invalidate_cached_replies (MMPortSerial *self,
+                                                   gboolean include_persistent);
+
+/* Adds one a{sv} dictionary with the latency statistics of each command sent
+ * through the port to the given aa{sv} builder */
+void     mm_port_serial_add_command_statistics (MMPortSerial *self,
+                                                const gchar *modem_path,
+                                                GVariantBuilder *builder);
+
 gboolean mm_port_serial_set_flow_control (MMPortSerial   *self,
                                           MMFlowControl   flow_control,
                                           GError        **error);
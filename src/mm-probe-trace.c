@@ -0,0 +1,231 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <stdio.h>
+#include <errno.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "mm-probe-trace.h"
+#include "mm-log.h"
+
+typedef struct {
+    guint       pid;
+    /* Port name to thread id; 0 is the device itself */
+    GHashTable *ports;
+    guint       next_tid;
+} TraceDevice;
+
+typedef struct {
+    gchar      *path;
+    FILE       *file;
+    /* Timestamps are given relative to the start of the recording */
+    gint64      start;
+    gboolean    empty;
+    /* Device uid to TraceDevice */
+    GHashTable *devices;
+    guint       next_pid;
+    GString    *buffer;
+} ProbeTrace;
+
+static ProbeTrace *trace;
+
+/*****************************************************************************/
+
+static void
+trace_device_free (TraceDevice *device)
+{
+    g_hash_table_destroy (device->ports);
+    g_slice_free (TraceDevice, device);
+}
+
+static void
+append_json_string (GString     *str,
+                    const gchar *value)
+{
+    const gchar *p;
+
+    g_string_append_c (str, '"');
+    for (p = value; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf (str, "\\%c", *p);
+        else if ((guchar) *p < 0x20)
+            g_string_append_printf (str, "\\u%04x", (guint) (guchar) *p);
+        else
+            g_string_append_c (str, *p);
+    }
+    g_string_append_c (str, '"');
+}
+
+static void
+write_event (void)
+{
+    /* The closing bracket is optional in the format, so events are written
+     * right away and the file is still valid if we don't shutdown cleanly */
+    if (!trace->empty)
+        fputs (",\n", trace->file);
+    trace->empty = FALSE;
+    fputs (trace->buffer->str, trace->file);
+    fflush (trace->file);
+    g_string_truncate (trace->buffer, 0);
+}
+
+static void
+write_name_metadata (const gchar *type,
+                     guint        pid,
+                     guint        tid,
+                     const gchar *name)
+{
+    g_string_append_printf (trace->buffer,
+                            "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":",
+                            type, pid, tid);
+    append_json_string (trace->buffer, name);
+    g_string_append (trace->buffer, "}}");
+    write_event ();
+}
+
+static TraceDevice *
+peek_device (const gchar *uid)
+{
+    TraceDevice *device;
+
+    device = g_hash_table_lookup (trace->devices, uid);
+    if (device)
+        return device;
+
+    device = g_slice_new0 (TraceDevice);
+    device->pid = ++trace->next_pid;
+    device->ports = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    device->next_tid = 1;
+    g_hash_table_insert (trace->devices, g_strdup (uid), device);
+
+    write_name_metadata ("process_name", device->pid, 0, uid);
+    write_name_metadata ("thread_name", device->pid, 0, "device");
+    return device;
+}
+
+static guint
+peek_port_tid (TraceDevice *device,
+               const gchar *port)
+{
+    gpointer tid;
+
+    if (g_hash_table_lookup_extended (device->ports, port, NULL, &tid))
+        return GPOINTER_TO_UINT (tid);
+
+    tid = GUINT_TO_POINTER (device->next_tid++);
+    g_hash_table_insert (device->ports, g_strdup (port), tid);
+
+    write_name_metadata ("thread_name", device->pid, GPOINTER_TO_UINT (tid), port);
+    return GPOINTER_TO_UINT (tid);
+}
+
+/*****************************************************************************/
+
+gboolean
+mm_probe_trace_is_enabled (void)
+{
+    return !!trace;
+}
+
+void
+mm_probe_trace_add (const gchar *device,
+                    const gchar *port,
+                    const gchar *name,
+                    gint64       start,
+                    const gchar *result)
+{
+    TraceDevice *trace_device;
+    guint        tid;
+    gint64       now;
+
+    if (!trace)
+        return;
+
+    g_return_if_fail (device != NULL);
+    g_return_if_fail (name != NULL);
+
+    now = g_get_monotonic_time ();
+    if (start < trace->start)
+        start = trace->start;
+
+    trace_device = peek_device (device);
+    tid = (port ? peek_port_tid (trace_device, port) : 0);
+
+    g_string_append (trace->buffer, "{\"name\":");
+    append_json_string (trace->buffer, name);
+    g_string_append_printf (trace->buffer,
+                            ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%u,\"tid\":%u",
+                            port ? "port" : "device",
+                            start - trace->start,
+                            now > start ? now - start : 0,
+                            trace_device->pid,
+                            tid);
+    if (result) {
+        g_string_append (trace->buffer, ",\"args\":{\"result\":");
+        append_json_string (trace->buffer, result);
+        g_string_append_c (trace->buffer, '}');
+    }
+    g_string_append_c (trace->buffer, '}');
+    write_event ();
+}
+
+/*****************************************************************************/
+
+void
+mm_probe_trace_setup (const gchar *path)
+{
+    FILE *file;
+
+    g_assert (!trace);
+
+    if (!path)
+        return;
+
+    file = g_fopen (path, "w");
+    if (!file) {
+        mm_warn ("Couldn't open probing trace file '%s': %s", path, g_strerror (errno));
+        return;
+    }
+
+    trace = g_slice_new0 (ProbeTrace);
+    trace->path = g_strdup (path);
+    trace->file = file;
+    trace->start = g_get_monotonic_time ();
+    trace->empty = TRUE;
+    trace->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) trace_device_free);
+    trace->buffer = g_string_sized_new (256);
+
+    fputs ("[\n", trace->file);
+    mm_dbg ("Recording probing trace in '%s'", path);
+}
+
+void
+mm_probe_trace_shutdown (void)
+{
+    if (!trace)
+        return;
+
+    fputs ("\n]\n", trace->file);
+    if (fclose (trace->file) != 0)
+        mm_warn ("Couldn't write probing trace file '%s': %s", trace->path, g_strerror (errno));
+    else
+        mm_dbg ("Probing trace written to '%s'", trace->path);
+
+    g_string_free (trace->buffer, TRUE);
+    g_hash_table_destroy (trace->devices);
+    g_free (trace->path);
+    g_slice_free (ProbeTrace, trace);
+    trace = NULL;
+}
@@ -0,0 +1,42 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_PROBE_TRACE_H
+#define MM_PROBE_TRACE_H
+
+#include <glib.h>
+
+/* Timeline of the device support checks.
+ *
+ * Each stage of the plugin manager and port probing logic is recorded as a
+ * span in a file using the Chrome trace event format (JSON array), which can
+ * be loaded in chrome://tracing or Perfetto. Each device is shown as a
+ * process, and each of its ports as a thread. */
+
+/* Start recording in the given file; if NULL, recording is disabled */
+void     mm_probe_trace_setup      (const gchar *path);
+/* Finish the file and stop recording */
+void     mm_probe_trace_shutdown   (void);
+
+gboolean mm_probe_trace_is_enabled (void);
+
+/* Record a span from the given start time (as given by g_get_monotonic_time())
+ * until now. If no port is given, the span is recorded for the whole device.
+ * The result is optional. */
+void     mm_probe_trace_add        (const gchar *device,
+                                    const gchar *port,
+                                    const gchar *name,
+                                    gint64       start,
+                                    const gchar *result);
+
+#endif /* MM_PROBE_TRACE_H */
@@ -404,3 +404,512 @@ mm_serial_parser_v1_destroy (gpointer data)
 
     g_slice_free (MMSerialParserV1, data);
 }
+
+/*****************************************************************************/
+/* V2 parser
+ *
+ * Instead of running the whole list of regular expressions over the complete
+ * response every time new data arrives, the V2 parser looks at the response
+ * line by line:
+ *
+ *  - Final result codes which V1 looks for anywhere in the response (CONNECT,
+ *    ERROR, NO CARRIER...) are looked for in each complete line just once;
+ *    the offset of the last scanned line is kept in the parser so that only
+ *    newly received lines are scanned in the next call.
+ *
+ *  - Final result codes which V1 requires at the end of the response (OK,
+ *    +CME ERROR, +CMS ERROR...) are only looked for in the last complete line,
+ *    found by walking the response backwards.
+ *
+ * There are some minor differences with the V1 parser, all of them given by
+ * V1 regexes matching more than they should: final result codes are only
+ * reported once the line is complete (i.e. "\r\nERROR" without the trailing
+ * <CR><LF> is not an error yet) and always need to be the whole contents of
+ * the line (i.e. "BUSY" in the middle of a line is not a connection error).
+ * Also, the specific connection error is reported (V1 reports NO CARRIER for
+ * BUSY, NO ANSWER and NO DIALTONE).
+ */
+
+typedef struct {
+    gboolean          connect;
+    gboolean          unknown_error;
+    gboolean          connect_failed;
+    MMConnectionError connect_failed_code;
+    gboolean          na;
+} ParserV2ScanResult;
+
+typedef struct {
+    /* Custom regular expressions used as hooks for non-standard replies */
+    GRegex *regex_custom_successful;
+    GRegex *regex_custom_error;
+    /* User-provided parser filter */
+    mm_serial_parser_v2_filter_fn filter_callback;
+    gpointer                      filter_user_data;
+    /* Incremental scan state; the result of the scan is kept until the
+     * response is reset, as the lines may have been scanned by
+     * mm_serial_parser_v2_check(). The owner of the response buffer must
+     * call mm_serial_parser_v2_reset() whenever it removes contents. */
+    gsize              scan_offset;
+    ParserV2ScanResult scan_result;
+} MMSerialParserV2;
+
+#define LINE_HAS_PREFIX(line, line_len, prefix)        \
+    ((line_len) >= (sizeof (prefix) - 1) &&            \
+     memcmp ((line), (prefix), sizeof (prefix) - 1) == 0)
+
+#define LINE_IS(line, line_len, str)                   \
+    ((line_len) == (sizeof (str) - 1) &&               \
+     memcmp ((line), (str), sizeof (str) - 1) == 0)
+
+/* Find the first <CR><LF> starting at the given offset, or -1 if none */
+static gssize
+find_crlf (const gchar *str,
+           gsize        len,
+           gsize        from)
+{
+    const gchar *p;
+
+    while (from + 1 < len) {
+        p = memchr (str + from, '\r', len - from - 1);
+        if (!p)
+            return -1;
+        if (p[1] == '\n')
+            return p - str;
+        from = (p - str) + 1;
+    }
+    return -1;
+}
+
+/* Find the last <CR><LF> ending before the given offset, or -1 if none */
+static gssize
+find_crlf_reverse (const gchar *str,
+                   gsize        end)
+{
+    for (; end >= 2; end--) {
+        if (str[end - 2] == '\r' && str[end - 1] == '\n')
+            return end - 2;
+    }
+    return -1;
+}
+
+static void
+parser_v2_scan_reset (MMSerialParserV2 *parser)
+{
+    parser->scan_offset = 0;
+    memset (&parser->scan_result, 0, sizeof (parser->scan_result));
+}
+
+static void
+parser_v2_scan_line (const gchar        *line,
+                     gsize               line_len,
+                     ParserV2ScanResult *result)
+{
+    if (!line_len)
+        return;
+
+    if (LINE_HAS_PREFIX (line, line_len, "CONNECT")) {
+        result->connect = TRUE;
+        return;
+    }
+
+    if (LINE_HAS_PREFIX (line, line_len, "ERROR") ||
+        LINE_HAS_PREFIX (line, line_len, "COMMAND NOT SUPPORT")) {
+        result->unknown_error = TRUE;
+        return;
+    }
+
+    if (LINE_IS (line, line_len, "NA")) {
+        result->na = TRUE;
+        return;
+    }
+
+    /* Only the first connection error found is reported */
+    if (result->connect_failed)
+        return;
+
+    if (LINE_HAS_PREFIX (line, line_len, "NO CARRIER"))
+        result->connect_failed_code = MM_CONNECTION_ERROR_NO_CARRIER;
+    else if (LINE_HAS_PREFIX (line, line_len, "BUSY"))
+        result->connect_failed_code = MM_CONNECTION_ERROR_BUSY;
+    else if (LINE_HAS_PREFIX (line, line_len, "NO ANSWER"))
+        result->connect_failed_code = MM_CONNECTION_ERROR_NO_ANSWER;
+    else if (LINE_HAS_PREFIX (line, line_len, "NO DIALTONE"))
+        result->connect_failed_code = MM_CONNECTION_ERROR_NO_DIALTONE;
+    else
+        return;
+    result->connect_failed = TRUE;
+}
+
+/* Scan all complete lines received since the last call */
+static void
+parser_v2_scan (MMSerialParserV2 *parser,
+                const gchar      *str,
+                gsize             len)
+{
+    gssize start;
+    gssize end;
+
+    /* Never scan past the end, even if contents were removed without
+     * resetting the parser */
+    if (G_UNLIKELY (len < parser->scan_offset))
+        parser_v2_scan_reset (parser);
+
+    start = find_crlf (str, len, parser->scan_offset);
+    if (start < 0) {
+        /* The last byte may be the <CR> of a <CR><LF> not fully received */
+        if (len > parser->scan_offset + 1)
+            parser->scan_offset = len - 1;
+    } else {
+        while ((end = find_crlf (str, len, start + 2)) >= 0) {
+            parser_v2_scan_line (str + start + 2, end - start - 2, &parser->scan_result);
+            start = end;
+        }
+        /* Next scan starts at the <CR><LF> leading the incomplete line */
+        parser->scan_offset = start;
+    }
+}
+
+/* Find the last complete line in the response, i.e. the last line preceded
+ * by <CR><LF> and followed by one or more <CR><LF>. Returns the offset of the
+ * <CR><LF> leading the line. */
+static gssize
+parser_v2_find_last_line (const gchar  *str,
+                          gsize         len,
+                          const gchar **line,
+                          gsize        *line_len)
+{
+    gsize  end;
+    gssize start;
+
+    end = len;
+    if (end < 2 || str[end - 2] != '\r' || str[end - 1] != '\n')
+        return -1;
+
+    while (end >= 2 && str[end - 2] == '\r' && str[end - 1] == '\n')
+        end -= 2;
+
+    start = find_crlf_reverse (str, end);
+    if (start < 0)
+        return -1;
+
+    *line = str + start + 2;
+    *line_len = end - start - 2;
+    return start;
+}
+
+/* Returns the value given after a "<prefix>:" error line, with leading
+ * whitespaces skipped, or NULL if there's no value */
+static gchar *
+parser_v2_get_error_value (const gchar *line,
+                           gsize        line_len,
+                           gsize        prefix_len,
+                           gboolean     numeric)
+{
+    const gchar *value;
+    gsize        value_len;
+    gsize        i;
+
+    value = line + prefix_len;
+    value_len = line_len - prefix_len;
+    while (value_len > 0 && g_ascii_isspace (*value)) {
+        value++;
+        value_len--;
+    }
+
+    if (numeric) {
+        if (!value_len)
+            return NULL;
+        for (i = 0; i < value_len; i++) {
+            if (!g_ascii_isdigit (value[i]))
+                return NULL;
+        }
+    } else if (!value_len) {
+        /* Keep the last whitespace, as V1 does */
+        if (value == line + prefix_len)
+            return NULL;
+        value--;
+        value_len++;
+    }
+
+    return g_strndup (value, value_len);
+}
+
+static gboolean
+parser_v2_is_sms_prompt (const gchar *str,
+                         gsize        len)
+{
+    gsize end;
+
+    end = len;
+    while (end > 0 && g_ascii_isspace (str[end - 1]))
+        end--;
+
+    return (end >= 3 &&
+            str[end - 1] == '>' &&
+            str[end - 2] == '\n' &&
+            str[end - 3] == '\r');
+}
+
+static gboolean
+parser_v2_is_final_line (const gchar *line,
+                         gsize        line_len)
+{
+    return (LINE_IS (line, line_len, "OK") ||
+            LINE_HAS_PREFIX (line, line_len, "+CME ERROR:") ||
+            LINE_HAS_PREFIX (line, line_len, "+CMS ERROR:") ||
+            LINE_HAS_PREFIX (line, line_len, "MODEM ERROR:"));
+}
+
+gpointer
+mm_serial_parser_v2_new (void)
+{
+    return g_slice_new0 (MMSerialParserV2);
+}
+
+void
+mm_serial_parser_v2_set_custom_regex (gpointer data,
+                                      GRegex *successful,
+                                      GRegex *error)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+
+    g_return_if_fail (parser != NULL);
+
+    if (parser->regex_custom_successful)
+        g_regex_unref (parser->regex_custom_successful);
+    if (parser->regex_custom_error)
+        g_regex_unref (parser->regex_custom_error);
+
+    parser->regex_custom_successful = successful ? g_regex_ref (successful) : NULL;
+    parser->regex_custom_error = error ? g_regex_ref (error) : NULL;
+}
+
+void
+mm_serial_parser_v2_add_filter (gpointer data,
+                                mm_serial_parser_v2_filter_fn callback,
+                                gpointer user_data)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+
+    g_return_if_fail (parser != NULL);
+
+    parser->filter_callback = callback;
+    parser->filter_user_data = user_data;
+}
+
+void
+mm_serial_parser_v2_reset (gpointer data)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+
+    g_return_if_fail (parser != NULL);
+
+    parser_v2_scan_reset (parser);
+}
+
+gboolean
+mm_serial_parser_v2_check (gpointer     data,
+                           const gchar *response,
+                           gsize        response_len)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+    const gchar *line = NULL;
+    gsize line_len = 0;
+    ParserV2ScanResult *scan;
+
+    g_return_val_if_fail (parser != NULL, TRUE);
+
+    if (G_UNLIKELY (!response_len))
+        return FALSE;
+
+    /* Leading NUL bytes need to be cleaned up, and filters and custom regexes
+     * may look at anything in the response; leave all that to the parser */
+    if (response[0] == '\0' ||
+        parser->filter_callback ||
+        parser->regex_custom_successful ||
+        parser->regex_custom_error)
+        return TRUE;
+
+    /* Scan the newly received complete lines; the result is kept in the
+     * parser state so that it is not lost for the parse() call */
+    parser_v2_scan (parser, response, response_len);
+    scan = &parser->scan_result;
+    if (scan->connect || scan->unknown_error || scan->connect_failed || scan->na)
+        return TRUE;
+
+    if (parser_v2_find_last_line (response, response_len, &line, &line_len) >= 0 &&
+        parser_v2_is_final_line (line, line_len))
+        return TRUE;
+
+    return parser_v2_is_sms_prompt (response, response_len);
+}
+
+gboolean
+mm_serial_parser_v2_parse (gpointer data,
+                           GString *response,
+                           GError **error)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+    ParserV2ScanResult scan;
+    GError *local_error = NULL;
+    gboolean found = FALSE;
+    const gchar *line = NULL;
+    gsize line_len = 0;
+    gssize line_start;
+    gchar *str = NULL;
+
+    g_return_val_if_fail (parser != NULL, FALSE);
+    g_return_val_if_fail (response != NULL, FALSE);
+
+    /* Skip NUL bytes if they are found leading the response */
+    while (response->len > 0 && response->str[0] == '\0')
+        g_string_erase (response, 0, 1);
+
+    if (G_UNLIKELY (!response->len))
+        return FALSE;
+
+    /* First, apply custom filter if any */
+    if (parser->filter_callback &&
+        !parser->filter_callback (parser,
+                                  parser->filter_user_data,
+                                  response,
+                                  &local_error)) {
+        g_assert (local_error != NULL);
+        mm_dbg ("Got response filtered in serial port: %s", local_error->message);
+        g_propagate_error (error, local_error);
+        response_clean (response);
+        parser_v2_scan_reset (parser);
+        return TRUE;
+    }
+
+    /* Custom successful replies first, if any */
+    if (parser->regex_custom_successful &&
+        g_regex_match_full (parser->regex_custom_successful,
+                            response->str, response->len,
+                            0, 0, NULL, NULL)) {
+        found = TRUE;
+        goto done;
+    }
+
+    /* Look for final result codes in the newly received complete lines, and
+     * in the last complete line of the response */
+    parser_v2_scan (parser, response->str, response->len);
+    scan = parser->scan_result;
+    line_start = parser_v2_find_last_line (response->str, response->len, &line, &line_len);
+
+    /* Successful responses */
+    if (line && LINE_IS (line, line_len, "OK")) {
+        g_string_truncate (response, line_start);
+        found = TRUE;
+        goto done;
+    }
+
+    if (scan.connect || parser_v2_is_sms_prompt (response->str, response->len)) {
+        found = TRUE;
+        goto done;
+    }
+
+    /* Custom error matches first, if any */
+    if (parser->regex_custom_error) {
+        GMatchInfo *match_info;
+
+        found = g_regex_match_full (parser->regex_custom_error,
+                                    response->str, response->len,
+                                    0, 0, &match_info, NULL);
+        if (found) {
+            str = g_match_info_fetch (match_info, 1);
+            g_assert (str);
+            local_error = mm_mobile_equipment_error_for_code (atoi (str));
+        }
+        g_match_info_free (match_info);
+        if (found)
+            goto done;
+    }
+
+    if (line) {
+        /* Numeric and string CME errors */
+        if (LINE_HAS_PREFIX (line, line_len, "+CME ERROR:")) {
+            if ((str = parser_v2_get_error_value (line, line_len, strlen ("+CME ERROR:"), TRUE)))
+                local_error = mm_mobile_equipment_error_for_code (atoi (str));
+            else if ((str = parser_v2_get_error_value (line, line_len, strlen ("+CME ERROR:"), FALSE)))
+                local_error = mm_mobile_equipment_error_for_string (str);
+        }
+        /* Numeric and string CMS errors */
+        else if (LINE_HAS_PREFIX (line, line_len, "+CMS ERROR:")) {
+            if ((str = parser_v2_get_error_value (line, line_len, strlen ("+CMS ERROR:"), TRUE)))
+                local_error = mm_message_error_for_code (atoi (str));
+            else if ((str = parser_v2_get_error_value (line, line_len, strlen ("+CMS ERROR:"), FALSE)))
+                local_error = mm_message_error_for_string (str);
+        }
+        /* Motorola EZX errors */
+        else if (LINE_HAS_PREFIX (line, line_len, "MODEM ERROR:")) {
+            if ((str = parser_v2_get_error_value (line, line_len, strlen ("MODEM ERROR:"), TRUE)))
+                local_error = mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+        }
+
+        if (local_error) {
+            found = TRUE;
+            goto done;
+        }
+    }
+
+    /* Last resort; unknown error */
+    if (scan.unknown_error) {
+        local_error = mm_mobile_equipment_error_for_code (MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+        found = TRUE;
+        goto done;
+    }
+
+    /* Connection failures */
+    if (scan.connect_failed) {
+        local_error = mm_connection_error_for_code (scan.connect_failed_code);
+        found = TRUE;
+        goto done;
+    }
+
+    /* NA error */
+    if (scan.na) {
+        /* Assume NA means 'Not Allowed' :) */
+        local_error = g_error_new (MM_MOBILE_EQUIPMENT_ERROR,
+                                   MM_MOBILE_EQUIPMENT_ERROR_NOT_ALLOWED,
+                                   "Not Allowed");
+        found = TRUE;
+        goto done;
+    }
+
+done:
+    g_free (str);
+    if (found) {
+        response_clean (response);
+        parser_v2_scan_reset (parser);
+    }
+
+    if (local_error) {
+        mm_dbg ("Got failure code %d: %s", local_error->code, local_error->message);
+        g_propagate_error (error, local_error);
+    }
+
+    return found;
+}
+
+gboolean
+mm_serial_parser_v2_is_known_error (const GError *error)
+{
+    /* Same kind of errors as in the V1 parser */
+    return mm_serial_parser_v1_is_known_error (error);
+}
+
+void
+mm_serial_parser_v2_destroy (gpointer data)
+{
+    MMSerialParserV2 *parser = (MMSerialParserV2 *) data;
+
+    g_return_if_fail (parser != NULL);
+
+    if (parser->regex_custom_successful)
+        g_regex_unref (parser->regex_custom_successful);
+    if (parser->regex_custom_error)
+        g_regex_unref (parser->regex_custom_error);
+
+    g_slice_free (MMSerialParserV2, data);
+}
@@ -38,4 +38,33 @@ void     mm_serial_parser_v1_add_filter (gpointer data,
                                          mm_serial_parser_v1_filter_fn callback,
                                          gpointer user_data);
 
+/* V2 parser: same behaviour as the V1 parser for all standard final result
+ * codes, but implemented as a single pass over the complete lines of the
+ * response instead of a cascade of regular expressions run over the whole
+ * buffer. Custom regexes are still supported, and are used as hooks for
+ * those modems replying with non-standard final results. */
+typedef mm_serial_parser_v1_filter_fn mm_serial_parser_v2_filter_fn;
+
+gpointer mm_serial_parser_v2_new                  (void);
+void     mm_serial_parser_v2_set_custom_regex     (gpointer data,
+                                                   GRegex *successful,
+                                                   GRegex *error);
+void     mm_serial_parser_v2_add_filter           (gpointer data,
+                                                   mm_serial_parser_v2_filter_fn callback,
+                                                   gpointer user_data);
+gboolean mm_serial_parser_v2_parse                (gpointer parser,
+                                                   GString *response,
+                                                   GError **error);
+/* Quick check on a read-only view of the response: returns FALSE if parse()
+ * would certainly not find a final result code yet, so that the response
+ * doesn't need to be copied and parsed. */
+gboolean mm_serial_parser_v2_check                (gpointer parser,
+                                                   const gchar *response,
+                                                   gsize response_len);
+/* Drop the incremental scan state; must be called whenever contents already
+ * given to parse() or check() are removed from the response. */
+void     mm_serial_parser_v2_reset                (gpointer parser);
+void     mm_serial_parser_v2_destroy              (gpointer parser);
+gboolean mm_serial_parser_v2_is_known_error       (const GError *error);
+
 #endif /* MM_SERIAL_PARSERS_H */
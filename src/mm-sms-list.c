@@ -48,34 +48,221 @@ static guint signals[SIGNAL_LAST];
 struct _MMSmsListPrivate {
     /* The owner modem */
     MMBaseModem *modem;
-    /* List of sms objects */
-    GList *list;
+    /* List of sms objects, most recent first */
+    GQueue *list;
+    /* Path of the exported sms objects to their link in the list */
+    GHashTable *by_path;
+    /* Storage and index of the parts taken to the sms they belong to */
+    GHashTable *by_part;
+    /* Concat reference and number of the multipart sms built from taken
+     * parts, to the list of sms with those, most recent first */
+    GHashTable *by_reference;
+    /* Sms objects created by the user. Their parts only get an index and a
+     * multipart reference once stored or sent, so they're not indexed. */
+    GList *local;
 };
 
 /*****************************************************************************/
+/* Indexes */
+
+typedef struct {
+    MMSmsStorage storage;
+    guint index;
+} PartKey;
+
+static guint
+part_key_hash (const PartKey *key)
+{
+    return (key->index * 31) + key->storage;
+}
+
+static gboolean
+part_key_equal (const PartKey *a,
+                const PartKey *b)
+{
+    return (a->storage == b->storage && a->index == b->index);
+}
+
+static PartKey *
+part_key_new (MMSmsStorage storage,
+              guint index)
+{
+    PartKey *key;
+
+    key = g_slice_new (PartKey);
+    key->storage = storage;
+    key->index = index;
+    return key;
+}
+
+static void
+part_key_free (PartKey *key)
+{
+    g_slice_free (PartKey, key);
+}
+
+static gchar *
+build_reference_key (guint reference,
+                     const gchar *number)
+{
+    return g_strdup_printf ("%u/%s", reference, number ? number : "");
+}
+
+static gchar *
+build_sms_reference_key (MMBaseSms *sms)
+{
+    GList *parts;
+
+    /* All parts of a multipart sms built from taken parts have the same
+     * number, see take_multipart() */
+    parts = mm_base_sms_get_parts (sms);
+    g_assert (parts != NULL);
+
+    return build_reference_key (mm_base_sms_get_multipart_reference (sms),
+                                mm_sms_part_get_number ((MMSmsPart *)parts->data));
+}
+
+static void
+index_part (MMSmsList *self,
+            MMBaseSms *sms,
+            MMSmsPart *part)
+{
+    MMSmsStorage storage;
+    guint index;
+
+    storage = mm_base_sms_get_storage (sms);
+    index = mm_sms_part_get_index (part);
+    if (storage == MM_SMS_STORAGE_UNKNOWN || index == SMS_PART_INVALID_INDEX)
+        return;
+
+    g_hash_table_insert (self->priv->by_part, part_key_new (storage, index), sms);
+}
+
+static void
+list_insert (MMSmsList *self,
+             MMBaseSms *sms,
+             gboolean local)
+{
+    const gchar *path;
+    GList *l;
+
+    g_queue_push_head (self->priv->list, sms);
+
+    path = mm_base_sms_get_path (sms);
+    if (path)
+        g_hash_table_insert (self->priv->by_path, g_strdup (path), self->priv->list->head);
+
+    if (local) {
+        self->priv->local = g_list_prepend (self->priv->local, sms);
+        return;
+    }
+
+    for (l = mm_base_sms_get_parts (sms); l; l = g_list_next (l))
+        index_part (self, sms, (MMSmsPart *)l->data);
+
+    if (mm_base_sms_is_multipart (sms)) {
+        gchar *key;
+        GQueue *bucket;
+
+        key = build_sms_reference_key (sms);
+        bucket = g_hash_table_lookup (self->priv->by_reference, key);
+        if (!bucket) {
+            bucket = g_queue_new ();
+            g_hash_table_insert (self->priv->by_reference, key, bucket);
+        } else
+            g_free (key);
+        g_queue_push_head (bucket, sms);
+    }
+}
+
+/* Returns the reference of the sms owned by the list */
+static MMBaseSms *
+list_remove (MMSmsList *self,
+             GList *link)
+{
+    MMBaseSms *sms;
+    MMSmsStorage storage;
+    const gchar *path;
+    GList *l;
+
+    sms = MM_BASE_SMS (link->data);
+    g_queue_delete_link (self->priv->list, link);
+
+    path = mm_base_sms_get_path (sms);
+    if (path)
+        g_hash_table_remove (self->priv->by_path, path);
+
+    if (g_list_find (self->priv->local, sms)) {
+        self->priv->local = g_list_remove (self->priv->local, sms);
+        return sms;
+    }
+
+    storage = mm_base_sms_get_storage (sms);
+    for (l = mm_base_sms_get_parts (sms); l; l = g_list_next (l)) {
+        PartKey key;
+
+        key.storage = storage;
+        key.index = mm_sms_part_get_index ((MMSmsPart *)l->data);
+        if (g_hash_table_lookup (self->priv->by_part, &key) == sms)
+            g_hash_table_remove (self->priv->by_part, &key);
+    }
+
+    if (mm_base_sms_is_multipart (sms)) {
+        gchar *key;
+        GQueue *bucket;
+
+        key = build_sms_reference_key (sms);
+        bucket = g_hash_table_lookup (self->priv->by_reference, key);
+        if (bucket) {
+            g_queue_remove (bucket, sms);
+            if (g_queue_is_empty (bucket))
+                g_hash_table_remove (self->priv->by_reference, key);
+        }
+        g_free (key);
+    }
+
+    return sms;
+}
+
+/*****************************************************************************/
+
+static gboolean
+is_local_multipart_reference (MMBaseSms *sms,
+                              const gchar *number,
+                              guint8 reference)
+{
+    return (mm_base_sms_is_multipart (sms) &&
+            mm_gdbus_sms_get_pdu_type (MM_GDBUS_SMS (sms)) == MM_SMS_PDU_TYPE_SUBMIT &&
+            mm_base_sms_get_storage (sms) != MM_SMS_STORAGE_UNKNOWN &&
+            mm_base_sms_get_multipart_reference (sms) == reference &&
+            g_str_equal (mm_gdbus_sms_get_number (MM_GDBUS_SMS (sms)), number));
+}
 
 gboolean
 mm_sms_list_has_local_multipart_reference (MMSmsList *self,
                                            const gchar *number,
                                            guint8 reference)
 {
+    GQueue *bucket;
+    gchar *key;
     GList *l;
 
     /* No one should look for multipart reference 0, which isn't valid */
     g_assert (reference != 0);
 
-    for (l = self->priv->list; l; l = g_list_next (l)) {
-        MMBaseSms *sms = MM_BASE_SMS (l->data);
+    /* Stored messages loaded from the modem */
+    key = build_reference_key (reference, number);
+    bucket = g_hash_table_lookup (self->priv->by_reference, key);
+    g_free (key);
+    for (l = bucket ? bucket->head : NULL; l; l = g_list_next (l)) {
+        if (is_local_multipart_reference (MM_BASE_SMS (l->data), number, reference))
+            return TRUE;
+    }
 
-        if (mm_base_sms_is_multipart (sms) &&
-            mm_gdbus_sms_get_pdu_type (MM_GDBUS_SMS (sms)) == MM_SMS_PDU_TYPE_SUBMIT &&
-            mm_base_sms_get_storage (sms) != MM_SMS_STORAGE_UNKNOWN &&
-            mm_base_sms_get_multipart_reference (sms) == reference &&
-            g_str_equal (mm_gdbus_sms_get_number (MM_GDBUS_SMS (sms)), number)) {
-            /* Yes, the SMS list has an SMS with the same destination number
-             * and multipart reference */
+    /* Messages created by the user */
+    for (l = self->priv->local; l; l = g_list_next (l)) {
+        if (is_local_multipart_reference (MM_BASE_SMS (l->data), number, reference))
             return TRUE;
-        }
     }
 
     return FALSE;
@@ -86,7 +273,7 @@ mm_sms_list_has_local_multipart_reference (MMSmsList *self,
 guint
 mm_sms_list_get_count (MMSmsList *self)
 {
-    return g_list_length (self->priv->list);
+    return g_queue_get_length (self->priv->list);
 }
 
 GStrv
@@ -97,9 +284,9 @@ mm_sms_list_get_paths (MMSmsList *self)
     guint i;
 
     path_list = g_new0 (gchar *,
-                        1 + g_list_length (self->priv->list));
+                        1 + g_queue_get_length (self->priv->list));
 
-    for (i = 0, l = self->priv->list; l; l = g_list_next (l)) {
+    for (i = 0, l = self->priv->list->head; l; l = g_list_next (l)) {
         const gchar *path;
 
         /* Don't try to add NULL paths (not yet exported SMS objects) */
@@ -121,13 +308,6 @@ mm_sms_list_delete_sms_finish (MMSmsList *self,
     return g_task_propagate_boolean (G_TASK (res), error);
 }
 
-static guint
-cmp_sms_by_path (MMBaseSms *sms,
-                 const gchar *path)
-{
-    return g_strcmp0 (mm_base_sms_get_path (sms), path);
-}
-
 static void
 delete_ready (MMBaseSms *sms,
               GAsyncResult *res,
@@ -148,13 +328,9 @@ delete_ready (MMBaseSms *sms,
     self = g_task_get_source_object (task);
     path = g_task_get_task_data (task);
     /* The SMS was properly deleted, we now remove it from our list */
-    l = g_list_find_custom (self->priv->list,
-                            path,
-                            (GCompareFunc)cmp_sms_by_path);
-    if (l) {
-        g_object_unref (MM_BASE_SMS (l->data));
-        self->priv->list = g_list_delete_link (self->priv->list, l);
-    }
+    l = g_hash_table_lookup (self->priv->by_path, path);
+    if (l)
+        g_object_unref (list_remove (self, l));
 
     /* We don't need to unref the SMS any more, but we can use the
      * reference we got in the method, which is the one kept alive
@@ -178,9 +354,7 @@ mm_sms_list_delete_sms (MMSmsList *self,
     GList *l;
     GTask *task;
 
-    l = g_list_find_custom (self->priv->list,
-                            (gpointer)sms_path,
-                            (GCompareFunc)cmp_sms_by_path);
+    l = g_hash_table_lookup (self->priv->by_path, sms_path);
     if (!l) {
         g_task_report_new_error (self,
                                  callback,
@@ -208,7 +382,7 @@ void
 mm_sms_list_add_sms (MMSmsList *self,
                      MMBaseSms *sms)
 {
-    self->priv->list = g_list_prepend (self->priv->list, g_object_ref (sms));
+    list_insert (self, g_object_ref (sms), TRUE);
     g_signal_emit (self, signals[SIGNAL_ADDED], 0,
                    mm_base_sms_get_path (sms),
                    FALSE);
@@ -216,29 +390,6 @@ mm_sms_list_add_sms (MMSmsList *self,
 
 /*****************************************************************************/
 
-static guint
-cmp_sms_by_concat_reference (MMBaseSms *sms,
-                             gpointer user_data)
-{
-    if (!mm_base_sms_is_multipart (sms))
-        return -1;
-
-    return (GPOINTER_TO_UINT (user_data) - mm_base_sms_get_multipart_reference (sms));
-}
-
-typedef struct {
-    guint part_index;
-    MMSmsStorage storage;
-} PartIndexAndStorage;
-
-static guint
-cmp_sms_by_part_index_and_storage (MMBaseSms *sms,
-                                   PartIndexAndStorage *ctx)
-{
-    return !(mm_base_sms_get_storage (sms) == ctx->storage &&
-             mm_base_sms_has_part_index (sms, ctx->part_index));
-}
-
 static gboolean
 take_singlepart (MMSmsList *self,
                  MMSmsPart *part,
@@ -256,7 +407,7 @@ take_singlepart (MMSmsList *self,
     if (!sms)
         return FALSE;
 
-    self->priv->list = g_list_prepend (self->priv->list, sms);
+    list_insert (self, sms, FALSE);
     g_signal_emit (self, signals[SIGNAL_ADDED], 0,
                    mm_base_sms_get_path (sms),
                    state == MM_SMS_STATE_RECEIVED);
@@ -270,17 +421,26 @@ take_multipart (MMSmsList *self,
                 MMSmsStorage storage,
                 GError **error)
 {
-    GList *l;
     MMBaseSms *sms;
     guint concat_reference;
+    GQueue *bucket;
+    gchar *key;
 
+    /* Parts are matched with the most recent multipart SMS with the same
+     * concat reference and number */
     concat_reference = mm_sms_part_get_concat_reference (part);
-    l = g_list_find_custom (self->priv->list,
-                            GUINT_TO_POINTER (concat_reference),
-                            (GCompareFunc)cmp_sms_by_concat_reference);
-    if (l)
+    key = build_reference_key (concat_reference, mm_sms_part_get_number (part));
+    bucket = g_hash_table_lookup (self->priv->by_reference, key);
+    g_free (key);
+    if (bucket) {
+        sms = MM_BASE_SMS (g_queue_peek_head (bucket));
+
         /* Try to take the part */
-        return mm_base_sms_multipart_take_part (MM_BASE_SMS (l->data), part, error);
+        if (!mm_base_sms_multipart_take_part (sms, part, error))
+            return FALSE;
+        index_part (self, sms, part);
+        return TRUE;
+    }
 
     /* Create new Multipart */
     sms = mm_base_sms_multipart_new (self->priv->modem,
@@ -293,7 +453,7 @@ take_multipart (MMSmsList *self,
     if (!sms)
         return FALSE;
 
-    self->priv->list = g_list_prepend (self->priv->list, sms);
+    list_insert (self, sms, FALSE);
     g_signal_emit (self, signals[SIGNAL_ADDED], 0,
                    mm_base_sms_get_path (sms),
                    (state == MM_SMS_STATE_RECEIVED ||
@@ -307,18 +467,27 @@ mm_sms_list_has_part (MMSmsList *self,
                       MMSmsStorage storage,
                       guint index)
 {
-    PartIndexAndStorage ctx;
+    PartKey key;
+    GList *l;
 
     if (storage == MM_SMS_STORAGE_UNKNOWN ||
         index == SMS_PART_INVALID_INDEX)
         return FALSE;
 
-    ctx.part_index = index;
-    ctx.storage = storage;
+    key.storage = storage;
+    key.index = index;
+    if (g_hash_table_contains (self->priv->by_part, &key))
+        return TRUE;
 
-    return !!g_list_find_custom (self->priv->list,
-                                 &ctx,
-                                 (GCompareFunc)cmp_sms_by_part_index_and_storage);
+    for (l = self->priv->local; l; l = g_list_next (l)) {
+        MMBaseSms *sms = MM_BASE_SMS (l->data);
+
+        if (mm_base_sms_get_storage (sms) == storage &&
+            mm_base_sms_has_part_index (sms, index))
+            return TRUE;
+    }
+
+    return FALSE;
 }
 
 gboolean
@@ -328,11 +497,6 @@ mm_sms_list_take_part (MMSmsList *self,
                        MMSmsStorage storage,
                        GError **error)
 {
-    PartIndexAndStorage ctx;
-
-    ctx.part_index = mm_sms_part_get_index (part);
-    ctx.storage = storage;
-
     /* Ensure we don't have already taken a part with the same index */
     if (mm_sms_list_has_part (self,
                               storage,
@@ -426,6 +590,13 @@ mm_sms_list_init (MMSmsList *self)
     self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                               MM_TYPE_SMS_LIST,
                                               MMSmsListPrivate);
+    self->priv->list = g_queue_new ();
+    self->priv->by_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    self->priv->by_part = g_hash_table_new_full ((GHashFunc)part_key_hash,
+                                                 (GEqualFunc)part_key_equal,
+                                                 (GDestroyNotify)part_key_free,
+                                                 NULL);
+    self->priv->by_reference = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
 }
 
 static void
@@ -434,12 +605,30 @@ dispose (GObject *object)
     MMSmsList *self = MM_SMS_LIST (object);
 
     g_clear_object (&self->priv->modem);
-    g_list_free_full (self->priv->list, g_object_unref);
-    self->priv->list = NULL;
+    g_hash_table_remove_all (self->priv->by_path);
+    g_hash_table_remove_all (self->priv->by_part);
+    g_hash_table_remove_all (self->priv->by_reference);
+    g_list_free (self->priv->local);
+    self->priv->local = NULL;
+    while (!g_queue_is_empty (self->priv->list))
+        g_object_unref (g_queue_pop_head (self->priv->list));
 
     G_OBJECT_CLASS (mm_sms_list_parent_class)->dispose (object);
 }
 
+static void
+finalize (GObject *object)
+{
+    MMSmsList *self = MM_SMS_LIST (object);
+
+    g_queue_free (self->priv->list);
+    g_hash_table_destroy (self->priv->by_path);
+    g_hash_table_destroy (self->priv->by_part);
+    g_hash_table_destroy (self->priv->by_reference);
+
+    G_OBJECT_CLASS (mm_sms_list_parent_class)->finalize (object);
+}
+
 static void
 mm_sms_list_class_init (MMSmsListClass *klass)
 {
@@ -451,6 +640,7 @@ mm_sms_list_class_init (MMSmsListClass *klass)
     object_class->get_property = get_property;
     object_class->set_property = set_property;
     object_class->dispose = dispose;
+    object_class->finalize = finalize;
 
     /* Properties */
     properties[PROP_MODEM] =
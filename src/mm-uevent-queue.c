@@ -0,0 +1,110 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include "mm-uevent-queue.h"
+#include "mm-log.h"
+
+typedef struct {
+    gchar    *sysfs_path;
+    GObject  *device;
+    gboolean  remove;
+    gboolean  add;
+} PendingUevent;
+
+struct _MMUeventQueue {
+    GQueue     *pending;
+    /* sysfs path to its link in the queue */
+    GHashTable *by_path;
+};
+
+static void
+pending_uevent_free (PendingUevent *pending)
+{
+    g_object_unref (pending->device);
+    g_free (pending->sysfs_path);
+    g_slice_free (PendingUevent, pending);
+}
+
+void
+mm_uevent_queue_push (MMUeventQueue *self,
+                      const gchar   *sysfs_path,
+                      GObject       *device,
+                      gboolean       remove)
+{
+    PendingUevent *pending;
+    GList         *link;
+
+    link = g_hash_table_lookup (self->by_path, sysfs_path);
+    if (!link) {
+        pending = g_slice_new0 (PendingUevent);
+        pending->sysfs_path = g_strdup (sysfs_path);
+        pending->device = g_object_ref (device);
+        g_queue_push_tail (self->pending, pending);
+        g_hash_table_insert (self->by_path, pending->sysfs_path, g_queue_peek_tail_link (self->pending));
+    } else {
+        mm_dbg ("Coalescing uevents for %s", sysfs_path);
+        pending = link->data;
+        g_object_unref (pending->device);
+        pending->device = g_object_ref (device);
+
+        /* Move the merged event to the position of the last one received */
+        g_queue_unlink (self->pending, link);
+        g_queue_push_tail_link (self->pending, link);
+    }
+
+    if (remove) {
+        pending->remove = TRUE;
+        pending->add = FALSE;
+    } else
+        pending->add = TRUE;
+}
+
+guint
+mm_uevent_queue_get_length (MMUeventQueue *self)
+{
+    return g_queue_get_length (self->pending);
+}
+
+void
+mm_uevent_queue_flush (MMUeventQueue            *self,
+                       MMUeventQueueProcessFunc  process,
+                       gpointer                  user_data)
+{
+    PendingUevent *pending;
+
+    while ((pending = g_queue_pop_head (self->pending)) != NULL) {
+        g_hash_table_remove (self->by_path, pending->sysfs_path);
+        if (pending->remove || pending->add)
+            process (pending->device, pending->remove, pending->add, user_data);
+        pending_uevent_free (pending);
+    }
+}
+
+MMUeventQueue *
+mm_uevent_queue_new (void)
+{
+    MMUeventQueue *self;
+
+    self = g_slice_new0 (MMUeventQueue);
+    self->pending = g_queue_new ();
+    self->by_path = g_hash_table_new (g_str_hash, g_str_equal);
+    return self;
+}
+
+void
+mm_uevent_queue_free (MMUeventQueue *self)
+{
+    g_hash_table_destroy (self->by_path);
+    g_queue_free_full (self->pending, (GDestroyNotify) pending_uevent_free);
+    g_slice_free (MMUeventQueue, self);
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#ifndef MM_UEVENT_QUEUE_H
+#define MM_UEVENT_QUEUE_H
+
+#include <glib-object.h>
+
+/* Queue of buffered uevents.
+ *
+ * Bursts of events are reduced to their net effect on each device, identified
+ * by its sysfs path:
+ *  - an add followed by a remove of the same device cancels the add; the
+ *    remove is still processed in case the device was known before,
+ *  - repeated remove/add cycles end up in a single remove followed by a
+ *    single add; the remove can't be skipped, as the kernel device was
+ *    really recreated and any open port would be unusable, so a device
+ *    which goes away and comes back (e.g. when a USB hub is power cycled)
+ *    is still removed and probed again,
+ *  - repeated add, change or move events end up in a single add.
+ *
+ * The merged event takes the position of the last event received for the
+ * device, so that the order among different devices is kept (e.g. a port
+ * added back after its parent was removed is processed after the parent
+ * removal). */
+
+typedef struct _MMUeventQueue MMUeventQueue;
+
+/* Called for each merged event when flushing the queue */
+typedef void (* MMUeventQueueProcessFunc) (GObject  *device,
+                                           gboolean  remove,
+                                           gboolean  add,
+                                           gpointer  user_data);
+
+MMUeventQueue *mm_uevent_queue_new        (void);
+void           mm_uevent_queue_free       (MMUeventQueue            *self);
+void           mm_uevent_queue_push       (MMUeventQueue            *self,
+                                           const gchar              *sysfs_path,
+                                           GObject                  *device,
+                                           gboolean                  remove);
+guint          mm_uevent_queue_get_length (MMUeventQueue            *self);
+void           mm_uevent_queue_flush      (MMUeventQueue            *self,
+                                           MMUeventQueueProcessFunc  process,
+                                           gpointer                  user_data);
+
+#endif /* MM_UEVENT_QUEUE_H */
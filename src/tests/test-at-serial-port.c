@@ -18,6 +18,8 @@
 #include <glib.h>
 
 #include "mm-port-serial-at.h"
+#include "mm-serial-parsers.h"
+#include "mm-modem-helpers.h"
 #include "mm-log.h"
 
 typedef struct {
@@ -47,23 +49,483 @@ at_serial_echo_removal (void)
     guint i;
 
     for (i = 0; i < G_N_ELEMENTS (echo_removal_tests); i++) {
-        GByteArray *ba;
+        MMPortSerialBuffer *buffer;
+        gsize len;
 
-        /* Note that we add last NUL also to the byte array, so that we can compare
+        /* Note that we add last NUL also to the buffer, so that we can compare
          * C strings later on */
-        ba = g_byte_array_sized_new (strlen (echo_removal_tests[i].original) + 1);
-        g_byte_array_prepend (ba,
-                              (guint8 *)echo_removal_tests[i].original,
-                              strlen (echo_removal_tests[i].original) + 1);
+        buffer = mm_port_serial_buffer_new (16);
+        mm_port_serial_buffer_append (buffer,
+                                      (guint8 *)echo_removal_tests[i].original,
+                                      strlen (echo_removal_tests[i].original) + 1);
 
-        mm_port_serial_at_remove_echo (ba);
+        mm_port_serial_at_remove_echo (buffer);
 
-        g_assert_cmpstr ((gchar *)ba->data, ==, echo_removal_tests[i].without_echo);
+        g_assert_cmpstr ((gchar *)mm_port_serial_buffer_peek (buffer, &len), ==, echo_removal_tests[i].without_echo);
 
-        g_byte_array_unref (ba);
+        mm_port_serial_buffer_free (buffer);
     }
 }
 
+/*****************************************************************************/
+
+static void
+assert_buffer_contents (MMPortSerialBuffer *buffer,
+                        const gchar        *expected)
+{
+    const guint8 *data;
+    gsize len;
+
+    g_assert_cmpuint (mm_port_serial_buffer_get_length (buffer), ==, strlen (expected));
+    data = mm_port_serial_buffer_peek (buffer, &len);
+    g_assert_cmpuint (len, ==, strlen (expected));
+    g_assert (memcmp (data, expected, len) == 0);
+}
+
+/* Leave the buffer contents wrapped around the end of the ring */
+static MMPortSerialBuffer *
+wrapped_buffer_new (void)
+{
+    MMPortSerialBuffer *buffer;
+
+    buffer = mm_port_serial_buffer_new (16);
+    mm_port_serial_buffer_append (buffer, (const guint8 *) "xxxxxxxxxxxx0123", 16);
+    mm_port_serial_buffer_consume (buffer, 12);
+    mm_port_serial_buffer_append (buffer, (const guint8 *) "456789", 6);
+    return buffer;
+}
+
+static void
+at_serial_buffer_wraparound (void)
+{
+    MMPortSerialBuffer *buffer;
+
+    /* Contiguous view of wrapped contents */
+    buffer = wrapped_buffer_new ();
+    assert_buffer_contents (buffer, "0123456789");
+    mm_port_serial_buffer_consume (buffer, 3);
+    assert_buffer_contents (buffer, "3456789");
+    mm_port_serial_buffer_consume (buffer, 100);
+    assert_buffer_contents (buffer, "");
+    mm_port_serial_buffer_free (buffer);
+
+    /* Consuming across the end of the ring */
+    buffer = wrapped_buffer_new ();
+    mm_port_serial_buffer_consume (buffer, 6);
+    mm_port_serial_buffer_append (buffer, (const guint8 *) "abcdef", 6);
+    assert_buffer_contents (buffer, "6789abcdef");
+    mm_port_serial_buffer_free (buffer);
+
+    /* Growing while wrapped */
+    buffer = wrapped_buffer_new ();
+    mm_port_serial_buffer_append (buffer, (const guint8 *) "abcdefghijklmnopqrstuvwxyz", 26);
+    assert_buffer_contents (buffer, "0123456789abcdefghijklmnopqrstuvwxyz");
+    mm_port_serial_buffer_free (buffer);
+
+    /* Removing ranges from wrapped contents */
+    buffer = wrapped_buffer_new ();
+    mm_port_serial_buffer_remove_range (buffer, 2, 3);
+    assert_buffer_contents (buffer, "0156789");
+    mm_port_serial_buffer_remove_range (buffer, 4, 2);
+    assert_buffer_contents (buffer, "01569");
+    mm_port_serial_buffer_remove_range (buffer, 0, 1);
+    assert_buffer_contents (buffer, "1569");
+    mm_port_serial_buffer_remove_range (buffer, 3, 10);
+    assert_buffer_contents (buffer, "156");
+    mm_port_serial_buffer_truncate (buffer, 1);
+    assert_buffer_contents (buffer, "1");
+    mm_port_serial_buffer_clear (buffer);
+    assert_buffer_contents (buffer, "");
+    mm_port_serial_buffer_free (buffer);
+}
+
+static void
+at_serial_buffer_random (void)
+{
+    MMPortSerialBuffer *buffer;
+    GByteArray *reference;
+    guint8 chunk[64];
+    guint i;
+    guint j;
+
+    buffer = mm_port_serial_buffer_new (16);
+    reference = g_byte_array_new ();
+
+    for (i = 0; i < 10000; i++) {
+        const guint8 *data;
+        gsize len;
+        guint n;
+        guint offset;
+
+        switch (g_test_rand_int_range (0, 3)) {
+        case 0:
+            n = g_test_rand_int_range (0, sizeof (chunk));
+            for (j = 0; j < n; j++)
+                chunk[j] = (guint8) g_test_rand_int_range (0, 256);
+            mm_port_serial_buffer_append (buffer, chunk, n);
+            g_byte_array_append (reference, chunk, n);
+            break;
+        case 1:
+            n = MIN (g_test_rand_int_range (0, sizeof (chunk)), reference->len);
+            mm_port_serial_buffer_consume (buffer, n);
+            g_byte_array_remove_range (reference, 0, n);
+            break;
+        case 2:
+            if (!reference->len)
+                break;
+            offset = g_test_rand_int_range (0, reference->len);
+            n = MIN (g_test_rand_int_range (0, 8), reference->len - offset);
+            mm_port_serial_buffer_remove_range (buffer, offset, n);
+            g_byte_array_remove_range (reference, offset, n);
+            break;
+        default:
+            g_assert_not_reached ();
+        }
+
+        data = mm_port_serial_buffer_peek (buffer, &len);
+        g_assert_cmpuint (len, ==, reference->len);
+        g_assert (memcmp (data, reference->data, len) == 0);
+    }
+
+    g_byte_array_unref (reference);
+    mm_port_serial_buffer_free (buffer);
+}
+
+typedef struct {
+    const gchar *pattern;
+    GRegexCompileFlags flags;
+    const gchar *prefix;
+} UnsolicitedMsgPrefixTest;
+
+static const UnsolicitedMsgPrefixTest unsolicited_msg_prefix_tests[] = {
+    { "\\r\\nRING\\r\\n",                G_REGEX_RAW, "RING" },
+    { "\\r\\n\\+CRING:\\s*(\\S+)\\r\\n", G_REGEX_RAW, "+CRING:" },
+    { "\\r\\n\\^RSSI:\\s*(\\d+)\\r\\n",  G_REGEX_RAW, "^RSSI:" },
+    { "\\r\\n\\+CIEV: (.*),(\\d)\\r\\n", G_REGEX_RAW, "+CIEV: " },
+    { "\\r\\n%IPDPACT:\\s*(\\d+)\\r\\n", G_REGEX_RAW, "%IPDPACT:" },
+    { "\\r\\n\\+PACSP(\\d)\\r\\n",       G_REGEX_RAW, "+PACSP" },
+    { "\\r\\n\\+PACSP.*\\r\\n",          G_REGEX_RAW, "+PACSP" },
+    { "\\r\\n\\^CONNECT .+\\r\\n",       G_REGEX_RAW, "^CONNECT " },
+    { "\\r\\nNO CARRIERS?\\r\\n",        G_REGEX_RAW, "NO CARRIER" },
+    { "\\r\\nAB+C\\r\\n",                G_REGEX_RAW, "AB" },
+    /* Not indexable */
+    { "\\r\\n(\\^NDISSTAT:.+)\\r+\\n",   G_REGEX_RAW, NULL },
+    { "\\+CREG: (\\d)\\r\\n",            G_REGEX_RAW, NULL },
+    { "\\r\\nRING|BUSY\\r\\n",           G_REGEX_RAW, NULL },
+    { "\\r\\nring\\r\\n",                G_REGEX_RAW | G_REGEX_CASELESS, NULL },
+};
+
+static void
+at_serial_unsolicited_msg_prefix (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (unsolicited_msg_prefix_tests); i++) {
+        GRegex *regex;
+        gchar *prefix;
+
+        regex = g_regex_new (unsolicited_msg_prefix_tests[i].pattern,
+                             unsolicited_msg_prefix_tests[i].flags,
+                             0,
+                             NULL);
+        g_assert (regex);
+
+        prefix = mm_port_serial_at_build_unsolicited_msg_prefix (regex);
+        g_assert_cmpstr (prefix, ==, unsolicited_msg_prefix_tests[i].prefix);
+
+        g_free (prefix);
+        g_regex_unref (regex);
+    }
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    const gchar *name;
+    GString     *calls;
+} UnsolicitedMsgTestHandler;
+
+static void
+unsolicited_msg_test_cb (MMPortSerialAt            *port,
+                         GMatchInfo                *match_info,
+                         UnsolicitedMsgTestHandler *handler)
+{
+    gchar *arg;
+
+    arg = g_match_info_fetch (match_info, 1);
+    if (arg)
+        g_string_append_printf (handler->calls, "%s:%s|", handler->name, arg);
+    else
+        g_string_append_printf (handler->calls, "%s|", handler->name);
+    g_free (arg);
+}
+
+static GRegex *
+add_unsolicited_msg_test_handler (MMPortSerialAt            *port,
+                                  const gchar               *pattern,
+                                  UnsolicitedMsgTestHandler *handler)
+{
+    GRegex *regex;
+
+    regex = g_regex_new (pattern, G_REGEX_RAW | G_REGEX_OPTIMIZE, 0, NULL);
+    g_assert (regex);
+    mm_port_serial_at_add_unsolicited_msg_handler (port,
+                                                   regex,
+                                                   (MMPortSerialAtUnsolicitedMsgFn) unsolicited_msg_test_cb,
+                                                   handler,
+                                                   NULL);
+    return regex;
+}
+
+static void
+port_parse_unsolicited (MMPortSerialAt     *port,
+                        MMPortSerialBuffer *buffer)
+{
+    MM_PORT_SERIAL_GET_CLASS (port)->parse_unsolicited (MM_PORT_SERIAL (port), buffer);
+}
+
+static void
+at_serial_unsolicited_msg_dispatch (void)
+{
+    MMPortSerialAt *port;
+    MMPortSerialBuffer *buffer;
+    GString *calls;
+    GRegex *regexes[5];
+    UnsolicitedMsgTestHandler ciev     = { "CIEV",     NULL };
+    UnsolicitedMsgTestHandler ndisstat = { "NDISSTAT", NULL };
+    UnsolicitedMsgTestHandler cgreg    = { "CGREG",    NULL };
+    UnsolicitedMsgTestHandler creg     = { "CREG",     NULL };
+    UnsolicitedMsgTestHandler ring     = { "RING",     NULL };
+    guint i;
+
+    /* The RING line is preceded by an extra <CR> and followed by an extra
+     * <LF>, so +CIEV only shows up at a line start once RING is removed */
+    static const gchar *response =
+        "echo\r\n+CREG: 1\r\n"
+        "\r\n+CGREG: 2\r\n"
+        "\r\r\nRING\r\n"
+        "\n+CIEV: x,1\r\n"
+        "\r\n^NDISSTAT: 1\r\n"
+        "\r\n+CREG: 5\r\n"
+        "\r\nOK\r\n";
+
+    calls = g_string_new ("");
+    ciev.calls = ndisstat.calls = cgreg.calls = creg.calls = ring.calls = calls;
+
+    port = mm_port_serial_at_new ("ttyTEST0", MM_PORT_SUBSYS_TTY);
+
+    /* Handlers are run in the reverse order they're added */
+    regexes[0] = add_unsolicited_msg_test_handler (port, "\\r\\n\\+CIEV: (.*),(\\d)\\r\\n", &ciev);
+    regexes[1] = add_unsolicited_msg_test_handler (port, "\\r\\n(\\^NDISSTAT:.+)\\r+\\n", &ndisstat);
+    regexes[2] = add_unsolicited_msg_test_handler (port, "\\r\\n\\+CGREG: (\\d)\\r\\n", &cgreg);
+    regexes[3] = add_unsolicited_msg_test_handler (port, "\\r\\n\\+CREG: (\\d)\\r\\n", &creg);
+    regexes[4] = add_unsolicited_msg_test_handler (port, "\\r\\nRING\\r\\n", &ring);
+    mm_port_serial_at_enable_unsolicited_msg_handler (port, regexes[2], FALSE);
+
+    buffer = mm_port_serial_buffer_new (16);
+    mm_port_serial_buffer_append (buffer, (const guint8 *) response, strlen (response));
+
+    /* Echo removed; all enabled handlers run, the one without literal prefix
+     * included; +CIEV only found when looking again after removing RING */
+    port_parse_unsolicited (port, buffer);
+    g_assert_cmpstr (calls->str, ==, "RING|CREG:1|CREG:5|NDISSTAT:^NDISSTAT: 1|CIEV:x|");
+    assert_buffer_contents (buffer, "\r\n+CGREG: 2\r\n\r\nOK\r\n");
+
+    /* Nothing else to do on the same contents */
+    g_string_truncate (calls, 0);
+    port_parse_unsolicited (port, buffer);
+    g_assert_cmpstr (calls->str, ==, "");
+    assert_buffer_contents (buffer, "\r\n+CGREG: 2\r\n\r\nOK\r\n");
+
+    /* Once enabled, the disabled handler runs as well */
+    mm_port_serial_at_enable_unsolicited_msg_handler (port, regexes[2], TRUE);
+    port_parse_unsolicited (port, buffer);
+    g_assert_cmpstr (calls->str, ==, "CGREG:2|");
+    assert_buffer_contents (buffer, "\r\nOK\r\n");
+
+    for (i = 0; i < G_N_ELEMENTS (regexes); i++)
+        g_regex_unref (regexes[i]);
+    mm_port_serial_buffer_free (buffer);
+    g_object_unref (port);
+    g_string_free (calls, TRUE);
+}
+
+/*****************************************************************************/
+/* +CMGL entries taken while the response arrives */
+
+typedef struct {
+    /* Match group with the PDU or text of the entry */
+    gint       data_group;
+    GPtrArray *entries;
+} CmglStreamingContext;
+
+static void
+cmgl_entry_received (MMPortSerialAt       *port,
+                     GMatchInfo           *match_info,
+                     CmglStreamingContext *ctx)
+{
+    gchar *idx;
+    gchar *data;
+
+    idx = g_match_info_fetch (match_info, 1);
+    data = g_match_info_fetch (match_info, ctx->data_group);
+    g_ptr_array_add (ctx->entries, g_strdup_printf ("%s:%s", idx, data));
+    g_free (data);
+    g_free (idx);
+}
+
+static MMPortSerialResponseType
+port_parse_response (MMPortSerialAt      *port,
+                     MMPortSerialBuffer  *buffer,
+                     GByteArray         **parsed_response,
+                     GError             **error)
+{
+    return MM_PORT_SERIAL_GET_CLASS (port)->parse_response (MM_PORT_SERIAL (port), buffer, parsed_response, error);
+}
+
+static void
+at_serial_cmgl_streaming_chunks (GRegex             *regex,
+                                 gint                data_group,
+                                 const gchar *const *entries,
+                                 const gchar *const *expected,
+                                 gsize               chunk_size)
+{
+    MMPortSerialAt *port;
+    MMPortSerialBuffer *buffer;
+    CmglStreamingContext ctx;
+    GByteArray *parsed = NULL;
+    GString *str;
+    gsize complete[8];
+    gsize offset;
+    guint n_entries;
+    guint i;
+
+    /* Build the whole response; each entry is complete once the <CR><LF>
+     * after its data line arrives */
+    str = g_string_new ("");
+    for (n_entries = 0; entries[n_entries]; n_entries++) {
+        g_assert_cmpuint (n_entries, <, G_N_ELEMENTS (complete));
+        g_string_append_printf (str, "\r\n%s", entries[n_entries]);
+        complete[n_entries] = str->len + 2;
+    }
+    g_string_append (str, "\r\n\r\nOK\r\n");
+
+    /* Same setup as the AT ports of a modem */
+    port = mm_port_serial_at_new ("ttyTEST0", MM_PORT_SUBSYS_TTY);
+    mm_port_serial_at_set_response_parser (port,
+                                           mm_serial_parser_v2_parse,
+                                           mm_serial_parser_v2_new (),
+                                           mm_serial_parser_v2_destroy);
+    mm_port_serial_at_set_response_check (port, mm_serial_parser_v2_check);
+    mm_port_serial_at_set_response_reset (port, mm_serial_parser_v2_reset);
+
+    ctx.data_group = data_group;
+    ctx.entries = g_ptr_array_new_with_free_func (g_free);
+    mm_port_serial_at_add_unsolicited_msg_handler (port,
+                                                   regex,
+                                                   (MMPortSerialAtUnsolicitedMsgFn) cmgl_entry_received,
+                                                   &ctx,
+                                                   NULL);
+
+    /* Feed the response in chunks, as read from the port */
+    buffer = mm_port_serial_buffer_new (16);
+    for (offset = 0; offset < str->len; offset += chunk_size) {
+        MMPortSerialResponseType type;
+        GError *error = NULL;
+
+        mm_port_serial_buffer_append (buffer,
+                                      (const guint8 *) str->str + offset,
+                                      MIN (chunk_size, str->len - offset));
+
+        port_parse_unsolicited (port, buffer);
+        type = port_parse_response (port, buffer, &parsed, &error);
+        g_assert_no_error (error);
+
+        /* Every entry whose data line is already terminated must be out */
+        for (i = 0; i < n_entries; i++) {
+            if (complete[i] <= offset + chunk_size)
+                g_assert_cmpuint (ctx.entries->len, >, i);
+        }
+
+        /* And the final response only once fully received */
+        if (offset + chunk_size < str->len)
+            g_assert_cmpint (type, ==, MM_PORT_SERIAL_RESPONSE_NONE);
+        else
+            g_assert_cmpint (type, ==, MM_PORT_SERIAL_RESPONSE_BUFFER);
+    }
+
+    g_assert_cmpuint (ctx.entries->len, ==, n_entries);
+    for (i = 0; i < n_entries; i++)
+        g_assert_cmpstr (g_ptr_array_index (ctx.entries, i), ==, expected[i]);
+
+    /* Nothing left in the final response for the command to parse */
+    g_assert (parsed != NULL);
+    g_assert (strstr ((const gchar *) parsed->data, "+CMGL") == NULL);
+    assert_buffer_contents (buffer, "");
+
+    g_byte_array_unref (parsed);
+    mm_port_serial_buffer_free (buffer);
+    g_object_unref (port);
+    g_ptr_array_unref (ctx.entries);
+    g_string_free (str, TRUE);
+}
+
+static const gsize cmgl_chunk_sizes[] = { 1, 2, 7, 64, 1024 };
+
+#define CMGL_PDU "079100F40D1101000F001000B917118336058F300001954747A0E4ACF41F27298CDCE83C6EF371B0402814020"
+
+static void
+at_serial_cmgl_streaming_pdu (void)
+{
+    static const gchar *entries[] = {
+        "+CMGL: 17,3,,35\r\n" CMGL_PDU,
+        "+CMGL: 15,3,,35\r\n" CMGL_PDU,
+        "+CMGL: 13,3,,35\r\n" CMGL_PDU,
+        "+CMGL: 11,3,,35\r\n" CMGL_PDU,
+        NULL
+    };
+    static const gchar *expected[] = {
+        "17:" CMGL_PDU,
+        "15:" CMGL_PDU,
+        "13:" CMGL_PDU,
+        "11:" CMGL_PDU,
+    };
+    GRegex *regex;
+    guint i;
+
+    regex = mm_3gpp_pdu_cmgl_entry_regex_get ();
+    g_assert (regex);
+    for (i = 0; i < G_N_ELEMENTS (cmgl_chunk_sizes); i++)
+        at_serial_cmgl_streaming_chunks (regex, 4, entries, expected, cmgl_chunk_sizes[i]);
+    g_regex_unref (regex);
+}
+
+static void
+at_serial_cmgl_streaming_text (void)
+{
+    static const gchar *entries[] = {
+        "+CMGL: 1,\"REC UNREAD\",\"+31612345678\",,\"12/04/25,19:56:50+08\"\r\nHello there",
+        "+CMGL: 4,\"REC READ\",\"+31612345678\",,\"12/04/25,19:57:02+08\"\r\nSecond one, with a comma",
+        "+CMGL: 7,\"STO UNSENT\",\"+31600000000\",,\r\nThird",
+        NULL
+    };
+    static const gchar *expected[] = {
+        "1:Hello there",
+        "4:Second one, with a comma",
+        "7:Third",
+    };
+    GRegex *regex;
+    guint i;
+
+    regex = mm_3gpp_text_cmgl_entry_regex_get ();
+    g_assert (regex);
+    for (i = 0; i < G_N_ELEMENTS (cmgl_chunk_sizes); i++)
+        at_serial_cmgl_streaming_chunks (regex, 6, entries, expected, cmgl_chunk_sizes[i]);
+    g_regex_unref (regex);
+}
+
+/*****************************************************************************/
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -89,6 +551,12 @@ int main (int argc, char **argv)
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/ModemManager/AT-serial/echo-removal", at_serial_echo_removal);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-msg-prefix", at_serial_unsolicited_msg_prefix);
+    g_test_add_func ("/ModemManager/AT-serial/unsolicited-msg-dispatch", at_serial_unsolicited_msg_dispatch);
+    g_test_add_func ("/ModemManager/AT-serial/buffer-wraparound", at_serial_buffer_wraparound);
+    g_test_add_func ("/ModemManager/AT-serial/buffer-random", at_serial_buffer_random);
+    g_test_add_func ("/ModemManager/AT-serial/cmgl-streaming-pdu", at_serial_cmgl_streaming_pdu);
+    g_test_add_func ("/ModemManager/AT-serial/cmgl-streaming-text", at_serial_cmgl_streaming_text);
 
     return g_test_run ();
 }
@@ -91,6 +91,22 @@ test_mixed_chars (void *f, gpointer d)
     g_free (utf8);
 }
 
+static void
+test_trailing_esc_char (void *f, gpointer d)
+{
+    /* A trailing escape char, with no extended char after it, can't be
+     * decoded and must not end up as raw bytes in the UTF-8 string */
+    static const guint8 gsm[] = { 0x41, 0x1B, 0x65, 0x42, 0x1B };
+    guint8 *utf8;
+
+    utf8 = mm_charset_gsm_unpacked_to_utf8 (gsm, G_N_ELEMENTS (gsm));
+    g_assert (utf8);
+    g_assert (g_utf8_validate ((const gchar *) utf8, -1, NULL));
+    g_assert_cmpstr ((const char *) utf8, ==, "A€B?");
+
+    g_free (utf8);
+}
+
 static void
 test_unpack_gsm7 (void *f, gpointer d)
 {
@@ -362,6 +378,363 @@ test_take_convert_ucs2_bad_ascii2 (void *f, gpointer d)
     g_assert (converted == NULL);
 }
 
+static void
+test_encoded_len_gsm7 (void *f, gpointer d)
+{
+    guint unsupported = 0;
+
+    /* Default alphabet characters take one septet, extended ones two */
+    g_assert_cmpuint (mm_charset_get_encoded_len ("abc@£Δ", MM_MODEM_CHARSET_GSM, &unsupported), ==, 6);
+    g_assert_cmpuint (unsupported, ==, 0);
+    g_assert_cmpuint (mm_charset_get_encoded_len ("{€}", MM_MODEM_CHARSET_GSM, &unsupported), ==, 6);
+    g_assert_cmpuint (unsupported, ==, 0);
+
+    /* Unsupported characters are counted as one septet each */
+    g_assert_cmpuint (mm_charset_get_encoded_len ("aŁb中", MM_MODEM_CHARSET_GSM, &unsupported), ==, 4);
+    g_assert_cmpuint (unsupported, ==, 2);
+}
+
+static void
+test_utf8_to_gsm7_unsupported (void *f, gpointer d)
+{
+    guint8 *gsm;
+    guint32 len = 0;
+
+    /* Unsupported characters are skipped */
+    gsm = mm_charset_utf8_to_unpacked_gsm ("aŁ€中b", &len);
+    g_assert (gsm);
+    g_assert_cmpuint (len, ==, 4);
+    g_assert_cmpuint (gsm[0], ==, 0x61);
+    g_assert_cmpuint (gsm[1], ==, 0x1b);
+    g_assert_cmpuint (gsm[2], ==, 0x65);
+    g_assert_cmpuint (gsm[3], ==, 0x62);
+    g_free (gsm);
+}
+
+static void
+test_ucs2_hex (void *f, gpointer d)
+{
+    gchar *hex;
+    gchar *utf8;
+
+    hex = mm_modem_charset_utf8_to_hex ("Año €", MM_MODEM_CHARSET_UCS2);
+    g_assert_cmpstr (hex, ==, "004100F1006F002020AC");
+
+    utf8 = mm_modem_charset_hex_to_utf8 (hex, MM_MODEM_CHARSET_UCS2);
+    g_assert_cmpstr (utf8, ==, "Año €");
+    g_free (utf8);
+
+    /* Lowercase hex is also accepted */
+    utf8 = mm_modem_charset_hex_to_utf8 ("004100f1006f002020ac", MM_MODEM_CHARSET_UCS2);
+    g_assert_cmpstr (utf8, ==, "Año €");
+    g_free (utf8);
+
+    /* Incomplete characters */
+    utf8 = mm_modem_charset_hex_to_utf8 ("004100", MM_MODEM_CHARSET_UCS2);
+    g_assert (utf8 == NULL);
+
+    g_free (hex);
+
+    hex = mm_modem_charset_utf8_to_hex ("", MM_MODEM_CHARSET_UCS2);
+    g_assert_cmpstr (hex, ==, "");
+    g_free (hex);
+
+    hex = mm_utf8_take_and_convert_to_charset (g_strdup ("Año €"), MM_MODEM_CHARSET_UCS2);
+    g_assert_cmpstr (hex, ==, "004100F1006F002020AC");
+    g_free (hex);
+}
+
+static void
+test_ucs2_byte_array_append (void *f, gpointer d)
+{
+    static const guint8 expected[] = { '"', 0x00, 0x41, 0x00, 0xF1, 0x20, 0xAC, '"' };
+    GByteArray *array;
+
+    array = g_byte_array_new ();
+    g_assert (mm_modem_charset_byte_array_append (array, "Añ€", TRUE, MM_MODEM_CHARSET_UCS2));
+    g_assert_cmpuint (array->len, ==, sizeof (expected));
+    g_assert (memcmp (array->data, expected, sizeof (expected)) == 0);
+    g_byte_array_unref (array);
+}
+
+static void
+test_8859_1_hex (void *f, gpointer d)
+{
+    gchar *hex;
+    gchar *utf8;
+
+    /* Converted through iconv, twice to go through the cached converter */
+    hex = mm_modem_charset_utf8_to_hex ("Año", MM_MODEM_CHARSET_8859_1);
+    g_assert_cmpstr (hex, ==, "41F16F");
+    g_free (hex);
+    hex = mm_modem_charset_utf8_to_hex ("Año", MM_MODEM_CHARSET_8859_1);
+    g_assert_cmpstr (hex, ==, "41F16F");
+
+    utf8 = mm_modem_charset_hex_to_utf8 (hex, MM_MODEM_CHARSET_8859_1);
+    g_assert_cmpstr (utf8, ==, "Año");
+    g_free (utf8);
+    utf8 = mm_modem_charset_hex_to_utf8 (hex, MM_MODEM_CHARSET_8859_1);
+    g_assert_cmpstr (utf8, ==, "Año");
+    g_free (utf8);
+
+    g_free (hex);
+}
+
+/* Bit by bit implementations, as reference for the optimized ones */
+
+static guint8 *
+reference_gsm_pack (const guint8 *src,
+                    guint32 src_len,
+                    guint8 start_offset,
+                    guint32 *out_packed_len)
+{
+    guint8 *packed;
+    guint32 plen;
+    guint32 i;
+    guint j;
+
+    plen = ((src_len * 7) + start_offset + 7) / 8;
+    packed = g_malloc0 (MAX (plen, 1));
+
+    for (i = 0; i < src_len; i++) {
+        for (j = 0; j < 7; j++) {
+            guint32 bit = start_offset + (i * 7) + j;
+
+            if (src[i] & (1 << j))
+                packed[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    *out_packed_len = plen;
+    return packed;
+}
+
+static guint8 *
+reference_gsm_unpack (const guint8 *gsm,
+                      guint32 num_septets,
+                      guint8 start_offset)
+{
+    guint8 *unpacked;
+    guint32 i;
+    guint j;
+
+    unpacked = g_malloc0 (num_septets + 1);
+
+    for (i = 0; i < num_septets; i++) {
+        for (j = 0; j < 7; j++) {
+            guint32 bit = start_offset + (i * 7) + j;
+
+            if (gsm[bit / 8] & (1 << (bit % 8)))
+                unpacked[i] |= 1 << j;
+        }
+    }
+
+    return unpacked;
+}
+
+static void
+test_pack_unpack_gsm7_random (void *f, gpointer d)
+{
+    GRand *rand;
+    guint iteration;
+
+    rand = g_rand_new_with_seed (0x7e57);
+
+    for (iteration = 0; iteration < 1000; iteration++) {
+        guint8 unpacked[200];
+        guint8 *packed;
+        guint8 *reference;
+        guint8 *result;
+        guint32 len;
+        guint32 packed_len;
+        guint32 reference_len;
+        guint32 result_len;
+        guint8 offset;
+        guint32 i;
+
+        len = g_rand_int_range (rand, 0, G_N_ELEMENTS (unpacked));
+        offset = g_rand_int_range (rand, 0, 8);
+        for (i = 0; i < len; i++)
+            unpacked[i] = g_rand_int_range (rand, 0, 128);
+
+        packed = gsm_pack (unpacked, len, offset, &packed_len);
+        reference = reference_gsm_pack (unpacked, len, offset, &reference_len);
+        g_assert_cmpuint (packed_len, ==, reference_len);
+        g_assert (memcmp (packed, reference, packed_len) == 0);
+
+        result = gsm_unpack (packed, len, offset, &result_len);
+        g_assert_cmpuint (result_len, ==, len);
+        g_assert (memcmp (result, unpacked, len) == 0);
+
+        g_free (packed);
+        g_free (reference);
+        g_free (result);
+    }
+
+    g_rand_free (rand);
+}
+
+#define BENCHMARK_TEXT_LEN  16384
+#define BENCHMARK_ITERATIONS 100
+
+static gchar *
+build_benchmark_text (void)
+{
+    static const gchar *words[] = { "Hello", "world", "ÄÖÜ", "año", "€5", "{x}", "ΔΦΓ", "1234", "@home", "\n" };
+    GString *text;
+    guint i;
+
+    text = g_string_sized_new (BENCHMARK_TEXT_LEN + 16);
+    for (i = 0; text->len < BENCHMARK_TEXT_LEN; i++) {
+        g_string_append (text, words[i % G_N_ELEMENTS (words)]);
+        g_string_append_c (text, ' ');
+    }
+    return g_string_free (text, FALSE);
+}
+
+static void
+test_gsm7_benchmark (void *f, gpointer d)
+{
+    gchar *text;
+    guint8 *unpacked;
+    guint8 *packed;
+    guint32 unpacked_len;
+    guint32 packed_len;
+    guint unsupported = 0;
+    gdouble elapsed;
+    gdouble reference;
+    guint i;
+
+    text = build_benchmark_text ();
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        g_assert_cmpuint (mm_charset_get_encoded_len (text, MM_MODEM_CHARSET_GSM, &unsupported), >, 0);
+    elapsed = g_test_timer_elapsed ();
+    g_assert_cmpuint (unsupported, ==, 0);
+    g_test_minimized_result ((elapsed * 1e9) / ((gdouble) strlen (text) * BENCHMARK_ITERATIONS),
+                             "GSM7 encoded length: %.2f ns/byte",
+                             (elapsed * 1e9) / ((gdouble) strlen (text) * BENCHMARK_ITERATIONS));
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        unpacked = mm_charset_utf8_to_unpacked_gsm (text, &unpacked_len);
+        g_free (unpacked);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result ((elapsed * 1e9) / ((gdouble) strlen (text) * BENCHMARK_ITERATIONS),
+                             "UTF-8 to GSM7: %.2f ns/byte",
+                             (elapsed * 1e9) / ((gdouble) strlen (text) * BENCHMARK_ITERATIONS));
+
+    unpacked = mm_charset_utf8_to_unpacked_gsm (text, &unpacked_len);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        g_free (reference_gsm_pack (unpacked, unpacked_len, 0, &packed_len));
+    reference = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        g_free (gsm_pack (unpacked, unpacked_len, 0, &packed_len));
+    elapsed = g_test_timer_elapsed ();
+    g_test_message ("pack %u septets: bit by bit %.2f ns/septet, packed %.2f ns/septet",
+                    unpacked_len,
+                    (reference * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS),
+                    (elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS));
+    g_test_minimized_result ((elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS),
+                             "GSM7 pack: %.2f ns/septet",
+                             (elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS));
+
+    packed = gsm_pack (unpacked, unpacked_len, 0, &packed_len);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+        g_free (reference_gsm_unpack (packed, unpacked_len, 0));
+    reference = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        guint8 *result;
+        guint32 result_len;
+
+        result = gsm_unpack (packed, unpacked_len, 0, &result_len);
+        g_free (result);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_message ("unpack %u septets: bit by bit %.2f ns/septet, packed %.2f ns/septet",
+                    unpacked_len,
+                    (reference * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS),
+                    (elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS));
+    g_test_minimized_result ((elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS),
+                             "GSM7 unpack: %.2f ns/septet",
+                             (elapsed * 1e9) / ((gdouble) unpacked_len * BENCHMARK_ITERATIONS));
+
+    g_free (packed);
+    g_free (unpacked);
+    g_free (text);
+}
+
+#define UCS2_BENCHMARK_ITERATIONS 20000
+
+static void
+test_ucs2_benchmark (void *f, gpointer d)
+{
+    /* A typical operator name reported in UCS-2 */
+    static const gchar *hex = "004D0079002000430061007200720069006500720020004500730070006100F10061002000340047002020AC";
+    gchar *expected;
+    gdouble reference;
+    gdouble elapsed;
+    guint i;
+
+    expected = mm_modem_charset_hex_to_utf8 (hex, MM_MODEM_CHARSET_UCS2);
+    g_assert (expected);
+
+    /* What every conversion used to do: open a new converter each time */
+    g_test_timer_start ();
+    for (i = 0; i < UCS2_BENCHMARK_ITERATIONS; i++) {
+        gchar *bin;
+        gchar *utf8;
+        gsize bin_len = 0;
+
+        bin = mm_utils_hexstr2bin (hex, &bin_len);
+        utf8 = g_convert (bin, bin_len, "UTF-8//TRANSLIT", "UCS-2BE", NULL, NULL, NULL);
+        g_assert_cmpstr (utf8, ==, expected);
+        g_free (utf8);
+        g_free (bin);
+    }
+    reference = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+    for (i = 0; i < UCS2_BENCHMARK_ITERATIONS; i++)
+        g_free (mm_modem_charset_hex_to_utf8 (hex, MM_MODEM_CHARSET_UCS2));
+    elapsed = g_test_timer_elapsed ();
+
+    g_test_message ("UCS-2 hex to UTF-8: g_convert %.2f us/string, converted %.2f us/string",
+                    (reference * 1e6) / UCS2_BENCHMARK_ITERATIONS,
+                    (elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS);
+    g_test_minimized_result ((elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS,
+                             "UCS-2 hex to UTF-8: %.2f us/string",
+                             (elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < UCS2_BENCHMARK_ITERATIONS; i++)
+        g_free (mm_modem_charset_utf8_to_hex (expected, MM_MODEM_CHARSET_UCS2));
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result ((elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS,
+                             "UTF-8 to UCS-2 hex: %.2f us/string",
+                             (elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS);
+
+    g_test_timer_start ();
+    for (i = 0; i < UCS2_BENCHMARK_ITERATIONS; i++)
+        g_free (mm_modem_charset_utf8_to_hex (expected, MM_MODEM_CHARSET_8859_1));
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result ((elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS,
+                             "UTF-8 to ISO-8859-1 hex (cached converter): %.2f us/string",
+                             (elapsed * 1e6) / UCS2_BENCHMARK_ITERATIONS);
+
+    g_free (expected);
+}
+
 void
 _mm_log (const char *loc,
          const char *func,
@@ -398,6 +771,9 @@ int main (int argc, char **argv)
     g_test_suite_add (suite, TESTCASE (test_def_chars, NULL));
     g_test_suite_add (suite, TESTCASE (test_esc_chars, NULL));
     g_test_suite_add (suite, TESTCASE (test_mixed_chars, NULL));
+    g_test_suite_add (suite, TESTCASE (test_trailing_esc_char, NULL));
+    g_test_suite_add (suite, TESTCASE (test_encoded_len_gsm7, NULL));
+    g_test_suite_add (suite, TESTCASE (test_utf8_to_gsm7_unsupported, NULL));
 
     g_test_suite_add (suite, TESTCASE (test_unpack_gsm7, NULL));
     g_test_suite_add (suite, TESTCASE (test_unpack_gsm7_7_chars, NULL));
@@ -410,11 +786,21 @@ int main (int argc, char **argv)
     g_test_suite_add (suite, TESTCASE (test_pack_gsm7_last_septet_alone, NULL));
 
     g_test_suite_add (suite, TESTCASE (test_pack_gsm7_7_chars_offset, NULL));
+    g_test_suite_add (suite, TESTCASE (test_pack_unpack_gsm7_random, NULL));
 
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_hex_utf8, NULL));
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_bad_ascii, NULL));
     g_test_suite_add (suite, TESTCASE (test_take_convert_ucs2_bad_ascii2, NULL));
 
+    g_test_suite_add (suite, TESTCASE (test_ucs2_hex, NULL));
+    g_test_suite_add (suite, TESTCASE (test_ucs2_byte_array_append, NULL));
+    g_test_suite_add (suite, TESTCASE (test_8859_1_hex, NULL));
+
+    if (g_test_perf ()) {
+        g_test_suite_add (suite, TESTCASE (test_gsm7_benchmark, NULL));
+        g_test_suite_add (suite, TESTCASE (test_ucs2_benchmark, NULL));
+    }
+
     result = g_test_run ();
 
     return result;
@@ -0,0 +1,232 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <locale.h>
+
+/* Define symbol to enable test message traces */
+#undef ENABLE_TEST_MESSAGE_TRACES
+
+#include "mm-expected-ports.h"
+#include "mm-log.h"
+
+#define TTY0 "00/option/tty"
+#define TTY2 "02/option/tty"
+#define TTY3 "03/option/tty"
+#define NET4 "04/qmi_wwan/net"
+#define QMI4 "04/qmi_wwan/usbmisc"
+
+/************************************************************/
+
+/* Builds the found port identifiers from a string separated by ',', with
+ * '?' for ports that can't be identified */
+static GPtrArray *
+build_found_ids (const gchar *str)
+{
+    GPtrArray  *found_ids;
+    gchar     **split;
+    guint       i;
+
+    found_ids = g_ptr_array_new_with_free_func (g_free);
+    if (!str[0])
+        return found_ids;
+
+    split = g_strsplit (str, ",", -1);
+    for (i = 0; split[i]; i++)
+        g_ptr_array_add (found_ids, g_str_equal (split[i], "?") ? NULL : g_strdup (split[i]));
+    g_strfreev (split);
+    return found_ids;
+}
+
+static gboolean
+all_found (MMExpectedPorts *expected,
+           const gchar     *found)
+{
+    GPtrArray *found_ids;
+    gboolean   result;
+
+    found_ids = build_found_ids (found);
+    result = mm_expected_ports_all_found (expected, found_ids);
+    g_ptr_array_unref (found_ids);
+    return result;
+}
+
+static gchar *
+learn (const gchar *found)
+{
+    GPtrArray  *found_ids;
+    gchar     **port_ids;
+    gchar      *str;
+
+    found_ids = build_found_ids (found);
+    port_ids = mm_expected_ports_build_ids (found_ids);
+    g_ptr_array_unref (found_ids);
+    if (!port_ids)
+        return NULL;
+
+    str = g_strjoinv (",", port_ids);
+    g_strfreev (port_ids);
+    return str;
+}
+
+/************************************************************/
+
+static void
+test_count (void)
+{
+    MMExpectedPorts *expected;
+
+    expected = mm_expected_ports_new_count (3);
+    g_assert_cmpuint (mm_expected_ports_get_length (expected), ==, 3);
+
+    g_assert (!all_found (expected, ""));
+    g_assert (!all_found (expected, TTY0 "," TTY2));
+    /* Any port counts, identified or not */
+    g_assert (all_found (expected, TTY0 ",?," NET4));
+    g_assert (all_found (expected, TTY0 "," TTY2 "," TTY3 "," NET4));
+
+    mm_expected_ports_free (expected);
+}
+
+static void
+test_ids (void)
+{
+    static const gchar *port_ids[] = { TTY0, TTY2, NET4, TTY2, NULL };
+    MMExpectedPorts *expected;
+
+    expected = mm_expected_ports_new_ids (port_ids);
+    g_assert_cmpuint (mm_expected_ports_get_length (expected), ==, 3);
+
+    g_assert (!all_found (expected, ""));
+    g_assert (!all_found (expected, TTY0 "," NET4));
+    g_assert (all_found (expected, NET4 "," TTY2 "," TTY0));
+    /* Extra ports are fine */
+    g_assert (all_found (expected, TTY0 "," TTY2 "," TTY3 "," NET4 ",?"));
+
+    mm_expected_ports_free (expected);
+}
+
+static void
+test_ids_not_replaced (void)
+{
+    static const gchar *port_ids[] = { TTY0, TTY2, NET4, NULL };
+    MMExpectedPorts *expected;
+
+    expected = mm_expected_ports_new_ids (port_ids);
+
+    /* Unknown or unexpected ports don't make up for a missing one */
+    g_assert (!all_found (expected, TTY0 "," TTY2 ",?"));
+    g_assert (!all_found (expected, TTY0 "," TTY2 "," TTY3));
+    g_assert (!all_found (expected, TTY0 "," TTY2 "," QMI4 "," TTY3));
+    /* Duplicates neither */
+    g_assert (!all_found (expected, TTY0 "," TTY2 "," TTY2));
+
+    mm_expected_ports_free (expected);
+}
+
+static void
+test_build_ids (void)
+{
+    gchar *str;
+
+    str = learn (TTY3 "," NET4 "," TTY0 "," TTY3);
+    g_assert_cmpstr (str, ==, TTY0 "," TTY3 "," NET4);
+    g_free (str);
+
+    /* Nothing to learn if any port can't be identified */
+    g_assert (learn (TTY0 ",?," NET4) == NULL);
+    g_assert (learn ("") == NULL);
+}
+
+static void
+test_learn_never_shrinks_early (void)
+{
+    static const gchar *port_ids[] = { TTY0, TTY2, NET4, NULL };
+    static const gchar *found[] = {
+        TTY0 "," TTY2 "," NET4,
+        NET4 "," TTY2 "," TTY0 "," TTY3,
+        TTY2 "," QMI4 "," NET4 "," TTY0,
+    };
+    MMExpectedPorts *expected;
+    guint            i;
+
+    /* Whenever the expectation is met, the set learned from the ports found
+     * keeps all the expected ones, so the early release can't reinforce a
+     * smaller set */
+    for (i = 0; i < G_N_ELEMENTS (found); i++) {
+        MMExpectedPorts  *learned;
+        gchar           **learned_ids;
+        GPtrArray        *found_ids;
+        guint             j;
+
+        expected = mm_expected_ports_new_ids (port_ids);
+        found_ids = build_found_ids (found[i]);
+        g_assert (mm_expected_ports_all_found (expected, found_ids));
+
+        learned_ids = mm_expected_ports_build_ids (found_ids);
+        g_assert (learned_ids);
+        learned = mm_expected_ports_new_ids ((const gchar * const *) learned_ids);
+        g_assert_cmpuint (mm_expected_ports_get_length (learned), >=, mm_expected_ports_get_length (expected));
+        for (j = 0; port_ids[j]; j++) {
+            guint k;
+
+            for (k = 0; learned_ids[k] && !g_str_equal (learned_ids[k], port_ids[j]); k++);
+            g_assert (learned_ids[k] != NULL);
+        }
+        /* The same ports meet the learned expectation again */
+        g_assert (mm_expected_ports_all_found (learned, found_ids));
+
+        mm_expected_ports_free (learned);
+        g_strfreev (learned_ids);
+        g_ptr_array_unref (found_ids);
+        mm_expected_ports_free (expected);
+    }
+}
+
+/************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/expected-ports/count",                 test_count);
+    g_test_add_func ("/MM/expected-ports/ids",                   test_ids);
+    g_test_add_func ("/MM/expected-ports/ids-not-replaced",      test_ids_not_replaced);
+    g_test_add_func ("/MM/expected-ports/build-ids",             test_build_ids);
+    g_test_add_func ("/MM/expected-ports/learn-never-shrinks",   test_learn_never_shrinks_early);
+
+    return g_test_run ();
+}
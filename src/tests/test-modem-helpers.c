@@ -3689,6 +3689,150 @@ test_parse_uint_list (void)
     }
 }
 
+/*****************************************************************************/
+/* Test concatenated command responses */
+
+static void
+test_split_concatenated_response (void)
+{
+    static const gchar *time_commands[] = { "+CTZU=1", "+CCLK?" };
+    static const gchar *info_commands[] = { "+CGMR", "+CPIN?", "+CMGL=4" };
+    gchar **split;
+
+    /* Commands without information text get an empty response */
+    split = mm_split_concatenated_response ("\r\n+CCLK: \"14/08/05,04:00:21+40\"\r\n", time_commands, 2);
+    g_assert (split != NULL);
+    g_assert_cmpuint (g_strv_length (split), ==, 2);
+    g_assert_cmpstr (split[0], ==, "");
+    g_assert_cmpstr (split[1], ==, "+CCLK: \"14/08/05,04:00:21+40\"");
+    g_strfreev (split);
+
+    /* Empty lines between the responses are ignored, and lines without
+     * prefix are kept with the previous one */
+    split = mm_split_concatenated_response ("+CGMR: 1.0\r\n\r\n+CPIN: READY\r\n\r\n"
+                                            "+CMGL: 0,1,,25\r\n0791\r\n\r\n"
+                                            "+CMGL: 1,1,,25\r\n0792",
+                                            info_commands, 3);
+    g_assert (split != NULL);
+    g_assert_cmpuint (g_strv_length (split), ==, 3);
+    g_assert_cmpstr (split[0], ==, "+CGMR: 1.0");
+    g_assert_cmpstr (split[1], ==, "+CPIN: READY");
+    g_assert_cmpstr (split[2], ==, "+CMGL: 0,1,,25\r\n0791\r\n+CMGL: 1,1,,25\r\n0792");
+    g_strfreev (split);
+
+    /* Prefixes are case-insensitive and the responses must come in order */
+    split = mm_split_concatenated_response ("+cpin: READY", info_commands, 3);
+    g_assert (split != NULL);
+    g_assert_cmpstr (split[0], ==, "");
+    g_assert_cmpstr (split[1], ==, "+cpin: READY");
+    g_assert_cmpstr (split[2], ==, "");
+    g_strfreev (split);
+
+    /* Text not belonging to any command */
+    g_assert (mm_split_concatenated_response ("1.0\r\n+CPIN: READY", info_commands, 3) == NULL);
+}
+
+/*****************************************************************************/
+/* Benchmark: parser throughput on captured responses */
+
+#define PARSER_BENCHMARK_ITERATIONS 2000
+
+static gboolean
+benchmark_cops_test (const gchar *reply)
+{
+    GList *list;
+
+    list = mm_3gpp_parse_cops_test_response (reply, NULL);
+    mm_3gpp_network_info_list_free (list);
+    return !!list;
+}
+
+static gboolean
+benchmark_cmgl (const gchar *reply)
+{
+    GList *list;
+
+    list = mm_3gpp_parse_pdu_cmgl_response (reply, NULL);
+    mm_3gpp_pdu_info_list_free (list);
+    return !!list;
+}
+
+static gboolean
+benchmark_cgdcont_read (const gchar *reply)
+{
+    GList *list;
+
+    list = mm_3gpp_parse_cgdcont_read_response (reply, NULL);
+    mm_3gpp_pdp_context_list_free (list);
+    return !!list;
+}
+
+static gboolean
+benchmark_cesq (const gchar *reply)
+{
+    guint rxlev, ber, rscp, ecn0, rsrq, rsrp;
+
+    return mm_3gpp_parse_cesq_response (reply, &rxlev, &ber, &rscp, &ecn0, &rsrq, &rsrp, NULL);
+}
+
+static gboolean
+benchmark_cind_test (const gchar *reply)
+{
+    GHashTable *hash;
+
+    hash = mm_3gpp_parse_cind_test_response (reply, NULL);
+    if (!hash)
+        return FALSE;
+    g_hash_table_unref (hash);
+    return TRUE;
+}
+
+typedef struct {
+    const gchar *name;
+    gboolean   (*parse) (const gchar *reply);
+    const gchar *reply;
+} ParserBenchmark;
+
+static const ParserBenchmark parser_benchmarks[] = {
+    { "+COPS=?", benchmark_cops_test,
+      "+COPS: (1,\"T-Mobile US\",\"TMO US\",\"31026\",0),(1,\"Cingular\",\"Cingular\",\"310410\",0),,(0, 1, 3),(0-2)" },
+    { "+CMGL", benchmark_cmgl,
+      "+CMGL: 0,1,,147\r\n07914306073011F00405812261F700003130916191314095C27"
+      "4D96D2FBBD3E437280CB2BEC961F3DB5D76818EF2F0381D9E83E06F39A8CC2E9FD372F"
+      "77BEE0249CBE37A594E0E83E2F532085E2F93CB73D0B93CA7A7DFEEB01C447F93DF731"
+      "0BD3E07CDCB727B7A9C7ECF41E432C8FC96B7C32079189E26874179D0F8DD7E93C3A0B"
+      "21B246AA641D637396C7EBBCB22D0FD7E77B5D376B3AB3C07" },
+    { "+CGDCONT?", benchmark_cgdcont_read,
+      "+CGDCONT: 1,\"IP\",\"nate.sktelecom.com\",\"\",0,0\r\n"
+      "+CGDCONT: 2,\"IPV6\",\"epc.tmobile.com\",\"\",0,0\r\n"
+      "+CGDCONT: 3,\"IPV4V6\",\"internet\",\"\",0,0" },
+    { "+CESQ", benchmark_cesq,
+      "+CESQ: 99,99,255,255,20,80" },
+    { "+CIND=?", benchmark_cind_test,
+      "+CIND: (\"battchg\",(0-5)),(\"signal\",(0-5)),(\"batterywarning\",(0-1)),(\"chargerconnected\",(0-1)),(\"service\",(0-1)),(\"sounder\",(0-1)),(\"message\",(0-1)),()" },
+};
+
+static void
+test_parser_benchmark (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (parser_benchmarks); i++) {
+        guint   j;
+        gdouble elapsed;
+
+        g_test_timer_start ();
+        for (j = 0; j < PARSER_BENCHMARK_ITERATIONS; j++)
+            g_assert (parser_benchmarks[i].parse (parser_benchmarks[i].reply));
+        elapsed = g_test_timer_elapsed ();
+
+        g_test_minimized_result ((elapsed * 1e6) / PARSER_BENCHMARK_ITERATIONS,
+                                 "%s response parse cost: %.2f us",
+                                 parser_benchmarks[i].name,
+                                 (elapsed * 1e6) / PARSER_BENCHMARK_ITERATIONS);
+    }
+}
+
 /*****************************************************************************/
 
 void
@@ -3916,6 +4060,11 @@ int main (int argc, char **argv)
 
     g_test_suite_add (suite, TESTCASE (test_parse_uint_list, NULL));
 
+    g_test_suite_add (suite, TESTCASE (test_split_concatenated_response, NULL));
+
+    if (g_test_perf ())
+        g_test_suite_add (suite, TESTCASE (test_parser_benchmark, NULL));
+
     result = g_test_run ();
 
     reg_test_data_free (reg_data);
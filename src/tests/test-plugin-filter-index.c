@@ -0,0 +1,465 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <locale.h>
+
+/* Define symbol to enable test message traces */
+#undef ENABLE_TEST_MESSAGE_TRACES
+
+#include "mm-plugin-filter-index.h"
+#include "mm-log.h"
+
+/*****************************************************************************/
+/* Synthetic filters */
+
+static const gchar *tty[]          = { "tty", NULL };
+static const gchar *net[]          = { "net", NULL };
+static const gchar *tty_usb[]      = { "tty", "usb", NULL };
+static const gchar *qmi_drivers[]  = { "qmi_wwan", "cdc_mbim", NULL };
+static const gchar *opt_drivers[]  = { "option", NULL };
+static const guint16 vids_a[]      = { 0x1111, 0x2222, 0 };
+static const guint16 vids_b[]      = { 0x3333, 0 };
+static const mm_uint16_pair pids_a[] = { { 0x4444, 0x0001 }, { 0x4444, 0x0002 }, { 0, 0 } };
+static const gchar *tags_a[]       = { "ID_MM_A_TAGGED", NULL };
+static const gchar *tags_b[]       = { "ID_MM_B_TAGGED", "ID_MM_A_TAGGED", NULL };
+
+static const MMPluginFilterIndexEntry entries[] = {
+    /* 0: any port */
+    { NULL, NULL, NULL, NULL, NULL, FALSE },
+    /* 1: tty ports of vendor A */
+    { tty, NULL, vids_a, NULL, NULL, FALSE },
+    /* 2: tty and usbmisc ports with the QMI/MBIM drivers */
+    { tty_usb, qmi_drivers, NULL, NULL, NULL, FALSE },
+    /* 3: vendor B, or the given products of another vendor */
+    { NULL, NULL, vids_b, pids_a, NULL, FALSE },
+    /* 4: net ports tagged with A */
+    { net, NULL, NULL, NULL, tags_a, FALSE },
+    /* 5: vendor A ports, or any other port after probing vendor strings */
+    { NULL, opt_drivers, vids_a, NULL, NULL, TRUE },
+    /* 6: ports tagged with A or B, of vendor B */
+    { NULL, NULL, vids_b, NULL, tags_b, FALSE },
+};
+
+/*****************************************************************************/
+/* Linear reference of the filter semantics the index must implement */
+
+static gboolean
+strv_contains (const gchar * const *strv,
+               const gchar         *str)
+{
+    guint i;
+
+    for (i = 0; strv && strv[i]; i++) {
+        if (g_str_equal (strv[i], str))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static gboolean
+reference_accepts (const MMPluginFilterIndexEntry *entry,
+                   const gchar                    *subsystem,
+                   const gchar * const            *drivers,
+                   guint16                         vendor,
+                   guint16                         product,
+                   const gchar * const            *tags)
+{
+    guint i;
+
+    if (entry->subsystems &&
+        !strv_contains (entry->subsystems, subsystem) &&
+        !(g_str_equal (subsystem, "usbmisc") && strv_contains (entry->subsystems, "usb")))
+        return FALSE;
+
+    if (entry->drivers) {
+        gboolean found = FALSE;
+
+        for (i = 0; !found && drivers && drivers[i]; i++)
+            found = strv_contains (entry->drivers, drivers[i]);
+        if (!found)
+            return FALSE;
+    }
+
+    if ((entry->vendor_ids || entry->product_ids) && !entry->ids_fallback) {
+        gboolean found = FALSE;
+
+        for (i = 0; vendor && !found && entry->vendor_ids && entry->vendor_ids[i]; i++)
+            found = (entry->vendor_ids[i] == vendor);
+        for (i = 0; vendor && product && !found && entry->product_ids && entry->product_ids[i].l; i++)
+            found = (entry->product_ids[i].l == vendor && entry->product_ids[i].r == product);
+        if (!found)
+            return FALSE;
+    }
+
+    if (entry->udev_tags) {
+        gboolean found = FALSE;
+
+        for (i = 0; !found && entry->udev_tags[i]; i++)
+            found = strv_contains (tags, entry->udev_tags[i]);
+        if (!found)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*****************************************************************************/
+
+typedef struct {
+    const gchar * const *tags;
+    guint                n_checks;
+} TagContext;
+
+static gboolean
+has_tag (const gchar *tag,
+         TagContext  *ctx)
+{
+    ctx->n_checks++;
+    return strv_contains (ctx->tags, tag);
+}
+
+static MMPluginFilterIndex *
+build_index (const MMPluginFilterIndexEntry *index_entries,
+             guint                           n_entries)
+{
+    MMPluginFilterIndex *index;
+    guint                i;
+
+    index = mm_plugin_filter_index_new (n_entries);
+    for (i = 0; i < n_entries; i++)
+        mm_plugin_filter_index_add (index, GUINT_TO_POINTER (i + 1), &index_entries[i]);
+    return index;
+}
+
+/* Returns the candidates as a string of entry numbers, e.g. "0,1,5" */
+static gchar *
+index_lookup (MMPluginFilterIndex *index,
+              const gchar         *subsystem,
+              const gchar * const *drivers,
+              guint16              vendor,
+              guint16              product,
+              const gchar * const *tags)
+{
+    TagContext  ctx = { tags, 0 };
+    GList      *list;
+    GList      *l;
+    GString    *str;
+
+    str = g_string_new ("");
+    list = mm_plugin_filter_index_lookup (index, subsystem, drivers, vendor, product,
+                                          (MMPluginFilterIndexTagFunc) has_tag, &ctx);
+    for (l = list; l; l = g_list_next (l))
+        g_string_append_printf (str, "%s%u", str->len ? "," : "", GPOINTER_TO_UINT (l->data) - 1);
+    g_list_free (list);
+    return g_string_free (str, FALSE);
+}
+
+static gchar *
+reference_lookup (const MMPluginFilterIndexEntry *index_entries,
+                  guint                           n_entries,
+                  const gchar                    *subsystem,
+                  const gchar * const            *drivers,
+                  guint16                         vendor,
+                  guint16                         product,
+                  const gchar * const            *tags)
+{
+    GString *str;
+    guint    i;
+
+    str = g_string_new ("");
+    for (i = 0; i < n_entries; i++) {
+        if (reference_accepts (&index_entries[i], subsystem, drivers, vendor, product, tags))
+            g_string_append_printf (str, "%s%u", str->len ? "," : "", i);
+    }
+    return g_string_free (str, FALSE);
+}
+
+static void
+common_test_lookup (const gchar         *subsystem,
+                    const gchar * const *drivers,
+                    guint16              vendor,
+                    guint16              product,
+                    const gchar * const *tags,
+                    const gchar         *expected)
+{
+    MMPluginFilterIndex *index;
+    gchar               *found;
+    gchar               *reference;
+
+    index = build_index (entries, G_N_ELEMENTS (entries));
+    found = index_lookup (index, subsystem, drivers, vendor, product, tags);
+    reference = reference_lookup (entries, G_N_ELEMENTS (entries), subsystem, drivers, vendor, product, tags);
+
+    g_assert_cmpstr (found, ==, expected);
+    g_assert_cmpstr (reference, ==, expected);
+
+    g_free (found);
+    g_free (reference);
+    mm_plugin_filter_index_free (index);
+}
+
+/*****************************************************************************/
+
+static void
+test_lookup_vendor_id (void)
+{
+    static const gchar *drivers[] = { "option", NULL };
+
+    common_test_lookup ("tty", drivers, 0x2222, 0x0001, NULL, "0,1,5");
+    common_test_lookup ("tty", NULL,    0x2222, 0x0001, NULL, "0,1");
+    common_test_lookup ("net", NULL,    0x3333, 0x0001, NULL, "0,3");
+}
+
+static void
+test_lookup_product_id (void)
+{
+    common_test_lookup ("tty", NULL, 0x4444, 0x0002, NULL, "0,3");
+    common_test_lookup ("tty", NULL, 0x4444, 0x0003, NULL, "0");
+    /* A product ID is only looked up along with its vendor ID */
+    common_test_lookup ("tty", NULL, 0x0000, 0x0002, NULL, "0");
+}
+
+static void
+test_lookup_ids_fallback (void)
+{
+    static const gchar *drivers[] = { "option", NULL };
+
+    /* Unknown vendor; only the entry with the vendor-string fallback
+     * may still support the port */
+    common_test_lookup ("tty", drivers, 0x9999, 0x0001, NULL, "0,5");
+    common_test_lookup ("tty", drivers, 0x0000, 0x0000, NULL, "0,5");
+}
+
+static void
+test_lookup_drivers (void)
+{
+    static const gchar *qmi[]       = { "qmi_wwan", NULL };
+    static const gchar *qmi_usb[]   = { "usb", "cdc_mbim", NULL };
+    static const gchar *unknown[]   = { "unknown", NULL };
+
+    common_test_lookup ("tty", qmi,     0x9999, 0x0001, NULL, "0,2");
+    /* Any of the drivers of the device may be the one expected */
+    common_test_lookup ("tty", qmi_usb, 0x9999, 0x0001, NULL, "0,2");
+    common_test_lookup ("tty", unknown, 0x9999, 0x0001, NULL, "0");
+}
+
+static void
+test_lookup_usbmisc (void)
+{
+    static const gchar *drivers[] = { "cdc_mbim", NULL };
+
+    /* Filters on the 'usb' subsystem also accept 'usbmisc' ports */
+    common_test_lookup ("usbmisc", drivers, 0x9999, 0x0001, NULL, "0,2");
+    common_test_lookup ("usb",     drivers, 0x9999, 0x0001, NULL, "0,2");
+    common_test_lookup ("net",     drivers, 0x9999, 0x0001, NULL, "0");
+}
+
+static void
+test_lookup_udev_tag (void)
+{
+    static const gchar *tag_a[] = { "ID_MM_A_TAGGED", NULL };
+    static const gchar *tag_b[] = { "ID_MM_B_TAGGED", NULL };
+
+    common_test_lookup ("net", NULL, 0x9999, 0x0001, tag_a, "0,4");
+    common_test_lookup ("net", NULL, 0x9999, 0x0001, NULL,  "0");
+    common_test_lookup ("net", NULL, 0x3333, 0x0001, tag_b, "0,3,6");
+    common_test_lookup ("tty", NULL, 0x3333, 0x0001, tag_a, "0,3,6");
+}
+
+static void
+test_lookup_udev_tag_checks (void)
+{
+    static const gchar *tag_a[] = { "ID_MM_A_TAGGED", NULL };
+    MMPluginFilterIndex *index;
+    TagContext           ctx = { tag_a, 0 };
+    GList               *list;
+
+    index = build_index (entries, G_N_ELEMENTS (entries));
+
+    /* No entry requiring a tag is left after the other filters; the port
+     * properties must not be looked up */
+    list = mm_plugin_filter_index_lookup (index, "tty", NULL, 0x2222, 0x0001,
+                                          (MMPluginFilterIndexTagFunc) has_tag, &ctx);
+    g_assert_cmpuint (g_list_length (list), ==, 2);
+    g_assert_cmpuint (ctx.n_checks, ==, 0);
+    g_list_free (list);
+
+    /* Only the tag of the net entry may make a difference */
+    list = mm_plugin_filter_index_lookup (index, "net", NULL, 0x2222, 0x0001,
+                                          (MMPluginFilterIndexTagFunc) has_tag, &ctx);
+    g_assert_cmpuint (g_list_length (list), ==, 2);
+    g_assert_cmpuint (ctx.n_checks, ==, 1);
+    g_list_free (list);
+
+    mm_plugin_filter_index_free (index);
+}
+
+/*****************************************************************************/
+/* Random filters, over more entries than fit in a single bitset word */
+
+#define N_RANDOM_ENTRIES 150
+#define N_RANDOM_LOOKUPS 2000
+
+static const gchar *random_subsystems[] = { "tty", "net", "usb", "usbmisc", "wwan", NULL };
+static const gchar *random_drivers[]    = { "option", "qcserial", "qmi_wwan", "cdc_mbim", "cdc_acm", NULL };
+static const gchar *random_tags[]       = { "ID_MM_A_TAGGED", "ID_MM_B_TAGGED", "ID_MM_C_TAGGED", NULL };
+static const guint16 random_vids[]      = { 0x1111, 0x2222, 0x3333, 0x4444 };
+
+/* Random subset of a NULL-terminated array of strings, or NULL */
+static const gchar **
+random_strv (GRand        *rand,
+             const gchar **values,
+             gboolean      allow_empty)
+{
+    const gchar **strv;
+    guint         n_values;
+    guint         i;
+    guint         n = 0;
+
+    if (allow_empty && g_rand_boolean (rand))
+        return NULL;
+
+    n_values = g_strv_length ((gchar **) values);
+    strv = g_new0 (const gchar *, n_values + 1);
+    for (i = 0; i < n_values; i++) {
+        if (g_rand_int_range (rand, 0, 3) == 0)
+            strv[n++] = values[i];
+    }
+    if (!n)
+        strv[n++] = values[g_rand_int_range (rand, 0, n_values)];
+    return strv;
+}
+
+static void
+random_entry_init (GRand                    *rand,
+                   MMPluginFilterIndexEntry *entry)
+{
+    memset (entry, 0, sizeof (*entry));
+
+    entry->subsystems = random_strv (rand, random_subsystems, TRUE);
+    entry->drivers = random_strv (rand, random_drivers, TRUE);
+    entry->udev_tags = (g_rand_int_range (rand, 0, 4) == 0) ? random_strv (rand, random_tags, FALSE) : NULL;
+
+    if (g_rand_boolean (rand)) {
+        guint16 *vids;
+
+        vids = g_new0 (guint16, 2);
+        vids[0] = random_vids[g_rand_int_range (rand, 0, G_N_ELEMENTS (random_vids))];
+        entry->vendor_ids = vids;
+    }
+    if (g_rand_int_range (rand, 0, 3) == 0) {
+        mm_uint16_pair *pids;
+
+        pids = g_new0 (mm_uint16_pair, 2);
+        pids[0].l = random_vids[g_rand_int_range (rand, 0, G_N_ELEMENTS (random_vids))];
+        pids[0].r = g_rand_int_range (rand, 1, 4);
+        entry->product_ids = pids;
+    }
+    entry->ids_fallback = (g_rand_int_range (rand, 0, 5) == 0);
+}
+
+static void
+random_entry_clear (MMPluginFilterIndexEntry *entry)
+{
+    g_free (entry->subsystems);
+    g_free (entry->drivers);
+    g_free (entry->udev_tags);
+    g_free ((gpointer) entry->vendor_ids);
+    g_free ((gpointer) entry->product_ids);
+}
+
+static void
+test_lookup_random (void)
+{
+    MMPluginFilterIndexEntry  random_entries[N_RANDOM_ENTRIES];
+    MMPluginFilterIndex      *index;
+    GRand                    *rand;
+    guint                     i;
+
+    rand = g_rand_new_with_seed (0xF11E);
+    for (i = 0; i < N_RANDOM_ENTRIES; i++)
+        random_entry_init (rand, &random_entries[i]);
+    index = build_index (random_entries, N_RANDOM_ENTRIES);
+
+    for (i = 0; i < N_RANDOM_LOOKUPS; i++) {
+        const gchar  *subsystem;
+        const gchar **drivers;
+        const gchar **tags;
+        guint16       vendor;
+        guint16       product;
+        gchar        *found;
+        gchar        *reference;
+
+        subsystem = random_subsystems[g_rand_int_range (rand, 0, g_strv_length ((gchar **) random_subsystems))];
+        drivers = random_strv (rand, random_drivers, TRUE);
+        tags = random_strv (rand, random_tags, TRUE);
+        vendor = (g_rand_int_range (rand, 0, 5) == 0) ? 0x9999 : random_vids[g_rand_int_range (rand, 0, G_N_ELEMENTS (random_vids))];
+        product = g_rand_int_range (rand, 0, 4);
+
+        found = index_lookup (index, subsystem, drivers, vendor, product, tags);
+        reference = reference_lookup (random_entries, N_RANDOM_ENTRIES, subsystem, drivers, vendor, product, tags);
+        g_assert_cmpstr (found, ==, reference);
+
+        g_free (found);
+        g_free (reference);
+        g_free (drivers);
+        g_free (tags);
+    }
+
+    mm_plugin_filter_index_free (index);
+    for (i = 0; i < N_RANDOM_ENTRIES; i++)
+        random_entry_clear (&random_entries[i]);
+    g_rand_free (rand);
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/plugin-filter-index/vendor-id",       test_lookup_vendor_id);
+    g_test_add_func ("/MM/plugin-filter-index/product-id",      test_lookup_product_id);
+    g_test_add_func ("/MM/plugin-filter-index/ids-fallback",    test_lookup_ids_fallback);
+    g_test_add_func ("/MM/plugin-filter-index/drivers",         test_lookup_drivers);
+    g_test_add_func ("/MM/plugin-filter-index/usbmisc",         test_lookup_usbmisc);
+    g_test_add_func ("/MM/plugin-filter-index/udev-tag",        test_lookup_udev_tag);
+    g_test_add_func ("/MM/plugin-filter-index/udev-tag-checks", test_lookup_udev_tag_checks);
+    g_test_add_func ("/MM/plugin-filter-index/random",          test_lookup_random);
+
+    return g_test_run ();
+}
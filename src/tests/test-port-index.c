@@ -0,0 +1,250 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <string.h>
+#include <locale.h>
+
+/* Define symbol to enable test message traces */
+#undef ENABLE_TEST_MESSAGE_TRACES
+
+#include "mm-port-index.h"
+#include "mm-log.h"
+
+/************************************************************/
+
+static void
+test_add_remove (void)
+{
+    MMPortIndex *index;
+    GObject     *device;
+
+    index = mm_port_index_new ();
+    device = g_object_new (G_TYPE_OBJECT, NULL);
+
+    mm_port_index_add (index, "tty", "ttyUSB0", device);
+    mm_port_index_add (index, "net", "wwan0", device);
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, 2);
+    g_assert (mm_port_index_lookup (index, "tty", "ttyUSB0") == device);
+    g_assert (mm_port_index_lookup (index, "net", "wwan0") == device);
+
+    /* Ports are told apart by subsystem too */
+    g_assert (mm_port_index_lookup (index, "net", "ttyUSB0") == NULL);
+    g_assert (mm_port_index_lookup (index, "tty", "ttyUSB1") == NULL);
+
+    g_assert (mm_port_index_remove (index, "tty", "ttyUSB0", device));
+    g_assert (!mm_port_index_remove (index, "tty", "ttyUSB0", device));
+    g_assert (mm_port_index_lookup (index, "tty", "ttyUSB0") == NULL);
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, 1);
+
+    mm_port_index_free (index);
+    g_object_unref (device);
+}
+
+static void
+test_stale_remove (void)
+{
+    MMPortIndex *index;
+    GObject     *old_device;
+    GObject     *new_device;
+
+    index = mm_port_index_new ();
+    old_device = g_object_new (G_TYPE_OBJECT, NULL);
+    new_device = g_object_new (G_TYPE_OBJECT, NULL);
+
+    /* The port is grabbed again by a new device before the old one is gone */
+    mm_port_index_add (index, "tty", "ttyUSB0", old_device);
+    mm_port_index_add (index, "tty", "ttyUSB0", new_device);
+    g_assert (mm_port_index_lookup (index, "tty", "ttyUSB0") == new_device);
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, 1);
+
+    /* Removing the old device must not drop the new one */
+    g_assert (!mm_port_index_remove (index, "tty", "ttyUSB0", old_device));
+    g_assert (mm_port_index_lookup (index, "tty", "ttyUSB0") == new_device);
+
+    g_assert (mm_port_index_remove (index, "tty", "ttyUSB0", new_device));
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, 0);
+
+    mm_port_index_free (index);
+    g_object_unref (old_device);
+    g_object_unref (new_device);
+}
+
+static void
+test_owner_references (void)
+{
+    MMPortIndex *index;
+    GObject     *device;
+
+    index = mm_port_index_new ();
+    device = g_object_new (G_TYPE_OBJECT, NULL);
+    g_object_add_weak_pointer (device, (gpointer *) &device);
+
+    mm_port_index_add (index, "tty", "ttyUSB0", device);
+    mm_port_index_add (index, "tty", "ttyUSB1", device);
+    g_object_unref (device);
+
+    /* The index keeps the owner alive while indexed */
+    g_assert (device != NULL);
+    g_assert (mm_port_index_remove (index, "tty", "ttyUSB0", device));
+    g_assert (device != NULL);
+    mm_port_index_clear (index);
+    g_assert (device == NULL);
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, 0);
+
+    mm_port_index_free (index);
+}
+
+/************************************************************/
+/* Random add and remove events, checked against a plain table */
+
+#define STRESS_N_DEVICES 32
+#define STRESS_N_PORTS   256
+#define STRESS_N_EVENTS  20000
+
+static const gchar *stress_subsystems[] = { "tty", "net", "usbmisc" };
+
+static void
+stress_check_all (MMPortIndex  *index,
+                  GHashTable   *reference,
+                  gchar       **names)
+{
+    guint i;
+    guint j;
+
+    g_assert_cmpuint (mm_port_index_get_length (index), ==, g_hash_table_size (reference));
+    for (i = 0; i < G_N_ELEMENTS (stress_subsystems); i++) {
+        for (j = 0; j < STRESS_N_PORTS; j++) {
+            gchar *key;
+
+            key = g_strdup_printf ("%s/%s", stress_subsystems[i], names[j]);
+            g_assert (mm_port_index_lookup (index, stress_subsystems[i], names[j]) == g_hash_table_lookup (reference, key));
+            g_free (key);
+        }
+    }
+}
+
+static void
+test_stress (void)
+{
+    MMPortIndex  *index;
+    GHashTable   *reference;
+    GObject      *devices[STRESS_N_DEVICES];
+    gchar        *names[STRESS_N_PORTS];
+    GRand        *rand;
+    guint         n_added = 0;
+    guint         n_removed = 0;
+    guint         i;
+
+    index = mm_port_index_new ();
+    reference = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    rand = g_rand_new_with_seed (0x1DE5);
+
+    for (i = 0; i < STRESS_N_DEVICES; i++)
+        devices[i] = g_object_new (G_TYPE_OBJECT, NULL);
+    for (i = 0; i < STRESS_N_PORTS; i++)
+        names[i] = g_strdup_printf ("ttyUSB%u", i);
+
+    for (i = 0; i < STRESS_N_EVENTS; i++) {
+        const gchar *subsystem;
+        const gchar *name;
+        GObject     *device;
+        GObject     *owner;
+        gchar       *key;
+
+        subsystem = stress_subsystems[g_rand_int_range (rand, 0, G_N_ELEMENTS (stress_subsystems))];
+        name = names[g_rand_int_range (rand, 0, STRESS_N_PORTS)];
+        device = devices[g_rand_int_range (rand, 0, STRESS_N_DEVICES)];
+        key = g_strdup_printf ("%s/%s", subsystem, name);
+        owner = g_hash_table_lookup (reference, key);
+
+        if (g_rand_boolean (rand)) {
+            mm_port_index_add (index, subsystem, name, device);
+            g_hash_table_insert (reference, g_strdup (key), device);
+            n_added++;
+        } else {
+            gboolean removed;
+
+            /* Mostly remove as the real owner, sometimes as a stale one */
+            if (owner && g_rand_int_range (rand, 0, 4) != 0)
+                device = owner;
+            removed = mm_port_index_remove (index, subsystem, name, device);
+            g_assert_cmpint (removed, ==, (owner && owner == device));
+            if (removed) {
+                g_hash_table_remove (reference, key);
+                n_removed++;
+            }
+        }
+
+        g_assert (mm_port_index_lookup (index, subsystem, name) == g_hash_table_lookup (reference, key));
+        g_free (key);
+
+        if (i % 1000 == 0)
+            stress_check_all (index, reference, names);
+    }
+    stress_check_all (index, reference, names);
+
+    /* Make sure both paths were really exercised */
+    g_assert_cmpuint (n_added, >, STRESS_N_EVENTS / 4);
+    g_assert_cmpuint (n_removed, >, STRESS_N_EVENTS / 8);
+
+    /* All owner references are released once the index is cleared */
+    mm_port_index_clear (index);
+    for (i = 0; i < STRESS_N_DEVICES; i++) {
+        g_assert_cmpuint (devices[i]->ref_count, ==, 1);
+        g_object_unref (devices[i]);
+    }
+    for (i = 0; i < STRESS_N_PORTS; i++)
+        g_free (names[i]);
+
+    g_rand_free (rand);
+    g_hash_table_unref (reference);
+    mm_port_index_free (index);
+}
+
+/************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/port-index/add-remove",       test_add_remove);
+    g_test_add_func ("/MM/port-index/stale-remove",     test_stale_remove);
+    g_test_add_func ("/MM/port-index/owner-references", test_owner_references);
+    g_test_add_func ("/MM/port-index/stress",           test_stress);
+
+    return g_test_run ();
+}
@@ -0,0 +1,428 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include "mm-error-helpers.h"
+#include "mm-serial-parsers.h"
+#include "mm-log.h"
+
+/*****************************************************************************/
+/* Common test cases, for which both parsers must give the same result */
+
+static const gchar *parser_tests[] = {
+    /* Successful replies */
+    "\r\nOK\r\n",
+    "\r\nOK\r\n\r\n",
+    "\r\n+CGMI: \"Some vendor\"\r\n\r\nOK\r\n",
+    "\r\n+CPMS: \"SM\",1,30,\"SM\",1,30,\"SM\",1,30\r\n\r\nOK\r\n",
+    "\r\n\r\n+CSQ: 20,99\r\n\r\nOK\r\n",
+    "\r\nCONNECT\r\n",
+    "\r\nCONNECT 115200\r\n",
+    "\r\n> ",
+    "\r\n>",
+    /* Errors */
+    "\r\nERROR\r\n",
+    "\r\n+CGMI: \"Some vendor\"\r\n\r\nERROR\r\n",
+    "\r\nCOMMAND NOT SUPPORT\r\n",
+    "\r\n+CME ERROR: 10\r\n",
+    "\r\n+CME ERROR:10\r\n",
+    "\r\n+CME ERROR: SIM not inserted\r\n",
+    "\r\n+CMS ERROR: 310\r\n",
+    "\r\n+CMS ERROR: SIM not inserted\r\n",
+    "\r\nMODEM ERROR: 3\r\n",
+    "\r\nNO CARRIER\r\n",
+    "\r\nNA\r\n",
+    /* Incomplete replies */
+    "\r\n",
+    "\r\n+CGMI: \"Some vendor\"\r\n",
+    "\r\n+CGMI: \"Some vendor\"\r\n\r\nO",
+    "\r\n+CGMI: \"Some vendor\"\r\n\r\nOK",
+    "\r\n+CGMI: \"Some vendor\"\r\n\r\nOK\r",
+    "\r\n+CME ERROR: 10",
+    "\r\nOK\r\n\r\n+CGMI: \"Some vendor\"\r\n",
+};
+
+static gboolean
+run_parser (gboolean     v2,
+            const gchar *str,
+            GString    **out_response,
+            GError     **error)
+{
+    gpointer  parser;
+    GString  *response;
+    gboolean  found;
+
+    response = g_string_new (str);
+    if (v2) {
+        parser = mm_serial_parser_v2_new ();
+        found = mm_serial_parser_v2_parse (parser, response, error);
+        mm_serial_parser_v2_destroy (parser);
+    } else {
+        parser = mm_serial_parser_v1_new ();
+        found = mm_serial_parser_v1_parse (parser, response, error);
+        mm_serial_parser_v1_destroy (parser);
+    }
+
+    *out_response = response;
+    return found;
+}
+
+static void
+test_parser_compare (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (parser_tests); i++) {
+        GString  *response_v1;
+        GString  *response_v2;
+        GError   *error_v1 = NULL;
+        GError   *error_v2 = NULL;
+        gboolean  found_v1;
+        gboolean  found_v2;
+
+        found_v1 = run_parser (FALSE, parser_tests[i], &response_v1, &error_v1);
+        found_v2 = run_parser (TRUE,  parser_tests[i], &response_v2, &error_v2);
+
+        g_assert_cmpint (found_v1, ==, found_v2);
+        g_assert_cmpstr (response_v1->str, ==, response_v2->str);
+        if (error_v1) {
+            g_assert (error_v2 != NULL);
+            g_assert_cmpuint (error_v1->domain, ==, error_v2->domain);
+            g_assert_cmpint (error_v1->code, ==, error_v2->code);
+        } else
+            g_assert_no_error (error_v2);
+
+        g_clear_error (&error_v1);
+        g_clear_error (&error_v2);
+        g_string_free (response_v1, TRUE);
+        g_string_free (response_v2, TRUE);
+    }
+}
+
+/*****************************************************************************/
+/* Incremental parsing: the same parser is fed a response growing byte by byte */
+
+static void
+test_parser_v2_incremental (void)
+{
+    static const gchar *reply = "\r\n+CMGL: 1,1,,23\r\n07914306073011F0040B914316709807F70000\r\n\r\nOK\r\n";
+    gpointer  parser;
+    gsize     len;
+    gsize     reply_len;
+    GString  *response = NULL;
+    GError   *error = NULL;
+    gboolean  found = FALSE;
+
+    parser = mm_serial_parser_v2_new ();
+    reply_len = strlen (reply);
+    for (len = 1; len <= reply_len; len++) {
+        response = g_string_new_len (reply, len);
+        found = mm_serial_parser_v2_parse (parser, response, &error);
+        g_assert_no_error (error);
+        if (found)
+            break;
+        g_string_free (response, TRUE);
+    }
+
+    g_assert (found);
+    g_assert_cmpuint (len, ==, reply_len);
+    g_assert_cmpstr (response->str, ==, "+CMGL: 1,1,,23\r\n07914306073011F0040B914316709807F70000");
+    g_string_free (response, TRUE);
+
+    /* After a successful parse the state is reset, so a new shorter reply
+     * must be parsed from scratch */
+    response = g_string_new ("\r\nERROR\r\n");
+    found = mm_serial_parser_v2_parse (parser, response, &error);
+    g_assert (found);
+    g_assert_error (error, MM_MOBILE_EQUIPMENT_ERROR, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+    g_clear_error (&error);
+    g_string_free (response, TRUE);
+
+    mm_serial_parser_v2_destroy (parser);
+}
+
+/*****************************************************************************/
+/* Reset: once the owner of the response removes contents (e.g. unsolicited
+ * messages), the lines before the last scan offset must be scanned again */
+
+static void
+test_parser_v2_reset (void)
+{
+    static const gchar *partial = "\r\n+CGMI: \"Some vendor\"\r\n";
+    static const gchar *updated = "\r\nERROR\r\n\r\n+CGMI: \"Some vendor\"\r\n";
+    gpointer  parser;
+    GString  *response;
+    GError   *error = NULL;
+
+    parser = mm_serial_parser_v2_new ();
+
+    response = g_string_new (partial);
+    g_assert (!mm_serial_parser_v2_check (parser, response->str, response->len));
+    g_assert (!mm_serial_parser_v2_parse (parser, response, &error));
+    g_assert_no_error (error);
+    g_string_free (response, TRUE);
+
+    /* Same length or longer, but different contents before the offset
+     * already scanned */
+    mm_serial_parser_v2_reset (parser);
+    response = g_string_new (updated);
+    g_assert (mm_serial_parser_v2_check (parser, response->str, response->len));
+    g_assert (mm_serial_parser_v2_parse (parser, response, &error));
+    g_assert_error (error, MM_MOBILE_EQUIPMENT_ERROR, MM_MOBILE_EQUIPMENT_ERROR_UNKNOWN);
+    g_clear_error (&error);
+    g_string_free (response, TRUE);
+
+    mm_serial_parser_v2_destroy (parser);
+}
+
+/*****************************************************************************/
+/* Quick check: the parser is only run when the check says so, and the result
+ * must be the same as when running the parser on every read */
+
+static void
+test_parser_v2_check (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (parser_tests); i++) {
+        gpointer  parser;
+        gpointer  checked_parser;
+        gsize     len;
+        gsize     str_len;
+
+        parser = mm_serial_parser_v2_new ();
+        checked_parser = mm_serial_parser_v2_new ();
+        str_len = strlen (parser_tests[i]);
+
+        for (len = 1; len <= str_len; len++) {
+            GString  *response;
+            GString  *checked_response;
+            GError   *error = NULL;
+            GError   *checked_error = NULL;
+            gboolean  found;
+            gboolean  checked_found = FALSE;
+
+            response = g_string_new_len (parser_tests[i], len);
+            found = mm_serial_parser_v2_parse (parser, response, &error);
+
+            checked_response = g_string_new_len (parser_tests[i], len);
+            if (mm_serial_parser_v2_check (checked_parser, checked_response->str, checked_response->len))
+                checked_found = mm_serial_parser_v2_parse (checked_parser, checked_response, &checked_error);
+
+            g_assert_cmpint (found, ==, checked_found);
+            if (found) {
+                g_assert_cmpstr (response->str, ==, checked_response->str);
+                if (error) {
+                    g_assert (checked_error != NULL);
+                    g_assert_cmpuint (error->domain, ==, checked_error->domain);
+                    g_assert_cmpint (error->code, ==, checked_error->code);
+                } else
+                    g_assert_no_error (checked_error);
+            }
+
+            g_clear_error (&error);
+            g_clear_error (&checked_error);
+            g_string_free (response, TRUE);
+            g_string_free (checked_response, TRUE);
+            if (found)
+                break;
+        }
+
+        mm_serial_parser_v2_destroy (parser);
+        mm_serial_parser_v2_destroy (checked_parser);
+    }
+}
+
+/*****************************************************************************/
+/* Connection errors: V1 reports NO CARRIER for all of them */
+
+typedef struct {
+    const gchar       *str;
+    MMConnectionError  code;
+} ConnectionErrorTest;
+
+static const ConnectionErrorTest connection_error_tests[] = {
+    { "\r\nNO CARRIER\r\n",  MM_CONNECTION_ERROR_NO_CARRIER  },
+    { "\r\nBUSY\r\n",        MM_CONNECTION_ERROR_BUSY        },
+    { "\r\nNO ANSWER\r\n",   MM_CONNECTION_ERROR_NO_ANSWER   },
+    { "\r\nNO DIALTONE\r\n", MM_CONNECTION_ERROR_NO_DIALTONE },
+};
+
+static void
+test_parser_v2_connection_errors (void)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (connection_error_tests); i++) {
+        GString *response;
+        GError  *error = NULL;
+
+        g_assert (run_parser (TRUE, connection_error_tests[i].str, &response, &error));
+        g_assert_error (error, MM_CONNECTION_ERROR, connection_error_tests[i].code);
+        g_assert_cmpuint (response->len, >, 0);
+
+        g_clear_error (&error);
+        g_string_free (response, TRUE);
+    }
+}
+
+static void
+test_parser_v2_custom_regex (void)
+{
+    gpointer  parser;
+    GRegex   *regex;
+    GString  *response;
+    GError   *error = NULL;
+
+    parser = mm_serial_parser_v2_new ();
+    regex = g_regex_new ("\\r\\n\\+CPIN: .*\\r\\n",
+                         G_REGEX_RAW | G_REGEX_OPTIMIZE,
+                         0, NULL);
+    mm_serial_parser_v2_set_custom_regex (parser, regex, NULL);
+    g_regex_unref (regex);
+
+    response = g_string_new ("\r\n+CPIN: READY\r\n");
+    g_assert (mm_serial_parser_v2_parse (parser, response, &error));
+    g_assert_no_error (error);
+    g_assert_cmpstr (response->str, ==, "+CPIN: READY");
+    g_string_free (response, TRUE);
+
+    mm_serial_parser_v2_destroy (parser);
+}
+
+/*****************************************************************************/
+/* Benchmark: parse cost per byte of a multi-line reply received in chunks,
+ * with the parser being run each time a new chunk is received, as the serial
+ * port does. */
+
+#define BENCHMARK_CHUNK_SIZE 64
+
+static GString *
+build_benchmark_reply (gsize size)
+{
+    GString *reply;
+    guint    i;
+
+    reply = g_string_sized_new (size + 16);
+    for (i = 0; reply->len < size; i++)
+        g_string_append_printf (reply,
+                                "\r\n+CMGL: %u,1,,23\r\n07914306073011F0040B914316709807F70000%04u\r\n",
+                                i, i);
+    g_string_append (reply, "\r\nOK\r\n");
+    return reply;
+}
+
+static gdouble
+benchmark_parser (gboolean       v2,
+                  const GString *reply,
+                  guint          iterations)
+{
+    gpointer parser;
+    guint    i;
+
+    parser = v2 ? mm_serial_parser_v2_new () : mm_serial_parser_v1_new ();
+
+    g_test_timer_start ();
+    for (i = 0; i < iterations; i++) {
+        gsize    len;
+        gboolean found = FALSE;
+
+        for (len = MIN (BENCHMARK_CHUNK_SIZE, reply->len); !found; len = MIN (len + BENCHMARK_CHUNK_SIZE, reply->len)) {
+            GString *response;
+
+            response = g_string_new_len (reply->str, len);
+            found = (v2 ?
+                     mm_serial_parser_v2_parse (parser, response, NULL) :
+                     mm_serial_parser_v1_parse (parser, response, NULL));
+            g_string_free (response, TRUE);
+            g_assert (found || len < reply->len);
+        }
+    }
+
+    if (v2)
+        mm_serial_parser_v2_destroy (parser);
+    else
+        mm_serial_parser_v1_destroy (parser);
+
+    /* nanoseconds per byte */
+    return (g_test_timer_elapsed () * 1e9) / ((gdouble) reply->len * iterations);
+}
+
+static void
+test_parser_benchmark (void)
+{
+    static const gsize sizes[] = { 64, 256, 1024, 4096, 16384 };
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+        GString *reply;
+        guint    iterations;
+        gdouble  v1;
+        gdouble  v2;
+
+        reply = build_benchmark_reply (sizes[i]);
+        iterations = MAX (1, (256 * 1024) / reply->len);
+
+        v1 = benchmark_parser (FALSE, reply, iterations);
+        v2 = benchmark_parser (TRUE,  reply, iterations);
+
+        g_test_message ("%6" G_GSIZE_FORMAT " bytes: v1 %8.2f ns/byte, v2 %8.2f ns/byte",
+                        reply->len, v1, v2);
+        g_test_minimized_result (v2, "v2 parse cost with %" G_GSIZE_FORMAT " bytes: %.2f ns/byte",
+                                 reply->len, v2);
+
+        g_string_free (reply, TRUE);
+    }
+}
+
+/*****************************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/ModemManager/serial-parsers/compare",              test_parser_compare);
+    g_test_add_func ("/ModemManager/serial-parsers/v2/incremental",       test_parser_v2_incremental);
+    g_test_add_func ("/ModemManager/serial-parsers/v2/reset",             test_parser_v2_reset);
+    g_test_add_func ("/ModemManager/serial-parsers/v2/check",             test_parser_v2_check);
+    g_test_add_func ("/ModemManager/serial-parsers/v2/connection-errors", test_parser_v2_connection_errors);
+    g_test_add_func ("/ModemManager/serial-parsers/v2/custom-regex",      test_parser_v2_custom_regex);
+
+    if (g_test_perf ())
+        g_test_add_func ("/ModemManager/serial-parsers/benchmark", test_parser_benchmark);
+
+    return g_test_run ();
+}
@@ -15,8 +15,10 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include <locale.h>
 
 #define _LIBMM_INSIDE_MM
@@ -44,6 +46,400 @@ test_load_cleanup_core (void)
     g_array_unref (rules);
 }
 
+/************************************************************/
+/* Full set of rules shipped, core and plugins */
+
+static gchar *
+setup_full_rules_dir (void)
+{
+    gchar       *rules_dir;
+    gchar       *plugins_dir;
+    GDir        *dir;
+    const gchar *name;
+    GError      *error = NULL;
+
+    /* The rules are installed in the same directory, but they live in
+     * different ones in the source tree, so link all of them together */
+    rules_dir = g_dir_make_tmp ("test-udev-rules-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    dir = g_dir_open (TESTUDEVRULESDIR, 0, &error);
+    g_assert_no_error (error);
+    while ((name = g_dir_read_name (dir)) != NULL) {
+        if (g_str_has_suffix (name, ".rules")) {
+            gchar *source;
+            gchar *target;
+
+            source = g_build_filename (TESTUDEVRULESDIR, name, NULL);
+            target = g_build_filename (rules_dir, name, NULL);
+            g_assert_cmpint (symlink (source, target), ==, 0);
+            g_free (source);
+            g_free (target);
+        }
+    }
+    g_dir_close (dir);
+
+    plugins_dir = g_build_filename (TESTUDEVRULESDIR, "..", "plugins", NULL);
+    dir = g_dir_open (plugins_dir, 0, &error);
+    g_assert_no_error (error);
+    while ((name = g_dir_read_name (dir)) != NULL) {
+        gchar       *plugin_dir;
+        GDir        *subdir;
+        const gchar *subname;
+
+        plugin_dir = g_build_filename (plugins_dir, name, NULL);
+        subdir = g_dir_open (plugin_dir, 0, NULL);
+        while (subdir && (subname = g_dir_read_name (subdir)) != NULL) {
+            if (g_str_has_suffix (subname, ".rules")) {
+                gchar *source;
+                gchar *target;
+
+                source = g_build_filename (plugin_dir, subname, NULL);
+                target = g_build_filename (rules_dir, subname, NULL);
+                g_assert_cmpint (symlink (source, target), ==, 0);
+                g_free (source);
+                g_free (target);
+            }
+        }
+        if (subdir)
+            g_dir_close (subdir);
+        g_free (plugin_dir);
+    }
+    g_dir_close (dir);
+    g_free (plugins_dir);
+
+    return rules_dir;
+}
+
+static void
+cleanup_full_rules_dir (gchar *rules_dir)
+{
+    GDir        *dir;
+    const gchar *name;
+
+    dir = g_dir_open (rules_dir, 0, NULL);
+    g_assert (dir);
+    while ((name = g_dir_read_name (dir)) != NULL) {
+        gchar *path;
+
+        path = g_build_filename (rules_dir, name, NULL);
+        g_unlink (path);
+        g_free (path);
+    }
+    g_dir_close (dir);
+    g_rmdir (rules_dir);
+    g_free (rules_dir);
+}
+
+static GArray *
+load_full_rules (void)
+{
+    gchar  *rules_dir;
+    GArray *rules;
+    GError *error = NULL;
+
+    rules_dir = setup_full_rules_dir ();
+    rules = mm_kernel_device_generic_rules_load (rules_dir, &error);
+    g_assert_no_error (error);
+    g_assert (rules);
+    cleanup_full_rules_dir (rules_dir);
+
+    return rules;
+}
+
+/************************************************************/
+
+static GHashTable *
+properties_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+}
+
+static void
+device_init (MMUdevRuleDevice *device,
+             const gchar      *subsystem,
+             const gchar      *name,
+             const gchar      *driver,
+             guint16           vid,
+             guint16           pid,
+             guint8            interface_number,
+             gchar           **out_sysfs_path)
+{
+    memset (device, 0, sizeof (MMUdevRuleDevice));
+
+    *out_sysfs_path = g_strdup_printf ("/sys/devices/pci0000:00/0000:00:14.0/usb1/1-2/1-2:1.%u/%s/%s",
+                                       interface_number, subsystem, name);
+    device->subsystem          = subsystem;
+    device->name               = name;
+    device->sysfs_path         = *out_sysfs_path;
+    device->driver             = driver;
+    device->physdev_vid        = vid;
+    device->physdev_pid        = pid;
+    device->interface_class    = 0xff;
+    device->interface_subclass = 0xff;
+    device->interface_protocol = 0xff;
+    device->interface_number   = interface_number;
+}
+
+static void
+test_apply_full (void)
+{
+    GArray           *rules;
+    GHashTable       *properties;
+    MMUdevRuleDevice  device;
+    gchar            *sysfs_path;
+
+    rules = load_full_rules ();
+
+    /* ZTE MF626 secondary port */
+    device_init (&device, "tty", "ttyUSB2", "option", 0x19d2, 0x0031, 0x03, &sysfs_path);
+    properties = properties_new ();
+    mm_kernel_device_generic_rules_apply (rules, &device, properties);
+    g_assert_cmpstr (g_hash_table_lookup (properties, "ID_MM_CANDIDATE"), ==, "1");
+    g_assert_cmpstr (g_hash_table_lookup (properties, ".MM_USBIFNUM"), ==, "03");
+    g_assert_cmpstr (g_hash_table_lookup (properties, "ID_MM_ZTE_PORT_TYPE_MODEM"), ==, "1");
+    g_assert (!g_hash_table_lookup (properties, "ID_MM_DEVICE_IGNORE"));
+    g_hash_table_unref (properties);
+    g_free (sysfs_path);
+
+    /* Blacklisted device */
+    device_init (&device, "tty", "ttyUSB0", "cdc_acm", 0x05b8, 0x0000, 0x00, &sysfs_path);
+    properties = properties_new ();
+    mm_kernel_device_generic_rules_apply (rules, &device, properties);
+    g_assert_cmpstr (g_hash_table_lookup (properties, "ID_MM_DEVICE_IGNORE"), ==, "1");
+    g_hash_table_unref (properties);
+    g_free (sysfs_path);
+
+    /* VT, not candidate */
+    device_init (&device, "vc", "vcs1", NULL, 0, 0, 0x00, &sysfs_path);
+    properties = properties_new ();
+    mm_kernel_device_generic_rules_apply (rules, &device, properties);
+    g_assert (!g_hash_table_lookup (properties, "ID_MM_CANDIDATE"));
+    g_hash_table_unref (properties);
+    g_free (sysfs_path);
+
+    g_array_unref (rules);
+}
+
+/************************************************************/
+/* Compare with plain linear rule processing */
+
+#define RANDOM_DEVICES 2000
+
+static const gchar *test_drivers[] = { "option", "qcserial", "qmi_wwan", "cdc_acm", "cdc_ether", "cdc_mbim", "sierra", NULL };
+static const gchar *test_subsystems[] = { "tty", "net", "usbmisc" };
+static const gchar *test_names[] = { "ttyUSB0", "wwan0", "cdc-wdm0" };
+
+typedef struct {
+    guint16 vid;
+    guint16 pid;
+} TestIds;
+
+static GArray *
+collect_rules_ids (GArray *rules)
+{
+    GArray *ids;
+    guint   i;
+
+    /* Vendor/product IDs given in the rules, so that random devices match
+     * some of them */
+    ids = g_array_new (FALSE, FALSE, sizeof (TestIds));
+    for (i = 0; i < rules->len; i++) {
+        MMUdevRule *rule;
+        TestIds     rule_ids = { 0, 0 };
+        guint       j;
+
+        rule = &g_array_index (rules, MMUdevRule, i);
+        for (j = 0; rule->conditions && j < rule->conditions->len; j++) {
+            MMUdevRuleMatch *match;
+
+            match = &g_array_index (rule->conditions, MMUdevRuleMatch, j);
+            if (!match->numeric_value_valid)
+                continue;
+            if (match->compiled_parameter == MM_UDEV_RULE_PARAMETER_ATTR_ID_VENDOR)
+                rule_ids.vid = match->numeric_value;
+            else if (match->compiled_parameter == MM_UDEV_RULE_PARAMETER_ATTR_ID_PRODUCT)
+                rule_ids.pid = match->numeric_value;
+        }
+        if (rule_ids.vid || rule_ids.pid)
+            g_array_append_val (ids, rule_ids);
+    }
+    return ids;
+}
+
+static void
+random_device (MMUdevRuleDevice  *device,
+               GArray            *ids,
+               gchar            **out_sysfs_path)
+{
+    TestIds *rule_ids;
+    guint    subsystem_i;
+    guint16  vid;
+    guint16  pid;
+
+    rule_ids = &g_array_index (ids, TestIds, g_test_rand_int_range (0, ids->len));
+    vid = rule_ids->vid ? rule_ids->vid : (guint16) g_test_rand_int_range (1, 0x10000);
+    pid = rule_ids->pid ? rule_ids->pid : (guint16) g_test_rand_int_range (0, 0x10000);
+
+    subsystem_i = g_test_rand_int_range (0, G_N_ELEMENTS (test_subsystems));
+    device_init (device,
+                 test_subsystems[subsystem_i],
+                 test_names[subsystem_i],
+                 test_drivers[g_test_rand_int_range (0, G_N_ELEMENTS (test_drivers))],
+                 vid,
+                 pid,
+                 (guint8) g_test_rand_int_range (0, 12),
+                 out_sysfs_path);
+}
+
+static GPtrArray *
+disable_dispatch (GArray *rules)
+{
+    GPtrArray *saved;
+    guint      i;
+
+    saved = g_ptr_array_sized_new (rules->len);
+    for (i = 0; i < rules->len; i++) {
+        MMUdevRule *rule;
+
+        rule = &g_array_index (rules, MMUdevRule, i);
+        g_ptr_array_add (saved, rule->dispatch);
+        rule->dispatch = NULL;
+    }
+    return saved;
+}
+
+static void
+restore_dispatch (GArray    *rules,
+                  GPtrArray *saved)
+{
+    guint i;
+
+    for (i = 0; i < rules->len; i++)
+        g_array_index (rules, MMUdevRule, i).dispatch = g_ptr_array_index (saved, i);
+    g_ptr_array_unref (saved);
+}
+
+static void
+assert_same_properties (GHashTable *a,
+                        GHashTable *b)
+{
+    GHashTableIter iter;
+    gpointer       key;
+    gpointer       value;
+
+    g_assert_cmpuint (g_hash_table_size (a), ==, g_hash_table_size (b));
+    g_hash_table_iter_init (&iter, a);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_assert_cmpstr ((const gchar *) value, ==, (const gchar *) g_hash_table_lookup (b, key));
+}
+
+static void
+test_compare_linear (void)
+{
+    GArray *rules;
+    GArray *ids;
+    guint   i;
+    guint   n_dispatch = 0;
+
+    rules = load_full_rules ();
+    ids = collect_rules_ids (rules);
+    g_assert_cmpuint (ids->len, >, 0);
+
+    for (i = 0; i < rules->len; i++) {
+        if (g_array_index (rules, MMUdevRule, i).dispatch)
+            n_dispatch++;
+    }
+    g_assert_cmpuint (n_dispatch, >, 0);
+
+    for (i = 0; i < RANDOM_DEVICES; i++) {
+        MMUdevRuleDevice  device;
+        gchar            *sysfs_path;
+        GHashTable       *indexed;
+        GHashTable       *linear;
+        GPtrArray        *saved;
+
+        random_device (&device, ids, &sysfs_path);
+
+        indexed = properties_new ();
+        mm_kernel_device_generic_rules_apply (rules, &device, indexed);
+
+        saved = disable_dispatch (rules);
+        linear = properties_new ();
+        mm_kernel_device_generic_rules_apply (rules, &device, linear);
+        restore_dispatch (rules, saved);
+
+        assert_same_properties (indexed, linear);
+
+        g_hash_table_unref (indexed);
+        g_hash_table_unref (linear);
+        g_free (sysfs_path);
+    }
+
+    g_array_unref (ids);
+    g_array_unref (rules);
+}
+
+/************************************************************/
+
+#define BENCHMARK_DEVICES 20000
+
+static void
+test_apply_benchmark (void)
+{
+    GArray           *rules;
+    GArray           *ids;
+    MMUdevRuleDevice *devices;
+    gchar           **sysfs_paths;
+    GPtrArray        *saved;
+    gdouble           linear_time;
+    gdouble           indexed_time;
+    guint             i;
+
+    rules = load_full_rules ();
+    ids = collect_rules_ids (rules);
+
+    devices = g_new (MMUdevRuleDevice, BENCHMARK_DEVICES);
+    sysfs_paths = g_new0 (gchar *, BENCHMARK_DEVICES + 1);
+    for (i = 0; i < BENCHMARK_DEVICES; i++)
+        random_device (&devices[i], ids, &sysfs_paths[i]);
+
+    saved = disable_dispatch (rules);
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_DEVICES; i++) {
+        GHashTable *properties;
+
+        properties = properties_new ();
+        mm_kernel_device_generic_rules_apply (rules, &devices[i], properties);
+        g_hash_table_unref (properties);
+    }
+    linear_time = g_test_timer_elapsed ();
+    restore_dispatch (rules, saved);
+
+    g_test_timer_start ();
+    for (i = 0; i < BENCHMARK_DEVICES; i++) {
+        GHashTable *properties;
+
+        properties = properties_new ();
+        mm_kernel_device_generic_rules_apply (rules, &devices[i], properties);
+        g_hash_table_unref (properties);
+    }
+    indexed_time = g_test_timer_elapsed ();
+
+    g_test_message ("%u devices, %u rules: linear %.3f us/device, indexed %.3f us/device",
+                    BENCHMARK_DEVICES, rules->len,
+                    (linear_time * 1e6) / BENCHMARK_DEVICES,
+                    (indexed_time * 1e6) / BENCHMARK_DEVICES);
+    g_test_minimized_result ((indexed_time * 1e6) / BENCHMARK_DEVICES,
+                             "udev rules applied: %.3f us/device",
+                             (indexed_time * 1e6) / BENCHMARK_DEVICES);
+
+    g_strfreev (sysfs_paths);
+    g_free (devices);
+    g_array_unref (ids);
+    g_array_unref (rules);
+}
+
 /************************************************************/
 
 void
@@ -73,6 +469,11 @@ int main (int argc, char **argv)
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/MM/test-udev-rules/load-cleanup-core", test_load_cleanup_core);
+    g_test_add_func ("/MM/test-udev-rules/apply-full",        test_apply_full);
+    g_test_add_func ("/MM/test-udev-rules/compare-linear",    test_compare_linear);
+
+    if (g_test_perf ())
+        g_test_add_func ("/MM/test-udev-rules/benchmark", test_apply_benchmark);
 
     return g_test_run ();
 }
@@ -0,0 +1,200 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details:
+ */
+
+#include <glib.h>
+#include <glib-object.h>
+#include <string.h>
+#include <locale.h>
+
+/* Define symbol to enable test message traces */
+#undef ENABLE_TEST_MESSAGE_TRACES
+
+#include "mm-uevent-queue.h"
+#include "mm-log.h"
+
+#define TTY_PATH "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-1/1-1:1.0/ttyUSB0/tty/ttyUSB0"
+#define NET_PATH "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-1/1-1:1.4/net/wwan0"
+#define USB_PATH "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-1"
+
+/************************************************************/
+
+typedef struct {
+    GHashTable *devices;
+    GString    *processed;
+} TestContext;
+
+/* Devices are plain objects, named after their sysfs path */
+static GObject *
+test_device (TestContext *ctx,
+             const gchar *sysfs_path)
+{
+    GObject *device;
+
+    device = g_hash_table_lookup (ctx->devices, sysfs_path);
+    if (!device) {
+        device = g_object_new (G_TYPE_OBJECT, NULL);
+        g_object_set_data_full (device, "name", g_path_get_basename (sysfs_path), g_free);
+        g_hash_table_insert (ctx->devices, (gpointer) sysfs_path, device);
+    }
+    return device;
+}
+
+static void
+test_push (TestContext   *ctx,
+           MMUeventQueue *queue,
+           const gchar   *sysfs_path,
+           gboolean       remove)
+{
+    mm_uevent_queue_push (queue, sysfs_path, test_device (ctx, sysfs_path), remove);
+}
+
+static void
+test_process (GObject     *device,
+              gboolean     remove,
+              gboolean     add,
+              TestContext *ctx)
+{
+    const gchar *name;
+
+    name = g_object_get_data (device, "name");
+    if (remove)
+        g_string_append_printf (ctx->processed, "%s-%s ", name, "remove");
+    if (add)
+        g_string_append_printf (ctx->processed, "%s-%s ", name, "add");
+}
+
+typedef struct {
+    const gchar *sysfs_path;
+    gboolean     remove;
+} TestUevent;
+
+static void
+common_test_flush (const TestUevent *uevents,
+                   guint             n_uevents,
+                   guint             expected_length,
+                   const gchar      *expected)
+{
+    TestContext    ctx;
+    MMUeventQueue *queue;
+    guint          i;
+
+    ctx.devices = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+    ctx.processed = g_string_new ("");
+
+    queue = mm_uevent_queue_new ();
+    for (i = 0; i < n_uevents; i++)
+        test_push (&ctx, queue, uevents[i].sysfs_path, uevents[i].remove);
+    g_assert_cmpuint (mm_uevent_queue_get_length (queue), ==, expected_length);
+
+    mm_uevent_queue_flush (queue, (MMUeventQueueProcessFunc) test_process, &ctx);
+    g_assert_cmpuint (mm_uevent_queue_get_length (queue), ==, 0);
+    g_assert_cmpstr (g_strchomp (ctx.processed->str), ==, expected);
+
+    mm_uevent_queue_free (queue);
+    g_string_free (ctx.processed, TRUE);
+    g_hash_table_destroy (ctx.devices);
+}
+
+/************************************************************/
+
+static void
+test_add_remove (void)
+{
+    static const TestUevent uevents[] = {
+        { TTY_PATH, FALSE },
+        { TTY_PATH, FALSE },
+        { NET_PATH, FALSE },
+        { TTY_PATH, TRUE  },
+    };
+
+    /* The add of the tty is cancelled, but the remove is still reported */
+    common_test_flush (uevents, G_N_ELEMENTS (uevents), 2, "wwan0-add ttyUSB0-remove");
+}
+
+static void
+test_remove_add (void)
+{
+    static const TestUevent uevents[] = {
+        { TTY_PATH, TRUE  },
+        { TTY_PATH, FALSE },
+        { TTY_PATH, TRUE  },
+        { TTY_PATH, FALSE },
+    };
+
+    /* The device was recreated, so it is still removed and added again */
+    common_test_flush (uevents, G_N_ELEMENTS (uevents), 1, "ttyUSB0-remove ttyUSB0-add");
+}
+
+static void
+test_parent_remove (void)
+{
+    static const TestUevent uevents[] = {
+        { TTY_PATH, TRUE  },
+        { USB_PATH, TRUE  },
+        { TTY_PATH, FALSE },
+    };
+
+    /* The tty added back must be processed after its parent is removed,
+     * or the parent removal would remove the modem just added again */
+    common_test_flush (uevents, G_N_ELEMENTS (uevents), 2, "1-1-remove ttyUSB0-remove ttyUSB0-add");
+}
+
+static void
+test_parent_remove_multiple (void)
+{
+    static const TestUevent uevents[] = {
+        { TTY_PATH, TRUE  },
+        { NET_PATH, TRUE  },
+        { USB_PATH, TRUE  },
+        { NET_PATH, FALSE },
+        { TTY_PATH, FALSE },
+    };
+
+    common_test_flush (uevents, G_N_ELEMENTS (uevents), 3, "1-1-remove wwan0-remove wwan0-add ttyUSB0-remove ttyUSB0-add");
+}
+
+/************************************************************/
+
+void
+_mm_log (const char *loc,
+         const char *func,
+         guint32 level,
+         const char *fmt,
+         ...)
+{
+#if defined ENABLE_TEST_MESSAGE_TRACES
+    /* Dummy log function */
+    va_list args;
+    gchar *msg;
+
+    va_start (args, fmt);
+    msg = g_strdup_vprintf (fmt, args);
+    va_end (args);
+    g_print ("%s\n", msg);
+    g_free (msg);
+#endif
+}
+
+int main (int argc, char **argv)
+{
+    setlocale (LC_ALL, "");
+
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/MM/uevent-queue/add-remove",               test_add_remove);
+    g_test_add_func ("/MM/uevent-queue/remove-add",               test_remove_add);
+    g_test_add_func ("/MM/uevent-queue/parent-remove",            test_parent_remove);
+    g_test_add_func ("/MM/uevent-queue/parent-remove-multiple",   test_parent_remove_multiple);
+
+    return g_test_run ();
+}
@@ -225,9 +225,11 @@ start_cb (void)
 
     /* Set common response parser */
     mm_port_serial_at_set_response_parser (MM_PORT_SERIAL_AT (port),
-                                           mm_serial_parser_v1_parse,
-                                           mm_serial_parser_v1_new (),
-                                           mm_serial_parser_v1_destroy);
+                                           mm_serial_parser_v2_parse,
+                                           mm_serial_parser_v2_new (),
+                                           mm_serial_parser_v2_destroy);
+    mm_port_serial_at_set_response_reset (MM_PORT_SERIAL_AT (port),
+                                          mm_serial_parser_v2_reset);
 
     /* Try to open the port... */
     g_print ("opening serial port...\n");